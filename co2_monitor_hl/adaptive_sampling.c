@@ -0,0 +1,91 @@
+#include "adaptive_sampling.h"
+
+#include <math.h>
+#include <stddef.h>
+
+// Sensor interval and read period per level, fastest first
+static const uint16_t levels[] = { 2, 10, 20, 60, 180, 300 };
+#define LEVEL_COUNT (sizeof(levels) / sizeof(levels[0]))
+
+static size_t level;
+static float anchorCo2 = NAN;
+static uint32_t anchorSeconds;
+static uint32_t quietSinceSeconds;
+static bool quiet;
+static ADAPTIVE_SAMPLING_STATE state;
+
+void adaptiveSampling_init(uint16_t intervalSeconds)
+{
+	level = 0;
+	while (level + 1 < LEVEL_COUNT && levels[level + 1] <= intervalSeconds)
+	{
+		level++;
+	}
+
+	anchorCo2 = NAN;
+	quiet = false;
+	state = (ADAPTIVE_SAMPLING_STATE){ .intervalSeconds = levels[level] };
+}
+
+uint16_t adaptiveSampling_update(float co2, float alertLevel, uint32_t nowSeconds)
+{
+	float distance = isnan(alertLevel) ? INFINITY : fabsf(co2 - alertLevel);
+	bool wasQuiet = quiet;
+
+	if (isnan(co2))
+	{
+		return levels[level];
+	}
+	state.samples++;
+
+	if (isnan(anchorCo2))
+	{
+		anchorCo2 = co2;
+		anchorSeconds = nowSeconds;
+	}
+	else if (nowSeconds - anchorSeconds >= ADAPTIVE_SAMPLING_RATE_WINDOW_SECONDS)
+	{
+		state.rate = (co2 - anchorCo2) * 60.0f / (float)(nowSeconds - anchorSeconds);
+		anchorCo2 = co2;
+		anchorSeconds = nowSeconds;
+	}
+
+	if (fabsf(state.rate) >= ADAPTIVE_SAMPLING_FAST_RATE || distance <= ADAPTIVE_SAMPLING_ALERT_MARGIN)
+	{
+		// Straight to the fastest level so detection latency is one short interval
+		quiet = false;
+		if (level != 0)
+		{
+			level = 0;
+			state.retunes++;
+		}
+	}
+	else if (fabsf(state.rate) < ADAPTIVE_SAMPLING_QUIET_RATE && distance > 2 * ADAPTIVE_SAMPLING_ALERT_MARGIN)
+	{
+		quiet = true;
+		if (!wasQuiet)
+		{
+			quietSinceSeconds = nowSeconds;
+		}
+		else if (nowSeconds - quietSinceSeconds >= ADAPTIVE_SAMPLING_QUIET_HOLD_SECONDS && level + 1 < LEVEL_COUNT)
+		{
+			// One level at a time, each level is held quiet before the next step
+			level++;
+			state.retunes++;
+			quietSinceSeconds = nowSeconds;
+		}
+	}
+	else
+	{
+		// Inside the hysteresis band, hold the current level
+		quiet = false;
+	}
+
+	state.intervalSeconds = levels[level];
+	return levels[level];
+}
+
+void adaptiveSampling_getState(ADAPTIVE_SAMPLING_STATE* out)
+{
+	*out = state;
+}
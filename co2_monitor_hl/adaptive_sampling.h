@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Rate of change is measured over at least this window so sensor noise at 2 s does not read as a trend
+#define ADAPTIVE_SAMPLING_RATE_WINDOW_SECONDS 60
+// Faster at or above this rate, ppm per minute
+#define ADAPTIVE_SAMPLING_FAST_RATE 40.0f
+// Slower only below this rate, the gap to ADAPTIVE_SAMPLING_FAST_RATE is the hysteresis band
+#define ADAPTIVE_SAMPLING_QUIET_RATE 15.0f
+// Fastest sampling within this distance of the alert level, quiet only beyond twice the distance
+#define ADAPTIVE_SAMPLING_ALERT_MARGIN 100.0f
+// Time a level must stay quiet before stepping one level slower
+#define ADAPTIVE_SAMPLING_QUIET_HOLD_SECONDS 120
+
+typedef struct
+{
+	uint16_t intervalSeconds;
+	float rate;					// ppm per minute over the last window
+	uint32_t retunes;
+	uint32_t samples;
+} ADAPTIVE_SAMPLING_STATE;
+
+/// <summary>
+/// Start at the slowest level that is not slower than intervalSeconds.
+/// </summary>
+void adaptiveSampling_init(uint16_t intervalSeconds);
+
+/// <summary>
+/// Feed a sample taken at nowSeconds (monotonic). Returns the interval to run at, which only
+/// differs from the current one when the level changes.
+/// </summary>
+/// <param name="alertLevel">CO2 alert level, NAN when not set</param>
+uint16_t adaptiveSampling_update(float co2, float alertLevel, uint32_t nowSeconds);
+
+void adaptiveSampling_getState(ADAPTIVE_SAMPLING_STATE* state);
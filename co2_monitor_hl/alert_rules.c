@@ -0,0 +1,209 @@
+#include "alert_rules.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+	uint64_t trueSinceUs;
+	bool pending;
+	bool active;
+} RULE_STATE;
+
+static const char* metricNames[RULE_METRIC_COUNT] = {
+	[RULE_METRIC_CO2] = "co2",
+	[RULE_METRIC_TEMPERATURE] = "temperature",
+	[RULE_METRIC_HUMIDITY] = "humidity",
+	[RULE_METRIC_CO2_SLOPE] = "co2slope",
+};
+
+static const char* actionNames[] = {
+	[RULE_ACTION_BUZZER] = "buzzer",
+	[RULE_ACTION_LED] = "led",
+	[RULE_ACTION_TELEMETRY] = "telemetry",
+	[RULE_ACTION_REPORT] = "report",
+};
+
+static ALERT_RULE rules[ALERT_RULES_MAX];
+static RULE_STATE ruleStates[ALERT_RULES_MAX];
+static size_t ruleCount = 0;
+
+static const char* SkipSpaces(const char* p)
+{
+	while (*p == ' ' || *p == '\t')
+	{
+		p++;
+	}
+	return p;
+}
+
+// Match a name table entry at p, followed by a character in terminators
+static int MatchName(const char** p, const char* const* names, size_t count, const char* terminators)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t length = strlen(names[i]);
+
+		if (strncmp(*p, names[i], length) == 0 && strchr(terminators, (*p)[length]) != NULL)
+		{
+			*p += length;
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+static bool ParseRule(const char* p, const char* end, ALERT_RULE* rule)
+{
+	char* next;
+	int index;
+
+	memset(rule, 0, sizeof(*rule));
+
+	p = SkipSpaces(p);
+	if ((index = MatchName(&p, metricNames, RULE_METRIC_COUNT, " \t<>")) < 0) { return false; }
+	rule->metric = (uint8_t)index;
+
+	p = SkipSpaces(p);
+	if (*p != '<' && *p != '>') { return false; }
+	rule->comparison = *p++ == '>' ? RULE_ABOVE : RULE_BELOW;
+
+	rule->threshold = strtof(p, &next);
+	if (next == p || next > end) { return false; }
+	p = SkipSpaces(next);
+
+	if (strncmp(p, "for ", 4) == 0)
+	{
+		unsigned long seconds = strtoul(p + 4, &next, 10);
+		if (next == p + 4 || next > end || seconds > 86400) { return false; }
+		rule->durationMs = (uint32_t)seconds * 1000u;
+		p = SkipSpaces(next);
+	}
+
+	if ((index = MatchName(&p, actionNames, sizeof(actionNames) / sizeof(actionNames[0]), ":; \t")) < 0) { return false; }
+	rule->action = (uint8_t)index;
+	rule->pattern = 1;
+
+	if (*p == ':')
+	{
+		unsigned long pattern = strtoul(p + 1, &next, 10);
+		if (next == p + 1 || next > end || pattern == 0 || pattern > 10) { return false; }
+		rule->pattern = (uint8_t)pattern;
+		p = next;
+	}
+
+	return SkipSpaces(p) == end;
+}
+
+bool alertRules_compile(const char* text)
+{
+	ALERT_RULE compiled[ALERT_RULES_MAX];
+	size_t count = 0;
+	const char* p = text;
+
+	while (*p)
+	{
+		const char* end = strchr(p, ';');
+		if (end == NULL)
+		{
+			end = p + strlen(p);
+		}
+
+		if (*SkipSpaces(p) != '\0' && SkipSpaces(p) != end)
+		{
+			if (count == ALERT_RULES_MAX || !ParseRule(p, end, &compiled[count]))
+			{
+				return false;
+			}
+			count++;
+		}
+
+		p = *end ? end + 1 : end;
+	}
+
+	memcpy(rules, compiled, count * sizeof(ALERT_RULE));
+	memset(ruleStates, 0, sizeof(ruleStates));
+	ruleCount = count;
+
+	return true;
+}
+
+size_t alertRules_count(void)
+{
+	return ruleCount;
+}
+
+size_t alertRules_evaluate(const float* metrics, uint64_t nowUs, ALERT_RULE_EVENT* events, size_t maxEvents)
+{
+	size_t eventCount = 0;
+
+	for (size_t i = 0; i < ruleCount; i++)
+	{
+		const ALERT_RULE* rule = &rules[i];
+		RULE_STATE* state = &ruleStates[i];
+		float value = metrics[rule->metric];
+		bool holds;
+
+		if (isnan(value))
+		{
+			continue;
+		}
+
+		holds = rule->comparison == RULE_ABOVE ? value > rule->threshold : value < rule->threshold;
+
+		if (!holds)
+		{
+			// Clears as soon as the condition stops holding
+			state->pending = false;
+			if (!state->active)
+			{
+				continue;
+			}
+			state->active = false;
+		}
+		else
+		{
+			if (state->active)
+			{
+				continue;
+			}
+			if (!state->pending)
+			{
+				state->pending = true;
+				state->trueSinceUs = nowUs;
+			}
+			if (nowUs - state->trueSinceUs < (uint64_t)rule->durationMs * 1000u)
+			{
+				continue;
+			}
+			state->active = true;
+		}
+
+		if (eventCount < maxEvents)
+		{
+			events[eventCount++] = (ALERT_RULE_EVENT){ .rule = rule, .index = (uint8_t)i, .active = state->active, .value = value };
+		}
+	}
+
+	return eventCount;
+}
+
+uint32_t alertRules_activeMask(void)
+{
+	uint32_t mask = 0;
+
+	for (size_t i = 0; i < ruleCount; i++)
+	{
+		if (ruleStates[i].active)
+		{
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+}
+
+const char* alertRules_metricName(RULE_METRIC metric)
+{
+	return metric < RULE_METRIC_COUNT ? metricNames[metric] : "unknown";
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ALERT_RULES_MAX 16
+
+typedef enum
+{
+	RULE_METRIC_CO2,
+	RULE_METRIC_TEMPERATURE,
+	RULE_METRIC_HUMIDITY,
+	RULE_METRIC_CO2_SLOPE,		// ppm per minute
+	RULE_METRIC_COUNT
+} RULE_METRIC;
+
+typedef enum
+{
+	RULE_ABOVE,
+	RULE_BELOW
+} RULE_COMPARISON;
+
+typedef enum
+{
+	RULE_ACTION_BUZZER,			// pattern is the number of chirps
+	RULE_ACTION_LED,			// alert LED on while the rule is active
+	RULE_ACTION_TELEMETRY,		// priority alert message
+	RULE_ACTION_REPORT			// active rule mask reported to the device twin
+} RULE_ACTION;
+
+typedef struct
+{
+	uint8_t metric;
+	uint8_t comparison;
+	uint8_t action;
+	uint8_t pattern;
+	float threshold;
+	uint32_t durationMs;		// condition must hold this long before the rule fires
+} ALERT_RULE;
+
+typedef struct
+{
+	const ALERT_RULE* rule;
+	uint8_t index;
+	bool active;				// true when the rule fired, false when it cleared
+	float value;
+} ALERT_RULE_EVENT;
+
+/// <summary>
+/// Compile rule text into the flat rule table. Rules are separated by ';', each one is
+/// "metric op threshold [for seconds] action[:pattern]", for example
+/// "co2 > 1500 for 60 buzzer:3; temperature > 28 for 300 led; co2slope > 50 telemetry; humidity < 25 report".
+/// Metrics: co2, temperature, humidity, co2slope. Ops: > <. Actions: buzzer, led, telemetry, report.
+/// On a parse error the current table is kept.
+/// </summary>
+/// <returns>true when the whole text compiled</returns>
+bool alertRules_compile(const char* text);
+
+size_t alertRules_count(void);
+
+/// <summary>
+/// Evaluate every rule against one sample, O(rules) with no allocation.
+/// </summary>
+/// <param name="metrics">RULE_METRIC_COUNT values, NAN skips rules on that metric</param>
+/// <param name="events">filled with the rules that fired or cleared on this sample</param>
+/// <returns>number of events</returns>
+size_t alertRules_evaluate(const float* metrics, uint64_t nowUs, ALERT_RULE_EVENT* events, size_t maxEvents);
+
+/// <summary>
+/// Bit n set while rule n is active.
+/// </summary>
+uint32_t alertRules_activeMask(void);
+
+const char* alertRules_metricName(RULE_METRIC metric);
@@ -0,0 +1,68 @@
+#include "barometer.h"
+
+#include "./embedded-scd/embedded-common/sensirion_common.h"
+#include "./embedded-scd/embedded-common/sensirion_i2c.h"
+#include <stdint.h>
+
+#define LPS22HH_WHO_AM_I 0x0F
+#define LPS22HH_ID 0xB3
+#define LPS22HH_CTRL_REG2 0x11
+#define LPS22HH_CTRL_REG2_ONE_SHOT 0x01
+#define LPS22HH_CTRL_REG2_IF_ADD_INC 0x10		// register address increments across a multi-byte read
+#define LPS22HH_STATUS 0x27
+#define LPS22HH_STATUS_P_DA 0x01
+#define LPS22HH_LSB_PER_HPA 4096.0f
+#define LPS22HH_ONE_SHOT_MS 20					// one-shot conversion, low-current mode, with margin
+
+// Register writes are two bytes, register and value, and show in the I2C command stats as 0x11xx.
+// The address written before a read is a single byte, those reads count under the preceding command.
+static bool ReadRegisters(uint8_t reg, uint8_t* data, uint16_t count)
+{
+	return sensirion_i2c_write(BAROMETER_I2C_ADDRESS, &reg, 1) == STATUS_OK &&
+		sensirion_i2c_read(BAROMETER_I2C_ADDRESS, data, count) == STATUS_OK;
+}
+
+static bool Probe(void)
+{
+	uint8_t id;
+
+	return ReadRegisters(LPS22HH_WHO_AM_I, &id, 1) && id == LPS22HH_ID;
+}
+
+static bool Start(void)
+{
+	const uint8_t command[] = { LPS22HH_CTRL_REG2, LPS22HH_CTRL_REG2_IF_ADD_INC | LPS22HH_CTRL_REG2_ONE_SHOT };
+
+	return sensirion_i2c_write(BAROMETER_I2C_ADDRESS, command, sizeof(command)) == STATUS_OK;
+}
+
+// STATUS, then PRESS_OUT_XL, _L and _H
+static bool Read(uint8_t* raw)
+{
+	return ReadRegisters(LPS22HH_STATUS, raw, 4);
+}
+
+static bool Decode(const uint8_t* raw, float* values)
+{
+	if (!(raw[0] & LPS22HH_STATUS_P_DA))
+	{
+		return false;
+	}
+	values[0] = (float)((int32_t)((uint32_t)raw[3] << 24 | (uint32_t)raw[2] << 16 | (uint32_t)raw[1] << 8) >> 8) / LPS22HH_LSB_PER_HPA;
+	return true;
+}
+
+static const char* const channels[] = { "Pressure" };
+
+const SENSOR_DRIVER barometerDriver = {
+	.name = "LPS22HH barometer",
+	.channels = channels,
+	.channelCount = 1,
+	.rawBytes = 4,
+	.conversionMs = LPS22HH_ONE_SHOT_MS,
+	.periodMs = 30000,
+	.probe = Probe,
+	.start = Start,
+	.read = Read,
+	.decode = Decode
+};
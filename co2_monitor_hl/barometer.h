@@ -0,0 +1,9 @@
+#pragma once
+
+#include "sensor_registry.h"
+
+// LPS22HH barometer on the SCD30's I2C bus, fitted directly to the bus on the Avnet starter kit Rev2. It is run
+// in one-shot mode so the part sleeps between conversions. One channel, "Pressure" in mbar.
+#define BAROMETER_I2C_ADDRESS 0x5C
+
+extern const SENSOR_DRIVER barometerDriver;
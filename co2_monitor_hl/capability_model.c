@@ -0,0 +1,163 @@
+// Generated by tools/codegen/capability_codegen.py from iot_central/CO2_Monitor_Capability_Model.json, do not edit.
+#include "capability_model.h"
+
+#include <math.h>
+#include <string.h>
+
+#define CAPABILITY_FIXED_LIMIT 1e15
+
+static char* PutUnsigned(char* p, uint64_t value)
+{
+	char digits[20];
+	int count = 0;
+
+	do
+	{
+		digits[count++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value);
+
+	while (count)
+	{
+		*p++ = digits[--count];
+	}
+	return p;
+}
+
+static char* PutInteger(char* p, int64_t value)
+{
+	if (value < 0)
+	{
+		*p++ = '-';
+		return PutUnsigned(p, 0 - (uint64_t)value);
+	}
+	return PutUnsigned(p, (uint64_t)value);
+}
+
+static char* PutNull(char* p)
+{
+	memcpy(p, "null", 4);
+	return p + 4;
+}
+
+// Rounded to a fixed number of decimals. JSON has no NaN, unread values go out as null.
+static char* PutFixed(char* p, double value, int decimals)
+{
+	static const uint64_t scales[] = { 1, 10, 100, 1000, 10000 };
+	uint64_t scaled, fraction;
+
+	if (isnan(value) || fabs(value) >= CAPABILITY_FIXED_LIMIT)
+	{
+		return PutNull(p);
+	}
+
+	scaled = (uint64_t)(fabs(value) * (double)scales[decimals] + 0.5);
+	if (value < 0 && scaled != 0)
+	{
+		*p++ = '-';
+	}
+	p = PutUnsigned(p, scaled / scales[decimals]);
+
+	*p++ = '.';
+	fraction = scaled % scales[decimals];
+	for (int i = decimals - 1; i >= 0; i--)
+	{
+		p[i] = (char)('0' + fraction % 10);
+		fraction /= 10;
+	}
+	return p + decimals;
+}
+
+const CAPABILITY_FIELD capabilityTelemetryFields[CAPABILITY_TELEMETRY_FIELD_COUNT] = {
+	{ "Temperature", CAPABILITY_SCHEMA_FLOAT, offsetof(CAPABILITY_TELEMETRY, temperature) },
+	{ "CO2", CAPABILITY_SCHEMA_FLOAT, offsetof(CAPABILITY_TELEMETRY, co2) },
+	{ "CO2Quality", CAPABILITY_SCHEMA_INTEGER, offsetof(CAPABILITY_TELEMETRY, co2Quality) },
+	{ "Humidity", CAPABILITY_SCHEMA_FLOAT, offsetof(CAPABILITY_TELEMETRY, humidity) },
+	{ "MsgId", CAPABILITY_SCHEMA_INTEGER, offsetof(CAPABILITY_TELEMETRY, msgId) },
+	{ "CapturedAt", CAPABILITY_SCHEMA_LONG, offsetof(CAPABILITY_TELEMETRY, capturedAt) },
+	{ "EnqueueMs", CAPABILITY_SCHEMA_INTEGER, offsetof(CAPABILITY_TELEMETRY, enqueueMs) },
+	{ "DewPoint", CAPABILITY_SCHEMA_FLOAT, offsetof(CAPABILITY_TELEMETRY, dewPoint) },
+	{ "AbsoluteHumidity", CAPABILITY_SCHEMA_FLOAT, offsetof(CAPABILITY_TELEMETRY, absoluteHumidity) },
+	{ "HeatIndex", CAPABILITY_SCHEMA_FLOAT, offsetof(CAPABILITY_TELEMETRY, heatIndex) },
+	{ "IAQ", CAPABILITY_SCHEMA_FLOAT, offsetof(CAPABILITY_TELEMETRY, iaq) }
+};
+
+size_t capability_encodeTelemetry(const CAPABILITY_TELEMETRY* telemetry, char* buffer)
+{
+	char* p = buffer;
+
+	memcpy(p, "{\"Temperature\":", 15);
+	p += 15;
+	p = PutFixed(p, telemetry->temperature, 2);
+
+	memcpy(p, ",\"CO2\":", 7);
+	p += 7;
+	p = PutFixed(p, telemetry->co2, 2);
+
+	memcpy(p, ",\"CO2Quality\":", 14);
+	p += 14;
+	p = PutInteger(p, telemetry->co2Quality);
+
+	memcpy(p, ",\"Humidity\":", 12);
+	p += 12;
+	p = PutFixed(p, telemetry->humidity, 2);
+
+	memcpy(p, ",\"MsgId\":", 9);
+	p += 9;
+	p = PutInteger(p, telemetry->msgId);
+
+	memcpy(p, ",\"CapturedAt\":", 14);
+	p += 14;
+	p = PutInteger(p, telemetry->capturedAt);
+
+	memcpy(p, ",\"EnqueueMs\":", 13);
+	p += 13;
+	p = PutInteger(p, telemetry->enqueueMs);
+
+	memcpy(p, ",\"DewPoint\":", 12);
+	p += 12;
+	p = PutFixed(p, telemetry->dewPoint, 2);
+
+	memcpy(p, ",\"AbsoluteHumidity\":", 20);
+	p += 20;
+	p = PutFixed(p, telemetry->absoluteHumidity, 2);
+
+	memcpy(p, ",\"HeatIndex\":", 13);
+	p += 13;
+	p = PutFixed(p, telemetry->heatIndex, 2);
+
+	memcpy(p, ",\"IAQ\":", 7);
+	p += 7;
+	p = PutFixed(p, telemetry->iaq, 2);
+
+	*p++ = '}';
+	*p = '\0';
+	return (size_t)(p - buffer);
+}
+
+const CAPABILITY_FIELD capabilityVentilationTelemetryFields[CAPABILITY_VENTILATION_TELEMETRY_FIELD_COUNT] = {
+	{ "AirChangesPerHour", CAPABILITY_SCHEMA_FLOAT, offsetof(CAPABILITY_VENTILATION_TELEMETRY, airChangesPerHour) },
+	{ "CO2GenerationPpmPerHour", CAPABILITY_SCHEMA_FLOAT, offsetof(CAPABILITY_VENTILATION_TELEMETRY, co2GenerationPpmPerHour) },
+	{ "Occupancy", CAPABILITY_SCHEMA_FLOAT, offsetof(CAPABILITY_VENTILATION_TELEMETRY, occupancy) }
+};
+
+size_t capability_encodeVentilationTelemetry(const CAPABILITY_VENTILATION_TELEMETRY* telemetry, char* buffer)
+{
+	char* p = buffer;
+
+	memcpy(p, "{\"AirChangesPerHour\":", 21);
+	p += 21;
+	p = PutFixed(p, telemetry->airChangesPerHour, 2);
+
+	memcpy(p, ",\"CO2GenerationPpmPerHour\":", 27);
+	p += 27;
+	p = PutFixed(p, telemetry->co2GenerationPpmPerHour, 2);
+
+	memcpy(p, ",\"Occupancy\":", 13);
+	p += 13;
+	p = PutFixed(p, telemetry->occupancy, 2);
+
+	*p++ = '}';
+	*p = '\0';
+	return (size_t)(p - buffer);
+}
@@ -0,0 +1,101 @@
+// Generated by tools/codegen/capability_codegen.py from iot_central/CO2_Monitor_Capability_Model.json, do not edit.
+#pragma once
+
+#include "dx_device_twins.h"
+#include "dx_direct_methods.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+	CAPABILITY_SCHEMA_FLOAT,
+	CAPABILITY_SCHEMA_DOUBLE,
+	CAPABILITY_SCHEMA_INTEGER,
+	CAPABILITY_SCHEMA_LONG,
+	CAPABILITY_SCHEMA_BOOLEAN,
+	CAPABILITY_SCHEMA_STRING,
+} CAPABILITY_SCHEMA;
+
+typedef struct
+{
+	const char* name;
+	CAPABILITY_SCHEMA schema;
+	size_t offset;
+} CAPABILITY_FIELD;
+
+// Telemetry, in model order
+typedef struct
+{
+	float temperature;
+	float co2;
+	int32_t co2Quality;
+	float humidity;
+	int32_t msgId;
+	int64_t capturedAt;
+	int32_t enqueueMs;
+	float dewPoint;
+	float absoluteHumidity;
+	float heatIndex;
+	float iaq;
+} CAPABILITY_TELEMETRY;
+
+#define CAPABILITY_TELEMETRY_FIELD_COUNT 11
+#define CAPABILITY_TELEMETRY_MAX_BYTES 332		// longest encoding, terminator included
+
+extern const CAPABILITY_FIELD capabilityTelemetryFields[CAPABILITY_TELEMETRY_FIELD_COUNT];
+
+/// <summary>
+/// Encode telemetry as the model's JSON message. Floating point values are written with fixed decimals,
+/// NaN as null. buffer must hold CAPABILITY_TELEMETRY_MAX_BYTES.
+/// </summary>
+/// <returns>length of the message, excluding the terminator</returns>
+size_t capability_encodeTelemetry(const CAPABILITY_TELEMETRY* telemetry, char* buffer);
+
+// Ventilation telemetry, in model order
+typedef struct
+{
+	float airChangesPerHour;
+	float co2GenerationPpmPerHour;
+	float occupancy;
+} CAPABILITY_VENTILATION_TELEMETRY;
+
+#define CAPABILITY_VENTILATION_TELEMETRY_FIELD_COUNT 3
+#define CAPABILITY_VENTILATION_TELEMETRY_MAX_BYTES 124		// longest encoding, terminator included
+
+extern const CAPABILITY_FIELD capabilityVentilationTelemetryFields[CAPABILITY_VENTILATION_TELEMETRY_FIELD_COUNT];
+
+/// <summary>
+/// Encode telemetry as the model's JSON message. Floating point values are written with fixed decimals,
+/// NaN as null. buffer must hold CAPABILITY_VENTILATION_TELEMETRY_MAX_BYTES.
+/// </summary>
+/// <returns>length of the message, excluding the terminator</returns>
+size_t capability_encodeVentilationTelemetry(const CAPABILITY_VENTILATION_TELEMETRY* telemetry, char* buffer);
+
+// Device twin bindings, writable properties take their handler
+#define CAPABILITY_TWIN_COUNT 18
+#define CAPABILITY_TWIN_WRITABLE_COUNT 10
+#define CAPABILITY_TWIN_DESIRED_CO2_ALERT_LEVEL(handlerFunction) { .twinProperty = "DesiredCO2AlertLevel", .twinType = DX_TYPE_FLOAT, .handler = handlerFunction }
+#define CAPABILITY_TWIN_DESIRED_CO2_ALERT_HYSTERESIS(handlerFunction) { .twinProperty = "DesiredCO2AlertHysteresis", .twinType = DX_TYPE_FLOAT, .handler = handlerFunction }
+#define CAPABILITY_TWIN_DESIRED_CO2_ALERT_CADENCE_MS(handlerFunction) { .twinProperty = "DesiredCO2AlertCadenceMs", .twinType = DX_TYPE_INT, .handler = handlerFunction }
+#define CAPABILITY_TWIN_ACTUAL_CO2_LEVEL { .twinProperty = "ActualCO2Level", .twinType = DX_TYPE_FLOAT }
+#define CAPABILITY_TWIN_DESIRED_ALERT_RULES(handlerFunction) { .twinProperty = "DesiredAlertRules", .twinType = DX_TYPE_STRING, .handler = handlerFunction }
+#define CAPABILITY_TWIN_ALERT_RULES_ACTIVE { .twinProperty = "AlertRulesActive", .twinType = DX_TYPE_INT }
+#define CAPABILITY_TWIN_DESIRED_TWIN_WINDOW_MS(handlerFunction) { .twinProperty = "DesiredTwinWindowMs", .twinType = DX_TYPE_INT, .handler = handlerFunction }
+#define CAPABILITY_TWIN_DESIRED_ROOM_VOLUME(handlerFunction) { .twinProperty = "DesiredRoomVolume", .twinType = DX_TYPE_FLOAT, .handler = handlerFunction }
+#define CAPABILITY_TWIN_DESIRED_REFERENCE_TEMPERATURE(handlerFunction) { .twinProperty = "DesiredReferenceTemperature", .twinType = DX_TYPE_FLOAT, .handler = handlerFunction }
+#define CAPABILITY_TWIN_TEMPERATURE_OFFSET { .twinProperty = "TemperatureOffset", .twinType = DX_TYPE_FLOAT }
+#define CAPABILITY_TWIN_DESIRED_CO2_AUTO_CALIBRATION(handlerFunction) { .twinProperty = "DesiredCO2AutoCalibration", .twinType = DX_TYPE_BOOL, .handler = handlerFunction }
+#define CAPABILITY_TWIN_DESIRED_FRESH_AIR_CALIBRATION(handlerFunction) { .twinProperty = "DesiredFreshAirCalibration", .twinType = DX_TYPE_STRING, .handler = handlerFunction }
+#define CAPABILITY_TWIN_CO2_CALIBRATION_PHASE { .twinProperty = "CO2CalibrationPhase", .twinType = DX_TYPE_INT }
+#define CAPABILITY_TWIN_LAST_CO2_CALIBRATION_AT { .twinProperty = "LastCO2CalibrationAt", .twinType = DX_TYPE_INT }
+#define CAPABILITY_TWIN_LAST_CO2_CALIBRATION_RESULT { .twinProperty = "LastCO2CalibrationResult", .twinType = DX_TYPE_INT }
+#define CAPABILITY_TWIN_LAST_CO2_CALIBRATION_CORRECTION { .twinProperty = "LastCO2CalibrationCorrection", .twinType = DX_TYPE_FLOAT }
+#define CAPABILITY_TWIN_DESIRED_AMBIENT_PRESSURE(handlerFunction) { .twinProperty = "DesiredAmbientPressure", .twinType = DX_TYPE_FLOAT, .handler = handlerFunction }
+#define CAPABILITY_TWIN_AMBIENT_PRESSURE { .twinProperty = "AmbientPressure", .twinType = DX_TYPE_FLOAT }
+
+// Direct method bindings
+#define CAPABILITY_METHOD_COUNT 3
+#define CAPABILITY_METHOD_FORCE_CO2_RECALIBRATION(handlerFunction) { .methodName = "ForceCO2Recalibration", .handler = handlerFunction }
+#define CAPABILITY_METHOD_CANCEL_CO2_RECALIBRATION(handlerFunction) { .methodName = "CancelCO2Recalibration", .handler = handlerFunction }
+#define CAPABILITY_METHOD_GET_CO2_CALIBRATION_HISTORY(handlerFunction) { .methodName = "GetCO2CalibrationHistory", .handler = handlerFunction }
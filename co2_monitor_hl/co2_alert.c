@@ -0,0 +1,59 @@
+#include "co2_alert.h"
+
+#include <math.h>
+
+static CO2_ALERT_CONFIG alertConfig = { .hysteresisPpm = 50.0f, .minHoldMs = 60000, .buzzerOnMs = 500, .buzzerCadenceMs = 10000, .maxInvalidReadings = 5 };
+static bool active = false;
+static uint64_t raisedUs;
+static uint32_t invalidReadings = 0;
+
+void co2Alert_configure(const CO2_ALERT_CONFIG* config)
+{
+	alertConfig = *config;
+}
+
+const CO2_ALERT_CONFIG* co2Alert_getConfig(void)
+{
+	return &alertConfig;
+}
+
+CO2_ALERT_EVENT co2Alert_evaluate(float co2, float alertLevel, uint64_t nowUs)
+{
+	// Without readings the level is unknown, the alert is not left sounding on a stale one
+	if (isnan(co2))
+	{
+		if (active && ++invalidReadings >= alertConfig.maxInvalidReadings)
+		{
+			active = false;
+			return CO2_ALERT_CLEARED;
+		}
+		return CO2_ALERT_NONE;
+	}
+	invalidReadings = 0;
+
+	if (isnan(alertLevel))
+	{
+		return CO2_ALERT_NONE;
+	}
+
+	if (!active && co2 > alertLevel)
+	{
+		active = true;
+		raisedUs = nowUs;
+		invalidReadings = 0;
+		return CO2_ALERT_RAISED;
+	}
+
+	if (active && co2 < alertLevel - alertConfig.hysteresisPpm && nowUs - raisedUs >= (uint64_t)alertConfig.minHoldMs * 1000u)
+	{
+		active = false;
+		return CO2_ALERT_CLEARED;
+	}
+
+	return CO2_ALERT_NONE;
+}
+
+bool co2Alert_isActive(void)
+{
+	return active;
+}
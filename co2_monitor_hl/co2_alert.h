@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+	float hysteresisPpm;		// raised at the alert level, cleared below the level minus this
+	uint32_t minHoldMs;			// a raised alert is not cleared before this
+	uint32_t buzzerOnMs;		// length of one chirp
+	uint32_t buzzerCadenceMs;	// chirp period while raised, 0 chirps once when raised
+	uint32_t maxInvalidReadings;	// a raised alert clears after this many unreadable samples in a row
+} CO2_ALERT_CONFIG;
+
+typedef enum
+{
+	CO2_ALERT_NONE,
+	CO2_ALERT_RAISED,
+	CO2_ALERT_CLEARED
+} CO2_ALERT_EVENT;
+
+void co2Alert_configure(const CO2_ALERT_CONFIG* config);
+
+const CO2_ALERT_CONFIG* co2Alert_getConfig(void);
+
+/// <summary>
+/// Evaluate a new sample. Called once per sample so the alert reacts as soon as the data exists.
+/// </summary>
+/// <param name="co2">NAN for a sample that could not be read or was filtered out</param>
+/// <param name="alertLevel">rising threshold, NAN leaves the alert state unchanged</param>
+CO2_ALERT_EVENT co2Alert_evaluate(float co2, float alertLevel, uint64_t nowUs);
+
+bool co2Alert_isActive(void);
@@ -0,0 +1,317 @@
+#include "co2_calibration.h"
+
+#include "persistent_store.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CLOCK_SET_UTC 1577836800u		// 2020-01-01, earlier means the wall clock was never set
+#define SECONDS_PER_DAY 86400u
+
+static CO2_CALIBRATION_CONFIG calibrationConfig = {
+	.settleSeconds = 120,
+	.windowSeconds = 120,
+	.maxDeviationPpm = 10.0f,
+	.maxDriftPpmPerMinute = 5.0f,
+	.maxCorrectionPpm = 250.0f,
+	.timeoutSeconds = 1800,
+	.scheduleGraceSeconds = 3600
+};
+
+static CO2_CALIBRATION_STATE state = {
+	.scheduleMinute = -1, .windowMeanPpm = NAN, .windowDeviationPpm = NAN, .windowDriftPpmPerMinute = NAN
+};
+
+// Persisted whole, the oldest record is overwritten first
+static struct
+{
+	uint32_t count;		// records ever written
+	CO2_CALIBRATION_RECORD records[CO2_CALIBRATION_HISTORY];
+} history;
+
+static CO2_CALIBRATION_TRIGGER trigger;
+static uint64_t requestUs, settleStartUs;
+static bool settleStarted;
+
+// Window readings, seconds since the request
+static float windowPpm[CO2_CALIBRATION_WINDOW_READINGS];
+static float windowSeconds[CO2_CALIBRATION_WINDOW_READINGS];
+static uint32_t windowNext, windowCount;
+
+void co2Calibration_configure(const CO2_CALIBRATION_CONFIG* config)
+{
+	calibrationConfig = *config;
+}
+
+const CO2_CALIBRATION_CONFIG* co2Calibration_getConfig(void)
+{
+	return &calibrationConfig;
+}
+
+void co2Calibration_init(void)
+{
+	if (!store_readRecord(STORE_RECORD_CO2_CALIBRATION, &history, sizeof(history)))
+	{
+		memset(&history, 0, sizeof(history));
+	}
+}
+
+static void Record(CO2_CALIBRATION_RESULT result, uint32_t utcSeconds)
+{
+	CO2_CALIBRATION_RECORD* record = &history.records[history.count % CO2_CALIBRATION_HISTORY];
+
+	*record = (CO2_CALIBRATION_RECORD){
+		.utcSeconds = utcSeconds,
+		.referencePpm = state.referencePpm,
+		.correctionPpm = isnan(state.windowMeanPpm) ? 0 : (int16_t)lroundf(state.referencePpm - state.windowMeanPpm),
+		.deviationDeciPpm = isnan(state.windowDeviationPpm) ? 0 : (uint16_t)fminf(state.windowDeviationPpm * 10.0f, UINT16_MAX),
+		.result = (uint8_t)result,
+		.trigger = (uint8_t)trigger
+	};
+	history.count++;
+	store_writeRecord(STORE_RECORD_CO2_CALIBRATION, &history, sizeof(history));
+
+	state.runs++;
+	state.phase = CO2_CALIBRATION_IDLE;
+}
+
+bool co2Calibration_request(uint16_t referencePpm, CO2_CALIBRATION_TRIGGER requestTrigger, uint64_t nowUs)
+{
+	if (state.phase != CO2_CALIBRATION_IDLE || referencePpm < CO2_CALIBRATION_MIN_PPM || referencePpm > CO2_CALIBRATION_MAX_PPM)
+	{
+		return false;
+	}
+
+	state.phase = CO2_CALIBRATION_SETTLING;
+	state.referencePpm = referencePpm;
+	state.windowMeanPpm = state.windowDeviationPpm = state.windowDriftPpmPerMinute = NAN;
+	trigger = requestTrigger;
+	requestUs = nowUs;
+	settleStarted = false;
+	windowCount = 0;
+	return true;
+}
+
+bool co2Calibration_cancel(uint32_t utcSeconds)
+{
+	if (state.phase != CO2_CALIBRATION_SETTLING && state.phase != CO2_CALIBRATION_CHECKING)
+	{
+		return false;
+	}
+	Record(CO2_CALIBRATION_CANCELLED, utcSeconds);
+	return true;
+}
+
+bool co2Calibration_setSchedule(const char* schedule)
+{
+	int hours, minutes, referencePpm = CO2_CALIBRATION_FRESH_AIR_PPM, fields;
+	char trailing;
+
+	if (schedule == NULL || schedule[strspn(schedule, " ")] == '\0')
+	{
+		state.scheduleMinute = -1;
+		state.nextScheduledUtc = 0;
+		return true;
+	}
+
+	fields = sscanf(schedule, "%d:%d %d %c", &hours, &minutes, &referencePpm, &trailing);
+	if ((fields != 2 && fields != 3) || hours < 0 || hours > 23 || minutes < 0 || minutes > 59 ||
+		referencePpm < CO2_CALIBRATION_MIN_PPM || referencePpm > CO2_CALIBRATION_MAX_PPM)
+	{
+		return false;
+	}
+
+	state.scheduleMinute = (int16_t)(hours * 60 + minutes);
+	state.scheduleReferencePpm = (uint16_t)referencePpm;
+	state.nextScheduledUtc = 0;
+	return true;
+}
+
+bool co2Calibration_isActive(void)
+{
+	return state.phase != CO2_CALIBRATION_IDLE;
+}
+
+/// <summary>
+/// Start the day's fresh-air run once its time has passed, unless it was missed by more than the grace
+/// </summary>
+static void CheckSchedule(uint64_t nowUs, uint32_t utcSeconds)
+{
+	uint32_t lateSeconds;
+
+	if (state.scheduleMinute < 0 || utcSeconds < CLOCK_SET_UTC)
+	{
+		return;
+	}
+
+	if (state.nextScheduledUtc == 0)
+	{
+		state.nextScheduledUtc = utcSeconds - utcSeconds % SECONDS_PER_DAY + (uint32_t)state.scheduleMinute * 60u;
+		if (state.nextScheduledUtc <= utcSeconds)
+		{
+			state.nextScheduledUtc += SECONDS_PER_DAY;
+		}
+		return;
+	}
+	if (utcSeconds < state.nextScheduledUtc)
+	{
+		return;
+	}
+
+	lateSeconds = utcSeconds - state.nextScheduledUtc;
+	state.nextScheduledUtc += SECONDS_PER_DAY * (1 + lateSeconds / SECONDS_PER_DAY);
+	if (lateSeconds <= calibrationConfig.scheduleGraceSeconds)
+	{
+		co2Calibration_request(state.scheduleReferencePpm, CO2_CALIBRATION_BY_SCHEDULE, nowUs);
+	}
+}
+
+/// <summary>
+/// Add a reading to the window and drop those older than windowSeconds
+/// </summary>
+/// <returns>true when the window spans windowSeconds</returns>
+static bool AddToWindow(float co2, float seconds)
+{
+	uint32_t oldest;
+
+	windowPpm[windowNext] = co2;
+	windowSeconds[windowNext] = seconds;
+	windowNext = (windowNext + 1) % CO2_CALIBRATION_WINDOW_READINGS;
+	if (windowCount < CO2_CALIBRATION_WINDOW_READINGS)
+	{
+		windowCount++;
+	}
+
+	oldest = (windowNext + CO2_CALIBRATION_WINDOW_READINGS - windowCount) % CO2_CALIBRATION_WINDOW_READINGS;
+	while (windowCount > 1 && seconds - windowSeconds[oldest] > calibrationConfig.windowSeconds)
+	{
+		oldest = (oldest + 1) % CO2_CALIBRATION_WINDOW_READINGS;
+		windowCount--;
+	}
+
+	// Missed readings are tolerated, half the window's readings still have to be there
+	return seconds - windowSeconds[oldest] >= calibrationConfig.windowSeconds - CO2_CALIBRATION_INTERVAL_SECONDS &&
+		windowCount >= calibrationConfig.windowSeconds / CO2_CALIBRATION_INTERVAL_SECONDS / 2;
+}
+
+/// <summary>
+/// Least squares line through the window: mean, slope and the standard deviation about the line
+/// </summary>
+static void FitWindow(void)
+{
+	uint32_t oldest = (windowNext + CO2_CALIBRATION_WINDOW_READINGS - windowCount) % CO2_CALIBRATION_WINDOW_READINGS;
+	double n = windowCount, t0 = windowSeconds[oldest];
+	double sumT = 0, sumY = 0, sumTT = 0, sumTY = 0, sumYY = 0, slope, sxx, residual;
+
+	for (uint32_t i = 0; i < windowCount; i++)
+	{
+		uint32_t index = (oldest + i) % CO2_CALIBRATION_WINDOW_READINGS;
+		double t = windowSeconds[index] - t0, y = windowPpm[index];
+
+		sumT += t;
+		sumY += y;
+		sumTT += t * t;
+		sumTY += t * y;
+		sumYY += y * y;
+	}
+
+	sxx = sumTT - sumT * sumT / n;
+	slope = sxx > 0 ? (sumTY - sumT * sumY / n) / sxx : 0;
+	residual = fmax(0.0, (sumYY - sumY * sumY / n) - slope * (sumTY - sumT * sumY / n));
+
+	state.windowMeanPpm = (float)(sumY / n);
+	state.windowDriftPpmPerMinute = (float)(slope * 60);
+	state.windowDeviationPpm = (float)sqrt(residual / fmax(1.0, n - 2));
+}
+
+bool co2Calibration_update(float co2, uint16_t intervalSeconds, uint64_t nowUs, uint32_t utcSeconds, uint16_t* referencePpm)
+{
+	CheckSchedule(nowUs, utcSeconds);
+
+	if (state.phase != CO2_CALIBRATION_SETTLING && state.phase != CO2_CALIBRATION_CHECKING)
+	{
+		return false;
+	}
+	if (nowUs - requestUs > (uint64_t)calibrationConfig.timeoutSeconds * 1000000u)
+	{
+		Record(CO2_CALIBRATION_UNSTABLE, utcSeconds);
+		return false;
+	}
+	if (isnan(co2) || intervalSeconds != CO2_CALIBRATION_INTERVAL_SECONDS)
+	{
+		return false;
+	}
+
+	if (state.phase == CO2_CALIBRATION_SETTLING)
+	{
+		if (!settleStarted)
+		{
+			settleStarted = true;
+			settleStartUs = nowUs;
+		}
+		if (nowUs - settleStartUs < (uint64_t)calibrationConfig.settleSeconds * 1000000u)
+		{
+			return false;
+		}
+		state.phase = CO2_CALIBRATION_CHECKING;
+	}
+
+	if (!AddToWindow(co2, (float)((nowUs - requestUs) / 1e6)))
+	{
+		return false;
+	}
+	FitWindow();
+
+	// An unsteady window slides on until the timeout, a steady one far from the reference will not get closer
+	if (state.windowDeviationPpm > calibrationConfig.maxDeviationPpm ||
+		fabsf(state.windowDriftPpmPerMinute) > calibrationConfig.maxDriftPpmPerMinute)
+	{
+		return false;
+	}
+	if (fabsf(state.referencePpm - state.windowMeanPpm) > calibrationConfig.maxCorrectionPpm)
+	{
+		Record(CO2_CALIBRATION_IMPLAUSIBLE, utcSeconds);
+		return false;
+	}
+
+	state.phase = CO2_CALIBRATION_APPLYING;
+	*referencePpm = state.referencePpm;
+	return true;
+}
+
+void co2Calibration_applied(bool confirmed, uint32_t utcSeconds)
+{
+	if (state.phase == CO2_CALIBRATION_APPLYING)
+	{
+		Record(confirmed ? CO2_CALIBRATION_APPLIED : CO2_CALIBRATION_WRITE_FAILED, utcSeconds);
+	}
+}
+
+size_t co2Calibration_getHistory(CO2_CALIBRATION_RECORD records[CO2_CALIBRATION_HISTORY])
+{
+	size_t count = history.count < CO2_CALIBRATION_HISTORY ? history.count : CO2_CALIBRATION_HISTORY;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		records[i] = history.records[(history.count - count + i) % CO2_CALIBRATION_HISTORY];
+	}
+	return count;
+}
+
+void co2Calibration_getState(CO2_CALIBRATION_STATE* out)
+{
+	*out = state;
+}
+
+const char* co2Calibration_resultName(CO2_CALIBRATION_RESULT result)
+{
+	switch (result)
+	{
+	case CO2_CALIBRATION_APPLIED: return "applied";
+	case CO2_CALIBRATION_UNSTABLE: return "unstable";
+	case CO2_CALIBRATION_IMPLAUSIBLE: return "implausible";
+	case CO2_CALIBRATION_WRITE_FAILED: return "write failed";
+	case CO2_CALIBRATION_CANCELLED:
+	default: return "cancelled";
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Forced recalibration (FRC) of the SCD30 against a known CO2 concentration, requested directly or daily at a
+// fresh-air time. As the datasheet asks the sensor first samples every 2 s for settleSeconds. The reference is
+// then only applied once a window of readings is flat, and close enough to it to be drift rather than a wrong
+// reference or a room that is not at fresh air. No I2C here, the caller writes the reference it is handed.
+// Every outcome goes into a short history kept in mutable storage.
+#define CO2_CALIBRATION_INTERVAL_SECONDS 2		// sensor measurement interval while calibrating
+#define CO2_CALIBRATION_MIN_PPM 400				// FRC references the sensor accepts
+#define CO2_CALIBRATION_MAX_PPM 2000
+#define CO2_CALIBRATION_FRESH_AIR_PPM 420		// scheduled reference when the schedule names none
+#define CO2_CALIBRATION_HISTORY 8
+#define CO2_CALIBRATION_WINDOW_READINGS 64		// windowSeconds / CO2_CALIBRATION_INTERVAL_SECONDS at most
+
+typedef struct
+{
+	uint16_t settleSeconds;			// sampling at CO2_CALIBRATION_INTERVAL_SECONDS before the window opens
+	uint16_t windowSeconds;			// readings tested for stability
+	float maxDeviationPpm;			// standard deviation about the window's line
+	float maxDriftPpmPerMinute;		// slope of the window's line
+	float maxCorrectionPpm;			// reference to window mean, further is taken as a wrong reference
+	uint16_t timeoutSeconds;		// no stable window by then fails the run
+	uint16_t scheduleGraceSeconds;	// a scheduled run found later than this waits for the next day
+} CO2_CALIBRATION_CONFIG;
+
+typedef enum
+{
+	CO2_CALIBRATION_IDLE,
+	CO2_CALIBRATION_SETTLING,		// waiting for the 2 s interval and settleSeconds of it
+	CO2_CALIBRATION_CHECKING,		// sliding the window until it is stable
+	CO2_CALIBRATION_APPLYING		// reference handed out, waiting for co2Calibration_applied
+} CO2_CALIBRATION_PHASE;
+
+typedef enum
+{
+	CO2_CALIBRATION_APPLIED,
+	CO2_CALIBRATION_UNSTABLE,		// no stable window within timeoutSeconds
+	CO2_CALIBRATION_IMPLAUSIBLE,	// stable, but further than maxCorrectionPpm from the reference
+	CO2_CALIBRATION_WRITE_FAILED,
+	CO2_CALIBRATION_CANCELLED
+} CO2_CALIBRATION_RESULT;
+
+typedef enum
+{
+	CO2_CALIBRATION_BY_REQUEST,
+	CO2_CALIBRATION_BY_SCHEDULE
+} CO2_CALIBRATION_TRIGGER;
+
+typedef struct
+{
+	uint32_t utcSeconds;			// when the run finished
+	uint16_t referencePpm;
+	int16_t correctionPpm;			// reference minus window mean, 0 when no window was tested
+	uint16_t deviationDeciPpm;		// window standard deviation, tenths of a ppm
+	uint8_t result;					// CO2_CALIBRATION_RESULT
+	uint8_t trigger;				// CO2_CALIBRATION_TRIGGER
+} CO2_CALIBRATION_RECORD;
+
+typedef struct
+{
+	CO2_CALIBRATION_PHASE phase;
+	uint16_t referencePpm;			// of the run in progress
+	int16_t scheduleMinute;			// UTC minute of day of the fresh-air run, -1 when none
+	uint16_t scheduleReferencePpm;
+	uint32_t nextScheduledUtc;		// 0 until the schedule and the clock are both set
+	float windowMeanPpm;			// last window tested, NAN before
+	float windowDeviationPpm;
+	float windowDriftPpmPerMinute;
+	uint32_t runs;					// history records written since boot
+} CO2_CALIBRATION_STATE;
+
+void co2Calibration_configure(const CO2_CALIBRATION_CONFIG* config);
+
+const CO2_CALIBRATION_CONFIG* co2Calibration_getConfig(void);
+
+/// <summary>
+/// Load the history from mutable storage.
+/// </summary>
+void co2Calibration_init(void);
+
+/// <summary>
+/// Start a run against referencePpm.
+/// </summary>
+/// <returns>false when a run is already in progress or the reference is out of range</returns>
+bool co2Calibration_request(uint16_t referencePpm, CO2_CALIBRATION_TRIGGER trigger, uint64_t nowUs);
+
+/// <summary>
+/// Stop the run in progress, recorded as cancelled. A reference already handed out can no longer be stopped.
+/// </summary>
+bool co2Calibration_cancel(uint32_t utcSeconds);
+
+/// <summary>
+/// Set the daily fresh-air run from "HH:MM" or "HH:MM ppm", UTC. An empty schedule removes it.
+/// </summary>
+/// <returns>false when the text does not parse, the schedule is unchanged then</returns>
+bool co2Calibration_setSchedule(const char* schedule);
+
+/// <summary>
+/// True while a run needs the sensor at CO2_CALIBRATION_INTERVAL_SECONDS.
+/// </summary>
+bool co2Calibration_isActive(void);
+
+/// <summary>
+/// Feed a reading taken at nowUs with the sensor at intervalSeconds. Starts scheduled runs when utcSeconds,
+/// the wall clock, is set.
+/// </summary>
+/// <param name="referencePpm">receives the reference to write</param>
+/// <returns>true when the reference should be written, then nothing more until co2Calibration_applied</returns>
+bool co2Calibration_update(float co2, uint16_t intervalSeconds, uint64_t nowUs, uint32_t utcSeconds, uint16_t* referencePpm);
+
+/// <summary>
+/// The write handed out by co2Calibration_update finished, confirmed by reading it back or not.
+/// </summary>
+void co2Calibration_applied(bool confirmed, uint32_t utcSeconds);
+
+/// <summary>
+/// Copy the history, oldest first.
+/// </summary>
+/// <returns>number of records copied</returns>
+size_t co2Calibration_getHistory(CO2_CALIBRATION_RECORD records[CO2_CALIBRATION_HISTORY]);
+
+void co2Calibration_getState(CO2_CALIBRATION_STATE* state);
+
+const char* co2Calibration_resultName(CO2_CALIBRATION_RESULT result);
@@ -0,0 +1,220 @@
+#include "co2_filter.h"
+
+#include <math.h>
+#include <string.h>
+
+#define MAD_TO_SIGMA 1.4826f	// median absolute deviation to standard deviation for normal noise
+
+static CO2_FILTER_CONFIG filterConfig = {
+	.window = 7,
+	.hampel = true,
+	.hampelSigmas = 3.0f,
+	.hampelFloorPpm = 60.0f,
+	.smoother = CO2_SMOOTH_KALMAN,
+	.kalmanProcessPpm2PerS = 10.0f,
+	.kalmanMeasurementPpm2 = 400.0f,
+	.maxHeldSamples = 3
+};
+
+static float history[CO2_FILTER_MAX_WINDOW];	// arrival order, the oldest at next once full
+static float sorted[CO2_FILTER_MAX_WINDOW];
+static int count = 0;
+static int next = 0;
+static bool kalmanStarted = false;
+static float kalmanEstimate, kalmanVariance;
+static uint64_t lastUs;
+static float lastOutput = NAN;
+static uint8_t heldSamples = 0;
+static CO2_FILTER_STATS stats;
+
+static void Reset(void)
+{
+	count = 0;
+	next = 0;
+	kalmanStarted = false;
+	lastOutput = NAN;
+	heldSamples = 0;
+	memset(&stats, 0, sizeof(stats));
+}
+
+void co2Filter_configure(const CO2_FILTER_CONFIG* config)
+{
+	filterConfig = *config;
+	if (filterConfig.window > CO2_FILTER_MAX_WINDOW)
+	{
+		filterConfig.window = CO2_FILTER_MAX_WINDOW;
+	}
+	filterConfig.window |= 1;
+	Reset();
+}
+
+const CO2_FILTER_CONFIG* co2Filter_getConfig(void)
+{
+	return &filterConfig;
+}
+
+/// <summary>
+/// First index in sorted whose value is not less than value
+/// </summary>
+static int LowerBound(float value)
+{
+	int lo = 0, hi = count;
+
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (sorted[mid] < value)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/// <summary>
+/// Slide the window: drop the oldest reading once full and insert the new one in order
+/// </summary>
+static void Insert(float co2)
+{
+	int at;
+
+	if (count == filterConfig.window)
+	{
+		at = LowerBound(history[next]);
+		memmove(&sorted[at], &sorted[at + 1], (size_t)(count - at - 1) * sizeof(float));
+		count--;
+	}
+
+	at = LowerBound(co2);
+	memmove(&sorted[at + 1], &sorted[at], (size_t)(count - at) * sizeof(float));
+	sorted[at] = co2;
+	count++;
+
+	history[next] = co2;
+	next = (next + 1) % filterConfig.window;
+}
+
+/// <summary>
+/// Median absolute deviation without sorting the deviations. Below the median they ascend walking down from it,
+/// above it walking up, so the median deviation is the k-th smallest of two sorted runs, found by bisection.
+/// </summary>
+static float MedianAbsoluteDeviation(void)
+{
+	int m = count / 2;
+	float median = sorted[m];
+	int belowCount = m, aboveCount = count - m;
+	int k = count / 2;		// 0-based rank of the median deviation
+	int lo = k + 1 - aboveCount > 0 ? k + 1 - aboveCount : 0;
+	int hi = k + 1 < belowCount ? k + 1 : belowCount;
+
+	while (lo <= hi)
+	{
+		int below = (lo + hi) / 2;		// deviations taken from below the median
+		int above = k + 1 - below;
+		float belowLast = below > 0 ? median - sorted[m - below] : -INFINITY;
+		float aboveLast = above > 0 ? sorted[m + above - 1] - median : -INFINITY;
+		float belowNext = below < belowCount ? median - sorted[m - below - 1] : INFINITY;
+		float aboveNext = above < aboveCount ? sorted[m + above] - median : INFINITY;
+
+		if (belowLast > aboveNext)
+		{
+			hi = below - 1;
+		}
+		else if (aboveLast > belowNext)
+		{
+			lo = below + 1;
+		}
+		else
+		{
+			return fmaxf(belowLast, aboveLast);
+		}
+	}
+	return 0.0f;
+}
+
+static float KalmanUpdate(float co2, uint64_t nowUs)
+{
+	float gain;
+
+	if (!kalmanStarted)
+	{
+		kalmanStarted = true;
+		kalmanEstimate = co2;
+		kalmanVariance = filterConfig.kalmanMeasurementPpm2;
+		return co2;
+	}
+
+	// Random walk between samples, the sampling interval is not fixed
+	kalmanVariance += filterConfig.kalmanProcessPpm2PerS * (float)(nowUs - lastUs) / 1e6f;
+	gain = kalmanVariance / (kalmanVariance + filterConfig.kalmanMeasurementPpm2);
+	kalmanEstimate += gain * (co2 - kalmanEstimate);
+	kalmanVariance *= 1.0f - gain;
+	return kalmanEstimate;
+}
+
+float co2Filter_apply(float co2, uint64_t nowUs, uint32_t* quality)
+{
+	float median, threshold, value = co2;
+
+	stats.samples++;
+	*quality = CO2_QUALITY_GOOD;
+
+	if (isnan(co2) || co2 < 0.0f || co2 > CO2_FILTER_MAX_PPM)
+	{
+		stats.invalid++;
+		*quality = CO2_QUALITY_INVALID;
+		if (isnan(lastOutput) || ++heldSamples > filterConfig.maxHeldSamples)
+		{
+			return NAN;
+		}
+		stats.held++;
+		*quality |= CO2_QUALITY_HELD;
+		return lastOutput;
+	}
+	heldSamples = 0;
+
+	Insert(co2);
+	median = sorted[count / 2];
+	if (count < filterConfig.window)
+	{
+		*quality |= CO2_QUALITY_SETTLING;
+	}
+
+	if (filterConfig.hampel && count >= 3)
+	{
+		threshold = fmaxf(filterConfig.hampelSigmas * MAD_TO_SIGMA * MedianAbsoluteDeviation(), filterConfig.hampelFloorPpm);
+		if (fabsf(co2 - median) > threshold)
+		{
+			stats.outliers++;
+			*quality |= CO2_QUALITY_OUTLIER;
+			value = median;
+		}
+	}
+
+	switch (filterConfig.smoother)
+	{
+	case CO2_SMOOTH_MEDIAN:
+		value = median;
+		*quality |= CO2_QUALITY_SMOOTHED;
+		break;
+	case CO2_SMOOTH_KALMAN:
+		value = KalmanUpdate(value, nowUs);
+		*quality |= CO2_QUALITY_SMOOTHED;
+		break;
+	default:
+		break;
+	}
+
+	lastUs = nowUs;
+	lastOutput = value;
+	return value;
+}
+
+void co2Filter_getStats(CO2_FILTER_STATS* out)
+{
+	*out = stats;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Filter stage between the SCD30 driver and everything that consumes CO2: invalid readings are bridged,
+// single-sample spikes rejected by a Hampel test over a sliding window, and the result optionally smoothed
+// by the window median or a scalar Kalman filter. Fixed memory, O(log N) compares per sample.
+#define CO2_FILTER_MAX_WINDOW 15
+#define CO2_FILTER_MAX_PPM 40000.0f		// SCD30 measurement range
+
+// Quality flags, combined
+#define CO2_QUALITY_GOOD 0x00
+#define CO2_QUALITY_INVALID 0x01		// reading was NaN or out of range
+#define CO2_QUALITY_HELD 0x02			// output is the last good value
+#define CO2_QUALITY_OUTLIER 0x04		// reading failed the Hampel test and was replaced by the window median
+#define CO2_QUALITY_SMOOTHED 0x08
+#define CO2_QUALITY_SETTLING 0x10		// window not full yet
+
+typedef enum
+{
+	CO2_SMOOTH_NONE,
+	CO2_SMOOTH_MEDIAN,
+	CO2_SMOOTH_KALMAN
+} CO2_SMOOTHER;
+
+typedef struct
+{
+	uint8_t window;					// odd, up to CO2_FILTER_MAX_WINDOW
+	bool hampel;
+	float hampelSigmas;				// outlier beyond this many robust standard deviations from the median
+	float hampelFloorPpm;			// nothing closer than this is an outlier, keeps sensor noise on a flat signal
+	CO2_SMOOTHER smoother;
+	float kalmanProcessPpm2PerS;	// how fast real CO2 may wander, variance per second between samples
+	float kalmanMeasurementPpm2;	// sensor noise variance
+	uint8_t maxHeldSamples;			// invalid readings bridged with the last output before it goes NAN
+} CO2_FILTER_CONFIG;
+
+typedef struct
+{
+	uint32_t samples;
+	uint32_t invalid;
+	uint32_t held;
+	uint32_t outliers;
+} CO2_FILTER_STATS;
+
+/// <summary>
+/// Replace the configuration and restart the filter.
+/// </summary>
+void co2Filter_configure(const CO2_FILTER_CONFIG* config);
+
+const CO2_FILTER_CONFIG* co2Filter_getConfig(void);
+
+/// <summary>
+/// Filter one reading taken at nowUs.
+/// </summary>
+/// <param name="quality">receives CO2_QUALITY_ flags</param>
+/// <returns>the filtered value, NAN when there is no usable reading</returns>
+float co2Filter_apply(float co2, uint64_t nowUs, uint32_t* quality);
+
+void co2Filter_getStats(CO2_FILTER_STATS* stats);
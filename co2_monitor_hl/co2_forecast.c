@@ -0,0 +1,195 @@
+#include "co2_forecast.h"
+
+#include <math.h>
+#include <string.h>
+
+static CO2_FORECAST_CONFIG forecastConfig = {
+	.windowSeconds = 300,
+	.leadSeconds = 600,
+	.clipSigmas = 3.0f,
+	.clipFloorPpm = 20.0f,
+	.minTStat = 4.0f,
+	.minPoints = 10
+};
+
+static struct
+{
+	double seconds;
+	float co2;
+} points[CO2_FORECAST_MAX_POINTS];	// ring, the oldest at head
+static int head = 0;
+static int count = 0;
+
+// Sums over the window with time taken from baseSeconds, which keeps the squares small
+static double baseSeconds;
+static double sumX, sumY, sumXX, sumXY, sumYY;
+
+static bool warning = false;
+static CO2_FORECAST_STATE state = { .slopePpmPerMinute = NAN, .secondsToLevel = NAN };
+
+void co2Forecast_configure(const CO2_FORECAST_CONFIG* config)
+{
+	forecastConfig = *config;
+	head = 0;
+	count = 0;
+	warning = false;
+	memset(&state, 0, sizeof(state));
+	state.slopePpmPerMinute = NAN;
+	state.secondsToLevel = NAN;
+}
+
+const CO2_FORECAST_CONFIG* co2Forecast_getConfig(void)
+{
+	return &forecastConfig;
+}
+
+static void Accumulate(double seconds, float co2, double sign)
+{
+	double x = seconds - baseSeconds;
+
+	sumX += sign * x;
+	sumY += sign * co2;
+	sumXX += sign * x * x;
+	sumXY += sign * x * co2;
+	sumYY += sign * (double)co2 * co2;
+}
+
+/// <summary>
+/// Rebuild the sums from the ring with the oldest point as the time base
+/// </summary>
+static void Resum(void)
+{
+	baseSeconds = count ? points[head].seconds : 0;
+	sumX = sumY = sumXX = sumXY = sumYY = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int at = (head + i) % CO2_FORECAST_MAX_POINTS;
+		Accumulate(points[at].seconds, points[at].co2, 1);
+	}
+}
+
+static void DropOldest(void)
+{
+	Accumulate(points[head].seconds, points[head].co2, -1);
+	head = (head + 1) % CO2_FORECAST_MAX_POINTS;
+	count--;
+}
+
+/// <summary>
+/// Slope, intercept at baseSeconds and slope standard error of the window
+/// </summary>
+static bool Fit(double* slope, double* intercept, double* slopeError, double* residualSigma)
+{
+	double n = count;
+	double sxx = sumXX - sumX * sumX / n;
+	double sxy = sumXY - sumX * sumY / n;
+	double syy = sumYY - sumY * sumY / n;
+	double sse;
+
+	if (count < forecastConfig.minPoints || sxx <= 0)
+	{
+		return false;
+	}
+
+	*slope = sxy / sxx;
+	*intercept = (sumY - *slope * sumX) / n;
+	sse = fmax(0.0, syy - *slope * sxy);
+	*residualSigma = sqrt(sse / (n - 2));
+	*slopeError = *residualSigma / sqrt(sxx);
+	return true;
+}
+
+CO2_FORECAST_EVENT co2Forecast_update(float co2, float alertLevel, uint64_t nowUs)
+{
+	double seconds = (double)nowUs / 1e6;
+	double slope, intercept, slopeError, sigma, predicted, bound, level, eta;
+	float fitted = co2;
+
+	if (isnan(co2))
+	{
+		return CO2_FORECAST_NONE;
+	}
+
+	while (count && (count == CO2_FORECAST_MAX_POINTS || seconds - points[head].seconds > forecastConfig.windowSeconds))
+	{
+		DropOldest();
+	}
+	if (count == 0 || seconds - baseSeconds > 2.0 * forecastConfig.windowSeconds)
+	{
+		Resum();
+	}
+
+	// Clip against the line so far, before the reading can move it
+	if (Fit(&slope, &intercept, &slopeError, &sigma))
+	{
+		predicted = intercept + slope * (seconds - baseSeconds);
+		bound = fmax(forecastConfig.clipSigmas * sigma, forecastConfig.clipFloorPpm);
+		if (fabs(co2 - predicted) > bound)
+		{
+			fitted = (float)(co2 > predicted ? predicted + bound : predicted - bound);
+			state.clipped++;
+		}
+	}
+
+	points[(head + count) % CO2_FORECAST_MAX_POINTS].seconds = seconds;
+	points[(head + count) % CO2_FORECAST_MAX_POINTS].co2 = fitted;
+	count++;
+	if (count == 1)
+	{
+		baseSeconds = seconds;
+	}
+	Accumulate(seconds, fitted, 1);
+
+	state.secondsToLevel = NAN;
+	if (!Fit(&slope, &intercept, &slopeError, &sigma))
+	{
+		state.slopePpmPerMinute = NAN;
+		return CO2_FORECAST_NONE;
+	}
+	state.slopePpmPerMinute = (float)(slope * 60);
+
+	if (isnan(alertLevel))
+	{
+		if (warning)
+		{
+			warning = false;
+			return CO2_FORECAST_CLEARED;
+		}
+		return CO2_FORECAST_NONE;
+	}
+
+	// The line may already be over the level while the reading is not
+	level = intercept + slope * (seconds - baseSeconds);
+	eta = slope > 0 ? fmax(0.0, (alertLevel - level) / slope) : NAN;
+	if (slope >= forecastConfig.minTStat * slopeError)
+	{
+		state.secondsToLevel = (float)eta;
+	}
+
+	if (!warning && state.secondsToLevel <= forecastConfig.leadSeconds && co2 < alertLevel)
+	{
+		warning = true;
+		state.warnings++;
+		return CO2_FORECAST_WARNING;
+	}
+
+	// Cleared once crossed, the alert takes over, or once the crossing moves well out of the lead time.
+	// Not on significance alone, which flickers while the rise is steady.
+	if (warning && (co2 >= alertLevel || !(eta <= 2.0 * forecastConfig.leadSeconds)))
+	{
+		warning = false;
+		return CO2_FORECAST_CLEARED;
+	}
+
+	return CO2_FORECAST_NONE;
+}
+
+bool co2Forecast_isWarning(void)
+{
+	return warning;
+}
+
+void co2Forecast_getState(CO2_FORECAST_STATE* out)
+{
+	*out = state;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Time until CO2 crosses the alert level, from a least squares line over the last windowSeconds of filtered
+// readings. A reading is clipped to the current line plus or minus a few residual standard deviations before it
+// enters the window, so a spike the filter let through cannot tilt the trend. Running sums over a ring of
+// points: O(1) per sample, the sums are rebuilt from the ring once per window to shed rounding.
+#define CO2_FORECAST_MAX_POINTS 256		// window / shortest sampling interval, older points drop early beyond it
+
+typedef struct
+{
+	uint16_t windowSeconds;		// trend fitted over this span
+	uint16_t leadSeconds;		// warn when the crossing is predicted within this
+	float clipSigmas;			// readings further than this many residual standard deviations from the line are clipped
+	float clipFloorPpm;			// nothing closer than this is clipped
+	float minTStat;				// the slope must be this many standard errors above zero
+	uint8_t minPoints;
+} CO2_FORECAST_CONFIG;
+
+typedef enum
+{
+	CO2_FORECAST_NONE,
+	CO2_FORECAST_WARNING,		// crossing predicted within leadSeconds
+	CO2_FORECAST_CLEARED		// no longer predicted, or crossed and left to the alert
+} CO2_FORECAST_EVENT;
+
+typedef struct
+{
+	float slopePpmPerMinute;	// NAN until the window holds minPoints
+	float secondsToLevel;		// NAN unless rising significantly toward the alert level
+	uint32_t warnings;
+	uint32_t clipped;
+} CO2_FORECAST_STATE;
+
+/// <summary>
+/// Replace the configuration and empty the window.
+/// </summary>
+void co2Forecast_configure(const CO2_FORECAST_CONFIG* config);
+
+const CO2_FORECAST_CONFIG* co2Forecast_getConfig(void);
+
+/// <summary>
+/// Feed a filtered reading taken at nowUs and re-forecast against alertLevel.
+/// </summary>
+/// <param name="alertLevel">CO2 alert level, NAN while there is none or the alert is already raised</param>
+CO2_FORECAST_EVENT co2Forecast_update(float co2, float alertLevel, uint64_t nowUs);
+
+bool co2Forecast_isWarning(void);
+
+void co2Forecast_getState(CO2_FORECAST_STATE* state);
@@ -0,0 +1,151 @@
+#include "comfort.h"
+
+#include <math.h>
+
+// Magnus coefficients over water, valid -45 to 60 degrees C
+#define MAGNUS_B 17.62f
+#define MAGNUS_C 243.12f
+#define MAGNUS_HPA 6.112f
+#define VAPOUR_HPA_TO_G_M3 216.7f		// 100 / gas constant of water vapour, times 1/K
+#define LOG2_E 1.44269504f
+#define LN_2 0.693147181f
+
+static COMFORT_CONFIG comfortConfig = {
+	.co2GoodPpm = 600.0f,
+	.co2BadPpm = 2000.0f,
+	.humidityGood = { 40.0f, 60.0f },
+	.humidityBad = { 20.0f, 80.0f },
+	.temperatureGood = { 20.0f, 24.0f },
+	.temperatureBad = { 16.0f, 28.0f },
+	.co2Weight = 0.5f,
+	.humidityWeight = 0.25f,
+	.temperatureWeight = 0.25f
+};
+
+void comfort_configure(const COMFORT_CONFIG* config)
+{
+	comfortConfig = *config;
+}
+
+const COMFORT_CONFIG* comfort_getConfig(void)
+{
+	return &comfortConfig;
+}
+
+float comfort_fastExp2(float x)
+{
+	union { float f; uint32_t u; } scale;
+	float whole, f;
+
+	if (x < -126.0f)
+	{
+		return 0.0f;
+	}
+	if (x > 127.0f)
+	{
+		return INFINITY;
+	}
+
+	// The exponent bits take the whole part, a degree 4 Chebyshev fit of 2^f on [-0.5, 0.5] the rest.
+	// Adding 1.5 * 2^23 rounds to the nearest integer in the FPU, floorf can be a library call.
+	whole = (x + 12582912.0f) - 12582912.0f;
+	f = x - whole;
+	scale.u = (uint32_t)((int32_t)whole + 127) << 23;
+	return scale.f * (1.000000075f + f * (0.693121034f + f * (0.2402210736f + f * (0.05592203565f + f * 0.009676037098f))));
+}
+
+// The mantissa is taken into [sqrt(1/2), sqrt(2)) where ln(m) = 2 atanh((m - 1) / (m + 1)) converges in three odd terms
+float comfort_fastLog2(float x)
+{
+	union { float f; uint32_t u; } bits = { .f = x };
+	int32_t exponent = (int32_t)((bits.u >> 23) & 0xff) - 127;
+	float s, s2;
+
+	bits.u = (bits.u & 0x007fffffu) | 0x3f800000u;
+	if (bits.f > 1.41421356f)
+	{
+		bits.f *= 0.5f;
+		exponent++;
+	}
+
+	s = (bits.f - 1.0f) / (bits.f + 1.0f);
+	s2 = s * s;
+	return (float)exponent + 2.0f * LOG2_E * s * (1.0f + s2 * (1.0f / 3.0f + s2 * 0.2f));
+}
+
+/// <summary>
+/// 100 inside [good[0], good[1]], falling linearly to 0 at bad[0] and bad[1]
+/// </summary>
+static float BandScore(float value, const float good[2], const float bad[2])
+{
+	if (value < good[0])
+	{
+		return value <= bad[0] ? 0.0f : 100.0f * (value - bad[0]) / (good[0] - bad[0]);
+	}
+	if (value > good[1])
+	{
+		return value >= bad[1] ? 0.0f : 100.0f * (bad[1] - value) / (bad[1] - good[1]);
+	}
+	return 100.0f;
+}
+
+/// <summary>
+/// NWS heat index: Steadman's simple formula, the Rothfusz regression where that reaches 80 F, with the
+/// low and high humidity adjustments. Worked in Fahrenheit as the coefficients are.
+/// </summary>
+static float HeatIndex(float temperature, float humidity)
+{
+	float t = temperature * 1.8f + 32.0f;
+	float rh = humidity;
+	float hi = 0.5f * (t + 61.0f + (t - 68.0f) * 1.2f + rh * 0.094f);
+
+	if ((hi + t) / 2.0f >= 80.0f)
+	{
+		hi = -42.379f + 2.04901523f * t + 10.14333127f * rh - 0.22475541f * t * rh - 0.00683783f * t * t
+			- 0.05481717f * rh * rh + 0.00122874f * t * t * rh + 0.00085282f * t * rh * rh - 0.00000199f * t * t * rh * rh;
+
+		if (rh < 13.0f && t >= 80.0f && t <= 112.0f)
+		{
+			hi -= (13.0f - rh) / 4.0f * sqrtf((17.0f - fabsf(t - 95.0f)) / 17.0f);
+		}
+		else if (rh > 85.0f && t >= 80.0f && t <= 87.0f)
+		{
+			hi += (rh - 85.0f) / 10.0f * (87.0f - t) / 5.0f;
+		}
+	}
+
+	return (hi - 32.0f) / 1.8f;
+}
+
+void comfort_compute(float co2, float temperature, float humidity, COMFORT_METRICS* metrics)
+{
+	float magnus, gamma, vapourHpa;
+	float co2Score, humidityScore, temperatureScore;
+
+	metrics->dewPoint = metrics->absoluteHumidity = metrics->heatIndex = metrics->iaq = NAN;
+
+	if (isnan(temperature) || isnan(humidity) || temperature <= -MAGNUS_C || humidity <= 0.0f || humidity > 100.0f)
+	{
+		return;
+	}
+
+	// Dew point solves Magnus(Td) = ln(RH) + Magnus(T), the vapour pressure is RH times its saturation value
+	magnus = MAGNUS_B * temperature / (MAGNUS_C + temperature);
+	gamma = comfort_fastLog2(humidity / 100.0f) * LN_2 + magnus;
+	metrics->dewPoint = MAGNUS_C * gamma / (MAGNUS_B - gamma);
+	vapourHpa = humidity / 100.0f * MAGNUS_HPA * comfort_fastExp2(magnus * LOG2_E);
+	metrics->absoluteHumidity = VAPOUR_HPA_TO_G_M3 * vapourHpa / (273.15f + temperature);
+	metrics->heatIndex = HeatIndex(temperature, humidity);
+
+	if (isnan(co2))
+	{
+		return;
+	}
+
+	co2Score = co2 <= comfortConfig.co2GoodPpm ? 100.0f : co2 >= comfortConfig.co2BadPpm ? 0.0f :
+		100.0f * (comfortConfig.co2BadPpm - co2) / (comfortConfig.co2BadPpm - comfortConfig.co2GoodPpm);
+	humidityScore = BandScore(humidity, comfortConfig.humidityGood, comfortConfig.humidityBad);
+	temperatureScore = BandScore(temperature, comfortConfig.temperatureGood, comfortConfig.temperatureBad);
+	metrics->iaq = comfortConfig.co2Weight * co2Score + comfortConfig.humidityWeight * humidityScore +
+		comfortConfig.temperatureWeight * temperatureScore;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Comfort metrics derived from each sample, so dashboards do not recompute them on every query.
+// Dew point and absolute humidity use the Magnus formula over water with exp and log replaced by
+// polynomial approximations, relative error under 4e-6, far inside the SCD30's +-3 %RH.
+// Heat index is the NWS Rothfusz regression, the indoor air quality score is a weighted mean of
+// CO2, humidity and temperature sub-scores, each 100 inside its good band falling linearly to 0.
+
+typedef struct
+{
+	float co2GoodPpm;			// CO2 sub-score is 100 at or below this
+	float co2BadPpm;			// and 0 at or above this
+	float humidityGood[2];		// %RH band scoring 100
+	float humidityBad[2];		// 0 at or beyond these
+	float temperatureGood[2];	// degrees C band scoring 100
+	float temperatureBad[2];
+	float co2Weight;			// sub-score weights, summing to 1
+	float humidityWeight;
+	float temperatureWeight;
+} COMFORT_CONFIG;
+
+typedef struct
+{
+	float dewPoint;				// degrees C
+	float absoluteHumidity;		// g/m3
+	float heatIndex;			// degrees C, apparent temperature
+	float iaq;					// 0 worst to 100 best
+} COMFORT_METRICS;
+
+void comfort_configure(const COMFORT_CONFIG* config);
+
+const COMFORT_CONFIG* comfort_getConfig(void);
+
+/// <summary>
+/// Derive the comfort metrics of one sample. A metric is NAN when an input it needs is NAN or out of range.
+/// </summary>
+void comfort_compute(float co2, float temperature, float humidity, COMFORT_METRICS* metrics);
+
+/// <summary>
+/// 2^x without libm, relative error under 4e-6.
+/// </summary>
+float comfort_fastExp2(float x);
+
+/// <summary>
+/// log2(x) for x > 0 without libm, absolute error under 2e-6.
+/// </summary>
+float comfort_fastLog2(float x);
@@ -0,0 +1,180 @@
+#include "duty_cycle.h"
+#include "persistent_store.h"
+
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include <applibs/powermanagement.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DUTY_BATCH_MESSAGE_BYTES 1024
+#define DUTY_BATCH_SAMPLES_PER_MESSAGE 12
+#define DUTY_ALWAYS_ON_SEND_SECONDS 1.0f
+
+typedef struct
+{
+	uint32_t time;			// RTC seconds
+	uint16_t co2;			// ppm
+	int16_t temperature;	// 0.01 degrees C
+	uint16_t humidity;		// 0.01 %RH
+} DUTY_SAMPLE;
+
+typedef struct
+{
+	uint32_t cycles;
+	uint32_t nextDeadline;
+	uint32_t lastSensorReady;
+	uint16_t sampleCount;
+	uint16_t reserved;
+	DUTY_SAMPLE samples[DUTY_CYCLE_MAX_SAMPLES];
+} DUTY_CYCLE_STATE;
+
+const DUTY_ENERGY_MODEL dutyCycleDefaultEnergyModel = {
+	.activeMa = 75.0f, .uploadMa = 150.0f, .powerDownMa = 0.02f, .supplyVolts = 3.3f,
+	.bootSeconds = 4.0f, .sampleSeconds = 2.5f, .uploadSeconds = 15.0f
+};
+
+static DUTY_CYCLE_STATE state;
+static bool stateLoaded = false;
+static char batchBuffer[DUTY_BATCH_MESSAGE_BYTES];
+
+float dutyCycle_energyPerSampleMj(const DUTY_ENERGY_MODEL* model, SCD30_POWER_POLICY policy, uint32_t periodSeconds, uint32_t uploadEvery)
+{
+	float period = (float)periodSeconds;
+	SCD30_POWER_ESTIMATE sensor;
+
+	// The sensor stays powered and measuring through power-down
+	scd30Power_estimate(policy, periodSeconds, &sensor);
+
+	if (uploadEvery == 0)
+	{
+		return model->supplyVolts * ((model->activeMa + sensor.averageMa) * period +
+			(model->uploadMa - model->activeMa) * DUTY_ALWAYS_ON_SEND_SECONDS);
+	}
+
+	float awake = model->bootSeconds + model->sampleSeconds;
+	float asleep = period > awake ? period - awake : 0.0f;
+
+	return model->supplyVolts * (model->activeMa * awake + model->powerDownMa * asleep + sensor.averageMa * period +
+		model->uploadMa * model->uploadSeconds / (float)uploadEvery);
+}
+
+uint32_t dutyCycle_planPowerDown(uint32_t now, uint32_t previousDeadline, uint32_t lastSensorReady,
+	uint16_t sensorIntervalSeconds, uint32_t* nextDeadline)
+{
+	uint32_t deadline = previousDeadline ? previousDeadline + DUTY_CYCLE_PERIOD_SECONDS : now + DUTY_CYCLE_PERIOD_SECONDS;
+
+	while (deadline <= now + DUTY_CYCLE_BOOT_LEAD_SECONDS)
+	{
+		deadline += DUTY_CYCLE_PERIOD_SECONDS;
+	}
+
+	// Measurements complete at lastSensorReady + k * interval, take the one nearest the deadline. The first at or
+	// after it would skip a whole period each time the SCD30's clock ran a little fast of the RTC.
+	if (lastSensorReady && sensorIntervalSeconds && deadline > lastSensorReady)
+	{
+		uint32_t k = (deadline - lastSensorReady + sensorIntervalSeconds / 2) / sensorIntervalSeconds;
+		deadline = lastSensorReady + k * sensorIntervalSeconds;
+		while (deadline <= now + DUTY_CYCLE_BOOT_LEAD_SECONDS)
+		{
+			deadline += sensorIntervalSeconds;
+		}
+	}
+
+	*nextDeadline = deadline;
+	uint32_t wake = deadline - DUTY_CYCLE_BOOT_LEAD_SECONDS;
+	return wake > now ? wake - now : 1;
+}
+
+static void LoadState(void)
+{
+	if (!stateLoaded)
+	{
+		if (!store_readRecord(STORE_RECORD_DUTY_CYCLE, &state, sizeof(state)))
+		{
+			memset(&state, 0, sizeof(state));
+		}
+		stateLoaded = true;
+	}
+}
+
+bool dutyCycle_recordSample(float co2, float temperature, float humidity, bool alert)
+{
+	LoadState();
+
+	if (state.sampleCount == DUTY_CYCLE_MAX_SAMPLES)
+	{
+		// Upload kept failing, drop the oldest reading
+		memmove(&state.samples[0], &state.samples[1], sizeof(DUTY_SAMPLE) * (DUTY_CYCLE_MAX_SAMPLES - 1));
+		state.sampleCount--;
+	}
+
+	state.lastSensorReady = (uint32_t)time(NULL);
+	state.samples[state.sampleCount++] = (DUTY_SAMPLE){
+		.time = state.lastSensorReady,
+		.co2 = (uint16_t)lroundf(co2),
+		.temperature = (int16_t)lroundf(temperature * 100.0f),
+		.humidity = (uint16_t)lroundf(humidity * 100.0f)
+	};
+	state.cycles++;
+
+	store_writeRecord(STORE_RECORD_DUTY_CYCLE, &state, sizeof(state));
+
+	return alert || state.cycles % DUTY_CYCLE_UPLOAD_EVERY == 0 || state.sampleCount == DUTY_CYCLE_MAX_SAMPLES;
+}
+
+bool dutyCycle_uploadBatch(DX_MESSAGE_PROPERTY** properties, size_t propertyCount)
+{
+	LoadState();
+
+	for (uint16_t first = 0; first < state.sampleCount; first += DUTY_BATCH_SAMPLES_PER_MESSAGE)
+	{
+		int used = snprintf(batchBuffer, sizeof(batchBuffer), "{ \"Batch\": [");
+
+		for (uint16_t i = first; i < state.sampleCount && i < first + DUTY_BATCH_SAMPLES_PER_MESSAGE &&
+			used > 0 && (size_t)used < sizeof(batchBuffer); i++)
+		{
+			const DUTY_SAMPLE* sample = &state.samples[i];
+			used += snprintf(batchBuffer + used, sizeof(batchBuffer) - (size_t)used,
+				"%s{ \"Time\": %u, \"CO2\": %u, \"Temperature\": %.2f, \"Humidity\": %.1f }",
+				i == first ? "" : ", ", sample->time, sample->co2, sample->temperature / 100.0, sample->humidity / 100.0);
+		}
+		if (used > 0 && (size_t)used < sizeof(batchBuffer))
+		{
+			used += snprintf(batchBuffer + used, sizeof(batchBuffer) - (size_t)used, "] }");
+		}
+
+		if (used <= 0 || (size_t)used >= sizeof(batchBuffer) || !dx_azureMsgSendWithProperties(batchBuffer, properties, propertyCount))
+		{
+			return false;
+		}
+	}
+
+	state.sampleCount = 0;
+	store_writeRecord(STORE_RECORD_DUTY_CYCLE, &state, sizeof(state));
+	return true;
+}
+
+void dutyCycle_powerDown(uint16_t sensorIntervalSeconds, SCD30_POWER_POLICY policy)
+{
+	uint32_t now = (uint32_t)time(NULL);
+
+	LoadState();
+
+	uint32_t residency = dutyCycle_planPowerDown(now, state.nextDeadline, state.lastSensorReady, sensorIntervalSeconds, &state.nextDeadline);
+	store_writeRecord(STORE_RECORD_DUTY_CYCLE, &state, sizeof(state));
+
+	Log_Debug("Duty cycle %u: %u samples logged, powering down for %u s. Model: %.0f mJ/sample with the SCD30 %s vs %.0f mJ/sample always on\n",
+		state.cycles, state.sampleCount, residency,
+		dutyCycle_energyPerSampleMj(&dutyCycleDefaultEnergyModel, policy, DUTY_CYCLE_PERIOD_SECONDS, DUTY_CYCLE_UPLOAD_EVERY),
+		scd30Power_policyName(policy),
+		dutyCycle_energyPerSampleMj(&dutyCycleDefaultEnergyModel, SCD30_POWER_CONTINUOUS, DUTY_CYCLE_PERIOD_SECONDS, 0));
+
+	if (PowerManagement_ForceSystemPowerDown(residency) != 0)
+	{
+		Log_Debug("ERROR: PowerManagement_ForceSystemPowerDown: errno=%d (%s)\n", errno, strerror(errno));
+	}
+}
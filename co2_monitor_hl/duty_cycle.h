@@ -0,0 +1,63 @@
+#pragma once
+
+#include "dx_azure_iot.h"
+#include "scd30_power.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Duty-cycle mode (DUTY_CYCLE in CMakeLists.txt): wake, take one reading, append it to mutable
+// storage and power the MT3620 down until the next deadline. Readings are uploaded as a batch every
+// DUTY_CYCLE_UPLOAD_EVERY cycles, when the log is full, or straight away on a CO2 alert.
+#define DUTY_CYCLE_PERIOD_SECONDS 300
+#define DUTY_CYCLE_UPLOAD_EVERY 12
+#define DUTY_CYCLE_MAX_SAMPLES 48
+
+// Power-down is timed so the app is up just before the SCD30 finishes a measurement: the 4 s boot, plus 2 s
+// since the recorded ready time and the residency are whole RTC seconds. Up late, it waits a whole interval.
+#define DUTY_CYCLE_BOOT_LEAD_SECONDS 6
+
+typedef struct
+{
+	float activeMa;			// MT3620 awake, radio idle
+	float uploadMa;			// MT3620 awake and transmitting
+	float powerDownMa;		// MT3620 in power-down
+	float supplyVolts;
+	float bootSeconds;		// power-down exit to app running
+	float sampleSeconds;	// app start to reading stored
+	float uploadSeconds;	// connect, send, flush
+} DUTY_ENERGY_MODEL;
+
+// Datasheet-level defaults for the MT3620. The SCD30 current comes from scd30Power_estimate for its power policy.
+extern const DUTY_ENERGY_MODEL dutyCycleDefaultEnergyModel;
+
+/// <summary>
+/// Average energy per stored sample in millijoules for a cycle period, upload cadence and SCD30 power policy.
+/// uploadEvery of 0 models the always-on app, awake and connected for the whole period.
+/// </summary>
+float dutyCycle_energyPerSampleMj(const DUTY_ENERGY_MODEL* model, SCD30_POWER_POLICY policy, uint32_t periodSeconds, uint32_t uploadEvery);
+
+/// <summary>
+/// Seconds to stay powered down. The next deadline follows the previous one by a whole period so
+/// cycles do not drift, then moved to the sensor measurement nearest it (lastReady + k * sensorInterval), and
+/// wake-up lands DUTY_CYCLE_BOOT_LEAD_SECONDS before that. Times are RTC seconds.
+/// </summary>
+uint32_t dutyCycle_planPowerDown(uint32_t now, uint32_t previousDeadline, uint32_t lastSensorReady,
+	uint16_t sensorIntervalSeconds, uint32_t* nextDeadline);
+
+/// <summary>
+/// Append a reading to the persisted log. Returns true when the batch should be uploaded now.
+/// </summary>
+bool dutyCycle_recordSample(float co2, float temperature, float humidity, bool alert);
+
+/// <summary>
+/// Send the logged readings as batch messages and clear the log once all were accepted.
+/// </summary>
+bool dutyCycle_uploadBatch(DX_MESSAGE_PROPERTY** properties, size_t propertyCount);
+
+/// <summary>
+/// Persist the cycle state and force power-down until the next deadline. Returns only on failure.
+/// The energy logged compares policy against the always-on app measuring continuously.
+/// </summary>
+void dutyCycle_powerDown(uint16_t sensorIntervalSeconds, SCD30_POWER_POLICY policy);
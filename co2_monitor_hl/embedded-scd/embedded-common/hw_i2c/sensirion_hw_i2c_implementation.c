@@ -32,17 +32,52 @@
 #include "sensirion_arch_config.h"
 #include "sensirion_common.h"
 #include "sensirion_i2c.h"
+#include "sensirion_hw_i2c_stats.h"
 
 #include "hw/azure_sphere_learning_path.h"
 #include <applibs/i2c.h>
 #include <applibs/log.h>
 #include <errno.h>
+#include <stdbool.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
 int i2cHandle = -1;
 
+// Retry policy: reads, and writes the retry filter passes, get up to
+// I2C_MAX_RETRIES further attempts, backing off 1, 2, 4 ms and never more than
+// I2C_MAX_BACKOFF_US between attempts. Other writes may have reached the sensor
+// and are sent once. The backoff sleeps on the event loop, so retrying stops
+// once the transaction has held the loop for I2C_RETRY_BUDGET_US. An attempt
+// that timed out has already waited out the bus timeout: it is retried once,
+// straight away at I2C_TIMEOUT_MAX_MS, only if the adapted timeout was shorter.
+#define I2C_MAX_RETRIES 3
+#define I2C_INITIAL_BACKOFF_US 1000u
+#define I2C_MAX_BACKOFF_US 8000u
+#define I2C_RETRY_BUDGET_US 10000u
+
+// Adaptive timeout: every I2C_TIMEOUT_REVIEW_INTERVAL transactions the timeout is
+// set to I2C_TIMEOUT_HEADROOM x p99, clamped to [I2C_TIMEOUT_MIN_MS, I2C_TIMEOUT_MAX_MS].
+// The floor is the same headroom over the longest nominal transfer, so the p99
+// sets the timeout. A sensor that stretches the clock often enough moves the p99
+// up with it, a rare stretch times out once, restores the maximum straight away
+// and is retried there. The maximum covers the SCD30's worst case stretch.
+#define I2C_NOMINAL_TRANSACTION_MS 2u	// an 18 byte SCD30 measurement read at 100 kHz
+#define I2C_TIMEOUT_HEADROOM 4u
+#define I2C_TIMEOUT_MIN_MS (I2C_TIMEOUT_HEADROOM * I2C_NOMINAL_TRANSACTION_MS)
+#define I2C_TIMEOUT_MAX_MS 250u
+#define I2C_TIMEOUT_REVIEW_INTERVAL 64u
+
+static sensirion_i2c_command_stats_t commandStats[SENSIRION_I2C_MAX_TRACKED_COMMANDS];
+static uint8_t commandStatsUsed = 0;
+static uint16_t lastCommand = 0;
+static uint32_t timeoutMs = I2C_TIMEOUT_MAX_MS;
+static uint32_t timeoutAdjustments = 0;
+static uint32_t transactionsSinceReview = 0;
+static sensirion_i2c_transaction_hook_t transactionHook = NULL;
+static sensirion_i2c_write_retry_filter_t writeRetryFilter = NULL;
+
 
 /*
  * INSTRUCTIONS
@@ -87,7 +122,13 @@ void sensirion_i2c_init(void) {
 		return;
 	}
 
-	result = I2CMaster_SetTimeout(i2cHandle, 100);
+	memset(commandStats, 0, sizeof(commandStats));
+	commandStatsUsed = 0;
+	timeoutAdjustments = 0;
+	transactionsSinceReview = 0;
+	timeoutMs = I2C_TIMEOUT_MAX_MS;
+
+	result = I2CMaster_SetTimeout(i2cHandle, timeoutMs);
 	if (result != 0)
 	{
 		Log_Debug("ERROR: I2CMaster_SetTimeout: errno=%d (%s)\n", errno, strerror(errno));
@@ -95,6 +136,269 @@ void sensirion_i2c_init(void) {
 	}
 }
 
+static uint32_t ElapsedUsec(const struct timespec* start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	int64_t usec = (int64_t)(now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000;
+	return usec < 0 ? 0 : (uint32_t)usec;
+}
+
+static uint8_t HistogramBucket(uint32_t usec)
+{
+	uint8_t bucket = 0;
+	uint32_t bound = SENSIRION_I2C_HISTOGRAM_BASE_USEC;
+
+	while (usec >= bound && bucket < SENSIRION_I2C_HISTOGRAM_BUCKETS - 1)
+	{
+		bound <<= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+uint32_t sensirion_i2c_histogram_percentile(const uint32_t* histogram, uint8_t percentile)
+{
+	uint64_t total = 0, seen = 0;
+
+	for (uint8_t i = 0; i < SENSIRION_I2C_HISTOGRAM_BUCKETS; i++)
+	{
+		total += histogram[i];
+	}
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	uint64_t target = (total * percentile + 99) / 100;
+
+	for (uint8_t i = 0; i < SENSIRION_I2C_HISTOGRAM_BUCKETS; i++)
+	{
+		seen += histogram[i];
+		if (seen >= target)
+		{
+			return SENSIRION_I2C_HISTOGRAM_BASE_USEC << i;
+		}
+	}
+	return SENSIRION_I2C_HISTOGRAM_BASE_USEC << (SENSIRION_I2C_HISTOGRAM_BUCKETS - 1);
+}
+
+static sensirion_i2c_command_stats_t* CommandStatsFor(uint16_t command)
+{
+	for (uint8_t i = 0; i < commandStatsUsed; i++)
+	{
+		if (commandStats[i].command == command)
+		{
+			return &commandStats[i];
+		}
+	}
+
+	if (commandStatsUsed < SENSIRION_I2C_MAX_TRACKED_COMMANDS)
+	{
+		commandStats[commandStatsUsed].command = command;
+		return &commandStats[commandStatsUsed++];
+	}
+
+	return &commandStats[SENSIRION_I2C_MAX_TRACKED_COMMANDS - 1];
+}
+
+static void AggregateHistogram(uint32_t* histogram)
+{
+	memset(histogram, 0, sizeof(uint32_t) * SENSIRION_I2C_HISTOGRAM_BUCKETS);
+
+	for (uint8_t i = 0; i < commandStatsUsed; i++)
+	{
+		for (uint8_t b = 0; b < SENSIRION_I2C_HISTOGRAM_BUCKETS; b++)
+		{
+			histogram[b] += commandStats[i].histogram[b];
+		}
+	}
+}
+
+static void ApplyTimeout(uint32_t newTimeoutMs)
+{
+	if (newTimeoutMs == timeoutMs || i2cHandle < 0)
+	{
+		return;
+	}
+
+	if (I2CMaster_SetTimeout(i2cHandle, newTimeoutMs) != 0)
+	{
+		Log_Debug("ERROR: I2CMaster_SetTimeout: errno=%d (%s)\n", errno, strerror(errno));
+		return;
+	}
+
+	timeoutMs = newTimeoutMs;
+	timeoutAdjustments++;
+}
+
+/// <summary>
+///     Set the bus timeout from the observed p99 latency of all commands.
+/// </summary>
+static void ReviewTimeout(void)
+{
+	uint32_t histogram[SENSIRION_I2C_HISTOGRAM_BUCKETS];
+
+	AggregateHistogram(histogram);
+
+	uint32_t p99Ms = (sensirion_i2c_histogram_percentile(histogram, 99) + 999) / 1000;
+	uint32_t newTimeoutMs = p99Ms * I2C_TIMEOUT_HEADROOM;
+
+	if (newTimeoutMs < I2C_TIMEOUT_MIN_MS)
+	{
+		newTimeoutMs = I2C_TIMEOUT_MIN_MS;
+	}
+	if (newTimeoutMs > I2C_TIMEOUT_MAX_MS)
+	{
+		newTimeoutMs = I2C_TIMEOUT_MAX_MS;
+	}
+
+	ApplyTimeout(newTimeoutMs);
+}
+
+static void RecordTransaction(sensirion_i2c_command_stats_t* stats, bool isRead, uint32_t usec, uint32_t retries, bool failed)
+{
+	if (transactionHook != NULL)
+	{
+		transactionHook(lastCommand, isRead, usec);
+	}
+
+	stats->transactions++;
+	stats->retries += retries;
+	stats->histogram[HistogramBucket(usec)]++;
+
+	if (usec > stats->max_usec)
+	{
+		stats->max_usec = usec;
+	}
+
+	if (failed)
+	{
+		stats->failures++;
+	}
+
+	if (++transactionsSinceReview >= I2C_TIMEOUT_REVIEW_INTERVAL)
+	{
+		transactionsSinceReview = 0;
+		ReviewTimeout();
+	}
+}
+
+/// <summary>
+///     Run one read or write with bounded exponential backoff between attempts.
+///     Only the successful (or final) attempt is timed, so the histogram reflects bus
+///     latency rather than backoff.
+/// </summary>
+static int8_t RunTransaction(uint8_t address, uint8_t* readData, const uint8_t* writeData, uint16_t count)
+{
+	sensirion_i2c_command_stats_t* stats = CommandStatsFor(lastCommand);
+	uint32_t backoffUs = I2C_INITIAL_BACKOFF_US;
+	uint32_t retries = 0;
+	uint32_t usec = 0;
+	ssize_t retVal = -1;
+	int error;
+	bool timedOut, shortened;
+	bool retryable = readData != NULL || (writeRetryFilter != NULL && writeRetryFilter(address, writeData, count));
+	struct timespec first, start;
+
+	// Not a bus transaction, nothing to time
+	if (i2cHandle < 0)
+	{
+		return STATUS_FAIL;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &first);
+	for (;;)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		retVal = readData != NULL
+			? I2CMaster_Read(i2cHandle, address, readData, count)
+			: I2CMaster_Write(i2cHandle, address, writeData, count);
+		error = errno;
+		usec = ElapsedUsec(&start);
+
+		if (retVal == count)
+		{
+			break;
+		}
+
+		timedOut = retVal < 0 && error == ETIMEDOUT;
+		shortened = timedOut && timeoutMs < I2C_TIMEOUT_MAX_MS;
+		if (timedOut)
+		{
+			ApplyTimeout(I2C_TIMEOUT_MAX_MS);
+		}
+
+		if (!retryable || retries >= I2C_MAX_RETRIES || (timedOut && !shortened) ||
+			(!timedOut && ElapsedUsec(&first) + backoffUs > I2C_RETRY_BUDGET_US))
+		{
+			// errno only describes a failed call, a short transfer leaves it stale
+			if (retVal < 0)
+			{
+				Log_Debug("ERROR: I2C %s of command 0x%04x failed after %u retries: errno=%d (%s)\n",
+					readData != NULL ? "read" : "write", lastCommand, retries, error, strerror(error));
+			}
+			else
+			{
+				Log_Debug("ERROR: I2C %s of command 0x%04x failed after %u retries: %d of %u bytes\n",
+					readData != NULL ? "read" : "write", lastCommand, retries, (int)retVal, count);
+			}
+			RecordTransaction(stats, readData != NULL, usec, retries, true);
+			return STATUS_FAIL;
+		}
+
+		retries++;
+		if (!timedOut)
+		{
+			sensirion_sleep_usec(backoffUs);
+			backoffUs = backoffUs * 2 > I2C_MAX_BACKOFF_US ? I2C_MAX_BACKOFF_US : backoffUs * 2;
+		}
+	}
+
+	RecordTransaction(stats, readData != NULL, usec, retries, false);
+	return STATUS_OK;
+}
+
+void sensirion_i2c_set_transaction_hook(sensirion_i2c_transaction_hook_t hook)
+{
+	transactionHook = hook;
+}
+
+void sensirion_i2c_set_write_retry_filter(sensirion_i2c_write_retry_filter_t filter)
+{
+	writeRetryFilter = filter;
+}
+
+void sensirion_i2c_get_stats(sensirion_i2c_stats_t* stats)
+{
+	uint32_t histogram[SENSIRION_I2C_HISTOGRAM_BUCKETS];
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (uint8_t i = 0; i < commandStatsUsed; i++)
+	{
+		stats->transactions += commandStats[i].transactions;
+		stats->retries += commandStats[i].retries;
+		stats->failures += commandStats[i].failures;
+		if (commandStats[i].max_usec > stats->max_usec)
+		{
+			stats->max_usec = commandStats[i].max_usec;
+		}
+	}
+
+	AggregateHistogram(histogram);
+	stats->p50_usec = sensirion_i2c_histogram_percentile(histogram, 50);
+	stats->p99_usec = sensirion_i2c_histogram_percentile(histogram, 99);
+	stats->timeout_ms = timeoutMs;
+	stats->timeout_adjustments = timeoutAdjustments;
+}
+
+const sensirion_i2c_command_stats_t* sensirion_i2c_get_command_stats(uint8_t index)
+{
+	return index < commandStatsUsed ? &commandStats[index] : NULL;
+}
+
 /// <summary>
 ///     Closes a file descriptor and prints an error on failure.
 /// </summary>
@@ -131,13 +435,8 @@ void sensirion_i2c_release(void) {
  * @returns 0 on success, error code otherwise
  */
 int8_t sensirion_i2c_read(uint8_t address, uint8_t* data, uint16_t count) {
-	// Read the data into the provided buffer
-	int32_t retVal = I2CMaster_Read(i2cHandle, address, data, count);
-	if (retVal != count)
-	{
-		Log_Debug("ERROR: Expected return value to match count\n");
-	}
-	return 0;
+	// Reads are attributed to the command written immediately before them
+	return RunTransaction(address, data, NULL, count);
 }
 
 /**
@@ -152,14 +451,12 @@ int8_t sensirion_i2c_read(uint8_t address, uint8_t* data, uint16_t count) {
  * @returns 0 on success, error code otherwise
  */
 int8_t sensirion_i2c_write(uint8_t address, const uint8_t* data, uint16_t count) {
-    // IMPLEMENT
-	int32_t retVal = I2CMaster_Write(i2cHandle, address, data, count);
-	if (retVal != count)
+	if (count >= SENSIRION_COMMAND_SIZE)
 	{
-		Log_Debug("ERROR: Expected return value to match count\n");
+		lastCommand = (uint16_t)((data[0] << 8) | data[1]);
 	}
 
-	return 0;
+	return RunTransaction(address, NULL, data, count);
 }
 
 /**
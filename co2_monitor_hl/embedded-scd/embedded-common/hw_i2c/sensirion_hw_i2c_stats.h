@@ -0,0 +1,116 @@
+/*
+ * Transaction statistics for the Azure Sphere I2C HAL
+ * (sensirion_hw_i2c_implementation.c).
+ *
+ * Every read and write is timed and attributed to the last command word that
+ * was written to the bus, and folded into a per-command log2 latency histogram.
+ * Reads, and writes the retry filter passes, are retried with bounded
+ * exponential backoff on failure. The histogram p99 sets the I2CMaster timeout.
+ */
+
+#ifndef SENSIRION_HW_I2C_STATS_H
+#define SENSIRION_HW_I2C_STATS_H
+
+#include "../sensirion_arch_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* Bucket i counts transactions that took less than 64us << i, the last bucket
+ * collects everything slower. */
+#define SENSIRION_I2C_HISTOGRAM_BUCKETS 12
+#define SENSIRION_I2C_HISTOGRAM_BASE_USEC 64u
+
+/* Number of distinct command words tracked, further commands share the last
+ * slot. */
+#define SENSIRION_I2C_MAX_TRACKED_COMMANDS 12
+
+typedef struct {
+    uint16_t command;
+    uint32_t transactions;
+    uint32_t retries;
+    uint32_t failures;
+    uint32_t max_usec;
+    uint32_t histogram[SENSIRION_I2C_HISTOGRAM_BUCKETS];
+} sensirion_i2c_command_stats_t;
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t retries;
+    uint32_t failures;
+    uint32_t timeout_adjustments;
+    uint32_t timeout_ms;
+    uint32_t p50_usec;
+    uint32_t p99_usec;
+    uint32_t max_usec;
+} sensirion_i2c_stats_t;
+
+/**
+ * Called after every read or write transaction, including failed ones.
+ *
+ * @param command  the last command word written to the bus
+ * @param is_read  1 for a read, 0 for a write
+ * @param usec     duration of the final attempt in microseconds
+ */
+typedef void (*sensirion_i2c_transaction_hook_t)(uint16_t command,
+                                                 uint8_t is_read,
+                                                 uint32_t usec);
+
+/**
+ * Install a hook for transaction tracing, NULL removes it.
+ */
+void sensirion_i2c_set_transaction_hook(sensirion_i2c_transaction_hook_t hook);
+
+/**
+ * Decides whether a failed write may be sent again.
+ *
+ * @param address  7-bit I2C address written to
+ * @param data     the bytes written, the command word first
+ * @param count    number of bytes written
+ * @returns        1 when a second delivery leaves the device as one would, a
+ *                 pointer ahead of a read or a setting written again
+ */
+typedef uint8_t (*sensirion_i2c_write_retry_filter_t)(uint8_t address,
+                                                      const uint8_t* data,
+                                                      uint16_t count);
+
+/**
+ * Install the filter for write retries. Without one no write is retried, reads
+ * always are.
+ */
+void sensirion_i2c_set_write_retry_filter(
+    sensirion_i2c_write_retry_filter_t filter);
+
+/**
+ * Summarise all transactions since sensirion_i2c_init().
+ *
+ * @param stats   filled with the aggregate counters and latency percentiles
+ */
+void sensirion_i2c_get_stats(sensirion_i2c_stats_t* stats);
+
+/**
+ * Per-command counters, in order of first use.
+ *
+ * @param index   slot index, starting at 0
+ * @returns       the slot, or NULL once index is past the last used slot
+ */
+const sensirion_i2c_command_stats_t* sensirion_i2c_get_command_stats(
+    uint8_t index);
+
+/**
+ * Percentile estimate from a latency histogram, reported as the upper bound
+ * of the bucket holding the percentile.
+ *
+ * @param histogram   SENSIRION_I2C_HISTOGRAM_BUCKETS counters
+ * @param percentile  1..100
+ * @returns           latency in microseconds, 0 if the histogram is empty
+ */
+uint32_t sensirion_i2c_histogram_percentile(const uint32_t* histogram,
+                                            uint8_t percentile);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SENSIRION_HW_I2C_STATS_H */
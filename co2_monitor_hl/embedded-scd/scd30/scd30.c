@@ -51,8 +51,8 @@ static const uint8_t SCD30_I2C_ADDRESS = 0x61;
 #define SCD30_CMD_SET_FORCED_RECALIBRATION 0x5204
 #define SCD30_CMD_AUTO_SELF_CALIBRATION 0x5306
 #define SCD30_CMD_READ_SERIAL 0xD033
+#define SCD30_CMD_READ_FIRMWARE_VERSION 0xD100
 #define SCD30_SERIAL_NUM_WORDS 16
-#define SCD30_WRITE_DELAY_US 20000
 
 #define SCD30_MAX_BUFFER_WORDS 24
 #define SCD30_CMD_SINGLE_WORD_BUF_LEN                                          \
@@ -113,6 +113,13 @@ int16_t scd30_set_measurement_interval(uint16_t interval_sec) {
     return ret;
 }
 
+int16_t scd30_get_measurement_interval(uint16_t *interval_sec) {
+    return sensirion_i2c_read_cmd(SCD30_I2C_ADDRESS,
+                                  SCD30_CMD_SET_MEASUREMENT_INTERVAL,
+                                  interval_sec,
+                                  SENSIRION_NUM_WORDS(*interval_sec));
+}
+
 int16_t scd30_get_data_ready(uint16_t *data_ready) {
     return sensirion_i2c_read_cmd(SCD30_I2C_ADDRESS, SCD30_CMD_GET_DATA_READY,
                                   data_ready, SENSIRION_NUM_WORDS(*data_ready));
@@ -129,6 +136,19 @@ int16_t scd30_set_temperature_offset(uint16_t temperature_offset) {
     return ret;
 }
 
+int16_t scd30_set_temperature_offset_no_wait(uint16_t temperature_offset) {
+    return sensirion_i2c_write_cmd_with_args(
+        SCD30_I2C_ADDRESS, SCD30_CMD_SET_TEMPERATURE_OFFSET,
+        &temperature_offset, SENSIRION_NUM_WORDS(temperature_offset));
+}
+
+int16_t scd30_get_temperature_offset(uint16_t *temperature_offset) {
+    return sensirion_i2c_read_cmd(SCD30_I2C_ADDRESS,
+                                  SCD30_CMD_SET_TEMPERATURE_OFFSET,
+                                  temperature_offset,
+                                  SENSIRION_NUM_WORDS(*temperature_offset));
+}
+
 int16_t scd30_set_altitude(uint16_t altitude) {
     int16_t ret;
 
@@ -140,6 +160,11 @@ int16_t scd30_set_altitude(uint16_t altitude) {
     return ret;
 }
 
+int16_t scd30_get_altitude(uint16_t *altitude) {
+    return sensirion_i2c_read_cmd(SCD30_I2C_ADDRESS, SCD30_CMD_SET_ALTITUDE,
+                                  altitude, SENSIRION_NUM_WORDS(*altitude));
+}
+
 int16_t scd30_get_automatic_self_calibration(uint8_t *asc_enabled) {
     uint16_t word;
     int16_t ret;
@@ -167,6 +192,14 @@ int16_t scd30_enable_automatic_self_calibration(uint8_t enable_asc) {
     return ret;
 }
 
+int16_t scd30_enable_automatic_self_calibration_no_wait(uint8_t enable_asc) {
+    uint16_t asc = !!enable_asc;
+
+    return sensirion_i2c_write_cmd_with_args(SCD30_I2C_ADDRESS,
+                                             SCD30_CMD_AUTO_SELF_CALIBRATION,
+                                             &asc, SENSIRION_NUM_WORDS(asc));
+}
+
 int16_t scd30_set_forced_recalibration(uint16_t co2_ppm) {
     int16_t ret;
 
@@ -178,6 +211,18 @@ int16_t scd30_set_forced_recalibration(uint16_t co2_ppm) {
     return ret;
 }
 
+int16_t scd30_set_forced_recalibration_no_wait(uint16_t co2_ppm) {
+    return sensirion_i2c_write_cmd_with_args(
+        SCD30_I2C_ADDRESS, SCD30_CMD_SET_FORCED_RECALIBRATION, &co2_ppm,
+        SENSIRION_NUM_WORDS(co2_ppm));
+}
+
+int16_t scd30_get_forced_recalibration(uint16_t *co2_ppm) {
+    return sensirion_i2c_read_cmd(SCD30_I2C_ADDRESS,
+                                  SCD30_CMD_SET_FORCED_RECALIBRATION, co2_ppm,
+                                  SENSIRION_NUM_WORDS(*co2_ppm));
+}
+
 int16_t scd30_read_serial(char *serial) {
     int16_t ret;
 
@@ -192,6 +237,13 @@ int16_t scd30_read_serial(char *serial) {
     return ret;
 }
 
+int16_t scd30_read_firmware_version(uint16_t *firmware_version) {
+    return sensirion_i2c_read_cmd(SCD30_I2C_ADDRESS,
+                                  SCD30_CMD_READ_FIRMWARE_VERSION,
+                                  firmware_version,
+                                  SENSIRION_NUM_WORDS(*firmware_version));
+}
+
 const char *scd30_get_driver_version() {
     return SCD_DRV_VERSION_STR;
 }
@@ -44,6 +44,9 @@
 extern "C" {
 #endif
 
+/* Time the sensor needs to process a write before it accepts the next command */
+#define SCD30_WRITE_DELAY_US 20000
+
 /**
  * scd30_probe() - check if the SCD sensor is available and initialize it
  *
@@ -127,6 +130,18 @@ int16_t scd30_read_measurement(float *co2_ppm, float *temperature,
  */
 int16_t scd30_set_measurement_interval(uint16_t interval_sec);
 
+/**
+ * scd30_get_measurement_interval() - Read the measurement interval used in
+ * continuous measurement mode.
+ *
+ * @param interval_sec  Pointer to memory of where to set the measurement
+ *                      interval in seconds. Remains untouched if return is
+ *                      non-zero.
+ *
+ * @return              0 if the command was successful, an error code otherwise
+ */
+int16_t scd30_get_measurement_interval(uint16_t *interval_sec);
+
 /**
  * scd30_get_data_ready() - Get data ready status
  *
@@ -165,6 +180,33 @@ int16_t scd30_get_data_ready(uint16_t *data_ready);
  */
 int16_t scd30_set_temperature_offset(uint16_t temperature_offset);
 
+/**
+ * scd30_set_temperature_offset_no_wait() - Set the temperature offset without
+ * waiting for the sensor to process it
+ *
+ * Same as scd30_set_temperature_offset() but returns right after the write.
+ * The caller must not send another command to the sensor for
+ * SCD30_WRITE_DELAY_US.
+ *
+ * @param temperature_offset    Temperature offset, unit [degrees Celsius * 100]
+ *
+ * @return                      0 if the command was successful, an error code
+ *                              otherwise
+ */
+int16_t scd30_set_temperature_offset_no_wait(uint16_t temperature_offset);
+
+/**
+ * scd30_get_temperature_offset() - Read the temperature offset
+ *
+ * @param temperature_offset    Pointer to memory of where to set the
+ *                              temperature offset, unit [degrees Celsius * 100].
+ *                              Remains untouched if return is non-zero.
+ *
+ * @return                      0 if the command was successful, an error code
+ *                              otherwise
+ */
+int16_t scd30_get_temperature_offset(uint16_t *temperature_offset);
+
 /**
  * scd30_set_altitude() - Set the altitude above sea level
  *
@@ -182,6 +224,17 @@ int16_t scd30_set_temperature_offset(uint16_t temperature_offset);
  */
 int16_t scd30_set_altitude(uint16_t altitude);
 
+/**
+ * scd30_get_altitude() - Read the altitude above sea level used for
+ * compensation
+ *
+ * @param altitude  Pointer to memory of where to set the altitude in meters
+ *                  above sea level. Remains untouched if return is non-zero.
+ *
+ * @return          0 if the command was successful, an error code otherwise
+ */
+int16_t scd30_get_altitude(uint16_t *altitude);
+
 /**
  * scd30_get_automatic_self_calibration() - Read if the sensor's automatic self
  * calibration is enabled or disabled
@@ -215,6 +268,20 @@ int16_t scd30_get_automatic_self_calibration(uint8_t *asc_enabled);
  */
 int16_t scd30_enable_automatic_self_calibration(uint8_t enable_asc);
 
+/**
+ * scd30_enable_automatic_self_calibration_no_wait() - Enable or disable ASC
+ * without waiting for the sensor to process it
+ *
+ * Same as scd30_enable_automatic_self_calibration() but returns right after
+ * the write. The caller must not send another command to the sensor for
+ * SCD30_WRITE_DELAY_US.
+ *
+ * @param enable_asc    enable ASC if non-zero, disable otherwise
+ *
+ * @return              0 if the command was successful, an error code otherwise
+ */
+int16_t scd30_enable_automatic_self_calibration_no_wait(uint8_t enable_asc);
+
 /**
  * scd30_set_forced_recalibration() - Forcibly recalibrate the sensor to a known
  * value.
@@ -239,6 +306,32 @@ int16_t scd30_enable_automatic_self_calibration(uint8_t enable_asc);
  */
 int16_t scd30_set_forced_recalibration(uint16_t co2_ppm);
 
+/**
+ * scd30_set_forced_recalibration_no_wait() - Forcibly recalibrate without
+ * waiting for the sensor to process it
+ *
+ * Same as scd30_set_forced_recalibration() but returns right after the write.
+ * The caller must not send another command to the sensor for
+ * SCD30_WRITE_DELAY_US.
+ *
+ * @param co2_ppm   recalibrate to this specific co2 concentration
+ *
+ * @return          0 if the command was successful, an error code otherwise
+ */
+int16_t scd30_set_forced_recalibration_no_wait(uint16_t co2_ppm);
+
+/**
+ * scd30_get_forced_recalibration() - Read the last forced recalibration
+ * reference
+ *
+ * @param co2_ppm   Pointer to memory of where to set the reference value of the
+ *                  last forced recalibration in ppm. Remains untouched if
+ *                  return is non-zero.
+ *
+ * @return          0 if the command was successful, an error code otherwise
+ */
+int16_t scd30_get_forced_recalibration(uint16_t *co2_ppm);
+
 /**
  * Read out the serial number
  *
@@ -260,6 +353,18 @@ int16_t scd30_set_forced_recalibration(uint16_t co2_ppm);
  */
 int16_t scd30_read_serial(char *serial);
 
+/**
+ * scd30_read_firmware_version() - Read the sensor firmware version
+ *
+ * @param firmware_version  Pointer to memory of where to set the firmware
+ *                          version, major version in the MSB and minor version
+ *                          in the LSB. Remains untouched if return is non-zero.
+ *
+ * @return                  0 if the command was successful, an error code
+ *                          otherwise
+ */
+int16_t scd30_read_firmware_version(uint16_t *firmware_version);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,7 @@
 
 #include "dx_azure_iot.h"
 #include "dx_config.h"
+#include "dx_direct_methods.h"
 #include "dx_exit_codes.h"
 #include "dx_gpio.h"
 #include "dx_intercore.h"
@@ -32,29 +33,172 @@
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include "adaptive_sampling.h"
+#include "alert_rules.h"
+#include "barometer.h"
+#include "capability_model.h"
+#include "co2_alert.h"
+#include "co2_calibration.h"
+#include "co2_filter.h"
+#include "co2_forecast.h"
+#include "comfort.h"
+#include "duty_cycle.h"
+#include "persistent_store.h"
+#include "pressure_compensation.h"
+#include "scd30_config.h"
+#include "reported_state.h"
+#include "rt_sampling.h"
+#include "scd30_power.h"
+#include "send_window.h"
+#include "scheduler.h"
+#include "sensor_registry.h"
+#include "sgp30.h"
+#include "temperature_calibration.h"
+#include "trace.h"
+#include "twin_cache.h"
+#include "ventilation.h"
+
 #include "./embedded-scd/scd30/scd30.h"
+#include "./embedded-scd/embedded-common/hw_i2c/sensirion_hw_i2c_stats.h"
+
+
+#define JSON_MESSAGE_BYTES 384 // Number of bytes to allocate for the JSON telemetry message for IoT Central
+#define TRACE_MESSAGE_BYTES 1536 // Per-span trace statistics message
+#define SCD30_PROBE_ATTEMPTS 5
+#define SCD30_READY_POLL_MS 100	// data ready polling while waiting for the first measurement
+#define SCD30_READY_POLLS 30
+#define DUTY_CYCLE_CONNECT_ATTEMPTS 60	// seconds to wait for a connection before keeping the batch for later
+#define DUTY_CYCLE_FLUSH_MS 5000		// time given to the IoT SDK to deliver a batch before powering down
+#define RULE_BUZZER_CHIRP_MS 200		// on and off time of one chirp in a rule buzzer pattern
+#define FORECAST_BUZZER_CHIRPS 2		// early warning chirps, a forecast crossing of the alert level
+#define TWIN_WINDOW_MS 2000				// default window: reported properties and acks set within it go out as one twin patch
+#define TWIN_WINDOW_MAX_MS 60000
+#define CO2_ALERT_HYSTERESIS_MAX_PPM 500.0f
+#define CO2_ALERT_CADENCE_MIN_MS 1000			// longer than a chirp, 0 chirps once
+#define CO2_ALERT_CADENCE_MAX_MS 600000
+#define CO2_REPORT_TOLERANCE_PPM 10.0f	// ActualCO2Level is only reported again once it moves further than this
+#define TELEMETRY_PERIOD_MS 30000		// shortest telemetry period, stretched to the sampling interval when adaptive sampling slows down
+#define ROOM_VOLUME_MAX_M3 10000.0f
+#define TEMPERATURE_OFFSET_REPORT_TOLERANCE_C 0.005f	// half a tick of the sensor's offset
+#define REFERENCE_TEMPERATURE_MIN_C -10.0f
+#define REFERENCE_TEMPERATURE_MAX_C 50.0f
+#define AMBIENT_PRESSURE_REPORT_TOLERANCE_MBAR 0.5f	// the sensor takes whole mbar
+#define SCD30_READBACK_MS (SCD30_WRITE_DELAY_US / 1000 + 5)	// a setting written without waiting is read back once the sensor took it
+#define CO2_CALIBRATION_HISTORY_BYTES 1200	// GetCO2CalibrationHistory response
+#define SCD30_START_MEASUREMENT_COMMAND 0x0010	// scd30.c command words that act on the sensor, never sent twice
+#define SCD30_FORCED_RECALIBRATION_COMMAND 0x5204
+
+#ifdef DUTY_CYCLE_MODE
+static const bool dutyCycleMode = true;
+#else
+static const bool dutyCycleMode = false;
+#endif
 
+// Duty-cycle mode stretches the sensor interval to the wake period, otherwise the sensor measures continuously
+// unless SCD30_STOP_START is set. Stop-start only applies while the app stays up. Adaptive sampling retunes the
+// interval and read period at runtime so it needs the sensor measuring continuously, stop-start keeps the read
+// period fixed so the warm-up can be scheduled ahead of each reading.
+#ifdef DUTY_CYCLE_MODE
+static const SCD30_POWER_POLICY scd30PowerPolicy = SCD30_POWER_LONG_INTERVAL;
+static const bool adaptiveSampling = false;
+#elif defined(SCD30_STOP_START)
+static const SCD30_POWER_POLICY scd30PowerPolicy = SCD30_POWER_STOP_START;
+static const bool adaptiveSampling = false;
+#else
+static const SCD30_POWER_POLICY scd30PowerPolicy = SCD30_POWER_CONTINUOUS;
+static const bool adaptiveSampling = true;
+#endif
 
-#define JSON_MESSAGE_BYTES 256 // Number of bytes to allocate for the JSON telemetry message for IoT Central
-#define OneMS 1000000		// used to simplify timer defn.
+// With the real-time sampling app deployed it owns the SCD30 and this app consumes its frames.
+// Not combined with duty-cycle mode, which powers the whole device down between readings.
+#ifdef RT_SAMPLING
+static const bool rtSamplingMode = true;
+#else
+static const bool rtSamplingMode = false;
+#endif
 
  // Forward signatures
-static void CO2AlertBuzzerOffOneShotTimer(EventLoopTimer* eventLoopTimer);
-static void CO2AlertHandler(EventLoopTimer* eventLoopTimer);
+static void CO2AlertBuzzerOffOneShotTimer(SCHED_TASK* task);
+static void CO2AlertHandler(SCHED_TASK* task);
+static void DutyCyclePowerDownHandler(SCHED_TASK* task);
+static void DutyCycleUploadHandler(SCHED_TASK* task);
 static void DeviceTwinGenericHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding);
-static void FlashLedOffTimerHandler(EventLoopTimer* eventLoopTimer);
-static void FlashLEDsTimerHandler(EventLoopTimer* eventLoopTimer);
-static void MeasureSensorHandler(EventLoopTimer* eventLoopTimer);
-static void PublishTelemetryTimer(EventLoopTimer* eventLoopTimer);
+static void FlashLedOffTimerHandler(SCHED_TASK* task);
+static void FlashLEDsTimerHandler(SCHED_TASK* task);
+static void FirstTelemetryHandler(SCHED_TASK* task);
+static void MeasureSensorHandler(SCHED_TASK* task);
+static void PublishDiagnosticsHandler(SCHED_TASK* task);
+static void PublishTelemetryTimer(SCHED_TASK* task);
+static void PublishVentilationHandler(SCHED_TASK* task);
+static void SensorPollHandler(SCHED_TASK* task);
+static void SensorStartHandler(SCHED_TASK* task);
+static void SensorWarmupHandler(SCHED_TASK* task);
+static void AlertRulesHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding);
+static void AmbientPressureHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding);
+static void BuzzerPatternHandler(SCHED_TASK* task);
+static void CO2AlertCadenceHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding);
+static void CO2AlertHysteresisHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding);
+static void CO2AutoCalibrationHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding);
+static void CO2AutoCalibrationWriteHandler(SCHED_TASK* task);
+static void CO2CalibrationReadbackHandler(SCHED_TASK* task);
+static void FreshAirCalibrationHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding);
+static DX_DIRECT_METHOD_RESPONSE_CODE CancelCO2RecalibrationHandler(JSON_Value* json, DX_DIRECT_METHOD_BINDING* directMethodBinding, char** responseMsg);
+static DX_DIRECT_METHOD_RESPONSE_CODE ForceCO2RecalibrationHandler(JSON_Value* json, DX_DIRECT_METHOD_BINDING* directMethodBinding, char** responseMsg);
+static DX_DIRECT_METHOD_RESPONSE_CODE GetCO2CalibrationHistoryHandler(JSON_Value* json, DX_DIRECT_METHOD_BINDING* directMethodBinding, char** responseMsg);
+static void ReportedStateFlushHandler(SCHED_TASK* task);
+static void ReferenceTemperatureHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding);
+static void RoomVolumeHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding);
+static void TemperatureOffsetReadbackHandler(SCHED_TASK* task);
+static void TwinWindowHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding);
 
 DX_USER_CONFIG dx_config;
 
 static char msgBuffer[JSON_MESSAGE_BYTES] = { 0 };
+static char traceMsgBuffer[TRACE_MESSAGE_BYTES] = { 0 };
+
+static float co2_ppm = NAN, temperature = NAN, relative_humidity = NAN;
+static bool rtSamplingActive = false;
+static uint32_t co2Quality = CO2_QUALITY_INVALID;	// CO2_QUALITY_ flags of co2_ppm
+static uint64_t sampleCapturedUs = 0;		// trace_nowUs of the reading in co2_ppm
+static COMFORT_METRICS comfortMetrics = { NAN, NAN, NAN, NAN };	// derived from the latest sample
+static uint32_t scd30TimeToReadyMs = 0;
+static uint32_t twinWindowMs = TWIN_WINDOW_MS;		// set by the DesiredTwinWindowMs device twin
+
+// Temperature offset calibration, only with the sensor measuring continuously and its offset not configured.
+// The record is kept with the offset it describes, an offset changed behind its back no longer matches it.
+typedef struct
+{
+	uint16_t offsetTicks;		// hundredths of a degree C, as the sensor stores it
+	uint8_t source;				// TEMPERATURE_OFFSET_SOURCE
+} TEMPERATURE_OFFSET_RECORD;
+static bool temperatureCalibrationActive = false;
+static uint16_t temperatureOffsetWritten;
+
+// CO2 recalibration and ASC settings are written without waiting out SCD30_WRITE_DELAY_US, like the temperature
+// offset. Sensor commands hold off until scd30QuietUntilUs, sched_nowUs time.
+static uint64_t scd30QuietUntilUs = 0;
+static uint16_t co2CalibrationWritten;
+static bool ascWritten = false;		// CO2AutoCalibrationWriteHandler is waiting to read the setting back
 
-static float co2_ppm, temperature, relative_humidity = NAN;
-static const struct timespec co2AlertBuzzerPeriod = { 0, 5 * 100 * 1000 };
+// The sensor is brought up on the event loop so networking, GPIOs and timers are not held up by probing
+typedef enum { SENSOR_PROBING, SENSOR_WAITING_FOR_DATA, SENSOR_READY, SENSOR_FAILED } SENSOR_STATE;
+static SENSOR_STATE sensorState = SENSOR_PROBING;
+
+// Boot timeline, milliseconds since main() was entered, published once after the first telemetry send
+typedef enum {
+	BOOT_AZURE_INITIALIZED, BOOT_TIMERS_STARTED, BOOT_SENSOR_PROBED, BOOT_SENSOR_CONFIGURED,
+	BOOT_FIRST_SAMPLE, BOOT_FIRST_CONNECT, BOOT_FIRST_SEND, BOOT_MILESTONE_COUNT
+} BOOT_MILESTONE;
+static int32_t bootTimeline[BOOT_MILESTONE_COUNT] = { -1, -1, -1, -1, -1, -1, -1 };
+
+// measurementInterval is set from scd30PowerPolicy at startup
+static SCD30_CONFIG scd30Config = {
+	.measurementInterval = 2, .ascEnabled = 1, .temperatureOffset = SCD30_CONFIG_UNMANAGED, .altitude = SCD30_CONFIG_UNMANAGED, .ambientPressure = 0
+};
 
 // GPIO Output PeripheralGpios
 #ifdef OEM_SEEED_STUDIO
@@ -68,28 +212,87 @@ static DX_PERIPHERAL_GPIO co2AlertPin = { .pin = CO2_ALERT, .direction = DX_OUTP
 #endif // OEM_AVNET
 
 static DX_GPIO azureIotConnectedLed = { .pin = NETWORK_CONNECTED_LED, .direction = DX_OUTPUT, .initialState = GPIO_Value_Low, .invertPin = true, .name = "azureConnectedLed" };
+static DX_GPIO alertLed = { .pin = LED_RED, .direction = DX_OUTPUT, .initialState = GPIO_Value_Low, .invertPin = true, .name = "alertLed" };
+
+// Timers, all driven by one timerfd. toleranceMs lets the scheduler run a task early so it shares a wakeup with
+// another task already due, priority orders tasks that run in the same wakeup. Tasks that wait out a sensor delay
+// have none.
+static SCHED_TASK flashLEDsTimer = { .name = "flashLEDsTimer", .handler = FlashLEDsTimerHandler, .periodMs = 1400, .toleranceMs = 50, .priority = 2, .span = TRACE_FLASH_LEDS };
+static SCHED_TASK flashLedOffTimer = { .name = "flashLedOffTimer", .handler = FlashLedOffTimerHandler, .toleranceMs = 50, .priority = 2, .span = TRACE_FLASH_LED_OFF };
+static SCHED_TASK measureSensorTimer = { .name = "measureSensorTimer", .handler = MeasureSensorHandler, .periodMs = 20000, .toleranceMs = 1000, .priority = 1, .span = TRACE_MEASURE_SENSOR };
+static SCHED_TASK publishTelemetryTimer = { .name = "publishTelemetryTimer", .handler = PublishTelemetryTimer, .periodMs = TELEMETRY_PERIOD_MS, .toleranceMs = 2000, .priority = 3, .span = TRACE_PUBLISH_TELEMETRY };
+// Buzzer cadence while an alert is raised, armed by EvaluateCO2Alert
+static SCHED_TASK co2AlertTimer = { .name = "co2AlertTimer", .handler = CO2AlertHandler, .toleranceMs = 100, .priority = 0, .span = TRACE_CO2_ALERT };
+static SCHED_TASK buzzerPatternTimer = { .name = "buzzerPatternTimer", .handler = BuzzerPatternHandler, .toleranceMs = 20, .priority = 0, .span = TRACE_CO2_ALERT };
+static SCHED_TASK co2AlertBuzzerOffOneShotTimer = { .name = "co2AlertBuzzerOffOneShotTimer", .handler = CO2AlertBuzzerOffOneShotTimer, .priority = 0, .span = TRACE_CO2_BUZZER_OFF };
+// Ventilation estimates move over tens of minutes, sent in a message of their own
+static SCHED_TASK publishVentilationTimer = { .name = "publishVentilationTimer", .handler = PublishVentilationHandler, .periodMs = VENTILATION_PUBLISH_PERIOD_MS, .toleranceMs = 30000, .priority = 4, .span = TRACE_PUBLISH_VENTILATION };
+static SCHED_TASK publishDiagnosticsTimer = { .name = "publishDiagnosticsTimer", .handler = PublishDiagnosticsHandler, .periodMs = 300000, .toleranceMs = 10000, .priority = 4, .span = TRACE_PUBLISH_DIAGNOSTICS };
+static SCHED_TASK sensorStartTimer = { .name = "sensorStartTimer", .handler = SensorStartHandler, .priority = 1, .span = TRACE_SENSOR_START };
+static SCHED_TASK sensorWarmupTimer = { .name = "sensorWarmupTimer", .handler = SensorWarmupHandler, .toleranceMs = 200, .priority = 1, .span = TRACE_SENSOR_START };
+static SCHED_TASK firstTelemetryTimer = { .name = "firstTelemetryTimer", .handler = FirstTelemetryHandler, .toleranceMs = 200, .priority = 3, .span = TRACE_FIRST_TELEMETRY };
+static SCHED_TASK reportedStateFlushTimer = { .name = "reportedStateFlushTimer", .handler = ReportedStateFlushHandler, .toleranceMs = 500, .priority = 3, .span = TRACE_DEVICE_TWIN };
+static SCHED_TASK dutyCycleUploadTimer = { .name = "dutyCycleUploadTimer", .handler = DutyCycleUploadHandler, .toleranceMs = 200, .priority = 3, .span = TRACE_PUBLISH_TELEMETRY };
+static SCHED_TASK dutyCyclePowerDownTimer = { .name = "dutyCyclePowerDownTimer", .handler = DutyCyclePowerDownHandler, .priority = 4, .span = TRACE_DUTY_CYCLE_POWER_DOWN };
+static SCHED_TASK temperatureOffsetTimer = { .name = "temperatureOffsetTimer", .handler = TemperatureOffsetReadbackHandler, .priority = 1, .span = TRACE_TEMPERATURE_OFFSET };
+static SCHED_TASK co2CalibrationTimer = { .name = "co2CalibrationTimer", .handler = CO2CalibrationReadbackHandler, .priority = 1, .span = TRACE_CO2_CALIBRATION };
+static SCHED_TASK co2AutoCalibrationTimer = { .name = "co2AutoCalibrationTimer", .handler = CO2AutoCalibrationWriteHandler, .toleranceMs = 20, .priority = 1, .span = TRACE_CO2_AUTO_CALIBRATION };
+static SCHED_TASK sensorPollTimer = { .name = "sensorPollTimer", .handler = SensorPollHandler, .priority = 2, .span = TRACE_SENSOR_POLL };
 
-// Timers
-static DX_TIMER flashLEDsTimer = { .period = {0, 0},.name = "flashLEDsTimer",.handler = FlashLEDsTimerHandler };
-static DX_TIMER flashLedOffTimer = { .period = {0,0},.name = "flashLedOffTimer",.handler = FlashLedOffTimerHandler };
-static DX_TIMER measureSensorTimer = { .period = {20, 0}, .name = "measureSensorTimer", .handler = MeasureSensorHandler };
-static DX_TIMER publishTelemetryTimer = { .period = {30, 0}, .name = "publishTelemetryTimer", .handler = PublishTelemetryTimer };
-static DX_TIMER co2AlertTimer = { .period = {4, 0}, .name = "co2AlertTimer", .handler = CO2AlertHandler };
-static DX_TIMER co2AlertBuzzerOffOneShotTimer = { .period = { 0, 0 }, .name = "co2AlertBuzzerOffOneShotTimer", .handler = CO2AlertBuzzerOffOneShotTimer };
+// Sensors besides the SCD30, all polled by sensorPollTimer. The barometer is only fitted to the Avnet board.
+static const SENSOR_DRIVER* const sensorDrivers[] = {
+#ifdef OEM_AVNET
+	&barometerDriver,
+#endif // OEM_AVNET
+	&sgp30Driver
+};
 
 // Azure IoT Device Twins
-static DX_DEVICE_TWIN_BINDING desiredCO2AlertLevel = { .twinProperty = "DesiredCO2AlertLevel", .twinType = DX_TYPE_FLOAT, .handler = DeviceTwinGenericHandler };
-static DX_DEVICE_TWIN_BINDING actualCO2Level = { .twinProperty = "ActualCO2Level", .twinType = DX_TYPE_FLOAT };
+// Names and types come from the capability model, see capability_model.h
+static DX_DEVICE_TWIN_BINDING desiredCO2AlertLevel = CAPABILITY_TWIN_DESIRED_CO2_ALERT_LEVEL(DeviceTwinGenericHandler);
+static DX_DEVICE_TWIN_BINDING desiredCO2AlertHysteresis = CAPABILITY_TWIN_DESIRED_CO2_ALERT_HYSTERESIS(CO2AlertHysteresisHandler);
+static DX_DEVICE_TWIN_BINDING desiredCO2AlertCadenceMs = CAPABILITY_TWIN_DESIRED_CO2_ALERT_CADENCE_MS(CO2AlertCadenceHandler);
+static DX_DEVICE_TWIN_BINDING actualCO2Level = CAPABILITY_TWIN_ACTUAL_CO2_LEVEL;
+static DX_DEVICE_TWIN_BINDING desiredAlertRules = CAPABILITY_TWIN_DESIRED_ALERT_RULES(AlertRulesHandler);
+static DX_DEVICE_TWIN_BINDING alertRulesActive = CAPABILITY_TWIN_ALERT_RULES_ACTIVE;
+static DX_DEVICE_TWIN_BINDING desiredTwinWindowMs = CAPABILITY_TWIN_DESIRED_TWIN_WINDOW_MS(TwinWindowHandler);
+static DX_DEVICE_TWIN_BINDING desiredRoomVolume = CAPABILITY_TWIN_DESIRED_ROOM_VOLUME(RoomVolumeHandler);
+static DX_DEVICE_TWIN_BINDING desiredReferenceTemperature = CAPABILITY_TWIN_DESIRED_REFERENCE_TEMPERATURE(ReferenceTemperatureHandler);
+static DX_DEVICE_TWIN_BINDING temperatureOffset = CAPABILITY_TWIN_TEMPERATURE_OFFSET;
+static DX_DEVICE_TWIN_BINDING desiredCO2AutoCalibration = CAPABILITY_TWIN_DESIRED_CO2_AUTO_CALIBRATION(CO2AutoCalibrationHandler);
+static DX_DEVICE_TWIN_BINDING desiredFreshAirCalibration = CAPABILITY_TWIN_DESIRED_FRESH_AIR_CALIBRATION(FreshAirCalibrationHandler);
+static DX_DEVICE_TWIN_BINDING co2CalibrationPhase = CAPABILITY_TWIN_CO2_CALIBRATION_PHASE;
+static DX_DEVICE_TWIN_BINDING lastCO2CalibrationAt = CAPABILITY_TWIN_LAST_CO2_CALIBRATION_AT;
+static DX_DEVICE_TWIN_BINDING lastCO2CalibrationResult = CAPABILITY_TWIN_LAST_CO2_CALIBRATION_RESULT;
+static DX_DEVICE_TWIN_BINDING lastCO2CalibrationCorrection = CAPABILITY_TWIN_LAST_CO2_CALIBRATION_CORRECTION;
+static DX_DEVICE_TWIN_BINDING desiredAmbientPressure = CAPABILITY_TWIN_DESIRED_AMBIENT_PRESSURE(AmbientPressureHandler);
+static DX_DEVICE_TWIN_BINDING ambientPressure = CAPABILITY_TWIN_AMBIENT_PRESSURE;
+
+// Azure IoT Direct Methods
+static DX_DIRECT_METHOD_BINDING forceCO2Recalibration = CAPABILITY_METHOD_FORCE_CO2_RECALIBRATION(ForceCO2RecalibrationHandler);
+static DX_DIRECT_METHOD_BINDING cancelCO2Recalibration = CAPABILITY_METHOD_CANCEL_CO2_RECALIBRATION(CancelCO2RecalibrationHandler);
+static DX_DIRECT_METHOD_BINDING getCO2CalibrationHistory = CAPABILITY_METHOD_GET_CO2_CALIBRATION_HISTORY(GetCO2CalibrationHistoryHandler);
 
 // Initialize Sets
-DX_GPIO* PeripheralGpioSet[] = { &co2AlertPin, &azureIotConnectedLed };
-DX_DEVICE_TWIN_BINDING* deviceTwinBindingSet[] = { &desiredCO2AlertLevel, &actualCO2Level };
-DX_TIMER* timerSet[] = {
+DX_GPIO* PeripheralGpioSet[] = { &co2AlertPin, &azureIotConnectedLed, &alertLed };
+DX_DEVICE_TWIN_BINDING* deviceTwinBindingSet[] = { &desiredCO2AlertLevel, &desiredCO2AlertHysteresis, &desiredCO2AlertCadenceMs, &actualCO2Level, &desiredAlertRules, &alertRulesActive, &desiredTwinWindowMs, &desiredRoomVolume,
+	&desiredReferenceTemperature, &temperatureOffset, &desiredCO2AutoCalibration, &desiredFreshAirCalibration, &co2CalibrationPhase,
+	&lastCO2CalibrationAt, &lastCO2CalibrationResult, &lastCO2CalibrationCorrection, &desiredAmbientPressure, &ambientPressure };
+_Static_assert(NELEMS(deviceTwinBindingSet) == CAPABILITY_TWIN_COUNT, "a capability model property has no binding");
+_Static_assert(CAPABILITY_TWIN_WRITABLE_COUNT <= TWIN_CACHE_PROPERTIES, "the twin cache cannot hold every writable property");
+DX_DIRECT_METHOD_BINDING* directMethodBindingSet[] = { &forceCO2Recalibration, &cancelCO2Recalibration, &getCO2CalibrationHistory };
+_Static_assert(NELEMS(directMethodBindingSet) == CAPABILITY_METHOD_COUNT, "a capability model command has no binding");
+_Static_assert(CAPABILITY_TELEMETRY_MAX_BYTES <= JSON_MESSAGE_BYTES, "telemetry message buffer too small");
+_Static_assert(CAPABILITY_VENTILATION_TELEMETRY_MAX_BYTES <= JSON_MESSAGE_BYTES, "ventilation message buffer too small");
+SCHED_TASK* timerSet[] = {
 		&flashLEDsTimer, & flashLedOffTimer, &measureSensorTimer, &publishTelemetryTimer,
-		&co2AlertTimer, &co2AlertBuzzerOffOneShotTimer
+		&co2AlertTimer, &co2AlertBuzzerOffOneShotTimer, &publishDiagnosticsTimer, &sensorStartTimer,
+		&firstTelemetryTimer, &sensorWarmupTimer, &buzzerPatternTimer, &reportedStateFlushTimer, &publishVentilationTimer,
+		&temperatureOffsetTimer, &co2CalibrationTimer, &co2AutoCalibrationTimer, &sensorPollTimer
 };
+// Duty-cycle mode only samples, uploads and powers down
+SCHED_TASK* dutyCycleTimerSet[] = { &sensorStartTimer, &dutyCycleUploadTimer, &dutyCyclePowerDownTimer, &reportedStateFlushTimer };
 
-static const char* MsgTemplate = "{ \"CO2\": %3.2f, \"Temperature\": %3.2f, \"Humidity\": \"%3.1f\", \"MsgId\":%d }";
 static DX_MESSAGE_PROPERTY* telemetryMessageProperties[] = {
 	&(DX_MESSAGE_PROPERTY) { .key = "appid", .value = "co2monitor" },
 	&(DX_MESSAGE_PROPERTY) {.key = "format", .value = "json" },
@@ -97,11 +300,60 @@ static DX_MESSAGE_PROPERTY* telemetryMessageProperties[] = {
 	&(DX_MESSAGE_PROPERTY) {.key = "version", .value = "1" }
 };
 
-static void FlashLedOffTimerHandler(EventLoopTimer* eventLoopTimer) {
-	if (ConsumeEventLoopTimerEvent(eventLoopTimer) != 0) {
-		dx_terminate(DX_ExitCode_ConsumeEventLoopTimeEvent);
-		return;
-	}
+static const char* DiagnosticsTemplate = "{ \"I2cTransactions\": %u, \"I2cRetries\": %u, \"I2cFailures\": %u, \"I2cP50Us\": %u, \"I2cP99Us\": %u, \"I2cMaxUs\": %u, \"I2cTimeoutMs\": %u, \"Scd30ReadyMs\": %u, \"WakeupsPerHour\": %u }";
+static const char* BootTimelineTemplate = "{ \"BootAzureInitMs\": %d, \"BootTimersMs\": %d, \"BootProbeMs\": %d, \"BootConfigMs\": %d, "
+	"\"BootFirstSampleMs\": %d, \"BootFirstConnectMs\": %d, \"BootFirstSendMs\": %d }";
+static DX_MESSAGE_PROPERTY* batchMessageProperties[] = {
+	&(DX_MESSAGE_PROPERTY) { .key = "appid", .value = "co2monitor" },
+	&(DX_MESSAGE_PROPERTY) {.key = "format", .value = "json" },
+	&(DX_MESSAGE_PROPERTY) {.key = "type", .value = "batch" },
+	&(DX_MESSAGE_PROPERTY) {.key = "version", .value = "1" }
+};
+static const char* AlertRuleTemplate = "{ \"AlertRule\": %u, \"Metric\": \"%s\", \"Value\": %.2f, \"Threshold\": %.2f, \"Active\": %s }";
+static const char* ForecastTemplate = "{ \"CO2Forecast\": %s, \"AlertLevel\": %.0f, \"SecondsToAlert\": %d, \"SlopePpmPerMin\": %.1f }";
+static DX_MESSAGE_PROPERTY* alertMessageProperties[] = {
+	&(DX_MESSAGE_PROPERTY) { .key = "appid", .value = "co2monitor" },
+	&(DX_MESSAGE_PROPERTY) {.key = "format", .value = "json" },
+	&(DX_MESSAGE_PROPERTY) {.key = "type", .value = "alert" },
+	&(DX_MESSAGE_PROPERTY) {.key = "priority", .value = "high" },
+	&(DX_MESSAGE_PROPERTY) {.key = "version", .value = "1" }
+};
+static DX_MESSAGE_PROPERTY* ventilationMessageProperties[] = {
+	&(DX_MESSAGE_PROPERTY) { .key = "appid", .value = "co2monitor" },
+	&(DX_MESSAGE_PROPERTY) {.key = "format", .value = "json" },
+	&(DX_MESSAGE_PROPERTY) {.key = "type", .value = "ventilation" },
+	&(DX_MESSAGE_PROPERTY) {.key = "version", .value = "1" }
+};
+static DX_MESSAGE_PROPERTY* sensorMessageProperties[] = {
+	&(DX_MESSAGE_PROPERTY) { .key = "appid", .value = "co2monitor" },
+	&(DX_MESSAGE_PROPERTY) {.key = "format", .value = "json" },
+	&(DX_MESSAGE_PROPERTY) {.key = "type", .value = "sensors" },
+	&(DX_MESSAGE_PROPERTY) {.key = "version", .value = "1" }
+};
+static DX_MESSAGE_PROPERTY* diagnosticsMessageProperties[] = {
+	&(DX_MESSAGE_PROPERTY) { .key = "appid", .value = "co2monitor" },
+	&(DX_MESSAGE_PROPERTY) {.key = "format", .value = "json" },
+	&(DX_MESSAGE_PROPERTY) {.key = "type", .value = "diagnostics" },
+	&(DX_MESSAGE_PROPERTY) {.key = "version", .value = "1" }
+};
+
+static int32_t BootElapsedMs(void)
+{
+	return (int32_t)(trace_nowUs() / 1000);
+}
+
+/// <summary>
+/// Record the first time a boot milestone is reached
+/// </summary>
+static void MarkBootMilestone(BOOT_MILESTONE milestone)
+{
+	if (bootTimeline[milestone] >= 0) { return; }
+
+	bootTimeline[milestone] = BootElapsedMs();
+	Log_Debug("Boot milestone %d at %d ms\n", milestone, bootTimeline[milestone]);
+}
+
+static void FlashLedOffTimerHandler(SCHED_TASK* task) {
 	dx_gpioOff(&azureIotConnectedLed);
 }
 
@@ -109,35 +361,29 @@ static void FlashLedOffTimerHandler(EventLoopTimer* eventLoopTimer) {
 /// <summary>
 /// Check status of connection to Azure IoT
 /// </summary>
-static void FlashLEDsTimerHandler(EventLoopTimer* eventLoopTimer)
+static void FlashLEDsTimerHandler(SCHED_TASK* task)
 {
-	static bool toggleConnectionStatusLed = true;
-
-	if (ConsumeEventLoopTimerEvent(eventLoopTimer) != 0)
-	{
-		dx_terminate(DX_ExitCode_ConsumeEventLoopTimeEvent);
-		return;
-	}
+	// flashLEDsTimer repeats every 1400 ms, the off time is relative to its deadline so the pattern does not drift
 	if (dx_azureIsConnected()) {
 
+		MarkBootMilestone(BOOT_FIRST_CONNECT);
+		trace_bootMilestone(TRACE_BOOT_FIRST_CONNECT);
+		sendWindow_service();
 		dx_gpioOn(&azureIotConnectedLed);
 		// on for 1300ms off for 100ms = 1400 ms in total
-		dx_timerOneShotSet(&flashLEDsTimer, &(struct timespec){1, 400 * OneMS});
-		dx_timerOneShotSet(&flashLedOffTimer, &(struct timespec){1, 300 * OneMS});
+		sched_runAt(&flashLedOffTimer, task->lastDeadlineUs + 1300 * 1000);
 
 	} else if (dx_isNetworkReady()) {
 
 		dx_gpioOn(&azureIotConnectedLed);
 		// on for 100ms off for 1300ms = 1400 ms in total
-		dx_timerOneShotSet(&flashLEDsTimer, &(struct timespec){1, 400 * OneMS});
-		dx_timerOneShotSet(&flashLedOffTimer, &(struct timespec){0, 100 * OneMS});
+		sched_runAt(&flashLedOffTimer, task->lastDeadlineUs + 100 * 1000);
 
 	} else {
 
 		dx_gpioOn(&azureIotConnectedLed);
 		// on for 700ms off for 700ms = 1400 ms in total
-		dx_timerOneShotSet(&flashLEDsTimer, &(struct timespec){1, 400 * OneMS});
-		dx_timerOneShotSet(&flashLedOffTimer, &(struct timespec){0, 700 * OneMS});
+		sched_runAt(&flashLedOffTimer, task->lastDeadlineUs + 700 * 1000);
 	}
 
 }
@@ -146,171 +392,1621 @@ static void FlashLEDsTimerHandler(EventLoopTimer* eventLoopTimer)
 /// <summary>
 /// Turn off CO2 Buzzer
 /// </summary>
-static void CO2AlertBuzzerOffOneShotTimer(EventLoopTimer* eventLoopTimer)
+static void CO2AlertBuzzerOffOneShotTimer(SCHED_TASK* task)
+{
+	dx_gpioOff(&co2AlertPin);
+}
+
+
+/// <summary>
+/// End of a twin window: send queued reported properties and acks as one patch and persist accepted
+/// desired properties. While not connected keep retrying every window.
+/// </summary>
+static void ReportedStateFlushHandler(SCHED_TASK* task)
 {
-	if (ConsumeEventLoopTimerEvent(eventLoopTimer) != 0)
+	reportedState_flush();
+	twinCache_flush();
+	if (reportedState_pending())
 	{
-		dx_terminate(DX_ExitCode_ConsumeEventLoopTimeEvent);
-		return;
+		sched_runAfter(task, twinWindowMs ? twinWindowMs : TWIN_WINDOW_MS);
 	}
-	dx_gpioOff(&co2AlertPin);
 }
 
+/// <summary>
+/// Open a twin window unless one is already open. Desired values are applied as they arrive, only their
+/// acks, reported state and persistence wait for the end of the window.
+/// </summary>
+static void ScheduleReportedState(void)
+{
+	if (!reportedStateFlushTimer.armed)
+	{
+		sched_runAfter(&reportedStateFlushTimer, twinWindowMs);
+	}
+}
+
+/// <summary>
+/// Desired CO2 alert level from the device twin, or from the desired-property cache until the twin arrives
+/// </summary>
+static float CO2AlertLevel(void)
+{
+	float level;
+
+	if (desiredCO2AlertLevel.twinStateUpdated)
+	{
+		return *(float*)desiredCO2AlertLevel.twinState;
+	}
+	return twinCache_get(desiredCO2AlertLevel.twinProperty, DX_TYPE_FLOAT, &level) ? level : NAN;
+}
+
+/// <summary>
+/// Chirp the CO2 buzzer, repeated at the alert cadence while the alert is raised
+/// </summary>
+static void CO2AlertHandler(SCHED_TASK* task)
+{
+	dx_gpioOn(&co2AlertPin);
+	sched_runAfter(&co2AlertBuzzerOffOneShotTimer, co2Alert_getConfig()->buzzerOnMs);
+}
 
 /// <summary>
-/// Turn on CO2 Buzzer if CO2 ppm greater than desiredCO2AlertLevel device twin
+/// Evaluate the CO2 alert on a new sample against the desiredCO2AlertLevel device twin.
+/// sampleUs is when the sample was read, sample-to-buzzer latency is traced as CO2AlertLatency.
 /// </summary>
-static void CO2AlertHandler(EventLoopTimer* eventLoopTimer)
+static void EvaluateCO2Alert(uint64_t sampleUs)
 {
-	//static bool buzzerState = false;
+	float alertLevel = CO2AlertLevel();
+	const CO2_ALERT_CONFIG* config = co2Alert_getConfig();
 
-	if (ConsumeEventLoopTimerEvent(eventLoopTimer) != 0)
+	switch (co2Alert_evaluate(co2_ppm, alertLevel, sampleUs))
 	{
-		dx_terminate(DX_ExitCode_ConsumeEventLoopTimeEvent);
+	case CO2_ALERT_RAISED:
+		CO2AlertHandler(&co2AlertTimer);
+		trace_recordDuration(TRACE_CO2_ALERT_LATENCY, (uint32_t)(trace_nowUs() - sampleUs));
+		co2AlertTimer.periodMs = config->buzzerCadenceMs;
+		if (config->buzzerCadenceMs)
+		{
+			sched_runAfter(&co2AlertTimer, config->buzzerCadenceMs);
+		}
+		break;
+	case CO2_ALERT_CLEARED:
+		sched_setPeriod(&co2AlertTimer, 0);
+		break;
+	default:
+		break;
 	}
-	else
+}
+
+/// <summary>
+/// Apply a new chirp cadence, a raised alert moves to it straight away
+/// </summary>
+static void SetCO2AlertCadence(uint32_t cadenceMs)
+{
+	CO2_ALERT_CONFIG config = *co2Alert_getConfig();
+
+	config.buzzerCadenceMs = cadenceMs;
+	co2Alert_configure(&config);
+	if (co2Alert_isActive())
 	{
-		if (desiredCO2AlertLevel.twinStateUpdated && !isnan(co2_ppm) && co2_ppm > * (float*)desiredCO2AlertLevel.twinState)
+		co2AlertTimer.periodMs = cadenceMs;
+		if (cadenceMs)
+		{
+			sched_runAfter(&co2AlertTimer, cadenceMs);
+		}
+		else
 		{
-			dx_gpioOn(&co2AlertPin);
-			dx_timerOneShotSet(&co2AlertBuzzerOffOneShotTimer, &co2AlertBuzzerPeriod);
+			sched_cancel(&co2AlertTimer);
 		}
 	}
 }
 
-static void PublishTelemetryTimer(EventLoopTimer* eventLoopTimer)
+static void SetCO2AlertHysteresis(float hysteresisPpm)
 {
-	static int msgId = 0;
+	CO2_ALERT_CONFIG config = *co2Alert_getConfig();
+
+	config.hysteresisPpm = hysteresisPpm;
+	co2Alert_configure(&config);
+}
+
+static int buzzerPatternSteps = 0;
+static int ledRulesActive = 0;
+
+/// <summary>
+/// Start a rule buzzer pattern of RULE_BUZZER_CHIRP_MS chirps
+/// </summary>
+static void StartBuzzerPattern(uint8_t chirps)
+{
+	buzzerPatternSteps = chirps * 2 - 1;
+	dx_gpioOn(&co2AlertPin);
+	buzzerPatternTimer.periodMs = RULE_BUZZER_CHIRP_MS;
+	sched_runAfter(&buzzerPatternTimer, RULE_BUZZER_CHIRP_MS);
+}
 
-	if (ConsumeEventLoopTimerEvent(eventLoopTimer) != 0)
+static void BuzzerPatternHandler(SCHED_TASK* task)
+{
+	// An odd number of steps left switches off, even switches on
+	if (buzzerPatternSteps % 2)
 	{
-		dx_terminate(DX_ExitCode_ConsumeEventLoopTimeEvent);
+		dx_gpioOff(&co2AlertPin);
 	}
 	else
 	{
-		if (!isnan(co2_ppm))
+		dx_gpioOn(&co2AlertPin);
+	}
+
+	if (--buzzerPatternSteps <= 0)
+	{
+		sched_setPeriod(task, 0);
+	}
+}
+
+/// <summary>
+/// Evaluate the compiled alert rules on a new sample and run the actions of rules that fired or cleared
+/// </summary>
+static void EvaluateAlertRules(uint64_t sampleUs)
+{
+	ADAPTIVE_SAMPLING_STATE samplingState;
+	ALERT_RULE_EVENT events[ALERT_RULES_MAX];
+	float metrics[RULE_METRIC_COUNT];
+	bool reportChanged = false;
+	size_t eventCount;
+
+	if (alertRules_count() == 0)
+	{
+		return;
+	}
+
+	adaptiveSampling_getState(&samplingState);
+	metrics[RULE_METRIC_CO2] = co2_ppm;
+	metrics[RULE_METRIC_TEMPERATURE] = temperature;
+	metrics[RULE_METRIC_HUMIDITY] = relative_humidity;
+	metrics[RULE_METRIC_CO2_SLOPE] = adaptiveSampling && samplingState.samples ? samplingState.rate : NAN;
+
+	eventCount = alertRules_evaluate(metrics, sampleUs, events, NELEMS(events));
+
+	for (size_t i = 0; i < eventCount; i++)
+	{
+		const ALERT_RULE* rule = events[i].rule;
+
+		switch (rule->action)
 		{
-			if (snprintf(msgBuffer, JSON_MESSAGE_BYTES, MsgTemplate, co2_ppm, temperature, relative_humidity, ++msgId) > 0)
+		case RULE_ACTION_BUZZER:
+			if (events[i].active)
+			{
+				StartBuzzerPattern(rule->pattern);
+			}
+			break;
+		case RULE_ACTION_LED:
+			ledRulesActive += events[i].active ? 1 : -1;
+			if (ledRulesActive > 0) { dx_gpioOn(&alertLed); }
+			else { dx_gpioOff(&alertLed); }
+			break;
+		case RULE_ACTION_TELEMETRY:
+			if (snprintf(msgBuffer, JSON_MESSAGE_BYTES, AlertRuleTemplate, events[i].index, alertRules_metricName(rule->metric),
+				events[i].value, rule->threshold, events[i].active ? "true" : "false") > 0)
 			{
-				Log_Debug("%s\n", msgBuffer);
-				dx_azureMsgSendWithProperties(msgBuffer, telemetryMessageProperties, NELEMS(telemetryMessageProperties));
+				sendWindow_send(SEND_KIND_ALERT, msgBuffer, alertMessageProperties, NELEMS(alertMessageProperties));
 			}
-			dx_deviceTwinReportState(&actualCO2Level, &co2_ppm);
+			break;
+		case RULE_ACTION_REPORT:
+			reportChanged = true;
+			break;
 		}
 	}
+
+	if (reportChanged && reportedState_setInt(alertRulesActive.twinProperty, (int)alertRules_activeMask()))
+	{
+		ScheduleReportedState();
+	}
+}
+
+/// <summary>
+/// Warn ahead of the CO2 alert when the trend crosses the alert level within the forecast lead time.
+/// Not while the alert is raised, it is already sounding.
+/// </summary>
+static void EvaluateCO2Forecast(uint64_t sampleUs)
+{
+	CO2_FORECAST_STATE state;
+	CO2_FORECAST_EVENT event = co2Forecast_update(co2_ppm, co2Alert_isActive() ? NAN : CO2AlertLevel(), sampleUs);
+
+	if (event == CO2_FORECAST_NONE)
+	{
+		return;
+	}
+
+	if (event == CO2_FORECAST_WARNING)
+	{
+		StartBuzzerPattern(FORECAST_BUZZER_CHIRPS);
+	}
+
+	// SecondsToAlert is -1 once no crossing is forecast
+	co2Forecast_getState(&state);
+	if (snprintf(msgBuffer, JSON_MESSAGE_BYTES, ForecastTemplate, event == CO2_FORECAST_WARNING ? "true" : "false", CO2AlertLevel(),
+		isnan(state.secondsToLevel) ? -1 : (int)state.secondsToLevel, isnan(state.slopePpmPerMinute) ? 0.0f : state.slopePpmPerMinute) > 0)
+	{
+		Log_Debug("%s\n", msgBuffer);
+		sendWindow_send(SEND_KIND_ALERT, msgBuffer, alertMessageProperties, NELEMS(alertMessageProperties));
+	}
 }
 
+/// <summary>
+/// Everything that runs on each new sample, in the sampling path
+/// </summary>
+static void ProcessSample(uint64_t sampleUs)
+{
+	sampleCapturedUs = sampleUs;
+	comfort_compute(co2_ppm, temperature, relative_humidity, &comfortMetrics);
+	EvaluateCO2Alert(sampleUs);
+	EvaluateCO2Forecast(sampleUs);
+	EvaluateAlertRules(sampleUs);
+}
 
 /// <summary>
-/// Read sensor and send to Azure IoT
+/// Pass a reading through the filter stage, co2_ppm becomes the filtered value, and on to the ventilation estimate.
+/// Duty-cycle mode does neither, the window and trend would not survive the power down between readings.
 /// </summary>
-static void MeasureSensorHandler(EventLoopTimer* eventLoopTimer)
+/// <returns>true when co2_ppm holds a usable value</returns>
+static bool FilterCO2(float co2, uint64_t sampleUs)
 {
-	if (ConsumeEventLoopTimerEvent(eventLoopTimer) != 0)
+	co2_ppm = co2Filter_apply(co2, sampleUs, &co2Quality);
+	if (isnan(co2_ppm))
 	{
-		dx_terminate(DX_ExitCode_ConsumeEventLoopTimeEvent);
+		// A run of unreadable samples clears a raised alert
+		EvaluateCO2Alert(sampleUs);
+		return false;
 	}
-	else
+
+	ventilation_update(co2_ppm, sampleUs);
+	return true;
+}
+
+/// <summary>
+/// A batch of frames from the real-time core, oldest first. Every frame goes through the sampling path
+/// so alert hold times see each reading, telemetry picks up the newest.
+/// </summary>
+static void RtFramesHandler(const SAMPLE_FRAME* frames, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
 	{
-		if (scd30_read_measurement(&co2_ppm, &temperature, &relative_humidity) != STATUS_OK)
+		if (frames[i].status == SAMPLE_FRAME_OK)
 		{
-			co2_ppm = NAN;
+			temperature = frames[i].temperature;
+			relative_humidity = frames[i].humidity;
+		}
+
+		if (!FilterCO2(frames[i].status == SAMPLE_FRAME_OK ? frames[i].co2 : NAN, frames[i].captureUs))
+		{
+			continue;
+		}
+
+		if (bootTimeline[BOOT_FIRST_SAMPLE] < 0)
+		{
+			MarkBootMilestone(BOOT_FIRST_SAMPLE);
+			trace_bootMilestone(TRACE_BOOT_FIRST_SAMPLE);
+			sched_runAfter(&firstTelemetryTimer, 0);
 		}
+		ProcessSample(frames[i].captureUs);
 	}
 }
 
 /// <summary>
-/// Generic Device Twin Handler. It just sets reported state for the twin
+/// Publish the boot timeline once every milestone has been reached
 /// </summary>
-static void DeviceTwinGenericHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding)
+static void PublishBootTimeline(void)
 {
-	dx_deviceTwinReportState(deviceTwinBinding, deviceTwinBinding->twinState);
-	dx_deviceTwinAckDesiredState(deviceTwinBinding, deviceTwinBinding->twinState, DX_DEVICE_TWIN_COMPLETED);
+	if (snprintf(msgBuffer, JSON_MESSAGE_BYTES, BootTimelineTemplate,
+		bootTimeline[BOOT_AZURE_INITIALIZED], bootTimeline[BOOT_TIMERS_STARTED], bootTimeline[BOOT_SENSOR_PROBED],
+		bootTimeline[BOOT_SENSOR_CONFIGURED], bootTimeline[BOOT_FIRST_SAMPLE], bootTimeline[BOOT_FIRST_CONNECT],
+		bootTimeline[BOOT_FIRST_SEND]) > 0)
+	{
+		Log_Debug("%s\n", msgBuffer);
+		sendWindow_send(SEND_KIND_BOOT_TIMELINE, msgBuffer, diagnosticsMessageProperties, NELEMS(diagnosticsMessageProperties));
+	}
 }
 
-static bool InitializeSdc30(void)
+/// <summary>
+/// Returns true when the CO2 telemetry was handed to the SDK or queued in the send window
+/// </summary>
+static bool PublishTelemetry(void)
 {
-	uint16_t interval_in_seconds = 2;
-	int retry = 0;
-	uint8_t asc_enabled, enable_asc;
+	static int msgId = 0;
+	SEND_RESULT result = SEND_RESULT_FAILED;
+	struct timespec wallClock;
+	CAPABILITY_TELEMETRY telemetry;
 
-	sensirion_i2c_init();
+	if (!isnan(co2_ppm))
+	{
+		// Capture time goes out as wall-clock ms so the cloud can tell how stale the reading is
+		telemetry.enqueueMs = (int32_t)((trace_nowUs() - sampleCapturedUs) / 1000);
+		clock_gettime(CLOCK_REALTIME, &wallClock);
+		telemetry.capturedAt = (int64_t)wallClock.tv_sec * 1000 + wallClock.tv_nsec / 1000000 - telemetry.enqueueMs;
+
+		telemetry.co2 = co2_ppm;
+		telemetry.co2Quality = (int32_t)co2Quality;
+		telemetry.temperature = temperature;
+		telemetry.humidity = relative_humidity;
+		telemetry.dewPoint = comfortMetrics.dewPoint;
+		telemetry.absoluteHumidity = comfortMetrics.absoluteHumidity;
+		telemetry.heatIndex = comfortMetrics.heatIndex;
+		telemetry.iaq = comfortMetrics.iaq;
+		telemetry.msgId = ++msgId;
+		capability_encodeTelemetry(&telemetry, msgBuffer);
+
+		Log_Debug("%s\n", msgBuffer);
+		result = sendWindow_sendSample(SEND_KIND_TELEMETRY, msgBuffer, telemetryMessageProperties, NELEMS(telemetryMessageProperties),
+			sampleCapturedUs);
+
+		if (reportedState_setFloat(actualCO2Level.twinProperty, co2_ppm, CO2_REPORT_TOLERANCE_PPM))
+		{
+			ScheduleReportedState();
+		}
+
+		if (result == SEND_RESULT_SENT && bootTimeline[BOOT_FIRST_SEND] < 0)
+		{
+			MarkBootMilestone(BOOT_FIRST_SEND);
+			trace_bootMilestone(TRACE_BOOT_FIRST_SEND);
+			PublishBootTimeline();
+		}
+	}
 
-	while (scd30_probe() != STATUS_OK && ++retry < 5)
+	// Readings from the other sensors go out with the CO2 telemetry, as their own message
+	if (sensorRegistry_formatTelemetry(msgBuffer, JSON_MESSAGE_BYTES) > 0)
 	{
-		printf("SCD30 sensor probing failed\n");
-		sensirion_sleep_usec(1000000u);
+		Log_Debug("%s\n", msgBuffer);
+		sendWindow_send(SEND_KIND_SENSORS, msgBuffer, sensorMessageProperties, NELEMS(sensorMessageProperties));
 	}
 
-	if (retry >= 5) { return false; }
+	return result == SEND_RESULT_SENT || result == SEND_RESULT_QUEUED;
+}
+
+static void PublishTelemetryTimer(SCHED_TASK* task)
+{
+	PublishTelemetry();
+}
+
+/// <summary>
+/// Send the first valid sample as soon as there is a connection rather than waiting for publishTelemetryTimer.
+/// A sample the send window queued is on its way, only a rejected send is tried again.
+/// </summary>
+static void FirstTelemetryHandler(SCHED_TASK* task)
+{
+	static bool accepted = false;
 
-	/*
-	When scd30 automatic self calibration activated for the first time a period of minimum 7 days is needed so
-	that the algorithm can find its initial parameter set for ASC. The sensor has to be exposed to fresh air for at least 1 hour every day.
-	Refer to the datasheet for further conditions and scd30.h for more info.
-	*/
+	if (accepted || bootTimeline[BOOT_FIRST_SEND] >= 0)
+	{
+		return;
+	}
 
-	if (scd30_get_automatic_self_calibration(&asc_enabled) == 0)
+	accepted = dx_azureIsConnected() && PublishTelemetry();
+	if (!accepted)
 	{
-		if (asc_enabled == 0)
-		{
-			enable_asc = 1;
-			if (scd30_enable_automatic_self_calibration(enable_asc) == 0)
-			{
-				Log_Debug("scd30 automatic self calibration enabled. Takes 7 days, at least 1 hour/day outside, powered continuously");
-			}
-		}
+		sched_runAfter(&firstTelemetryTimer, 1000);
 	}
+}
 
-	scd30_set_measurement_interval(interval_in_seconds);
-	sensirion_sleep_usec(20000u);
-	scd30_start_periodic_measurement(0);
-	sensirion_sleep_usec(interval_in_seconds * 1000000u);
+/// <summary>
+/// Publish air changes, CO2 generation and occupancy once a decay has been fitted
+/// </summary>
+static void PublishVentilationHandler(SCHED_TASK* task)
+{
+	VENTILATION_ESTIMATE estimate;
+	CAPABILITY_VENTILATION_TELEMETRY telemetry;
 
-	return true;
+	ventilation_getEstimate(&estimate);
+	if (isnan(estimate.airChangesPerHour))
+	{
+		return;
+	}
+
+	telemetry.airChangesPerHour = estimate.airChangesPerHour;
+	telemetry.co2GenerationPpmPerHour = estimate.generationPpmPerHour;
+	telemetry.occupancy = estimate.occupancy;
+	capability_encodeVentilationTelemetry(&telemetry, msgBuffer);
+
+	Log_Debug("%s\n", msgBuffer);
+	sendWindow_send(SEND_KIND_VENTILATION, msgBuffer, ventilationMessageProperties, NELEMS(ventilationMessageProperties));
 }
 
 /// <summary>
-///  Initialize PeripheralGpios, device twins, direct methods, timers.
+/// Publish I2C retry and latency counters, and log the per-command breakdown
 /// </summary>
-/// <returns>0 on success, or -1 on failure</returns>
-static void InitPeripheralGpiosAndHandlers(void)
+static void PublishDiagnosticsHandler(SCHED_TASK* task)
 {
-	dx_azureInitialize(dx_config.scopeId, NULL);
+	sensirion_i2c_stats_t i2cStats;
+	SCHED_STATS schedStats;
+	REPORTED_STATE_STATS reportedStats;
+	SEND_WINDOW_STATS sendStats;
+	TRACE_SPAN_STATS confirmStats, enqueueStats, waitStats, endToEndStats;
+	RT_SAMPLING_STATS rtStats;
+	CO2_FILTER_STATS filterStats;
+	VENTILATION_ESTIMATE ventilationEstimate;
+	CO2_FORECAST_STATE forecastState;
+	TEMPERATURE_CALIBRATION_STATE calibrationState;
+	CO2_CALIBRATION_STATE co2CalibrationState;
+	PRESSURE_COMPENSATION_STATE pressureState;
+	SENSOR_REGISTRY_STATS sensorStats;
+	const sensirion_i2c_command_stats_t* commandStats;
 
-	InitializeSdc30();
+	for (uint8_t i = 0; (commandStats = sensirion_i2c_get_command_stats(i)) != NULL; i++)
+	{
+		Log_Debug("I2C command 0x%04x: %u transactions, %u retries, %u failures, p99 %u us, max %u us\n",
+			commandStats->command, commandStats->transactions, commandStats->retries, commandStats->failures,
+			sensirion_i2c_histogram_percentile(commandStats->histogram, 99), commandStats->max_usec);
+	}
 
-	dx_gpioSetOpen(PeripheralGpioSet, NELEMS(PeripheralGpioSet));
-	dx_deviceTwinSetOpen(deviceTwinBindingSet, NELEMS(deviceTwinBindingSet));
+	sensirion_i2c_get_stats(&i2cStats);
+	sched_getStats(&schedStats);
+	reportedState_getStats(&reportedStats);
+	sendWindow_getStats(&sendStats);
+	trace_getStats(TRACE_SEND_CONFIRM, &confirmStats);
+	trace_getStats(TRACE_SAMPLE_ENQUEUE, &enqueueStats);
+	trace_getStats(TRACE_SEND_WAIT, &waitStats);
+	trace_getStats(TRACE_SAMPLE_TO_CLOUD, &endToEndStats);
 
-	dx_timerSetStart(timerSet, NELEMS(timerSet));
+	Log_Debug("Send window: %u in flight (%u bytes, max %u), %u queued, %u sent, %u confirmed in p50 %u us p99 %u us, %u failed, %u aggregated, %u dropped\n",
+		sendStats.inFlight, sendStats.inFlightBytes, sendStats.maxInFlight, sendStats.backlog, sendStats.sent, sendStats.confirmed,
+		confirmStats.p50Us, confirmStats.p99Us, sendStats.failed, sendStats.aggregated, sendStats.dropped);
 
-	scd30_read_measurement(&co2_ppm, &temperature, &relative_humidity);
+	Log_Debug("Sample to cloud p50/p99 ms: capture to enqueue %u/%u, send wait %u/%u, confirm %u/%u, end to end %u/%u\n",
+		enqueueStats.p50Us / 1000, enqueueStats.p99Us / 1000, waitStats.p50Us / 1000, waitStats.p99Us / 1000,
+		confirmStats.p50Us / 1000, confirmStats.p99Us / 1000, endToEndStats.p50Us / 1000, endToEndStats.p99Us / 1000);
+
+	co2Filter_getStats(&filterStats);
+	Log_Debug("CO2 filter: %u samples, %u invalid (%u held), %u outliers rejected\n",
+		filterStats.samples, filterStats.invalid, filterStats.held, filterStats.outliers);
+
+	co2Forecast_getState(&forecastState);
+	Log_Debug("CO2 forecast: %.1f ppm/min, %.0f s to the alert level, %u early warnings, %u readings clipped\n",
+		forecastState.slopePpmPerMinute, forecastState.secondsToLevel, forecastState.warnings, forecastState.clipped);
+
+	ventilation_getEstimate(&ventilationEstimate);
+	Log_Debug("Ventilation: %.2f air changes per hour from %u decays (%u rejected), generation %.0f ppm/h, occupancy %.1f\n",
+		ventilationEstimate.airChangesPerHour, ventilationEstimate.decaysFitted, ventilationEstimate.decaysRejected,
+		ventilationEstimate.generationPpmPerHour, ventilationEstimate.occupancy);
+
+	co2Calibration_getState(&co2CalibrationState);
+	Log_Debug("CO2 calibration: phase %d, last window %.0f ppm (sd %.1f, drift %.1f ppm/min), %u runs, ASC %s, fresh-air run at %u\n",
+		(int)co2CalibrationState.phase, co2CalibrationState.windowMeanPpm, co2CalibrationState.windowDeviationPpm,
+		co2CalibrationState.windowDriftPpmPerMinute, co2CalibrationState.runs, scd30Config.ascEnabled ? "on" : "off",
+		co2CalibrationState.nextScheduledUtc);
+
+	pressureCompensation_getState(&pressureState);
+	Log_Debug("Pressure compensation: %u mbar in the sensor, %.1f mbar from %s, %u writes, %u held back by the write spacing\n",
+		pressureState.appliedMbar, pressureState.pressureMbar, pressureCompensation_sourceName(pressureState.source),
+		pressureState.writes, pressureState.deferred);
+
+	sensorRegistry_getStats(&sensorStats);
+	Log_Debug("Other sensors: %u present, %u readings (%u rejected, %u failures), %u operations in %u wakeups (max %u, %u starts pulled in)\n",
+		sensorStats.present, sensorStats.readings, sensorStats.rejected, sensorStats.failures, sensorStats.operations,
+		sensorStats.wakeups, sensorStats.maxBatch, sensorStats.pulledIn);
+
+	if (temperatureCalibrationActive)
+	{
+		temperatureCalibration_getState(&calibrationState);
+		Log_Debug("Temperature offset: %.2f C from %s, self-heating fit %.2f C (time constant %.0f s), reference error %.2f C, %u writes\n",
+			calibrationState.offsetC, temperatureCalibration_sourceName(calibrationState.source), calibrationState.selfHeatingC,
+			calibrationState.timeConstantSeconds, calibrationState.referenceErrorC, calibrationState.writes);
+	}
+
+	if (rtSamplingActive)
+	{
+		rtSampling_getStats(&rtStats);
+		Log_Debug("Real-time sampling: %u frames in %u batches (max %u), %u lost, %u bad messages\n",
+			rtStats.frames, rtStats.batches, rtStats.maxBatch, rtStats.lostFrames, rtStats.badMessages);
+	}
+
+	Log_Debug("Scheduler: %u tasks run in %u wakeups, %u pulled in early, latest %u us after its deadline\n",
+		schedStats.tasksRun, schedStats.wakeups, schedStats.pulledIn, schedStats.maxLatenessUs);
+
+	Log_Debug("Reported state: %u patches (%u per hour, %u confirmed) carrying %u properties, %u unchanged dropped, %u acks coalesced, %u sent directly\n",
+		reportedStats.patches, schedStats.uptimeSeconds ? (uint32_t)((uint64_t)reportedStats.patches * 3600 / schedStats.uptimeSeconds) : 0,
+		reportedStats.confirmed, reportedStats.properties, reportedStats.suppressed, reportedStats.coalesced, reportedStats.direct);
+
+	if (snprintf(msgBuffer, JSON_MESSAGE_BYTES, DiagnosticsTemplate, i2cStats.transactions, i2cStats.retries, i2cStats.failures,
+		i2cStats.p50_usec, i2cStats.p99_usec, i2cStats.max_usec, i2cStats.timeout_ms, scd30TimeToReadyMs,
+		schedStats.uptimeSeconds ? (uint32_t)((uint64_t)schedStats.wakeups * 3600 / schedStats.uptimeSeconds) : 0) > 0)
+	{
+		Log_Debug("%s\n", msgBuffer);
+		sendWindow_send(SEND_KIND_DIAGNOSTICS, msgBuffer, diagnosticsMessageProperties, NELEMS(diagnosticsMessageProperties));
+	}
 
-	dx_timerOneShotSet(&flashLEDsTimer, &(struct timespec){1, 0});
+	// Span name: [count, p50 us, p99 us, max us]
+	if (trace_formatStats(traceMsgBuffer, sizeof(traceMsgBuffer)))
+	{
+		Log_Debug("%s\n", traceMsgBuffer);
+		sendWindow_send(SEND_KIND_TRACE, traceMsgBuffer, diagnosticsMessageProperties, NELEMS(diagnosticsMessageProperties));
+	}
 }
 
 /// <summary>
-///     Close PeripheralGpios and handlers.
+/// Under SCD30_POWER_STOP_START stop measuring after a reading and restart a warm-up ahead of the next one
 /// </summary>
-static void ClosePeripheralGpiosAndHandlers(void)
+static void Scd30PowerAfterReading(void)
 {
-	Log_Debug("Closing file descriptors\n");
+	if (scd30PowerPolicy != SCD30_POWER_STOP_START || dutyCycleMode)
+	{
+		return;
+	}
 
-	dx_timerSetStop(timerSet, NELEMS(timerSet));
-	dx_azureToDeviceStop();
+	if (scd30_stop_periodic_measurement() == STATUS_OK)
+	{
+		sched_runAt(&sensorWarmupTimer, measureSensorTimer.deadlineUs - (uint64_t)scd30Power_warmupMs() * 1000u);
+	}
+}
 
-	dx_gpioSetClose(PeripheralGpioSet, NELEMS(PeripheralGpioSet));
+static void SensorWarmupHandler(SCHED_TASK* task)
+{
+	if (scd30_start_periodic_measurement(scd30Config.ambientPressure) != STATUS_OK)
+	{
+		Log_Debug("SCD30 restart failed\n");
+	}
+}
 
-	dx_deviceTwinSetClose();
+/// <summary>
+/// Move the sensor interval, read period and telemetry period to the adaptive sampling level
+/// </summary>
+static void RetuneSampling(uint16_t intervalSeconds)
+{
+	ADAPTIVE_SAMPLING_STATE state;
+
+	if (scd30_set_measurement_interval(intervalSeconds) != STATUS_OK)
+	{
+		return;
+	}
 
-	scd30_stop_periodic_measurement();
+	// The interval lives in sensor non-volatile memory, the cached configuration follows it
+	scd30Config.measurementInterval = intervalSeconds;
+	scd30Config_written(&scd30Config);
 
-	dx_timerEventLoopStop();
+	sched_setPeriod(&measureSensorTimer, intervalSeconds * 1000u);
+	sched_setPeriod(&publishTelemetryTimer, intervalSeconds * 1000u > TELEMETRY_PERIOD_MS ? intervalSeconds * 1000u : TELEMETRY_PERIOD_MS);
+
+	adaptiveSampling_getState(&state);
+	Log_Debug("Sampling every %u s, CO2 changing %.1f ppm/min, %u retunes in %u samples\n",
+		intervalSeconds, state.rate, state.retunes, state.samples);
 }
 
-int main(int argc, char* argv[])
+/// <summary>
+/// A setting was written without waiting, other sensor commands hold off for SCD30_WRITE_DELAY_US
+/// </summary>
+static void Scd30WroteNoWait(void)
 {
+	scd30QuietUntilUs = sched_nowUs() + SCD30_WRITE_DELAY_US;
+}
+
+/// <summary>
+/// Run task again once the sensor has taken the last setting written without waiting
+/// </summary>
+/// <returns>true when the sensor can take a command now</returns>
+static bool Scd30Quiet(SCHED_TASK* task)
+{
+	if (sched_nowUs() >= scd30QuietUntilUs)
+	{
+		return true;
+	}
+	sched_runAt(task, scd30QuietUntilUs);
+	return false;
+}
+
+/// <summary>
+/// CO2 recalibration needs the sensor sampling on the high-level core, and adaptive sampling to move it to 2 s
+/// </summary>
+static bool CO2CalibrationAvailable(void)
+{
+	return sensorState == SENSOR_READY && !rtSamplingActive && adaptiveSampling;
+}
+
+/// <summary>
+/// Report the recalibration phase and the latest history record
+/// </summary>
+static void ReportCO2Calibration(void)
+{
+	CO2_CALIBRATION_STATE state;
+	CO2_CALIBRATION_RECORD records[CO2_CALIBRATION_HISTORY];
+	size_t count = co2Calibration_getHistory(records);
+	bool changed;
+
+	co2Calibration_getState(&state);
+	changed = reportedState_setInt(co2CalibrationPhase.twinProperty, (int)state.phase);
+	if (count > 0)
+	{
+		changed |= reportedState_setInt(lastCO2CalibrationAt.twinProperty, (int)records[count - 1].utcSeconds);
+		changed |= reportedState_setInt(lastCO2CalibrationResult.twinProperty, records[count - 1].result);
+		changed |= reportedState_setFloat(lastCO2CalibrationCorrection.twinProperty, records[count - 1].correctionPpm, 0.5f);
+	}
+	if (changed)
+	{
+		ScheduleReportedState();
+	}
+}
+
+/// <summary>
+/// Feed a raw reading to the CO2 recalibration and write the reference once the readings are stable.
+/// The write does not wait out SCD30_WRITE_DELAY_US, co2CalibrationTimer reads it back after it.
+/// </summary>
+static void CalibrateCO2(float co2, uint64_t sampleUs)
+{
+	CO2_CALIBRATION_STATE before, after;
+	uint16_t referencePpm;
+
+	co2Calibration_getState(&before);
+	if (co2Calibration_update(co2, scd30Config.measurementInterval, sampleUs, (uint32_t)time(NULL), &referencePpm))
+	{
+		co2CalibrationWritten = referencePpm;
+		if (scd30_set_forced_recalibration_no_wait(referencePpm) == STATUS_OK)
+		{
+			Scd30WroteNoWait();
+			sched_runAfter(&co2CalibrationTimer, SCD30_READBACK_MS);
+		}
+		else
+		{
+			co2Calibration_applied(false, (uint32_t)time(NULL));
+		}
+	}
+
+	co2Calibration_getState(&after);
+	if (after.phase != before.phase)
+	{
+		ReportCO2Calibration();
+	}
+}
+
+/// <summary>
+/// Confirm a forced recalibration by reading its reference back
+/// </summary>
+static void CO2CalibrationReadbackHandler(SCHED_TASK* task)
+{
+	uint16_t referencePpm;
+	bool confirmed = scd30_get_forced_recalibration(&referencePpm) == STATUS_OK && referencePpm == co2CalibrationWritten;
+	CO2_CALIBRATION_STATE state;
+
+	co2Calibration_applied(confirmed, (uint32_t)time(NULL));
+	co2Calibration_getState(&state);
+	Log_Debug("CO2 recalibrated to %u ppm %s, window mean was %.1f ppm\n", co2CalibrationWritten,
+		confirmed ? "and confirmed" : "but not confirmed", state.windowMeanPpm);
+
+	// Readings step by the correction, restart the filter so the step is not taken for spikes
+	if (confirmed)
+	{
+		co2Filter_configure(co2Filter_getConfig());
+	}
+	ReportCO2Calibration();
+}
+
+/// <summary>
+/// Write the desired ASC setting once the sensor is ready, then read it back and acknowledge the twin
+/// </summary>
+static void CO2AutoCalibrationWriteHandler(SCHED_TASK* task)
+{
+	uint8_t ascEnabled;
+	bool confirmed;
+
+	if (sensorState == SENSOR_FAILED || rtSamplingActive)
+	{
+		reportedState_ack(&desiredCO2AutoCalibration, DX_DEVICE_TWIN_ERROR);
+		ScheduleReportedState();
+		return;
+	}
+	if (sensorState != SENSOR_READY)
+	{
+		sched_runAfter(task, 1000);
+		return;
+	}
+	if (!Scd30Quiet(task))
+	{
+		return;
+	}
+
+	if (!ascWritten)
+	{
+		if (scd30_enable_automatic_self_calibration_no_wait((uint8_t)scd30Config.ascEnabled) == STATUS_OK)
+		{
+			ascWritten = true;
+			Scd30WroteNoWait();
+			sched_runAfter(task, SCD30_READBACK_MS);
+			return;
+		}
+		confirmed = false;
+	}
+	else
+	{
+		ascWritten = false;
+		confirmed = scd30_get_automatic_self_calibration(&ascEnabled) == STATUS_OK && ascEnabled == scd30Config.ascEnabled;
+	}
+
+	// ASC lives in sensor non-volatile memory, the cached configuration follows it once read back
+	if (confirmed)
+	{
+		scd30Config_written(&scd30Config);
+	}
+	else
+	{
+		scd30Config_invalidate();
+	}
+	Log_Debug("SCD30 automatic self-calibration %s%s\n", scd30Config.ascEnabled ? "on" : "off", confirmed ? "" : ", not confirmed");
+	reportedState_ack(&desiredCO2AutoCalibration, confirmed ? DX_DEVICE_TWIN_COMPLETED : DX_DEVICE_TWIN_ERROR);
+	ScheduleReportedState();
+}
+
+/// <summary>
+/// Start the temperature offset calibration from the offset in the sensor, called once the sensor is ready
+/// </summary>
+static void StartTemperatureCalibration(uint64_t nowUs)
+{
+	uint16_t offsetTicks;
+	TEMPERATURE_OFFSET_RECORD record;
+	TEMPERATURE_OFFSET_SOURCE source = TEMPERATURE_OFFSET_UNCALIBRATED;
+
+	// A stop-start sensor warms up again before every reading, and a configured offset is not ours to move
+	if (scd30PowerPolicy != SCD30_POWER_CONTINUOUS || dutyCycleMode || scd30Config.temperatureOffset != SCD30_CONFIG_UNMANAGED ||
+		scd30_get_temperature_offset(&offsetTicks) != STATUS_OK)
+	{
+		return;
+	}
+
+	if (store_readRecord(STORE_RECORD_TEMPERATURE_CALIBRATION, &record, sizeof(record)) && record.offsetTicks == offsetTicks)
+	{
+		source = (TEMPERATURE_OFFSET_SOURCE)record.source;
+	}
+
+	temperatureCalibration_start(offsetTicks / 100.0f, source, nowUs);
+	temperatureCalibrationActive = true;
+	if (reportedState_setFloat(temperatureOffset.twinProperty, offsetTicks / 100.0f, TEMPERATURE_OFFSET_REPORT_TOLERANCE_C))
+	{
+		ScheduleReportedState();
+	}
+}
+
+/// <summary>
+/// Feed a reading to the temperature offset calibration and write the offset once it converges.
+/// The write does not wait out SCD30_WRITE_DELAY_US, temperatureOffsetTimer reads it back after it.
+/// </summary>
+static void CalibrateTemperatureOffset(float reading, uint64_t sampleUs)
+{
+	float offsetC;
+
+	// A reading that already wrote a CO2 recalibration leaves the offset to the next one
+	if (!temperatureCalibrationActive || sched_nowUs() < scd30QuietUntilUs || !temperatureCalibration_update(reading, sampleUs, &offsetC))
+	{
+		return;
+	}
+
+	temperatureOffsetWritten = (uint16_t)(offsetC * 100.0f + 0.5f);
+	if (scd30_set_temperature_offset_no_wait(temperatureOffsetWritten) != STATUS_OK)
+	{
+		temperatureCalibration_written(NAN);
+		return;
+	}
+	Scd30WroteNoWait();
+	sched_runAfter(&temperatureOffsetTimer, SCD30_READBACK_MS);
+}
+
+/// <summary>
+/// Confirm a written temperature offset, persist where it came from and report it
+/// </summary>
+static void TemperatureOffsetReadbackHandler(SCHED_TASK* task)
+{
+	uint16_t offsetTicks;
+	TEMPERATURE_CALIBRATION_STATE state;
+	TEMPERATURE_OFFSET_RECORD record;
+
+	if (scd30_get_temperature_offset(&offsetTicks) != STATUS_OK || offsetTicks != temperatureOffsetWritten)
+	{
+		Log_Debug("Temperature offset write not confirmed, retrying on the next reading\n");
+		temperatureCalibration_written(NAN);
+		return;
+	}
+
+	temperatureCalibration_written(offsetTicks / 100.0f);
+	temperatureCalibration_getState(&state);
+	Log_Debug("Temperature offset %.2f C written from %s after %u s\n", state.offsetC,
+		temperatureCalibration_sourceName(state.source), state.convergedSeconds);
+
+	record = (TEMPERATURE_OFFSET_RECORD){ .offsetTicks = offsetTicks, .source = (uint8_t)state.source };
+	store_writeRecord(STORE_RECORD_TEMPERATURE_CALIBRATION, &record, sizeof(record));
+
+	if (reportedState_setFloat(temperatureOffset.twinProperty, state.offsetC, TEMPERATURE_OFFSET_REPORT_TOLERANCE_C))
+	{
+		ScheduleReportedState();
+	}
+}
+
+/// <summary>
+/// Report the pressure the sensor compensates for
+/// </summary>
+static void ReportAmbientPressure(void)
+{
+	if (reportedState_setFloat(ambientPressure.twinProperty, scd30Config.ambientPressure, AMBIENT_PRESSURE_REPORT_TOLERANCE_MBAR))
+	{
+		ScheduleReportedState();
+	}
+}
+
+/// <summary>
+/// Restart the sensor's measurement once the pressure has moved far enough. The restart does not wait out
+/// SCD30_WRITE_DELAY_US, like the other settings.
+/// </summary>
+static void CompensatePressure(uint64_t sampleUs)
+{
+	uint16_t mbar;
+	bool written;
+
+	// A recalibration window would take the step for drift, the pressure waits for the run to finish
+	if (sched_nowUs() < scd30QuietUntilUs || co2Calibration_isActive() || !pressureCompensation_update(sampleUs, &mbar))
+	{
+		return;
+	}
+
+	// A stop-start sensor has been stopped for this reading and is given the pressure when it is next started
+	if (scd30PowerPolicy == SCD30_POWER_STOP_START)
+	{
+		written = true;
+	}
+	else
+	{
+		written = scd30_start_periodic_measurement(mbar) == STATUS_OK;
+		if (written)
+		{
+			Scd30WroteNoWait();
+		}
+	}
+	pressureCompensation_written(written, mbar, sampleUs);
+	if (!written)
+	{
+		return;
+	}
+
+	// The pressure is part of the configuration the cache describes, which follows it
+	scd30Config.ambientPressure = mbar;
+	scd30Config_written(&scd30Config);
+	Log_Debug("CO2 compensated for %u mbar\n", mbar);
+	ReportAmbientPressure();
+}
+
+/// <summary>
+/// Read sensor and send to Azure IoT
+/// </summary>
+static void MeasureSensorHandler(SCHED_TASK* task)
+{
+	static int notReadyPolls = 0;
+	uint16_t data_ready = 0;
+	uint64_t sampleUs;
+	float rawCo2;
+
+	if (sensorState == SENSOR_READY && Scd30Quiet(task))
+	{
+		// With the read period equal to the sensor interval a read can land just before the measurement.
+		// Polling again shortly also moves the read phase onto the sensor's.
+		if (adaptiveSampling && scd30_get_data_ready(&data_ready) == STATUS_OK && !data_ready && ++notReadyPolls < SCD30_READY_POLLS)
+		{
+			sched_runAfter(task, SCD30_READY_POLL_MS);
+			return;
+		}
+		notReadyPolls = 0;
+
+		sampleUs = trace_nowUs();
+		if (scd30_read_measurement(&co2_ppm, &temperature, &relative_humidity) != STATUS_OK)
+		{
+			co2_ppm = NAN;
+		}
+		rawCo2 = co2_ppm;
+		if (FilterCO2(co2_ppm, sampleUs))
+		{
+			ProcessSample(sampleUs);
+		}
+		Scd30PowerAfterReading();
+
+		if (adaptiveSampling)
+		{
+			float alertLevel = CO2AlertLevel();
+			uint16_t intervalSeconds = adaptiveSampling_update(co2_ppm, alertLevel, (uint32_t)(sched_nowUs() / 1000000u));
+
+			// A recalibration keeps the sensor at its interval for the whole run
+			if (co2Calibration_isActive())
+			{
+				intervalSeconds = CO2_CALIBRATION_INTERVAL_SECONDS;
+			}
+			if (intervalSeconds != scd30Config.measurementInterval)
+			{
+				RetuneSampling(intervalSeconds);
+			}
+		}
+
+		// Settings written without waiting go last on the bus for this reading, measureSensorTimer waits them out
+		CalibrateCO2(rawCo2, sampleUs);
+		CalibrateTemperatureOffset(isnan(rawCo2) ? NAN : temperature, sampleUs);
+		CompensatePressure(sampleUs);
+	}
+}
+
+/// <summary>
+/// Readings from the other sensors, the barometer feeds the pressure compensation
+/// </summary>
+static void SensorReadingHandler(const SENSOR_DRIVER* driver, const float* values)
+{
+	if (driver == &barometerDriver)
+	{
+		pressureCompensation_addBarometer(values[0], trace_nowUs());
+	}
+}
+
+/// <summary>
+/// Run the other sensors' starts and reads that are due, then sleep until the next
+/// </summary>
+static void SensorPollHandler(SCHED_TASK* task)
+{
+	uint64_t nextUs = sensorRegistry_poll(sched_nowUs());
+
+	if (nextUs != UINT64_MAX)
+	{
+		sched_runAt(task, nextUs);
+	}
+}
+
+/// <summary>
+/// Generic Device Twin Handler. It just acknowledges the desired state, the ack carries the value as reported state
+/// </summary>
+static void DeviceTwinGenericHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding)
+{
+	uint64_t traceStartUs = trace_nowUs();
+
+	twinCache_store(deviceTwinBinding);
+	reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+	ScheduleReportedState();
+
+	trace_end(TRACE_DEVICE_TWIN, traceStartUs);
+}
+
+/// <summary>
+/// Twin window length, 0 sends every ack and report straight away
+/// </summary>
+static void TwinWindowHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding)
+{
+	int windowMs = *(int*)deviceTwinBinding->twinState;
+
+	if (windowMs < 0 || windowMs > TWIN_WINDOW_MAX_MS)
+	{
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_ERROR);
+	}
+	else
+	{
+		twinWindowMs = (uint32_t)windowMs;
+		twinCache_store(deviceTwinBinding);
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+	}
+	ScheduleReportedState();
+}
+
+/// <summary>
+/// How far below the alert level CO2 must fall before a raised alert clears, in ppm
+/// </summary>
+static void CO2AlertHysteresisHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding)
+{
+	float hysteresisPpm = *(float*)deviceTwinBinding->twinState;
+
+	if (!(hysteresisPpm >= 0.0f && hysteresisPpm <= CO2_ALERT_HYSTERESIS_MAX_PPM))
+	{
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_ERROR);
+	}
+	else
+	{
+		SetCO2AlertHysteresis(hysteresisPpm);
+		twinCache_store(deviceTwinBinding);
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+	}
+	ScheduleReportedState();
+}
+
+/// <summary>
+/// Buzzer chirp period while the CO2 alert is raised, 0 chirps once
+/// </summary>
+static void CO2AlertCadenceHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding)
+{
+	int cadenceMs = *(int*)deviceTwinBinding->twinState;
+
+	if (cadenceMs != 0 && (cadenceMs < CO2_ALERT_CADENCE_MIN_MS || cadenceMs > CO2_ALERT_CADENCE_MAX_MS))
+	{
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_ERROR);
+	}
+	else
+	{
+		SetCO2AlertCadence((uint32_t)cadenceMs);
+		twinCache_store(deviceTwinBinding);
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+	}
+	ScheduleReportedState();
+}
+
+/// <summary>
+/// Room volume for the occupancy estimate, in cubic metres
+/// </summary>
+static void RoomVolumeHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding)
+{
+	float volume = *(float*)deviceTwinBinding->twinState;
+
+	if (!(volume >= 1.0f && volume <= ROOM_VOLUME_MAX_M3))
+	{
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_ERROR);
+	}
+	else
+	{
+		ventilation_setRoomVolume(volume);
+		twinCache_store(deviceTwinBinding);
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+	}
+	ScheduleReportedState();
+}
+
+/// <summary>
+/// Temperature measured next to the device, calibrates the temperature offset against it
+/// </summary>
+static void ReferenceTemperatureHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding)
+{
+	float reference = *(float*)deviceTwinBinding->twinState;
+
+	// A reference holds when it is sent, the same one delivered again on a reconnect is stale
+	if (twinCache_matches(deviceTwinBinding))
+	{
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+	}
+	else if (!(reference >= REFERENCE_TEMPERATURE_MIN_C && reference <= REFERENCE_TEMPERATURE_MAX_C) ||
+		!temperatureCalibrationActive || !temperatureCalibration_setReference(reference, trace_nowUs()))
+	{
+		Log_Debug("Reference temperature %.2f C not taken, send it again once the sensor has warmed up\n", reference);
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_ERROR);
+	}
+	else
+	{
+		twinCache_store(deviceTwinBinding);
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+	}
+	ScheduleReportedState();
+}
+
+/// <summary>
+/// Automatic self-calibration on or off. Written once the sensor is ready and acknowledged after it was read back.
+/// </summary>
+static void CO2AutoCalibrationHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding)
+{
+	bool enabled = *(bool*)deviceTwinBinding->twinState;
+	bool applied = twinCache_matches(deviceTwinBinding) && scd30Config.ascEnabled == enabled;
+
+	scd30Config.ascEnabled = enabled;
+	twinCache_store(deviceTwinBinding);
+
+	// While probing scd30Config_apply has yet to write it, cached at boot it already has
+	if (sensorState == SENSOR_PROBING || applied)
+	{
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+		ScheduleReportedState();
+		return;
+	}
+
+	if (!co2AutoCalibrationTimer.armed)
+	{
+		sched_runAfter(&co2AutoCalibrationTimer, 0);
+	}
+}
+
+/// <summary>
+/// Daily fresh-air recalibration time, "HH:MM" or "HH:MM ppm" in UTC, empty for none
+/// </summary>
+static void FreshAirCalibrationHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding)
+{
+	const char* schedule = (const char*)deviceTwinBinding->twinState;
+
+	// Setting the schedule again would move a run that is due to the next day
+	if (twinCache_matches(deviceTwinBinding))
+	{
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+	}
+	else if (!co2Calibration_setSchedule(schedule))
+	{
+		Log_Debug("Fresh-air calibration schedule rejected: %s\n", schedule);
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_ERROR);
+	}
+	else
+	{
+		twinCache_store(deviceTwinBinding);
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+	}
+	ScheduleReportedState();
+}
+
+/// <summary>
+/// Site pressure for the CO2 compensation in mbar, 0 for the default. A reporting barometer takes precedence,
+/// the sensor is updated on the next reading.
+/// </summary>
+static void AmbientPressureHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding)
+{
+	float mbar = *(float*)deviceTwinBinding->twinState;
+
+	if (!pressureCompensation_setTwin(mbar))
+	{
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_ERROR);
+	}
+	else
+	{
+		twinCache_store(deviceTwinBinding);
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+	}
+	ScheduleReportedState();
+}
+
+/// <summary>
+/// Direct method response, a JSON string the IoT SDK frees once it is sent
+/// </summary>
+static DX_DIRECT_METHOD_RESPONSE_CODE MethodResponse(DX_DIRECT_METHOD_RESPONSE_CODE code, const char* message, char** responseMsg)
+{
+	size_t length = strlen(message) + 3;
+
+	*responseMsg = malloc(length);
+	if (*responseMsg != NULL)
+	{
+		snprintf(*responseMsg, length, "\"%s\"", message);
+	}
+	return code;
+}
+
+/// <summary>
+/// Direct method: recalibrate CO2 against {"referencePpm": n}. Returns once the run has started, its outcome
+/// is reported in the LastCO2Calibration properties.
+/// </summary>
+static DX_DIRECT_METHOD_RESPONSE_CODE ForceCO2RecalibrationHandler(JSON_Value* json, DX_DIRECT_METHOD_BINDING* directMethodBinding, char** responseMsg)
+{
+	JSON_Object* payload = json_value_get_object(json);
+	double referencePpm;
+
+	if (payload == NULL || !json_object_has_value(payload, "referencePpm"))
+	{
+		return MethodResponse(DX_METHOD_FAILED, "referencePpm missing", responseMsg);
+	}
+	referencePpm = json_object_get_number(payload, "referencePpm");
+	if (!(referencePpm >= CO2_CALIBRATION_MIN_PPM && referencePpm <= CO2_CALIBRATION_MAX_PPM))
+	{
+		return MethodResponse(DX_METHOD_FAILED, "referencePpm must be 400 to 2000", responseMsg);
+	}
+	if (!CO2CalibrationAvailable())
+	{
+		return MethodResponse(DX_METHOD_FAILED, "sensor not sampling on this core", responseMsg);
+	}
+	if (!co2Calibration_request((uint16_t)(referencePpm + 0.5), CO2_CALIBRATION_BY_REQUEST, trace_nowUs()))
+	{
+		return MethodResponse(DX_METHOD_FAILED, "a recalibration is already running", responseMsg);
+	}
+
+	Log_Debug("CO2 recalibration to %.0f ppm requested\n", referencePpm);
+	ReportCO2Calibration();
+	// Move to the recalibration interval now rather than at the next reading
+	sched_runAfter(&measureSensorTimer, 0);
+	return MethodResponse(DX_METHOD_SUCCEEDED, "settling", responseMsg);
+}
+
+static DX_DIRECT_METHOD_RESPONSE_CODE CancelCO2RecalibrationHandler(JSON_Value* json, DX_DIRECT_METHOD_BINDING* directMethodBinding, char** responseMsg)
+{
+	if (!co2Calibration_cancel((uint32_t)time(NULL)))
+	{
+		return MethodResponse(DX_METHOD_FAILED, "no recalibration to cancel", responseMsg);
+	}
+	ReportCO2Calibration();
+	return MethodResponse(DX_METHOD_SUCCEEDED, "cancelled", responseMsg);
+}
+
+/// <summary>
+/// Direct method: the recalibration history, oldest first
+/// </summary>
+static DX_DIRECT_METHOD_RESPONSE_CODE GetCO2CalibrationHistoryHandler(JSON_Value* json, DX_DIRECT_METHOD_BINDING* directMethodBinding, char** responseMsg)
+{
+	CO2_CALIBRATION_RECORD records[CO2_CALIBRATION_HISTORY];
+	size_t count = co2Calibration_getHistory(records), length = 1;
+	char* response = malloc(CO2_CALIBRATION_HISTORY_BYTES);
+
+	if (response == NULL)
+	{
+		return DX_METHOD_FAILED;
+	}
+
+	response[0] = '[';
+	for (size_t i = 0; i < count; i++)
+	{
+		length += (size_t)snprintf(response + length, CO2_CALIBRATION_HISTORY_BYTES - length,
+			"%s{\"at\":%u,\"trigger\":\"%s\",\"referencePpm\":%u,\"correctionPpm\":%d,\"deviationPpm\":%.1f,\"result\":\"%s\"}",
+			i ? "," : "", records[i].utcSeconds, records[i].trigger == CO2_CALIBRATION_BY_SCHEDULE ? "schedule" : "request",
+			records[i].referencePpm, records[i].correctionPpm, records[i].deviationDeciPpm / 10.0,
+			co2Calibration_resultName(records[i].result));
+	}
+	snprintf(response + length, CO2_CALIBRATION_HISTORY_BYTES - length, "]");
+
+	*responseMsg = response;
+	return DX_METHOD_SUCCEEDED;
+}
+
+/// <summary>
+/// Compile the DesiredAlertRules device twin into the rule table, rejected text keeps the current rules
+/// </summary>
+static void AlertRulesHandler(DX_DEVICE_TWIN_BINDING* deviceTwinBinding)
+{
+	// Already compiled from the desired-property cache at boot, recompiling would reset active rules
+	if (twinCache_matches(deviceTwinBinding))
+	{
+		twinCache_store(deviceTwinBinding);
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+		ScheduleReportedState();
+		return;
+	}
+
+	if (deviceTwinBinding->twinState == NULL || !alertRules_compile((char*)deviceTwinBinding->twinState))
+	{
+		Log_Debug("Alert rules rejected: %s\n", (char*)deviceTwinBinding->twinState);
+		reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_ERROR);
+		ScheduleReportedState();
+		return;
+	}
+
+	// Rule state starts over with the new table
+	ledRulesActive = 0;
+	dx_gpioOff(&alertLed);
+	Log_Debug("%zu alert rules compiled\n", alertRules_count());
+	twinCache_store(deviceTwinBinding);
+
+	reportedState_ack(deviceTwinBinding, DX_DEVICE_TWIN_COMPLETED);
+	reportedState_setInt(alertRulesActive.twinProperty, 0);
+	ScheduleReportedState();
+}
+
+/// <summary>
+/// I2C HAL transaction hook, records every read and write as a trace span
+/// </summary>
+static void I2cTransactionTraced(uint16_t command, uint8_t is_read, uint32_t usec)
+{
+	trace_recordDuration(is_read ? TRACE_I2C_READ : TRACE_I2C_WRITE, usec);
+}
+
+#ifdef TRACE_CHROME_JSON
+static void ChromeTraceWrite(const char* text)
+{
+	Log_Debug("%s", text);
+}
+#endif
+
+/// <summary>
+/// A failed write is only sent again when a second delivery changes nothing: an SCD30 command without arguments
+/// selects what the next read returns or stops measuring, one with arguments writes a setting unless it starts
+/// measuring or recalibrates. The barometer's register address ahead of a read is retried, its register writes
+/// start a conversion. Other devices' writes are sent once.
+/// </summary>
+static uint8_t I2cWriteRetryable(uint8_t address, const uint8_t* data, uint16_t count)
+{
+	uint16_t command = count >= 2 ? (uint16_t)((data[0] << 8) | data[1]) : 0;
+
+	if (address == scd30_get_configured_address())
+	{
+		return count == 2 || (command != SCD30_START_MEASUREMENT_COMMAND && command != SCD30_FORCED_RECALIBRATION_COMMAND);
+	}
+	return address == BAROMETER_I2C_ADDRESS && count == 1;
+}
+
+/// <summary>
+/// Duty-cycle mode: log the reading, then either connect and upload the batch or power straight down
+/// </summary>
+static void DutyCycleSampleTaken(void)
+{
+	bool alert = co2_ppm > CO2AlertLevel();
+
+	if (dutyCycle_recordSample(co2_ppm, temperature, relative_humidity, alert))
+	{
+		dx_azureInitialize(dx_config.scopeId, NULL);
+		dx_deviceTwinSetOpen(deviceTwinBindingSet, NELEMS(deviceTwinBindingSet));
+		sched_runAfter(&dutyCycleUploadTimer, 1000);
+	}
+	else
+	{
+		sched_runAfter(&dutyCyclePowerDownTimer, 0);
+	}
+}
+
+static void DutyCycleUploadHandler(SCHED_TASK* task)
+{
+	static int attempts = 0;
+
+	if (dx_azureIsConnected() && dutyCycle_uploadBatch(batchMessageProperties, NELEMS(batchMessageProperties)))
+	{
+		sched_runAfter(&dutyCyclePowerDownTimer, DUTY_CYCLE_FLUSH_MS);
+	}
+	else if (++attempts < DUTY_CYCLE_CONNECT_ATTEMPTS)
+	{
+		sched_runAfter(task, 1000);
+	}
+	else
+	{
+		// Readings stay logged and go out with the next upload
+		sched_runAfter(&dutyCyclePowerDownTimer, 0);
+	}
+}
+
+static void DutyCyclePowerDownHandler(SCHED_TASK* task)
+{
+	twinCache_flush();
+	dutyCycle_powerDown(scd30Config.measurementInterval, scd30PowerPolicy);
+
+	// Power-down was refused, stay up and take the next reading after a period instead
+	sensorState = SENSOR_WAITING_FOR_DATA;
+	sched_runAfter(&sensorStartTimer, DUTY_CYCLE_PERIOD_SECONDS * 1000);
+}
+
+/// <summary>
+/// Sensor bring-up state machine: probe (retried every second), apply configuration, then poll
+/// data ready every SCD30_READY_POLL_MS and take the first sample as soon as it exists
+/// </summary>
+static void SensorStartHandler(SCHED_TASK* task)
+{
+	static int probeAttempts = 0;
+	static int readyPolls = 0;
+	static uint64_t probeStartUs = 0;
+	uint16_t data_ready = 0;
+	SCD30_CONFIG_RESULT configResult;
+	uint64_t sampleUs;
+
+	if (sensorState == SENSOR_PROBING)
+	{
+		if (probeAttempts == 0)
+		{
+			probeStartUs = trace_nowUs();
+		}
+
+		if (scd30_probe() != STATUS_OK)
+		{
+			Log_Debug("SCD30 sensor probing failed\n");
+			if (++probeAttempts < SCD30_PROBE_ATTEMPTS)
+			{
+				sched_runAfter(&sensorStartTimer, 1000);
+			}
+			else
+			{
+				sensorState = SENSOR_FAILED;
+				if (dutyCycleMode) { sched_runAfter(&dutyCyclePowerDownTimer, 0); }
+			}
+			return;
+		}
+		MarkBootMilestone(BOOT_SENSOR_PROBED);
+		trace_end(TRACE_BOOT_SENSOR_PROBE, probeStartUs);
+
+		/*
+		When scd30 automatic self calibration activated for the first time a period of minimum 7 days is needed so
+		that the algorithm can find its initial parameter set for ASC. The sensor has to be exposed to fresh air for at least 1 hour every day.
+		Refer to the datasheet for further conditions and scd30.h for more info.
+		*/
+
+		if (!scd30Config_apply(&scd30Config, &configResult))
+		{
+			sensorState = SENSOR_FAILED;
+			if (dutyCycleMode) { sched_runAfter(&dutyCyclePowerDownTimer, 0); }
+			return;
+		}
+		MarkBootMilestone(BOOT_SENSOR_CONFIGURED);
+
+		sensorState = SENSOR_WAITING_FOR_DATA;
+	}
+
+	if (sensorState == SENSOR_WAITING_FOR_DATA)
+	{
+		// After a warm reboot the sensor is usually already measuring and data is ready on the first poll
+		// The first measurement after a start can take a whole measurement interval
+		if ((scd30_get_data_ready(&data_ready) != STATUS_OK || !data_ready) &&
+			++readyPolls < SCD30_READY_POLLS + scd30Config.measurementInterval * 1000 / SCD30_READY_POLL_MS)
+		{
+			sched_runAfter(&sensorStartTimer, SCD30_READY_POLL_MS);
+			return;
+		}
+
+		sensorState = SENSOR_READY;
+		readyPolls = 0;
+		scd30TimeToReadyMs = (uint32_t)(BootElapsedMs() - bootTimeline[BOOT_TIMERS_STARTED]);
+		Log_Debug("SCD30 ready in %u ms\n", scd30TimeToReadyMs);
+		StartTemperatureCalibration(trace_nowUs());
+
+		sampleUs = trace_nowUs();
+		if (scd30_read_measurement(&co2_ppm, &temperature, &relative_humidity) == STATUS_OK)
+		{
+			MarkBootMilestone(BOOT_FIRST_SAMPLE);
+			trace_bootMilestone(TRACE_BOOT_FIRST_SAMPLE);
+
+			if (dutyCycleMode)
+			{
+				DutyCycleSampleTaken();
+			}
+			else
+			{
+				if (FilterCO2(co2_ppm, sampleUs))
+				{
+					ProcessSample(sampleUs);
+				}
+				sched_runAfter(&firstTelemetryTimer, 0);
+				Scd30PowerAfterReading();
+			}
+		}
+		else
+		{
+			co2_ppm = NAN;
+			if (dutyCycleMode) { sched_runAfter(&dutyCyclePowerDownTimer, 0); }
+		}
+	}
+}
+
+/// <summary>
+///  Initialize PeripheralGpios, device twins, direct methods, timers.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+static void InitPeripheralGpiosAndHandlers(void)
+{
+	uint64_t spanStartUs;
+	bool started;
+	const char* cachedRules;
+	int cachedWindowMs;
+	int cachedAlertCadenceMs;
+	float cachedAlertHysteresis;
+	float cachedRoomVolume;
+	bool cachedAutoCalibration;
+	const char* cachedFreshAirCalibration;
+	float cachedAmbientPressure;
+	uint16_t pressureMbar;
+	uint32_t readingPeriodSeconds = dutyCycleMode ? DUTY_CYCLE_PERIOD_SECONDS : measureSensorTimer.periodMs / 1000;
+	ADAPTIVE_SAMPLING_STATE samplingState;
+
+	// Desired properties from the last connection, so alerting works before the twin arrives or without a network
+	if (twinCache_load())
+	{
+		Log_Debug("Desired properties cached at twin version %d\n", twinCache_version());
+		if (twinCache_get(desiredAlertRules.twinProperty, DX_TYPE_STRING, &cachedRules))
+		{
+			alertRules_compile(cachedRules);
+		}
+		if (twinCache_get(desiredTwinWindowMs.twinProperty, DX_TYPE_INT, &cachedWindowMs))
+		{
+			twinWindowMs = (uint32_t)cachedWindowMs;
+		}
+		if (twinCache_get(desiredCO2AlertHysteresis.twinProperty, DX_TYPE_FLOAT, &cachedAlertHysteresis))
+		{
+			SetCO2AlertHysteresis(cachedAlertHysteresis);
+		}
+		if (twinCache_get(desiredCO2AlertCadenceMs.twinProperty, DX_TYPE_INT, &cachedAlertCadenceMs))
+		{
+			SetCO2AlertCadence((uint32_t)cachedAlertCadenceMs);
+		}
+		if (twinCache_get(desiredRoomVolume.twinProperty, DX_TYPE_FLOAT, &cachedRoomVolume))
+		{
+			ventilation_setRoomVolume(cachedRoomVolume);
+		}
+		if (twinCache_get(desiredCO2AutoCalibration.twinProperty, DX_TYPE_BOOL, &cachedAutoCalibration))
+		{
+			scd30Config.ascEnabled = cachedAutoCalibration;
+		}
+		if (twinCache_get(desiredFreshAirCalibration.twinProperty, DX_TYPE_STRING, &cachedFreshAirCalibration))
+		{
+			co2Calibration_setSchedule(cachedFreshAirCalibration);
+		}
+		if (twinCache_get(desiredAmbientPressure.twinProperty, DX_TYPE_FLOAT, &cachedAmbientPressure))
+		{
+			pressureCompensation_setTwin(cachedAmbientPressure);
+		}
+	}
+	co2Calibration_init();
+
+	// In duty-cycle mode the cloud connection is only brought up for a batch upload
+	if (!dutyCycleMode)
+	{
+		spanStartUs = trace_nowUs();
+		dx_azureInitialize(dx_config.scopeId, NULL);
+		trace_end(TRACE_BOOT_AZURE_INIT, spanStartUs);
+		MarkBootMilestone(BOOT_AZURE_INITIALIZED);
+	}
+
+	dx_gpioSetOpen(PeripheralGpioSet, NELEMS(PeripheralGpioSet));
+
+	if (dutyCycleMode)
+	{
+		started = sched_start(dx_timerGetEventLoop(), dutyCycleTimerSet, NELEMS(dutyCycleTimerSet));
+	}
+	else
+	{
+		dx_deviceTwinSetOpen(deviceTwinBindingSet, NELEMS(deviceTwinBindingSet));
+		dx_directMethodSubscribe(directMethodBindingSet, NELEMS(directMethodBindingSet));
+		started = sched_start(dx_timerGetEventLoop(), timerSet, NELEMS(timerSet));
+		ReportCO2Calibration();
+	}
+
+	if (!started)
+	{
+		dx_terminate(DX_ExitCode_Main_EventLoopFail);
+		return;
+	}
+	MarkBootMilestone(BOOT_TIMERS_STARTED);
+
+	if (rtSamplingMode && !dutyCycleMode)
+	{
+		rtSamplingActive = rtSampling_start(dx_timerGetEventLoop(), RtFramesHandler);
+		if (rtSamplingActive)
+		{
+			// The real-time core owns the I2C bus
+			sched_cancel(&measureSensorTimer);
+			return;
+		}
+		Log_Debug("Sampling on the high-level core instead\n");
+	}
+
+	scd30Power_logTradeoffs(readingPeriodSeconds);
+	if (adaptiveSampling)
+	{
+		// Sensor interval and read period start out equal, at the nearest adaptive level
+		adaptiveSampling_init((uint16_t)readingPeriodSeconds);
+		adaptiveSampling_getState(&samplingState);
+		scd30Config.measurementInterval = samplingState.intervalSeconds;
+		sched_setPeriod(&measureSensorTimer, samplingState.intervalSeconds * 1000u);
+	}
+	else
+	{
+		scd30Config.measurementInterval = scd30Power_measurementInterval(scd30PowerPolicy, readingPeriodSeconds);
+	}
+	Log_Debug("SCD30 power policy %s, measurement interval %u s\n", scd30Power_policyName(scd30PowerPolicy), scd30Config.measurementInterval);
+
+	spanStartUs = trace_nowUs();
+	sensirion_i2c_init();
+	sensirion_i2c_set_transaction_hook(I2cTransactionTraced);
+	sensirion_i2c_set_write_retry_filter(I2cWriteRetryable);
+	trace_end(TRACE_BOOT_I2C_INIT, spanStartUs);
+
+	// A pressure known from the twin or the default goes in with the sensor configuration
+	if (pressureCompensation_update(sched_nowUs(), &pressureMbar))
+	{
+		scd30Config.ambientPressure = pressureMbar;
+		pressureCompensation_written(true, pressureMbar, sched_nowUs());
+	}
+	ReportAmbientPressure();
+
+	sched_runAfter(&sensorStartTimer, 0);
+
+	// The other sensors are probed on the first poll, after the SCD30's first probe
+	if (!dutyCycleMode && sensorRegistry_init(sensorDrivers, NELEMS(sensorDrivers), SensorReadingHandler))
+	{
+		sched_runAfter(&sensorPollTimer, 0);
+	}
+}
+
+/// <summary>
+///     Close PeripheralGpios and handlers.
+/// </summary>
+static void ClosePeripheralGpiosAndHandlers(void)
+{
+	Log_Debug("Closing file descriptors\n");
+
+	sched_stop();
+	twinCache_flush();
+	dx_azureToDeviceStop();
+
+	dx_gpioSetClose(PeripheralGpioSet, NELEMS(PeripheralGpioSet));
+
+	dx_deviceTwinSetClose();
+	dx_directMethodUnsubscribe();
+
+	if (rtSamplingActive)
+	{
+		rtSampling_stop();
+	}
+	else
+	{
+		scd30_stop_periodic_measurement();
+	}
+
+#ifdef TRACE_CHROME_JSON
+	// The most recent spans go to the debug output, saved from there as a .json file for chrome://tracing
+	trace_writeChromeTrace(ChromeTraceWrite);
+#endif
+
+	dx_timerEventLoopStop();
+}
+
+int main(int argc, char* argv[])
+{
+	trace_init();
+
 	dx_registerTerminationHandler();
 
 	dx_configParseCmdLineArguments(argc, argv, &dx_config);
@@ -318,6 +2014,7 @@ int main(int argc, char* argv[])
 	{
 		return dx_getTerminationExitCode();
 	}
+	trace_bootMilestone(TRACE_BOOT_CONFIG_PARSE);
 
 	InitPeripheralGpiosAndHandlers();
 
@@ -0,0 +1,126 @@
+#include "persistent_store.h"
+
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include <applibs/storage.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STORE_MAGIC 0x53324F43 // "CO2S"
+
+typedef struct
+{
+	uint32_t magic;
+	uint16_t record;
+	uint16_t length;
+	uint32_t checksum;
+} STORE_HEADER;
+
+// Region offset and capacity (header included) for each STORE_RECORD.
+// The total must stay within MutableStorage SizeKB in app_manifest.json.
+static const struct
+{
+	off_t offset;
+	size_t capacity;
+} layout[STORE_RECORD_COUNT] = {
+	[STORE_RECORD_SCD30_CONFIG] = { .offset = 0, .capacity = 64 },
+	[STORE_RECORD_DUTY_CYCLE] = { .offset = 64, .capacity = 1024 },
+	// 1088-2111 held the desired twin cache at 10 properties, left unused so the new record starts empty
+	[STORE_RECORD_TEMPERATURE_CALIBRATION] = { .offset = 2112, .capacity = 64 },
+	[STORE_RECORD_CO2_CALIBRATION] = { .offset = 2176, .capacity = 256 },
+	[STORE_RECORD_DESIRED_TWIN] = { .offset = 2432, .capacity = 1536 },
+};
+
+uint32_t store_hash(const void* data, size_t length)
+{
+	const uint8_t* bytes = data;
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static int OpenStore(void)
+{
+#ifdef STORE_FILE_PATH
+	int fd = open(STORE_FILE_PATH, O_RDWR | O_CREAT, 0600);
+#else
+	int fd = Storage_OpenMutableFile();
+#endif
+	if (fd < 0)
+	{
+		Log_Debug("ERROR: Could not open store: errno=%d (%s)\n", errno, strerror(errno));
+	}
+	return fd;
+}
+
+bool store_readRecord(STORE_RECORD record, void* data, size_t length)
+{
+	STORE_HEADER header;
+	bool result = false;
+	int fd;
+
+	if (record >= STORE_RECORD_COUNT || length + sizeof(header) > layout[record].capacity || (fd = OpenStore()) < 0)
+	{
+		return false;
+	}
+
+	if (pread(fd, &header, sizeof(header), layout[record].offset) == sizeof(header) &&
+		header.magic == STORE_MAGIC && header.record == record && header.length == length &&
+		pread(fd, data, length, layout[record].offset + (off_t)sizeof(header)) == (ssize_t)length)
+	{
+		result = store_hash(data, length) == header.checksum;
+	}
+
+	close(fd);
+	return result;
+}
+
+bool store_writeRecord(STORE_RECORD record, const void* data, size_t length)
+{
+	STORE_HEADER header = { .magic = STORE_MAGIC, .record = (uint16_t)record, .length = (uint16_t)length, .checksum = store_hash(data, length) };
+	bool result = false;
+	int fd;
+
+	if (record >= STORE_RECORD_COUNT || length + sizeof(header) > layout[record].capacity || (fd = OpenStore()) < 0)
+	{
+		return false;
+	}
+
+	// Payload first, then header, so a torn write leaves a record that fails its checksum
+	if (pwrite(fd, data, length, layout[record].offset + (off_t)sizeof(header)) == (ssize_t)length &&
+		pwrite(fd, &header, sizeof(header), layout[record].offset) == sizeof(header))
+	{
+		result = true;
+	}
+	else
+	{
+		Log_Debug("ERROR: Could not write store record %d: errno=%d (%s)\n", record, errno, strerror(errno));
+	}
+
+	close(fd);
+	return result;
+}
+
+bool store_eraseRecord(STORE_RECORD record)
+{
+	STORE_HEADER header = { 0 };
+	bool result = false;
+	int fd;
+
+	if (record >= STORE_RECORD_COUNT || (fd = OpenStore()) < 0)
+	{
+		return false;
+	}
+
+	result = pwrite(fd, &header, sizeof(header), layout[record].offset) == sizeof(header);
+
+	close(fd);
+	return result;
+}
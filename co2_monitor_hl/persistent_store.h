@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Records kept in the application's mutable storage file. Each record owns a fixed
+// region so records can be rewritten independently without compaction.
+// Define STORE_FILE_PATH to keep the records in a plain file instead, for running the modules on Linux.
+typedef enum
+{
+	STORE_RECORD_SCD30_CONFIG = 0,
+	STORE_RECORD_DUTY_CYCLE,
+	STORE_RECORD_DESIRED_TWIN,
+	STORE_RECORD_TEMPERATURE_CALIBRATION,
+	STORE_RECORD_CO2_CALIBRATION,
+	STORE_RECORD_COUNT
+} STORE_RECORD;
+
+/// <summary>
+/// Read a record written by store_writeRecord. Fails if the record was never written,
+/// was written with a different length, or fails its checksum.
+/// </summary>
+bool store_readRecord(STORE_RECORD record, void* data, size_t length);
+
+/// <summary>
+/// Replace a record. The length must fit the region reserved for the record.
+/// </summary>
+bool store_writeRecord(STORE_RECORD record, const void* data, size_t length);
+
+/// <summary>
+/// Invalidate a record so the next store_readRecord fails.
+/// </summary>
+bool store_eraseRecord(STORE_RECORD record);
+
+/// <summary>
+/// 32-bit FNV-1a hash, used for record checksums and configuration fingerprints.
+/// </summary>
+uint32_t store_hash(const void* data, size_t length);
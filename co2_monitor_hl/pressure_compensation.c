@@ -0,0 +1,161 @@
+#include "pressure_compensation.h"
+
+#include <math.h>
+
+static PRESSURE_COMPENSATION_CONFIG compensationConfig = {
+	.defaultMbar = 0.0f,
+	.thresholdMbar = 5.0f,
+	.minWriteSeconds = 600,
+	.smoothingSeconds = 300,
+	.barometerStaleSeconds = 900
+};
+
+static PRESSURE_COMPENSATION_STATE state = { .pressureMbar = NAN };
+
+static float twinMbar = 0.0f;
+static bool twinChanged = false;		// an explicit twin value is written straight away
+static float barometerMbar = NAN;		// smoothed
+static uint64_t barometerUs;
+static uint64_t lastWriteUs;
+
+void pressureCompensation_configure(const PRESSURE_COMPENSATION_CONFIG* config)
+{
+	compensationConfig = *config;
+}
+
+const PRESSURE_COMPENSATION_CONFIG* pressureCompensation_getConfig(void)
+{
+	return &compensationConfig;
+}
+
+static bool InRange(float mbar)
+{
+	return mbar >= PRESSURE_COMPENSATION_MIN_MBAR && mbar <= PRESSURE_COMPENSATION_MAX_MBAR;
+}
+
+bool pressureCompensation_setTwin(float mbar)
+{
+	if (mbar != 0.0f && !InRange(mbar))
+	{
+		return false;
+	}
+	twinChanged = twinChanged || mbar != twinMbar;
+	twinMbar = mbar;
+	return true;
+}
+
+void pressureCompensation_addBarometer(float mbar, uint64_t nowUs)
+{
+	float alpha;
+
+	if (!InRange(mbar))
+	{
+		return;
+	}
+
+	if (isnan(barometerMbar) || nowUs - barometerUs > (uint64_t)compensationConfig.barometerStaleSeconds * 1000000u)
+	{
+		barometerMbar = mbar;
+	}
+	else
+	{
+		alpha = 1.0f - expf(-(float)((nowUs - barometerUs) / 1e6) / compensationConfig.smoothingSeconds);
+		barometerMbar += alpha * (mbar - barometerMbar);
+	}
+	barometerUs = nowUs;
+}
+
+/// <summary>
+/// Pick the pressure from the best source available now
+/// </summary>
+static void SelectSource(uint64_t nowUs)
+{
+	if (!isnan(barometerMbar) && nowUs - barometerUs <= (uint64_t)compensationConfig.barometerStaleSeconds * 1000000u)
+	{
+		state.source = PRESSURE_SOURCE_BAROMETER;
+		state.pressureMbar = barometerMbar;
+	}
+	else if (twinMbar != 0.0f)
+	{
+		state.source = PRESSURE_SOURCE_TWIN;
+		state.pressureMbar = twinMbar;
+	}
+	else if (InRange(compensationConfig.defaultMbar))
+	{
+		state.source = PRESSURE_SOURCE_DEFAULT;
+		state.pressureMbar = compensationConfig.defaultMbar;
+	}
+	else
+	{
+		state.source = PRESSURE_SOURCE_NONE;
+		state.pressureMbar = NAN;
+	}
+}
+
+bool pressureCompensation_update(uint64_t nowUs, uint16_t* mbar)
+{
+	SelectSource(nowUs);
+
+	// Clearing the twin with no default goes back to uncompensated, a barometer going quiet keeps its last
+	// pressure, closer than none
+	if (isnan(state.pressureMbar))
+	{
+		if (twinChanged && state.appliedMbar != 0)
+		{
+			twinChanged = false;
+			*mbar = 0;
+			return true;
+		}
+		return false;
+	}
+
+	// The first pressure and a twin change go in at once, drift waits for the threshold and the spacing
+	if (state.appliedMbar != 0 && !(twinChanged && state.source == PRESSURE_SOURCE_TWIN))
+	{
+		if (fabsf(state.pressureMbar - state.appliedMbar) < compensationConfig.thresholdMbar)
+		{
+			return false;
+		}
+		if (nowUs - lastWriteUs < (uint64_t)compensationConfig.minWriteSeconds * 1000000u)
+		{
+			state.deferred++;
+			return false;
+		}
+	}
+	twinChanged = false;
+
+	*mbar = (uint16_t)lroundf(state.pressureMbar);
+	return *mbar != state.appliedMbar;
+}
+
+void pressureCompensation_written(bool written, uint16_t mbar, uint64_t nowUs)
+{
+	if (written)
+	{
+		state.appliedMbar = mbar;
+		state.writes++;
+		lastWriteUs = nowUs;
+	}
+}
+
+void pressureCompensation_getState(PRESSURE_COMPENSATION_STATE* out)
+{
+	*out = state;
+}
+
+float pressureCompensation_mbarAtAltitude(float meters)
+{
+	return 1013.25f * powf(1.0f - 2.25577e-5f * meters, 5.25588f);
+}
+
+const char* pressureCompensation_sourceName(PRESSURE_SOURCE source)
+{
+	switch (source)
+	{
+	case PRESSURE_SOURCE_DEFAULT: return "default";
+	case PRESSURE_SOURCE_TWIN: return "twin";
+	case PRESSURE_SOURCE_BAROMETER: return "barometer";
+	case PRESSURE_SOURCE_NONE:
+	default: return "none";
+	}
+}
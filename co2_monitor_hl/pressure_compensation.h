@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Ambient pressure for the SCD30's CO2 compensation. The sensor assumes 1013 mbar unless told otherwise and
+// its reading scales with pressure, so a site at 1500 m reads about 17 % low. The pressure comes from a
+// barometer when one is fitted and reporting, else the device twin, else the configured default. Each update
+// restarts the sensor's measurement, so the sensor is only updated once the pressure has moved further than
+// thresholdMbar, at most every minWriteSeconds. No I2C here, the caller writes the pressure it is handed.
+#define PRESSURE_COMPENSATION_MIN_MBAR 700		// range scd30_start_periodic_measurement accepts
+#define PRESSURE_COMPENSATION_MAX_MBAR 1400
+
+typedef struct
+{
+	float defaultMbar;				// site pressure when neither barometer nor twin gives one, 0 for none
+	float thresholdMbar;			// smaller moves are not written
+	uint16_t minWriteSeconds;		// writes after the first are at least this far apart
+	uint16_t smoothingSeconds;		// time constant of the barometer average
+	uint16_t barometerStaleSeconds;	// a barometer silent this long is no longer used
+} PRESSURE_COMPENSATION_CONFIG;
+
+typedef enum
+{
+	PRESSURE_SOURCE_NONE,
+	PRESSURE_SOURCE_DEFAULT,
+	PRESSURE_SOURCE_TWIN,
+	PRESSURE_SOURCE_BAROMETER
+} PRESSURE_SOURCE;
+
+typedef struct
+{
+	PRESSURE_SOURCE source;			// of pressureMbar
+	float pressureMbar;				// current pressure, NAN without a source
+	uint16_t appliedMbar;			// in the sensor, 0 when uncompensated
+	uint32_t writes;
+	uint32_t deferred;				// moves past the threshold held back by minWriteSeconds
+} PRESSURE_COMPENSATION_STATE;
+
+void pressureCompensation_configure(const PRESSURE_COMPENSATION_CONFIG* config);
+
+const PRESSURE_COMPENSATION_CONFIG* pressureCompensation_getConfig(void);
+
+/// <summary>
+/// Pressure set in the device twin, 0 to fall back to the default.
+/// </summary>
+/// <returns>false when out of the sensor's range</returns>
+bool pressureCompensation_setTwin(float mbar);
+
+/// <summary>
+/// Feed a barometer reading taken at nowUs.
+/// </summary>
+void pressureCompensation_addBarometer(float mbar, uint64_t nowUs);
+
+/// <summary>
+/// Check whether the sensor should be updated.
+/// </summary>
+/// <param name="mbar">receives the pressure to write, 0 for uncompensated</param>
+/// <returns>true when it should, then call pressureCompensation_written</returns>
+bool pressureCompensation_update(uint64_t nowUs, uint16_t* mbar);
+
+/// <summary>
+/// The pressure handed out by pressureCompensation_update was written, or failed to be.
+/// </summary>
+void pressureCompensation_written(bool written, uint16_t mbar, uint64_t nowUs);
+
+void pressureCompensation_getState(PRESSURE_COMPENSATION_STATE* state);
+
+/// <summary>
+/// Standard atmosphere pressure at an altitude, for a default from the site's altitude.
+/// </summary>
+float pressureCompensation_mbarAtAltitude(float meters);
+
+const char* pressureCompensation_sourceName(PRESSURE_SOURCE source);
@@ -0,0 +1,247 @@
+#include "reported_state.h"
+
+#include "dx_azure_iot.h"
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define REPORTED_STATE_NAME_BYTES 32
+
+typedef enum
+{
+	ENTRY_FLOAT,
+	ENTRY_INT,
+	ENTRY_ACK
+} ENTRY_TYPE;
+
+typedef struct
+{
+	char name[REPORTED_STATE_NAME_BYTES];
+	ENTRY_TYPE type;
+	bool pending;
+	bool sent;
+	float pendingFloat;
+	float sentFloat;
+	int pendingInt;
+	int sentInt;
+	char json[REPORTED_STATE_VALUE_BYTES];
+} REPORTED_ENTRY;
+
+static REPORTED_ENTRY entries[REPORTED_STATE_PROPERTIES];
+static size_t entryCount = 0;
+static char patch[REPORTED_STATE_PATCH_BYTES];
+static REPORTED_STATE_STATS stats;
+
+static REPORTED_ENTRY* FindEntry(const char* property, ENTRY_TYPE type)
+{
+	for (size_t i = 0; i < entryCount; i++)
+	{
+		if (entries[i].type == type && strncmp(entries[i].name, property, REPORTED_STATE_NAME_BYTES) == 0)
+		{
+			return &entries[i];
+		}
+	}
+
+	if (entryCount == REPORTED_STATE_PROPERTIES || strlen(property) >= REPORTED_STATE_NAME_BYTES)
+	{
+		return NULL;
+	}
+
+	memset(&entries[entryCount], 0, sizeof(REPORTED_ENTRY));
+	strcpy(entries[entryCount].name, property);
+	entries[entryCount].type = type;
+	return &entries[entryCount++];
+}
+
+bool reportedState_setFloat(const char* property, float value, float tolerance)
+{
+	REPORTED_ENTRY* entry = FindEntry(property, ENTRY_FLOAT);
+
+	if (entry == NULL || isnan(value))
+	{
+		return false;
+	}
+
+	// Compared with the value last sent, not last set, so slow drift is still reported and a pending
+	// value that has come back to what the cloud already holds is dropped
+	if (entry->sent && fabsf(value - entry->sentFloat) <= tolerance)
+	{
+		stats.suppressed++;
+		entry->pending = false;
+		return false;
+	}
+
+	snprintf(entry->json, sizeof(entry->json), "%.2f", value);
+	entry->pendingFloat = value;
+	entry->pending = true;
+	return true;
+}
+
+bool reportedState_setInt(const char* property, int value)
+{
+	REPORTED_ENTRY* entry = FindEntry(property, ENTRY_INT);
+
+	if (entry == NULL)
+	{
+		return false;
+	}
+
+	if (entry->sent && value == entry->sentInt)
+	{
+		stats.suppressed++;
+		entry->pending = false;
+		return false;
+	}
+
+	snprintf(entry->json, sizeof(entry->json), "%d", value);
+	entry->pendingInt = value;
+	entry->pending = true;
+	return true;
+}
+
+// JSON string with quotes and backslashes escaped and control characters as \u00XX, one raw control
+// character would make the whole patch invalid. False when it does not fit.
+static bool FormatString(char* out, size_t size, const char* text)
+{
+	size_t used = 0;
+
+	out[used++] = '"';
+	for (; *text; text++)
+	{
+		unsigned char c = (unsigned char)*text;
+
+		// Room for the longest escape, the closing quote and the terminator
+		if (used + 8 > size)
+		{
+			return false;
+		}
+		if (c < 0x20)
+		{
+			used += (size_t)snprintf(&out[used], size - used, "\\u%04x", c);
+			continue;
+		}
+		if (c == '"' || c == '\\')
+		{
+			out[used++] = '\\';
+		}
+		out[used++] = (char)c;
+	}
+	out[used++] = '"';
+	out[used] = '\0';
+	return true;
+}
+
+bool reportedState_ack(const DX_DEVICE_TWIN_BINDING* binding, int statusCode)
+{
+	REPORTED_ENTRY* entry = FindEntry(binding->twinProperty, ENTRY_ACK);
+	char value[REPORTED_STATE_VALUE_BYTES - 32];
+	bool formatted = binding->twinState != NULL;
+
+	if (formatted)
+	{
+		switch (binding->twinType)
+		{
+		case DX_TYPE_FLOAT: snprintf(value, sizeof(value), "%.2f", *(float*)binding->twinState); break;
+		case DX_TYPE_DOUBLE: snprintf(value, sizeof(value), "%.2f", *(double*)binding->twinState); break;
+		case DX_TYPE_INT: snprintf(value, sizeof(value), "%d", *(int*)binding->twinState); break;
+		case DX_TYPE_BOOL: snprintf(value, sizeof(value), "%s", *(bool*)binding->twinState ? "true" : "false"); break;
+		case DX_TYPE_STRING: formatted = FormatString(value, sizeof(value), (const char*)binding->twinState); break;
+		default: formatted = false; break;
+		}
+	}
+
+	if (entry == NULL || !formatted)
+	{
+		stats.direct++;
+		return dx_deviceTwinAckDesiredState((DX_DEVICE_TWIN_BINDING*)binding, binding->twinState, statusCode);
+	}
+
+	if (entry->pending)
+	{
+		stats.coalesced++;
+	}
+	snprintf(entry->json, sizeof(entry->json), "{\"value\":%s,\"ac\":%d,\"av\":%d}", value, statusCode, binding->twinVersion);
+	entry->pending = true;
+	return true;
+}
+
+bool reportedState_pending(void)
+{
+	for (size_t i = 0; i < entryCount; i++)
+	{
+		if (entries[i].pending)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static void ReportedStateConfirmed(int status_code, void* context)
+{
+	if (status_code >= 200 && status_code < 300)
+	{
+		stats.confirmed++;
+	}
+}
+
+bool reportedState_flush(void)
+{
+	size_t used = 0;
+	uint32_t count = 0;
+	int written;
+
+	if (!reportedState_pending() || !dx_azureIsConnected())
+	{
+		return false;
+	}
+
+	patch[used++] = '{';
+	for (size_t i = 0; i < entryCount; i++)
+	{
+		if (!entries[i].pending)
+		{
+			continue;
+		}
+
+		written = snprintf(&patch[used], sizeof(patch) - used, "%s\"%s\":%s", count ? "," : "", entries[i].name, entries[i].json);
+		if (written < 0 || used + (size_t)written + 2 > sizeof(patch))
+		{
+			// The rest goes in the next flush
+			break;
+		}
+		used += (size_t)written;
+		count++;
+	}
+	patch[used++] = '}';
+	patch[used] = '\0';
+
+	if (count == 0 ||
+		IoTHubDeviceClient_LL_SendReportedState(dx_azureClientHandleGet(), (const unsigned char*)patch, used, ReportedStateConfirmed, NULL) != IOTHUB_CLIENT_OK)
+	{
+		return false;
+	}
+
+	for (size_t i = 0, cleared = 0; i < entryCount && cleared < count; i++)
+	{
+		if (entries[i].pending)
+		{
+			entries[i].pending = false;
+			entries[i].sent = true;
+			entries[i].sentFloat = entries[i].pendingFloat;
+			entries[i].sentInt = entries[i].pendingInt;
+			cleared++;
+		}
+	}
+
+	stats.patches++;
+	stats.properties += count;
+	return true;
+}
+
+void reportedState_getStats(REPORTED_STATE_STATS* out)
+{
+	*out = stats;
+}
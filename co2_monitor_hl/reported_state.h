@@ -0,0 +1,46 @@
+#pragma once
+
+#include "dx_device_twins.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Reported properties are merged here and sent as one twin patch per flush, unchanged values are dropped
+#define REPORTED_STATE_PROPERTIES 20
+#define REPORTED_STATE_VALUE_BYTES 96		// one formatted JSON value
+#define REPORTED_STATE_PATCH_BYTES 1024
+
+typedef struct
+{
+	uint32_t patches;			// twin patches sent
+	uint32_t confirmed;			// patches the hub acknowledged
+	uint32_t properties;		// property values carried by those patches
+	uint32_t suppressed;		// updates dropped because the value had not changed
+	uint32_t coalesced;			// acks replaced by a newer ack of the same property before a flush
+	uint32_t direct;			// acks too large for the accumulator, sent on their own
+} REPORTED_STATE_STATS;
+
+/// <summary>
+/// Queue a float, dropped when within tolerance of the value last sent.
+/// </summary>
+/// <returns>true when the property is now pending</returns>
+bool reportedState_setFloat(const char* property, float value, float tolerance);
+
+bool reportedState_setInt(const char* property, int value);
+
+/// <summary>
+/// Queue a writable property acknowledgement. It also carries the value, so a separate report of
+/// the same property is not needed. Later acks of the same property in one window replace earlier ones.
+/// </summary>
+bool reportedState_ack(const DX_DEVICE_TWIN_BINDING* binding, int statusCode);
+
+/// <summary>
+/// True when properties are waiting for reportedState_flush.
+/// </summary>
+bool reportedState_pending(void);
+
+/// <summary>
+/// Send every pending property in one patch. Keeps them pending when not connected.
+/// </summary>
+bool reportedState_flush(void);
+
+void reportedState_getStats(REPORTED_STATE_STATS* stats);
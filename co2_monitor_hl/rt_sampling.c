@@ -0,0 +1,286 @@
+#include "rt_sampling.h"
+
+#include "trace.h"
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include <errno.h>
+#include <string.h>
+
+#ifdef INTERCORE_STANDIN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#include "dx_intercore.h"
+#endif
+
+static RT_SAMPLING_HANDLER frameHandler = NULL;
+static RT_SAMPLING_STATS stats;
+static uint32_t nextSequence = 0;
+static bool sequenceKnown = false;
+
+// Local clock minus producer clock. Each notification gives an estimate plus transit delay, so the smallest
+// over a window of batches is used and re-taken every window to follow drift between the cores.
+#define CLOCK_OFFSET_WINDOW 64
+static int64_t clockOffsetUs = 0;
+static int64_t windowOffsetUs = 0;
+static uint32_t windowBatches = 0;
+
+static const SAMPLE_CONTROL_MESSAGE controlMessage = {
+	.type = SAMPLE_MESSAGE_CONTROL,
+	.version = SAMPLE_PROTOCOL_VERSION,
+	.intervalSeconds = RT_SAMPLING_INTERVAL_SECONDS,
+	.batchFrames = RT_SAMPLING_BATCH_FRAMES,
+	.maxLatencyMs = RT_SAMPLING_MAX_LATENCY_MS
+};
+
+static bool ValidBatch(const SAMPLE_BATCH_MESSAGE* message, size_t length)
+{
+	return length >= SAMPLE_BATCH_MESSAGE_BYTES(0) && message->type == SAMPLE_MESSAGE_BATCH &&
+		message->version == SAMPLE_PROTOCOL_VERSION && message->count <= SAMPLE_BATCH_FRAMES &&
+		length >= SAMPLE_BATCH_MESSAGE_BYTES(message->count);
+}
+
+static void UpdateClockOffset(uint64_t nowUs, uint64_t producerUs)
+{
+	int64_t offsetUs = (int64_t)(nowUs - producerUs);
+
+	if (windowBatches == 0 || offsetUs < windowOffsetUs)
+	{
+		windowOffsetUs = offsetUs;
+	}
+	if (stats.batches == 0 || offsetUs < clockOffsetUs)
+	{
+		clockOffsetUs = offsetUs;
+	}
+	if (++windowBatches == CLOCK_OFFSET_WINDOW)
+	{
+		clockOffsetUs = windowOffsetUs;
+		windowBatches = 0;
+	}
+}
+
+/// <summary>
+/// Count sequence gaps, move capture times onto the local clock and pass the batch on.
+/// producerUs is the producer's clock when it notified.
+/// </summary>
+static void DeliverFrames(SAMPLE_FRAME* frames, size_t count, uint64_t producerUs)
+{
+	uint64_t nowUs = trace_nowUs();
+
+	if (count == 0)
+	{
+		return;
+	}
+	UpdateClockOffset(nowUs, producerUs);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (sequenceKnown && frames[i].sequence != nextSequence)
+		{
+			stats.lostFrames += frames[i].sequence - nextSequence;
+		}
+		nextSequence = frames[i].sequence + 1;
+		sequenceKnown = true;
+
+		// A frame cannot have been captured after it arrived, whatever the offset estimate says
+		frames[i].captureUs += (uint64_t)clockOffsetUs;
+		if (frames[i].captureUs > nowUs)
+		{
+			frames[i].captureUs = nowUs;
+		}
+	}
+
+	trace_recordDuration(TRACE_RT_FRAME_AGE, (uint32_t)(nowUs - frames[0].captureUs));
+
+	stats.batches++;
+	stats.frames += (uint32_t)count;
+	if (count > stats.maxBatch)
+	{
+		stats.maxBatch = (uint32_t)count;
+	}
+
+	frameHandler(frames, count);
+}
+
+#ifdef INTERCORE_STANDIN
+
+static SAMPLE_RING* ring = MAP_FAILED;
+static int notifyFd = -1;
+static EventLoop* notifyEventLoop = NULL;
+static EventRegistration* notifyRegistration = NULL;
+
+static void NotifyEventHandler(EventLoop* eventLoop, int fd, EventLoop_IoEvents events, void* context)
+{
+	SAMPLE_BATCH_MESSAGE doorbell;
+	SAMPLE_FRAME frames[SAMPLE_BATCH_FRAMES];
+	uint64_t producerUs = 0;
+	ssize_t length;
+	size_t count;
+
+	// A doorbell only says frames are waiting, those that queued up while busy collapse into one drain
+	while ((length = recv(fd, &doorbell, sizeof(doorbell), 0)) > 0)
+	{
+		if (ValidBatch(&doorbell, (size_t)length))
+		{
+			producerUs = doorbell.producerUs;
+		}
+		else
+		{
+			stats.badMessages++;
+		}
+	}
+
+	if (producerUs == 0)
+	{
+		return;
+	}
+
+	while ((count = sampleRing_drain(ring, frames, SAMPLE_BATCH_FRAMES)) > 0)
+	{
+		DeliverFrames(frames, count, producerUs);
+	}
+}
+
+static bool Connect(EventLoop* eventLoop)
+{
+	struct sockaddr_un address = { .sun_family = AF_UNIX, .sun_path = INTERCORE_STANDIN_CONSUMER_SOCKET };
+	int shmFd = shm_open(INTERCORE_STANDIN_SHM_NAME, O_RDWR, 0);
+
+	if (shmFd < 0)
+	{
+		Log_Debug("ERROR: shm_open %s: errno=%d (%s)\n", INTERCORE_STANDIN_SHM_NAME, errno, strerror(errno));
+		return false;
+	}
+
+	ring = mmap(NULL, sizeof(SAMPLE_RING), PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+	close(shmFd);
+	if (ring == MAP_FAILED || ring->version != SAMPLE_PROTOCOL_VERSION || ring->capacity != SAMPLE_RING_FRAMES)
+	{
+		Log_Debug("ERROR: sample ring missing or of another version\n");
+		return false;
+	}
+
+	notifyFd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	unlink(INTERCORE_STANDIN_CONSUMER_SOCKET);
+	if (notifyFd < 0 || bind(notifyFd, (struct sockaddr*)&address, sizeof(address)) < 0)
+	{
+		Log_Debug("ERROR: notification socket: errno=%d (%s)\n", errno, strerror(errno));
+		return false;
+	}
+
+	notifyRegistration = EventLoop_RegisterIo(eventLoop, notifyFd, EventLoop_Input, NotifyEventHandler, NULL);
+	if (notifyRegistration == NULL)
+	{
+		Log_Debug("ERROR: EventLoop_RegisterIo: errno=%d (%s)\n", errno, strerror(errno));
+		return false;
+	}
+	notifyEventLoop = eventLoop;
+	return true;
+}
+
+static bool SendControl(void)
+{
+	struct sockaddr_un address = { .sun_family = AF_UNIX, .sun_path = INTERCORE_STANDIN_PRODUCER_SOCKET };
+
+	return sendto(notifyFd, &controlMessage, sizeof(controlMessage), 0, (struct sockaddr*)&address, sizeof(address)) ==
+		sizeof(controlMessage);
+}
+
+static void Disconnect(void)
+{
+	if (notifyRegistration != NULL)
+	{
+		EventLoop_UnregisterIo(notifyEventLoop, notifyRegistration);
+		notifyRegistration = NULL;
+	}
+
+	if (notifyFd >= 0)
+	{
+		close(notifyFd);
+		notifyFd = -1;
+		unlink(INTERCORE_STANDIN_CONSUMER_SOCKET);
+	}
+
+	if (ring != MAP_FAILED)
+	{
+		munmap(ring, sizeof(SAMPLE_RING));
+		ring = MAP_FAILED;
+	}
+}
+
+#else
+
+static void IntercoreMessageHandler(void* data, ssize_t length);
+
+// The mailbox cannot share memory, the real-time app drains its ring into each batch message
+static SAMPLE_BATCH_MESSAGE batchMessage;
+static DX_INTERCORE_BINDING intercoreBinding = {
+	.sockFd = -1,
+	.nonblocking_io = true,
+	.rtAppComponentId = RT_SAMPLING_COMPONENT_ID,
+	.interCoreCallback = IntercoreMessageHandler,
+	.intercore_recv_block = &batchMessage,
+	.intercore_recv_block_length = sizeof(batchMessage)
+};
+
+static void IntercoreMessageHandler(void* data, ssize_t length)
+{
+	SAMPLE_BATCH_MESSAGE* message = data;
+
+	if (length < 0 || !ValidBatch(message, (size_t)length))
+	{
+		stats.badMessages++;
+		return;
+	}
+
+	DeliverFrames(message->frames, message->count, message->producerUs);
+}
+
+static bool Connect(EventLoop* eventLoop)
+{
+	return dx_intercoreConnect(&intercoreBinding);
+}
+
+static bool SendControl(void)
+{
+	return dx_intercorePublish(&intercoreBinding, (void*)&controlMessage, sizeof(controlMessage));
+}
+
+static void Disconnect(void)
+{
+	// DevX owns the socket
+}
+
+#endif
+
+bool rtSampling_start(EventLoop* eventLoop, RT_SAMPLING_HANDLER handler)
+{
+	frameHandler = handler;
+	memset(&stats, 0, sizeof(stats));
+	sequenceKnown = false;
+	windowBatches = 0;
+
+	if (!Connect(eventLoop) || !SendControl())
+	{
+		Log_Debug("ERROR: real-time sampling component not reachable\n");
+		Disconnect();
+		return false;
+	}
+
+	Log_Debug("Real-time sampling every %u s, batches of %u frames or %u ms\n", controlMessage.intervalSeconds,
+		controlMessage.batchFrames, controlMessage.maxLatencyMs);
+	return true;
+}
+
+void rtSampling_stop(void)
+{
+	Disconnect();
+}
+
+void rtSampling_getStats(RT_SAMPLING_STATS* out)
+{
+	*out = stats;
+}
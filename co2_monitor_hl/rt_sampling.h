@@ -0,0 +1,51 @@
+#pragma once
+
+#include "sample_ring.h"
+
+#include <applibs/eventloop.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Sampling offloaded to the real-time core, which owns the I2C bus, samples at the full sensor rate and
+// hands frames over in batches. Built with INTERCORE_STANDIN the channel is the Linux stand-in instead:
+// the ring in POSIX shared memory and notifications as datagrams, see tools/intercore-standin.
+// The real-time app owns the SCD30's ISU, so in an RT_SAMPLING build app_manifest.json must not declare it, and
+// falling back to sampling here only works where the manifest still does. Its ComponentId comes from its own
+// app_manifest.json through RT_SAMPLING_APP_MANIFEST in CMakeLists.txt.
+#if defined(RT_SAMPLING) && !defined(RT_SAMPLING_COMPONENT_ID)
+#error "RT_SAMPLING needs RT_SAMPLING_COMPONENT_ID, set RT_SAMPLING_APP_MANIFEST in CMakeLists.txt"
+#elif !defined(RT_SAMPLING_COMPONENT_ID)
+#define RT_SAMPLING_COMPONENT_ID ""		// no real-time app, rtSampling_start is not called
+#endif
+#define RT_SAMPLING_INTERVAL_SECONDS 2		// SCD30 minimum measurement interval
+#define RT_SAMPLING_BATCH_FRAMES 5
+#define RT_SAMPLING_MAX_LATENCY_MS 10000
+
+#define INTERCORE_STANDIN_SHM_NAME "/co2_samples"
+#define INTERCORE_STANDIN_CONSUMER_SOCKET "/tmp/co2_samples.hl"
+#define INTERCORE_STANDIN_PRODUCER_SOCKET "/tmp/co2_samples.rt"
+
+/// <summary>
+/// Receives each batch in sequence order, captureUs already mapped onto the trace_nowUs clock.
+/// </summary>
+typedef void (*RT_SAMPLING_HANDLER)(const SAMPLE_FRAME* frames, size_t count);
+
+typedef struct
+{
+	uint32_t batches;
+	uint32_t frames;
+	uint32_t lostFrames;		// sequence gaps, the producer ring overran
+	uint32_t maxBatch;
+	uint32_t badMessages;
+} RT_SAMPLING_STATS;
+
+/// <summary>
+/// Connect to the sampling component and ask it to start.
+/// </summary>
+/// <returns>false when the channel could not be opened, the caller keeps sampling itself</returns>
+bool rtSampling_start(EventLoop* eventLoop, RT_SAMPLING_HANDLER handler);
+
+void rtSampling_stop(void);
+
+void rtSampling_getStats(RT_SAMPLING_STATS* stats);
@@ -0,0 +1,53 @@
+#include "sample_ring.h"
+
+#include <string.h>
+
+void sampleRing_init(SAMPLE_RING* ring)
+{
+	memset(ring, 0, sizeof(*ring));
+	ring->version = SAMPLE_PROTOCOL_VERSION;
+	ring->capacity = SAMPLE_RING_FRAMES;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+}
+
+bool sampleRing_push(SAMPLE_RING* ring, const SAMPLE_FRAME* frame)
+{
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	// Indices run freely and wrap at 2^32, the difference is the fill level
+	if (head - tail >= SAMPLE_RING_FRAMES)
+	{
+		return false;
+	}
+
+	ring->frames[head & (SAMPLE_RING_FRAMES - 1)] = *frame;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	return true;
+}
+
+size_t sampleRing_drain(SAMPLE_RING* ring, SAMPLE_FRAME* frames, size_t max)
+{
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	size_t count = head - tail;
+
+	if (count > max)
+	{
+		count = max;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		frames[i] = ring->frames[(tail + i) & (SAMPLE_RING_FRAMES - 1)];
+	}
+
+	atomic_store_explicit(&ring->tail, tail + (uint32_t)count, memory_order_release);
+	return count;
+}
+
+size_t sampleRing_count(SAMPLE_RING* ring)
+{
+	return atomic_load_explicit(&ring->head, memory_order_acquire) - atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Sensor frames produced by the real-time sampling component and consumed by the high-level app.
+// Everything here is shared between the two sides, so it uses fixed-width fields and carries a version.
+#define SAMPLE_PROTOCOL_VERSION 1
+#define SAMPLE_RING_FRAMES 64			// power of two
+#define SAMPLE_BATCH_FRAMES 30			// keeps a batch message under the 1 KB intercore mailbox limit
+
+#define SAMPLE_FRAME_OK 0
+
+typedef struct
+{
+	uint32_t sequence;			// consecutive per frame, a gap means the producer overran the ring
+	int32_t status;				// SAMPLE_FRAME_OK or the sensor driver error
+	uint64_t captureUs;			// producer monotonic clock
+	float co2;
+	float temperature;
+	float humidity;
+	uint32_t reserved;
+} SAMPLE_FRAME;
+
+// Single producer, single consumer. head is only written by the producer and tail only by the consumer,
+// each with release ordering so the other side sees the frames before the index.
+typedef struct
+{
+	uint32_t version;
+	uint32_t capacity;
+	_Atomic uint32_t head;
+	uint32_t reserved1[15];		// head and tail on separate cache lines
+	_Atomic uint32_t tail;
+	uint32_t reserved2[15];
+	SAMPLE_FRAME frames[SAMPLE_RING_FRAMES];
+} SAMPLE_RING;
+
+typedef enum
+{
+	SAMPLE_MESSAGE_CONTROL = 1,	// high-level app to producer
+	SAMPLE_MESSAGE_BATCH = 2		// producer to high-level app
+} SAMPLE_MESSAGE_TYPE;
+
+// Sent by the high-level app to start sampling. The producer only learns where to send batches from it.
+typedef struct
+{
+	uint32_t type;
+	uint32_t version;
+	uint32_t intervalSeconds;	// sensor measurement interval
+	uint32_t batchFrames;		// notify once this many frames are waiting
+	uint32_t maxLatencyMs;		// or once the oldest waiting frame is this old
+} SAMPLE_CONTROL_MESSAGE;
+
+// Notification from the producer. Over the mailbox the frames travel in the message; with the ring
+// in shared memory count is 0 and the consumer drains the ring itself.
+typedef struct
+{
+	uint32_t type;
+	uint16_t version;
+	uint16_t count;
+	uint64_t producerUs;		// producer clock when sent, maps captureUs onto the consumer clock
+	SAMPLE_FRAME frames[SAMPLE_BATCH_FRAMES];
+} SAMPLE_BATCH_MESSAGE;
+
+#define SAMPLE_BATCH_MESSAGE_BYTES(count) (offsetof(SAMPLE_BATCH_MESSAGE, frames) + (size_t)(count) * sizeof(SAMPLE_FRAME))
+
+void sampleRing_init(SAMPLE_RING* ring);
+
+/// <summary>
+/// Producer side. Does not overwrite: when the ring is full the frame is dropped and false returned.
+/// </summary>
+bool sampleRing_push(SAMPLE_RING* ring, const SAMPLE_FRAME* frame);
+
+/// <summary>
+/// Consumer side. Copy out up to max of the oldest frames and release their slots.
+/// </summary>
+/// <returns>number of frames copied</returns>
+size_t sampleRing_drain(SAMPLE_RING* ring, SAMPLE_FRAME* frames, size_t max);
+
+size_t sampleRing_count(SAMPLE_RING* ring);
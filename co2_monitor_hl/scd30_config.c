@@ -0,0 +1,188 @@
+#include "scd30_config.h"
+#include "persistent_store.h"
+
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include <string.h>
+#include <time.h>
+
+#include "./embedded-scd/scd30/scd30.h"
+
+typedef struct
+{
+	uint32_t configHash;
+	uint16_t firmwareVersion;
+	uint16_t reserved;
+} SCD30_CONFIG_RECORD;
+
+// RAM copy of the persisted record, so a setting written outside apply costs at most one store write
+static SCD30_CONFIG_RECORD persisted;
+static bool persistedLoaded = false;
+static bool persistedValid = false;
+
+static uint32_t MonotonicMs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+static uint32_t ConfigHash(const SCD30_CONFIG* config)
+{
+	uint16_t fields[] = { config->measurementInterval, config->ascEnabled, config->temperatureOffset, config->altitude, config->ambientPressure };
+	return store_hash(fields, sizeof(fields));
+}
+
+/// <summary>
+/// Read each managed setting and write it only when it differs from desired.
+/// </summary>
+static bool ReadBackAndDiff(const SCD30_CONFIG* desired, SCD30_CONFIG_RESULT* result)
+{
+	uint16_t interval, offset, altitude;
+	uint8_t asc;
+
+	result->reads++;
+	if (scd30_read_firmware_version(&result->firmwareVersion) != STATUS_OK)
+	{
+		return false;
+	}
+
+	result->reads++;
+	if (scd30_get_measurement_interval(&interval) != STATUS_OK)
+	{
+		return false;
+	}
+	if (interval != desired->measurementInterval)
+	{
+		result->writes++;
+		if (scd30_set_measurement_interval(desired->measurementInterval) != STATUS_OK)
+		{
+			return false;
+		}
+	}
+
+	result->reads++;
+	if (scd30_get_automatic_self_calibration(&asc) != STATUS_OK)
+	{
+		return false;
+	}
+	if (asc != desired->ascEnabled)
+	{
+		result->writes++;
+		if (scd30_enable_automatic_self_calibration((uint8_t)desired->ascEnabled) != STATUS_OK)
+		{
+			return false;
+		}
+		if (desired->ascEnabled)
+		{
+			Log_Debug("scd30 automatic self calibration enabled. Takes 7 days, at least 1 hour/day outside, powered continuously\n");
+		}
+	}
+
+	if (desired->temperatureOffset != SCD30_CONFIG_UNMANAGED)
+	{
+		result->reads++;
+		if (scd30_get_temperature_offset(&offset) != STATUS_OK)
+		{
+			return false;
+		}
+		if (offset != desired->temperatureOffset)
+		{
+			result->writes++;
+			if (scd30_set_temperature_offset(desired->temperatureOffset) != STATUS_OK)
+			{
+				return false;
+			}
+		}
+	}
+
+	if (desired->altitude != SCD30_CONFIG_UNMANAGED)
+	{
+		result->reads++;
+		if (scd30_get_altitude(&altitude) != STATUS_OK)
+		{
+			return false;
+		}
+		if (altitude != desired->altitude)
+		{
+			result->writes++;
+			if (scd30_set_altitude(desired->altitude) != STATUS_OK)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Measurement state cannot be read back and the sensor remembers a stop across a power cycle.
+/// The app stops it on exit and the stop-start policy between readings, so every apply starts it.
+/// </summary>
+static bool StartMeasurement(const SCD30_CONFIG* desired, SCD30_CONFIG_RESULT* result)
+{
+	result->writes++;
+	return scd30_start_periodic_measurement(desired->ambientPressure) == STATUS_OK;
+}
+
+bool scd30Config_apply(const SCD30_CONFIG* desired, SCD30_CONFIG_RESULT* result)
+{
+	uint32_t start = MonotonicMs();
+	uint32_t hash = ConfigHash(desired);
+
+	memset(result, 0, sizeof(*result));
+
+	persistedValid = store_readRecord(STORE_RECORD_SCD30_CONFIG, &persisted, sizeof(persisted));
+	persistedLoaded = true;
+
+	if (persistedValid && persisted.configHash == hash && StartMeasurement(desired, result))
+	{
+		result->path = SCD30_CONFIG_WARM;
+		result->firmwareVersion = persisted.firmwareVersion;
+	}
+	else if (ReadBackAndDiff(desired, result) && StartMeasurement(desired, result))
+	{
+		result->path = SCD30_CONFIG_READBACK;
+
+		persisted = (SCD30_CONFIG_RECORD){ .configHash = hash, .firmwareVersion = result->firmwareVersion };
+		persistedValid = store_writeRecord(STORE_RECORD_SCD30_CONFIG, &persisted, sizeof(persisted));
+	}
+	else
+	{
+		result->path = SCD30_CONFIG_FAILED;
+		scd30Config_invalidate();
+	}
+
+	result->elapsedMs = MonotonicMs() - start;
+
+	Log_Debug("SCD30 config %s in %u ms: firmware %u.%u, %u reads, %u writes\n",
+		result->path == SCD30_CONFIG_WARM ? "cached" : result->path == SCD30_CONFIG_READBACK ? "applied" : "failed",
+		result->elapsedMs, result->firmwareVersion >> 8, result->firmwareVersion & 0xFF, result->reads, result->writes);
+
+	return result->path != SCD30_CONFIG_FAILED;
+}
+
+void scd30Config_written(const SCD30_CONFIG* applied)
+{
+	uint32_t hash = ConfigHash(applied);
+
+	// Without a firmware version from an apply there is no record to update, and nothing valid to leave behind
+	if (!persistedValid || persisted.configHash == hash)
+	{
+		return;
+	}
+
+	persisted.configHash = hash;
+	persistedValid = store_writeRecord(STORE_RECORD_SCD30_CONFIG, &persisted, sizeof(persisted));
+}
+
+void scd30Config_invalidate(void)
+{
+	if (persistedLoaded && !persistedValid)
+	{
+		return;
+	}
+	persistedValid = false;
+	store_eraseRecord(STORE_RECORD_SCD30_CONFIG);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Leave the corresponding sensor setting as it is
+#define SCD30_CONFIG_UNMANAGED 0xFFFF
+
+typedef struct
+{
+	uint16_t measurementInterval;	// seconds, 2..1800
+	uint16_t ascEnabled;			// automatic self calibration, 0 or 1
+	uint16_t temperatureOffset;		// 0.01 degrees C, or SCD30_CONFIG_UNMANAGED
+	uint16_t altitude;				// meters above sea level, or SCD30_CONFIG_UNMANAGED
+	uint16_t ambientPressure;		// mbar passed to scd30_start_periodic_measurement, 0 disables
+} SCD30_CONFIG;
+
+typedef enum
+{
+	SCD30_CONFIG_FAILED,
+	SCD30_CONFIG_WARM,		// cached hash matched, only the measurement start written
+	SCD30_CONFIG_READBACK	// settings read back and only the differences written
+} SCD30_CONFIG_PATH;
+
+typedef struct
+{
+	SCD30_CONFIG_PATH path;
+	uint16_t firmwareVersion;
+	uint8_t reads;
+	uint8_t writes;
+	uint32_t elapsedMs;
+} SCD30_CONFIG_RESULT;
+
+/// <summary>
+/// Bring the sensor's non-volatile settings in line with desired and start periodic
+/// measurement. Settings are read back in one pass and only those that differ are
+/// written. The hash of the applied configuration is persisted so that a warm reboot
+/// with the same configuration skips the read-back as well. Measurement is started
+/// on every path, the sensor keeps a stop across restarts.
+/// </summary>
+bool scd30Config_apply(const SCD30_CONFIG* desired, SCD30_CONFIG_RESULT* result);
+
+/// <summary>
+/// Record that the sensor holds applied after a setting was written, and acknowledged, outside
+/// scd30Config_apply. The persisted hash is overwritten in place, one store write and none when it
+/// already matches, so a warm reboot with this configuration still skips the read-back.
+/// </summary>
+void scd30Config_written(const SCD30_CONFIG* applied);
+
+/// <summary>
+/// Forget the persisted configuration hash, forcing a read-back on the next apply.
+/// Call when a setting may have changed outside scd30Config_apply without being confirmed.
+/// </summary>
+void scd30Config_invalidate(void);
@@ -0,0 +1,96 @@
+#include "scd30_power.h"
+
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include <math.h>
+
+// Model constants. The datasheet gives 19 mA average at one measurement per 2 s and
+// +/-(30 ppm + 3 %) accuracy; the split into idle current and per-measurement charge and the
+// extra noise of an unfiltered single measurement are estimates.
+#define SCD30_MIN_INTERVAL_SECONDS 2
+#define SCD30_MAX_INTERVAL_SECONDS 1800
+#define SCD30_IDLE_MA 5.0f
+#define SCD30_MEASUREMENT_MAS 28.0f		// mA*s per measurement, 5 + 28 / 2 = 19 mA at 2 s
+#define SCD30_SUPPLY_VOLTS 3.3f
+#define SCD30_DATASHEET_ERROR_PPM (30.0f + 0.03f * 1000.0f)
+#define SCD30_SINGLE_SAMPLE_NOISE_PPM 15.0f
+
+static uint32_t ClampInterval(uint32_t seconds)
+{
+	if (seconds < SCD30_MIN_INTERVAL_SECONDS) { return SCD30_MIN_INTERVAL_SECONDS; }
+	if (seconds > SCD30_MAX_INTERVAL_SECONDS) { return SCD30_MAX_INTERVAL_SECONDS; }
+	return seconds;
+}
+
+uint16_t scd30Power_measurementInterval(SCD30_POWER_POLICY policy, uint32_t readingPeriodSeconds)
+{
+	return (uint16_t)(policy == SCD30_POWER_LONG_INTERVAL ? ClampInterval(readingPeriodSeconds) : SCD30_MIN_INTERVAL_SECONDS);
+}
+
+uint32_t scd30Power_warmupMs(void)
+{
+	// Warm-up measurements plus one interval of margin for the first one
+	return (SCD30_POWER_WARMUP_SAMPLES + 1) * SCD30_MIN_INTERVAL_SECONDS * 1000;
+}
+
+void scd30Power_estimate(SCD30_POWER_POLICY policy, uint32_t readingPeriodSeconds, SCD30_POWER_ESTIMATE* estimate)
+{
+	float period = (float)(readingPeriodSeconds < SCD30_MIN_INTERVAL_SECONDS ? SCD30_MIN_INTERVAL_SECONDS : readingPeriodSeconds);
+	float measurementsPerPeriod;
+
+	switch (policy)
+	{
+	case SCD30_POWER_LONG_INTERVAL:
+	{
+		float interval = (float)ClampInterval(readingPeriodSeconds);
+		measurementsPerPeriod = period / interval;
+		// A single unfiltered measurement, up to one interval old
+		estimate->errorPpm = sqrtf(SCD30_DATASHEET_ERROR_PPM * SCD30_DATASHEET_ERROR_PPM + SCD30_SINGLE_SAMPLE_NOISE_PPM * SCD30_SINGLE_SAMPLE_NOISE_PPM);
+		estimate->stalenessSeconds = interval / 2.0f;
+		break;
+	}
+	case SCD30_POWER_STOP_START:
+	{
+		float warmup = (float)scd30Power_warmupMs() / 1000.0f;
+		measurementsPerPeriod = (warmup < period ? warmup : period) / SCD30_MIN_INTERVAL_SECONDS;
+		// Warm-up measurements average down the single sample noise
+		float noise = SCD30_SINGLE_SAMPLE_NOISE_PPM / sqrtf((float)SCD30_POWER_WARMUP_SAMPLES + 1.0f);
+		estimate->errorPpm = sqrtf(SCD30_DATASHEET_ERROR_PPM * SCD30_DATASHEET_ERROR_PPM + noise * noise);
+		estimate->stalenessSeconds = SCD30_MIN_INTERVAL_SECONDS / 2.0f;
+		break;
+	}
+	case SCD30_POWER_CONTINUOUS:
+	default:
+		measurementsPerPeriod = period / SCD30_MIN_INTERVAL_SECONDS;
+		estimate->errorPpm = SCD30_DATASHEET_ERROR_PPM;
+		estimate->stalenessSeconds = SCD30_MIN_INTERVAL_SECONDS / 2.0f;
+		break;
+	}
+
+	estimate->averageMa = SCD30_IDLE_MA + SCD30_MEASUREMENT_MAS * measurementsPerPeriod / period;
+	estimate->energyMjPerReading = estimate->averageMa * period * SCD30_SUPPLY_VOLTS;
+}
+
+const char* scd30Power_policyName(SCD30_POWER_POLICY policy)
+{
+	switch (policy)
+	{
+	case SCD30_POWER_LONG_INTERVAL: return "long-interval";
+	case SCD30_POWER_STOP_START: return "stop-start";
+	case SCD30_POWER_CONTINUOUS:
+	default: return "continuous";
+	}
+}
+
+void scd30Power_logTradeoffs(uint32_t readingPeriodSeconds)
+{
+	SCD30_POWER_ESTIMATE estimate;
+
+	for (int policy = SCD30_POWER_CONTINUOUS; policy <= SCD30_POWER_STOP_START; policy++)
+	{
+		scd30Power_estimate(policy, readingPeriodSeconds, &estimate);
+		Log_Debug("SCD30 %s @ %u s: %.2f mA, %.0f mJ/reading, +/-%.1f ppm, %.1f s old\n",
+			scd30Power_policyName(policy), readingPeriodSeconds, estimate.averageMa, estimate.energyMjPerReading,
+			estimate.errorPpm, estimate.stalenessSeconds);
+	}
+}
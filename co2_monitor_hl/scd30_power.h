@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+// How the SCD30 is run between the readings the app actually uses
+typedef enum
+{
+	SCD30_POWER_CONTINUOUS,		// 2 s measurement interval, always fresh, highest current
+	SCD30_POWER_LONG_INTERVAL,	// measurement interval stretched to the reading period (max 1800 s)
+	SCD30_POWER_STOP_START		// stopped between readings, restarted a warm-up ahead of the next one
+} SCD30_POWER_POLICY;
+
+// Measurements taken after a restart before a reading is trusted
+#define SCD30_POWER_WARMUP_SAMPLES 3
+
+typedef struct
+{
+	float averageMa;			// sensor average current
+	float energyMjPerReading;	// at 3.3 V
+	float errorPpm;				// expected error at 1000 ppm
+	float stalenessSeconds;		// average age of a reading when it is used
+} SCD30_POWER_ESTIMATE;
+
+/// <summary>
+/// Sensor measurement interval to configure for a policy and reading period.
+/// </summary>
+uint16_t scd30Power_measurementInterval(SCD30_POWER_POLICY policy, uint32_t readingPeriodSeconds);
+
+/// <summary>
+/// How long before a reading periodic measurement must be restarted under SCD30_POWER_STOP_START.
+/// </summary>
+uint32_t scd30Power_warmupMs(void);
+
+/// <summary>
+/// Energy and accuracy model for a policy at a reading period.
+/// </summary>
+void scd30Power_estimate(SCD30_POWER_POLICY policy, uint32_t readingPeriodSeconds, SCD30_POWER_ESTIMATE* estimate);
+
+const char* scd30Power_policyName(SCD30_POWER_POLICY policy);
+
+/// <summary>
+/// Log the estimate for every policy at a reading period.
+/// </summary>
+void scd30Power_logTradeoffs(uint32_t readingPeriodSeconds);
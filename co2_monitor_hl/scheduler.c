@@ -0,0 +1,242 @@
+#include "scheduler.h"
+
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SCHED_MAX_TASKS 24
+
+static SCHED_TASK** taskSet = NULL;
+static size_t taskSetCount = 0;
+static int timerFd = -1;
+static EventLoop* schedEventLoop = NULL;
+static EventRegistration* timerRegistration = NULL;
+static uint64_t armedWakeUs = 0;
+static uint64_t startUs = 0;
+static SCHED_STATS stats;
+
+uint64_t sched_nowUs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+/// <summary>
+/// Arm the timerfd for the earliest deadline. Tasks whose tolerance window reaches back to
+/// that wakeup are pulled in and run with it, no task is ever deferred past its deadline.
+/// </summary>
+static void ArmTimer(void)
+{
+	uint64_t wakeUs = UINT64_MAX;
+	struct itimerspec its = { 0 };
+
+	for (size_t i = 0; i < taskSetCount; i++)
+	{
+		if (taskSet[i]->armed && taskSet[i]->deadlineUs < wakeUs)
+		{
+			wakeUs = taskSet[i]->deadlineUs;
+		}
+	}
+
+	if (wakeUs == armedWakeUs || timerFd < 0)
+	{
+		return;
+	}
+
+	if (wakeUs != UINT64_MAX)
+	{
+		its.it_value.tv_sec = (time_t)(wakeUs / 1000000u);
+		its.it_value.tv_nsec = (long)(wakeUs % 1000000u) * 1000;
+	}
+
+	if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &its, NULL) != 0)
+	{
+		Log_Debug("ERROR: timerfd_settime: errno=%d (%s)\n", errno, strerror(errno));
+		return;
+	}
+	armedWakeUs = wakeUs;
+}
+
+/// <summary>
+/// Run every due task and every task within its tolerance of being due, highest priority
+/// (lowest value) first, then re-arm.
+/// </summary>
+static void TimerEventHandler(EventLoop* el, int fd, EventLoop_IoEvents events, void* context)
+{
+	SCHED_TASK* due[SCHED_MAX_TASKS];
+	size_t dueCount = 0;
+	uint64_t expirations;
+	uint64_t now = sched_nowUs();
+
+	if (read(timerFd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+	{
+		Log_Debug("ERROR: scheduler timerfd read: errno=%d (%s)\n", errno, strerror(errno));
+	}
+
+	armedWakeUs = 0;
+	stats.wakeups++;
+
+	for (size_t i = 0; i < taskSetCount; i++)
+	{
+		SCHED_TASK* task = taskSet[i];
+
+		if (!task->armed || task->deadlineUs > now + (uint64_t)task->toleranceMs * 1000u)
+		{
+			continue;
+		}
+
+		size_t pos = dueCount++;
+		while (pos > 0 && (due[pos - 1]->priority > task->priority ||
+			(due[pos - 1]->priority == task->priority && due[pos - 1]->deadlineUs > task->deadlineUs)))
+		{
+			due[pos] = due[pos - 1];
+			pos--;
+		}
+		due[pos] = task;
+	}
+
+	// Advance deadlines before running so handlers can re-arm or cancel any task
+	for (size_t i = 0; i < dueCount; i++)
+	{
+		SCHED_TASK* task = due[i];
+
+		if (task->deadlineUs < now && now - task->deadlineUs > stats.maxLatenessUs)
+		{
+			stats.maxLatenessUs = (uint32_t)(now - task->deadlineUs);
+		}
+		else if (task->deadlineUs > now)
+		{
+			stats.pulledIn++;
+		}
+
+		task->lastDeadlineUs = task->deadlineUs;
+		if (task->periodMs)
+		{
+			// Missed periods are skipped rather than run back to back
+			do
+			{
+				task->deadlineUs += (uint64_t)task->periodMs * 1000u;
+			} while (task->deadlineUs <= now);
+		}
+		else
+		{
+			task->armed = false;
+		}
+	}
+
+	for (size_t i = 0; i < dueCount; i++)
+	{
+		uint64_t spanStartUs = trace_nowUs();
+		due[i]->handler(due[i]);
+		trace_end(due[i]->span, spanStartUs);
+		stats.tasksRun++;
+	}
+
+	ArmTimer();
+}
+
+bool sched_start(EventLoop* eventLoop, SCHED_TASK* tasks[], size_t taskCount)
+{
+	if (taskCount > SCHED_MAX_TASKS)
+	{
+		Log_Debug("ERROR: scheduler supports at most %d tasks\n", SCHED_MAX_TASKS);
+		return false;
+	}
+
+	timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timerFd < 0)
+	{
+		Log_Debug("ERROR: timerfd_create: errno=%d (%s)\n", errno, strerror(errno));
+		return false;
+	}
+
+	timerRegistration = EventLoop_RegisterIo(eventLoop, timerFd, EventLoop_Input, TimerEventHandler, NULL);
+	if (timerRegistration == NULL)
+	{
+		Log_Debug("ERROR: EventLoop_RegisterIo: errno=%d (%s)\n", errno, strerror(errno));
+		close(timerFd);
+		timerFd = -1;
+		return false;
+	}
+
+	schedEventLoop = eventLoop;
+	taskSet = tasks;
+	taskSetCount = taskCount;
+	startUs = sched_nowUs();
+	memset(&stats, 0, sizeof(stats));
+
+	for (size_t i = 0; i < taskSetCount; i++)
+	{
+		taskSet[i]->armed = taskSet[i]->periodMs != 0;
+		taskSet[i]->deadlineUs = startUs + (uint64_t)taskSet[i]->periodMs * 1000u;
+	}
+
+	ArmTimer();
+	return true;
+}
+
+void sched_stop(void)
+{
+	if (timerRegistration != NULL)
+	{
+		EventLoop_UnregisterIo(schedEventLoop, timerRegistration);
+		timerRegistration = NULL;
+	}
+
+	if (timerFd >= 0)
+	{
+		close(timerFd);
+		timerFd = -1;
+	}
+
+	taskSetCount = 0;
+}
+
+void sched_runAt(SCHED_TASK* task, uint64_t deadlineUs)
+{
+	task->deadlineUs = deadlineUs;
+	task->armed = true;
+	ArmTimer();
+}
+
+void sched_runAfter(SCHED_TASK* task, uint32_t delayMs)
+{
+	sched_runAt(task, sched_nowUs() + (uint64_t)delayMs * 1000u);
+}
+
+void sched_cancel(SCHED_TASK* task)
+{
+	task->armed = false;
+	ArmTimer();
+}
+
+void sched_setPeriod(SCHED_TASK* task, uint32_t periodMs)
+{
+	uint64_t now = sched_nowUs();
+
+	task->periodMs = periodMs;
+	if (periodMs == 0)
+	{
+		sched_cancel(task);
+		return;
+	}
+
+	task->deadlineUs = (task->lastDeadlineUs ? task->lastDeadlineUs : now) + (uint64_t)periodMs * 1000u;
+	if (task->deadlineUs < now)
+	{
+		task->deadlineUs = now;
+	}
+	task->armed = true;
+	ArmTimer();
+}
+
+void sched_getStats(SCHED_STATS* out)
+{
+	*out = stats;
+	out->uptimeSeconds = (uint32_t)((sched_nowUs() - startUs) / 1000000u);
+}
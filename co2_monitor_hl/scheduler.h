@@ -0,0 +1,65 @@
+#pragma once
+
+#include "trace.h"
+
+#include <applibs/eventloop.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// All application tasks share one timerfd. Deadlines are absolute on CLOCK_MONOTONIC so
+// periodic tasks never drift. The timerfd fires at the earliest deadline, and a task due
+// within its tolerance after that runs early in the same wakeup rather than waking again.
+typedef struct _schedTask
+{
+	const char* name;
+	void (*handler)(struct _schedTask* task);
+	uint32_t periodMs;		// 0 for one-shot tasks
+	uint32_t toleranceMs;	// how early the task may run to share a wakeup, 0 for tasks that wait out a delay
+	uint8_t priority;		// 0 runs first among tasks due in the same wakeup
+	TRACE_SPAN span;		// each run is recorded against this span
+	// Managed by the scheduler
+	bool armed;
+	uint64_t deadlineUs;	// next deadline
+	uint64_t lastDeadlineUs;// deadline of the current or most recent run
+} SCHED_TASK;
+
+typedef struct
+{
+	uint32_t wakeups;
+	uint32_t tasksRun;
+	uint32_t pulledIn;		// runs ahead of their deadline to share a wakeup
+	uint32_t maxLatenessUs;
+	uint32_t uptimeSeconds;
+} SCHED_STATS;
+
+/// <summary>
+/// Register the timerfd with the event loop and arm every periodic task one period from now.
+/// </summary>
+bool sched_start(EventLoop* eventLoop, SCHED_TASK* tasks[], size_t taskCount);
+
+void sched_stop(void);
+
+/// <summary>
+/// Monotonic clock in microseconds, the time base for deadlines.
+/// </summary>
+uint64_t sched_nowUs(void);
+
+/// <summary>
+/// Run a task once at an absolute deadline. Re-arming an armed task moves its deadline.
+/// </summary>
+void sched_runAt(SCHED_TASK* task, uint64_t deadlineUs);
+
+/// <summary>
+/// Run a task once, delayMs from now.
+/// </summary>
+void sched_runAfter(SCHED_TASK* task, uint32_t delayMs);
+
+void sched_cancel(SCHED_TASK* task);
+
+/// <summary>
+/// Change a periodic task's period, the next deadline is one new period after the last one.
+/// </summary>
+void sched_setPeriod(SCHED_TASK* task, uint32_t periodMs);
+
+void sched_getStats(SCHED_STATS* stats);
@@ -0,0 +1,284 @@
+#include "send_window.h"
+
+#include "trace.h"
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include <azureiot/iothub_device_client_ll.h>
+#include <azureiot/iothub_message.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct
+{
+	bool inUse;
+	uint32_t bytes;
+	uint64_t captureUs;			// 0 unless the message carries a sample
+	uint64_t enqueuedUs;
+	uint64_t sentUs;
+} IN_FLIGHT;
+
+typedef struct
+{
+	SEND_KIND kind;
+	DX_MESSAGE_PROPERTY** properties;
+	size_t propertyCount;
+	uint64_t captureUs;
+	uint64_t enqueuedUs;
+	char text[SEND_WINDOW_MESSAGE_BYTES];
+} BACKLOG_ENTRY;
+
+static SEND_WINDOW_POLICY policy = SEND_POLICY_AGGREGATE;
+static IN_FLIGHT inFlight[SEND_WINDOW_MAX_MESSAGES];
+static BACKLOG_ENTRY backlog[SEND_WINDOW_BACKLOG];
+static size_t backlogHead = 0;
+static size_t backlogCount = 0;
+static SEND_WINDOW_STATS stats;
+
+void sendWindow_setPolicy(SEND_WINDOW_POLICY newPolicy)
+{
+	policy = newPolicy;
+}
+
+static bool WindowHasRoom(size_t bytes)
+{
+	return stats.inFlight < SEND_WINDOW_MAX_MESSAGES && stats.inFlightBytes + bytes <= SEND_WINDOW_MAX_BYTES;
+}
+
+static void MessageConfirmed(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* context)
+{
+	IN_FLIGHT* slot = context;
+	uint64_t nowUs = trace_nowUs();
+
+	trace_recordDuration(TRACE_SEND_CONFIRM, (uint32_t)(nowUs - slot->sentUs));
+	if (slot->captureUs)
+	{
+		trace_recordDuration(TRACE_SAMPLE_TO_CLOUD, (uint32_t)(nowUs - slot->captureUs));
+		Log_Debug("Sample confirmed %s: capture to enqueue %u ms, send wait %u ms, confirm %u ms\n",
+			result == IOTHUB_CLIENT_CONFIRMATION_OK ? "ok" : "failed", (uint32_t)((slot->enqueuedUs - slot->captureUs) / 1000),
+			(uint32_t)((slot->sentUs - slot->enqueuedUs) / 1000), (uint32_t)((nowUs - slot->sentUs) / 1000));
+	}
+
+	if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
+	{
+		stats.confirmed++;
+	}
+	else
+	{
+		stats.failed++;
+	}
+
+	slot->inUse = false;
+	stats.inFlight--;
+	stats.inFlightBytes -= slot->bytes;
+
+	sendWindow_service();
+}
+
+static bool Submit(const char* msg, size_t bytes, DX_MESSAGE_PROPERTY** properties, size_t propertyCount, uint64_t captureUs,
+	uint64_t enqueuedUs)
+{
+	IOTHUB_MESSAGE_HANDLE message;
+	IN_FLIGHT* slot = NULL;
+	char sendWaitMs[12];
+	uint64_t nowUs;
+	bool result;
+
+	for (size_t i = 0; i < SEND_WINDOW_MAX_MESSAGES && slot == NULL; i++)
+	{
+		if (!inFlight[i].inUse)
+		{
+			slot = &inFlight[i];
+		}
+	}
+
+	if (slot == NULL || (message = IoTHubMessage_CreateFromString(msg)) == NULL)
+	{
+		return false;
+	}
+
+	IoTHubMessage_SetContentTypeSystemProperty(message, "application/json");
+	IoTHubMessage_SetContentEncodingSystemProperty(message, "utf-8");
+	for (size_t i = 0; i < propertyCount; i++)
+	{
+		IoTHubMessage_SetProperty(message, properties[i]->key, properties[i]->value);
+	}
+
+	// Time spent in the backlog, so the cloud can split enqueue-to-send from send-to-hub
+	nowUs = trace_nowUs();
+	snprintf(sendWaitMs, sizeof(sendWaitMs), "%u", (uint32_t)((nowUs - enqueuedUs) / 1000));
+	IoTHubMessage_SetProperty(message, SEND_WINDOW_WAIT_PROPERTY, sendWaitMs);
+	trace_recordDuration(TRACE_SEND_WAIT, (uint32_t)(nowUs - enqueuedUs));
+
+	slot->captureUs = captureUs;
+	slot->enqueuedUs = enqueuedUs;
+	slot->sentUs = nowUs;
+	result = IoTHubDeviceClient_LL_SendEventAsync(dx_azureClientHandleGet(), message, MessageConfirmed, slot) == IOTHUB_CLIENT_OK;
+	IoTHubMessage_Destroy(message);
+
+	if (!result)
+	{
+		stats.failed++;
+		return false;
+	}
+
+	slot->inUse = true;
+	slot->bytes = (uint32_t)bytes;
+	stats.inFlight++;
+	stats.inFlightBytes += slot->bytes;
+	stats.sent++;
+	if (stats.inFlight > stats.maxInFlight)
+	{
+		stats.maxInFlight = stats.inFlight;
+	}
+	return true;
+}
+
+void sendWindow_service(void)
+{
+	while (backlogCount && dx_azureIsConnected())
+	{
+		BACKLOG_ENTRY* entry = &backlog[backlogHead];
+		size_t bytes = strlen(entry->text);
+
+		if (!WindowHasRoom(bytes) || !Submit(entry->text, bytes, entry->properties, entry->propertyCount, entry->captureUs, entry->enqueuedUs))
+		{
+			break;
+		}
+
+		backlogHead = (backlogHead + 1) % SEND_WINDOW_BACKLOG;
+		backlogCount--;
+	}
+	stats.backlog = (uint32_t)backlogCount;
+}
+
+static bool Mergeable(SEND_KIND kind)
+{
+	return kind == SEND_KIND_TELEMETRY || kind == SEND_KIND_SENSORS;
+}
+
+// Which queued message a full backlog gives up first under SEND_POLICY_AGGREGATE, lowest first: a stale sample,
+// then periodic reports the next one repeats, alert edges and the boot timeline last
+static int Keep(SEND_KIND kind)
+{
+	switch (kind)
+	{
+	case SEND_KIND_TELEMETRY:
+	case SEND_KIND_SENSORS:
+		return 0;
+	case SEND_KIND_VENTILATION:
+	case SEND_KIND_DIAGNOSTICS:
+	case SEND_KIND_TRACE:
+		return 1;
+	default:
+		return 2;
+	}
+}
+
+static BACKLOG_ENTRY* BacklogEntry(size_t position)
+{
+	return &backlog[(backlogHead + position) % SEND_WINDOW_BACKLOG];
+}
+
+// Drop the queued message at position, the ones behind it move up and keep their order
+static void RemoveFromBacklog(size_t position)
+{
+	for (size_t i = position; i + 1 < backlogCount; i++)
+	{
+		*BacklogEntry(i) = *BacklogEntry(i + 1);
+	}
+	backlogCount--;
+}
+
+static SEND_RESULT Enqueue(SEND_KIND kind, const char* msg, size_t bytes, DX_MESSAGE_PROPERTY** properties, size_t propertyCount,
+	uint64_t captureUs, uint64_t enqueuedUs)
+{
+	BACKLOG_ENTRY* entry = NULL;
+	size_t victim = 0;
+
+	if (bytes >= SEND_WINDOW_MESSAGE_BYTES)
+	{
+		stats.dropped++;
+		return SEND_RESULT_DROPPED;
+	}
+
+	if (policy == SEND_POLICY_AGGREGATE && Mergeable(kind))
+	{
+		for (size_t i = 0; i < backlogCount && entry == NULL; i++)
+		{
+			if (BacklogEntry(i)->kind == kind)
+			{
+				entry = BacklogEntry(i);
+				stats.aggregated++;
+			}
+		}
+	}
+
+	if (entry == NULL && backlogCount == SEND_WINDOW_BACKLOG)
+	{
+		stats.dropped++;
+		if (policy == SEND_POLICY_DROP_NEWEST)
+		{
+			return SEND_RESULT_DROPPED;
+		}
+		for (size_t i = 1; policy == SEND_POLICY_AGGREGATE && i < backlogCount; i++)
+		{
+			if (Keep(BacklogEntry(i)->kind) < Keep(BacklogEntry(victim)->kind))
+			{
+				victim = i;
+			}
+		}
+		// A sample arriving behind a backlog of events is the one given up
+		if (policy == SEND_POLICY_AGGREGATE && Keep(kind) < Keep(BacklogEntry(victim)->kind))
+		{
+			return SEND_RESULT_DROPPED;
+		}
+		RemoveFromBacklog(victim);
+	}
+
+	if (entry == NULL)
+	{
+		entry = BacklogEntry(backlogCount);
+		backlogCount++;
+	}
+
+	memcpy(entry->text, msg, bytes + 1);
+	entry->kind = kind;
+	entry->properties = properties;
+	entry->propertyCount = propertyCount;
+	entry->captureUs = captureUs;
+	entry->enqueuedUs = enqueuedUs;
+	stats.backlog = (uint32_t)backlogCount;
+	return SEND_RESULT_QUEUED;
+}
+
+SEND_RESULT sendWindow_sendSample(SEND_KIND kind, const char* msg, DX_MESSAGE_PROPERTY** properties, size_t propertyCount,
+	uint64_t captureUs)
+{
+	size_t bytes = strlen(msg);
+	uint64_t enqueuedUs = trace_nowUs();
+
+	if (captureUs)
+	{
+		trace_recordDuration(TRACE_SAMPLE_ENQUEUE, (uint32_t)(enqueuedUs - captureUs));
+	}
+
+	sendWindow_service();
+
+	// Keep order: while anything is queued new messages queue behind it
+	if (backlogCount == 0 && dx_azureIsConnected() && WindowHasRoom(bytes))
+	{
+		return Submit(msg, bytes, properties, propertyCount, captureUs, enqueuedUs) ? SEND_RESULT_SENT : SEND_RESULT_FAILED;
+	}
+
+	return Enqueue(kind, msg, bytes, properties, propertyCount, captureUs, enqueuedUs);
+}
+
+SEND_RESULT sendWindow_send(SEND_KIND kind, const char* msg, DX_MESSAGE_PROPERTY** properties, size_t propertyCount)
+{
+	return sendWindow_sendSample(kind, msg, properties, propertyCount, 0);
+}
+
+void sendWindow_getStats(SEND_WINDOW_STATS* out)
+{
+	*out = stats;
+}
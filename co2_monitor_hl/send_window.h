@@ -0,0 +1,80 @@
+#pragma once
+
+#include "dx_azure_iot.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Messages handed to the IoT SDK and not yet confirmed are capped by count and bytes, so a slow link
+// cannot grow SDK memory. Messages that do not fit wait in a small backlog managed by the policy.
+#define SEND_WINDOW_MAX_MESSAGES 4
+#define SEND_WINDOW_MAX_BYTES 2048
+#define SEND_WINDOW_BACKLOG 4
+#define SEND_WINDOW_MESSAGE_BYTES 1536		// largest message the backlog holds
+
+// Message property carrying the milliseconds between sendWindow_send and the hand-off to the SDK
+#define SEND_WINDOW_WAIT_PROPERTY "sendWaitMs"
+
+// What a message is, the key SEND_POLICY_AGGREGATE merges on. Only readings a newer reading supersedes are merged,
+// alert edges, diagnostics and the boot timeline each carry something the next message of their kind does not.
+typedef enum
+{
+	SEND_KIND_TELEMETRY,		// SCD30 sample, merged
+	SEND_KIND_SENSORS,			// secondary sensor readings, merged
+	SEND_KIND_VENTILATION,
+	SEND_KIND_ALERT,			// alert, rule and forecast edges
+	SEND_KIND_DIAGNOSTICS,
+	SEND_KIND_TRACE,
+	SEND_KIND_BOOT_TIMELINE
+} SEND_KIND;
+
+typedef enum
+{
+	SEND_POLICY_AGGREGATE,		// a newer sample replaces a queued one of its kind, when full samples are dropped before events
+	SEND_POLICY_DROP_OLDEST,
+	SEND_POLICY_DROP_NEWEST
+} SEND_WINDOW_POLICY;
+
+typedef enum
+{
+	SEND_RESULT_SENT,			// handed to the SDK
+	SEND_RESULT_QUEUED,			// waiting in the backlog
+	SEND_RESULT_DROPPED,
+	SEND_RESULT_FAILED
+} SEND_RESULT;
+
+typedef struct
+{
+	uint32_t inFlight;
+	uint32_t inFlightBytes;
+	uint32_t maxInFlight;
+	uint32_t backlog;
+	uint32_t sent;
+	uint32_t confirmed;
+	uint32_t failed;			// rejected by the SDK or confirmed with an error
+	uint32_t aggregated;		// queued messages replaced by a newer one
+	uint32_t dropped;
+} SEND_WINDOW_STATS;
+
+void sendWindow_setPolicy(SEND_WINDOW_POLICY policy);
+
+/// <summary>
+/// Send a device-to-cloud message through the window. The kind decides what the backlog may merge or drop when it
+/// is full. Confirmation latency is traced as SendConfirm.
+/// </summary>
+SEND_RESULT sendWindow_send(SEND_KIND kind, const char* msg, DX_MESSAGE_PROPERTY** properties, size_t propertyCount);
+
+/// <summary>
+/// As sendWindow_send for a message carrying a sample read at captureUs (trace_nowUs clock). The pipeline is traced
+/// per stage: SampleEnqueue (capture to send call), SendWait (backlog), SendConfirm (SDK to hub acknowledgement)
+/// and SampleToCloud end to end, and each confirmation is logged with its stage breakdown.
+/// </summary>
+SEND_RESULT sendWindow_sendSample(SEND_KIND kind, const char* msg, DX_MESSAGE_PROPERTY** properties, size_t propertyCount,
+	uint64_t captureUs);
+
+/// <summary>
+/// Move backlog messages into the window as it frees up, after a reconnect for example.
+/// </summary>
+void sendWindow_service(void);
+
+void sendWindow_getStats(SEND_WINDOW_STATS* stats);
@@ -0,0 +1,327 @@
+#include "sensor_registry.h"
+
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef enum
+{
+	SENSOR_UNPROBED,
+	SENSOR_ABSENT,				// probed again at nextUs
+	SENSOR_IDLE,				// waiting for its next start
+	SENSOR_CONVERTING			// started, waiting for the conversion to finish
+} SENSOR_PHASE;
+
+typedef struct
+{
+	const SENSOR_DRIVER* driver;
+	SENSOR_PHASE phase;
+	uint64_t nextUs;			// next start when idle, read when converting, probe when absent
+	uint64_t startedUs;
+	uint64_t dueUs;				// when the last start was due, its period counts from here
+	uint64_t configuredUs;
+	uint32_t failuresInRow;
+	bool reconfigure;			// configured again before the next start, after backing off
+	bool taken;					// read this wakeup, waiting to be decoded
+	bool unsent;				// values not yet formatted for telemetry
+	uint8_t raw[SENSOR_REGISTRY_MAX_RAW_BYTES];
+	float values[SENSOR_REGISTRY_MAX_CHANNELS];
+} SENSOR;
+
+static SENSOR sensors[SENSOR_REGISTRY_MAX_DRIVERS];
+static size_t sensorCount = 0;
+static SENSOR_READING_HANDLER readingHandler = NULL;
+static SENSOR_REGISTRY_STATS stats;
+
+bool sensorRegistry_init(const SENSOR_DRIVER* const* drivers, size_t count, SENSOR_READING_HANDLER handler)
+{
+	if (count > SENSOR_REGISTRY_MAX_DRIVERS)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		if (drivers[i]->channelCount > SENSOR_REGISTRY_MAX_CHANNELS || drivers[i]->rawBytes > SENSOR_REGISTRY_MAX_RAW_BYTES)
+		{
+			return false;
+		}
+	}
+
+	memset(sensors, 0, sizeof(sensors));
+	memset(&stats, 0, sizeof(stats));
+	for (size_t i = 0; i < count; i++)
+	{
+		sensors[i].driver = drivers[i];
+		sensors[i].phase = SENSOR_UNPROBED;
+	}
+	sensorCount = count;
+	readingHandler = handler;
+	return true;
+}
+
+static bool Present(const SENSOR* sensor)
+{
+	return sensor->phase == SENSOR_IDLE || sensor->phase == SENSOR_CONVERTING;
+}
+
+/// <summary>
+/// A sensor that does not answer is tried again every SENSOR_REGISTRY_BACKOFF_MS, so one plugged in later or
+/// slow to come up is still picked up.
+/// </summary>
+static void Probe(SENSOR* sensor, uint64_t nowUs)
+{
+	const SENSOR_DRIVER* driver = sensor->driver;
+
+	if (!driver->probe() || (driver->configure != NULL && !driver->configure()))
+	{
+		if (sensor->phase == SENSOR_UNPROBED)
+		{
+			Log_Debug("Sensor %s not found, probed again every %d ms\n", driver->name, SENSOR_REGISTRY_BACKOFF_MS);
+		}
+		sensor->phase = SENSOR_ABSENT;
+		sensor->nextUs = nowUs + (uint64_t)SENSOR_REGISTRY_BACKOFF_MS * 1000u;
+		return;
+	}
+
+	sensor->phase = SENSOR_IDLE;
+	sensor->configuredUs = nowUs;
+	sensor->nextUs = nowUs + (uint64_t)driver->configureMs * 1000u;
+	stats.present++;
+	Log_Debug("Sensor %s found, polled every %u ms\n", driver->name, driver->periodMs);
+}
+
+/// <summary>
+/// A start or read failed. One that keeps failing, unplugged or hung, backs off and is configured again.
+/// </summary>
+static void Failed(SENSOR* sensor, uint64_t nowUs)
+{
+	uint32_t delayMs = sensor->driver->periodMs;
+
+	stats.failures++;
+	sensor->phase = SENSOR_IDLE;
+	if (++sensor->failuresInRow >= SENSOR_REGISTRY_FAILURES_TO_BACK_OFF)
+	{
+		delayMs = SENSOR_REGISTRY_BACKOFF_MS;
+		sensor->reconfigure = sensor->driver->configure != NULL;
+	}
+	sensor->nextUs = nowUs + (uint64_t)delayMs * 1000u;
+}
+
+static void Start(SENSOR* sensor, uint64_t nowUs)
+{
+	const SENSOR_DRIVER* driver = sensor->driver;
+
+	if (sensor->reconfigure)
+	{
+		if (!driver->configure())
+		{
+			Failed(sensor, nowUs);
+			return;
+		}
+		sensor->reconfigure = false;
+		sensor->configuredUs = nowUs;
+	}
+
+	if (!driver->start())
+	{
+		Failed(sensor, nowUs);
+		return;
+	}
+	sensor->phase = SENSOR_CONVERTING;
+	sensor->startedUs = nowUs;
+	sensor->dueUs = sensor->nextUs > nowUs ? sensor->nextUs : nowUs;
+	sensor->nextUs = nowUs + (uint64_t)driver->conversionMs * 1000u;
+}
+
+static void Read(SENSOR* sensor, uint64_t nowUs)
+{
+	if (!sensor->driver->read(sensor->raw))
+	{
+		Failed(sensor, nowUs);
+		return;
+	}
+	sensor->phase = SENSOR_IDLE;
+	sensor->failuresInRow = 0;
+	sensor->taken = true;
+	// A start pulled in early keeps the period, it does not move the next one forward
+	sensor->nextUs = sensor->dueUs + (uint64_t)sensor->driver->periodMs * 1000u;
+}
+
+static void Decode(SENSOR* sensor, uint64_t nowUs)
+{
+	const SENSOR_DRIVER* driver = sensor->driver;
+	float values[SENSOR_REGISTRY_MAX_CHANNELS];
+
+	sensor->taken = false;
+	if (nowUs - sensor->configuredUs < (uint64_t)driver->warmupMs * 1000u)
+	{
+		return;
+	}
+	if (!driver->decode(sensor->raw, values))
+	{
+		stats.rejected++;
+		return;
+	}
+
+	memcpy(sensor->values, values, sizeof(float) * driver->channelCount);
+	sensor->unsent = true;
+	stats.readings++;
+	if (readingHandler != NULL)
+	{
+		readingHandler(driver, values);
+	}
+}
+
+uint64_t sensorRegistry_poll(uint64_t nowUs)
+{
+	SENSOR* starts[SENSOR_REGISTRY_MAX_DRIVERS];
+	size_t startCount = 0, position;
+	uint32_t batch = 0;
+	bool due = false;
+	uint64_t next = UINT64_MAX, first;
+
+	for (size_t i = 0; i < sensorCount; i++)
+	{
+		if (sensors[i].phase == SENSOR_UNPROBED || (sensors[i].phase == SENSOR_ABSENT && sensors[i].nextUs <= nowUs))
+		{
+			Probe(&sensors[i], nowUs);
+		}
+		due = due || (Present(&sensors[i]) && sensors[i].nextUs <= nowUs);
+	}
+
+	if (due)
+	{
+		// Starts due soon come along, ordered so the longest conversion runs behind the most bus traffic
+		for (size_t i = 0; i < sensorCount; i++)
+		{
+			SENSOR* sensor = &sensors[i];
+
+			if (sensor->phase != SENSOR_IDLE || sensor->nextUs > nowUs + (uint64_t)sensor->driver->periodMs * 1000u / 8)
+			{
+				continue;
+			}
+			if (sensor->nextUs > nowUs)
+			{
+				stats.pulledIn++;
+			}
+			for (position = startCount; position > 0 && starts[position - 1]->driver->conversionMs < sensor->driver->conversionMs; position--)
+			{
+				starts[position] = starts[position - 1];
+			}
+			starts[position] = sensor;
+			startCount++;
+		}
+		for (size_t i = 0; i < startCount; i++)
+		{
+			Start(starts[i], nowUs);
+			batch++;
+		}
+
+		for (size_t i = 0; i < sensorCount; i++)
+		{
+			if (sensors[i].phase == SENSOR_CONVERTING && sensors[i].nextUs <= nowUs)
+			{
+				Read(&sensors[i], nowUs);
+				batch++;
+			}
+		}
+
+		for (size_t i = 0; i < sensorCount; i++)
+		{
+			if (sensors[i].taken)
+			{
+				Decode(&sensors[i], nowUs);
+			}
+		}
+
+		stats.wakeups++;
+		stats.operations += batch;
+		if (batch > stats.maxBatch)
+		{
+			stats.maxBatch = batch;
+		}
+	}
+
+	for (size_t i = 0; i < sensorCount; i++)
+	{
+		if (sensors[i].phase != SENSOR_UNPROBED && sensors[i].nextUs < next)
+		{
+			next = sensors[i].nextUs;
+		}
+	}
+
+	// Conversions ending close together are read in one wakeup, at the last of them
+	first = next;
+	for (size_t i = 0; i < sensorCount && first != UINT64_MAX; i++)
+	{
+		if (sensors[i].phase == SENSOR_CONVERTING && sensors[i].nextUs > next &&
+			sensors[i].nextUs - first <= SENSOR_REGISTRY_READ_SLACK_MS * 1000u)
+		{
+			next = sensors[i].nextUs;
+		}
+	}
+	return next;
+}
+
+bool sensorRegistry_isPresent(const SENSOR_DRIVER* driver)
+{
+	for (size_t i = 0; i < sensorCount; i++)
+	{
+		if (sensors[i].driver == driver)
+		{
+			return Present(&sensors[i]);
+		}
+	}
+	return false;
+}
+
+size_t sensorRegistry_formatTelemetry(char* buffer, size_t size)
+{
+	size_t length = 0;
+	int written;
+	bool any = false;
+
+	written = snprintf(buffer, size, "{");
+	if (written < 0 || (size_t)written >= size)
+	{
+		return 0;
+	}
+	length = (size_t)written;
+
+	for (size_t i = 0; i < sensorCount; i++)
+	{
+		if (!sensors[i].unsent)
+		{
+			continue;
+		}
+		for (uint8_t channel = 0; channel < sensors[i].driver->channelCount; channel++)
+		{
+			written = snprintf(buffer + length, size - length, "%s \"%s\": %.2f", any ? "," : "",
+				sensors[i].driver->channels[channel], sensors[i].values[channel]);
+			if (written < 0 || (size_t)written >= size - length)
+			{
+				return 0;
+			}
+			length += (size_t)written;
+			any = true;
+		}
+	}
+
+	written = snprintf(buffer + length, size - length, " }");
+	if (!any || written < 0 || (size_t)written >= size - length)
+	{
+		return 0;
+	}
+
+	for (size_t i = 0; i < sensorCount; i++)
+	{
+		sensors[i].unsent = false;
+	}
+	return length + (size_t)written;
+}
+
+void sensorRegistry_getStats(SENSOR_REGISTRY_STATS* out)
+{
+	*out = stats;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Secondary sensors on the SCD30's I2C bus, each described by a driver table and polled from one task.
+// Every sensor is triggered, then read once its conversion time has passed. Conversions that end within
+// SENSOR_REGISTRY_READ_SLACK_MS of each other share a wakeup, and starts due within an eighth of their period
+// are pulled into one. In a wakeup all starts go first, longest conversion first, then the reads, so the bus
+// carries the other sensors' transfers while a conversion runs. Decoding follows the bus traffic. A sensor that
+// does not answer its probe is probed again every SENSOR_REGISTRY_BACKOFF_MS. Adding a sensor takes a driver
+// table and a decoder, listed with the others in main.c.
+#define SENSOR_REGISTRY_MAX_DRIVERS 8
+#define SENSOR_REGISTRY_MAX_CHANNELS 4		// decoded values per sensor
+#define SENSOR_REGISTRY_MAX_RAW_BYTES 16	// read hands decode at most this much
+#define SENSOR_REGISTRY_READ_SLACK_MS 20		// a read waits this long at most to share a wakeup
+#define SENSOR_REGISTRY_FAILURES_TO_BACK_OFF 3	// consecutive failed reads before polling at SENSOR_REGISTRY_BACKOFF_MS
+#define SENSOR_REGISTRY_BACKOFF_MS 60000
+
+typedef struct
+{
+	const char* name;
+	const char* const* channels;	// names of the decoded values, as sent in telemetry
+	uint8_t channelCount;
+	uint8_t rawBytes;				// read fills this much for decode
+	uint32_t configureMs;			// from configure until the first start
+	uint32_t warmupMs;				// readings this soon after configure are dropped
+	uint32_t conversionMs;			// from start until the result can be read
+	uint32_t periodMs;				// between starts
+	bool (*probe)(void);			// true when the part answers as itself
+	bool (*configure)(void);		// NULL when its defaults do
+	bool (*start)(void);			// trigger a conversion
+	bool (*read)(uint8_t* raw);		// bus transfer only
+	bool (*decode)(const uint8_t* raw, float* values);	// no I2C, false for a reading that is not valid
+} SENSOR_DRIVER;
+
+/// <summary>
+/// Called for every decoded reading straight after it was taken.
+/// </summary>
+typedef void (*SENSOR_READING_HANDLER)(const SENSOR_DRIVER* driver, const float* values);
+
+typedef struct
+{
+	uint32_t present;			// sensors that answered their probe
+	uint32_t wakeups;			// polls with work to do
+	uint32_t operations;		// starts and reads
+	uint32_t maxBatch;			// most operations in one wakeup
+	uint32_t pulledIn;			// starts run early to share a wakeup
+	uint32_t readings;
+	uint32_t failures;			// starts or reads that failed on the bus
+	uint32_t rejected;			// reads decode turned down
+} SENSOR_REGISTRY_STATS;
+
+/// <summary>
+/// Register the drivers. Nothing goes on the bus here, the first poll probes and configures them.
+/// </summary>
+/// <returns>false when there are more than SENSOR_REGISTRY_MAX_DRIVERS or a driver exceeds the limits</returns>
+bool sensorRegistry_init(const SENSOR_DRIVER* const* drivers, size_t count, SENSOR_READING_HANDLER handler);
+
+/// <summary>
+/// Run the starts, reads and probes of absent sensors due at nowUs.
+/// </summary>
+/// <returns>when to poll next, UINT64_MAX when no sensor is registered</returns>
+uint64_t sensorRegistry_poll(uint64_t nowUs);
+
+/// <summary>
+/// Whether the sensor answered its probe.
+/// </summary>
+bool sensorRegistry_isPresent(const SENSOR_DRIVER* driver);
+
+/// <summary>
+/// Encode the channels read since the last call as a JSON object.
+/// </summary>
+/// <returns>length of the message, 0 when nothing new was read or it did not fit</returns>
+size_t sensorRegistry_formatTelemetry(char* buffer, size_t size);
+
+void sensorRegistry_getStats(SENSOR_REGISTRY_STATS* stats);
@@ -0,0 +1,62 @@
+#include "sgp30.h"
+
+#include "./embedded-scd/embedded-common/sensirion_common.h"
+#include <stdint.h>
+
+#define SGP30_CMD_GET_FEATURE_SET 0x202F
+#define SGP30_CMD_IAQ_INIT 0x2003
+#define SGP30_CMD_MEASURE_IAQ 0x2008
+#define SGP30_FEATURE_SET_MS 10
+#define SGP30_PRODUCT_TYPE_MASK 0xF000		// 0 for the SGP30
+#define SGP30_IAQ_INIT_MS 10
+#define SGP30_MEASURE_IAQ_MS 12
+#define SGP30_WARMUP_MS 15000
+
+static bool Probe(void)
+{
+	uint16_t featureSet;
+
+	return sensirion_i2c_delayed_read_cmd(SGP30_I2C_ADDRESS, SGP30_CMD_GET_FEATURE_SET, SGP30_FEATURE_SET_MS * 1000u, &featureSet, 1) == STATUS_OK &&
+		(featureSet & SGP30_PRODUCT_TYPE_MASK) == 0;
+}
+
+static bool Configure(void)
+{
+	return sensirion_i2c_write_cmd(SGP30_I2C_ADDRESS, SGP30_CMD_IAQ_INIT) == STATUS_OK;
+}
+
+static bool Start(void)
+{
+	return sensirion_i2c_write_cmd(SGP30_I2C_ADDRESS, SGP30_CMD_MEASURE_IAQ) == STATUS_OK;
+}
+
+// CO2eq and TVOC words, CRCs checked and removed
+static bool Read(uint8_t* raw)
+{
+	return sensirion_i2c_read_words_as_bytes(SGP30_I2C_ADDRESS, raw, 2) == STATUS_OK;
+}
+
+static bool Decode(const uint8_t* raw, float* values)
+{
+	values[0] = (float)((uint16_t)raw[0] << 8 | raw[1]);
+	values[1] = (float)((uint16_t)raw[2] << 8 | raw[3]);
+	return true;
+}
+
+static const char* const channels[] = { "CO2eq", "TVOC" };
+
+const SENSOR_DRIVER sgp30Driver = {
+	.name = "SGP30 VOC",
+	.channels = channels,
+	.channelCount = 2,
+	.rawBytes = 4,
+	.configureMs = SGP30_IAQ_INIT_MS,
+	.warmupMs = SGP30_WARMUP_MS,
+	.conversionMs = SGP30_MEASURE_IAQ_MS,
+	.periodMs = 1000,
+	.probe = Probe,
+	.configure = Configure,
+	.start = Start,
+	.read = Read,
+	.decode = Decode
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "sensor_registry.h"
+
+// Sensirion SGP30 VOC sensor on the SCD30's I2C bus, such as the Grove VOC and eCO2 board. Its baseline
+// algorithm wants a measurement every second, and for 15 s after initialisation it reads a fixed 400 ppm and
+// 0 ppb, those readings are dropped. Channels "CO2eq" in ppm and "TVOC" in ppb.
+#define SGP30_I2C_ADDRESS 0x58
+
+extern const SENSOR_DRIVER sgp30Driver;
@@ -0,0 +1,262 @@
+#include "temperature_calibration.h"
+
+#include <math.h>
+
+static TEMPERATURE_CALIBRATION_CONFIG calibrationConfig = {
+	.minRiseC = 0.3f,
+	.settleSeconds = 600,
+	.settleToleranceC = 0.1f,
+	.warmupMaxSeconds = 7200,
+	.referenceSeconds = 300,
+	.referenceToleranceC = 0.02f,
+	.applyThresholdC = 0.05f
+};
+
+static TEMPERATURE_CALIBRATION_STATE state = {
+	.offsetC = NAN, .selfHeatingC = NAN, .timeConstantSeconds = NAN, .referenceErrorC = NAN
+};
+
+// Warm-up: minute means, and the (T, dT/dt) line through consecutive means
+static bool warmupActive = false;
+static uint64_t startUs;
+static float firstC;
+static double firstMidSeconds;		// from start to the middle of the first minute
+static double stepSum;
+static uint32_t stepCount;
+static uint64_t stepStartUs;
+static float previousMeanC;
+static uint64_t previousMeanUs;
+static double n, sumX, sumY, sumXX, sumXY;
+static float settlingC;
+static uint64_t settlingSinceUs;
+static uint64_t steadyUs;			// the self-heating is within 2 % of its final value
+
+// Reference: mean and variance of reading minus reference
+static bool referenceActive = false;
+static float referenceC;
+static uint64_t referenceSetUs, referenceUs;
+static double referenceCount, referenceSum, referenceSumSquares;
+
+static float pendingC = NAN;
+static TEMPERATURE_OFFSET_SOURCE pendingSource;
+static bool writing = false;
+
+void temperatureCalibration_configure(const TEMPERATURE_CALIBRATION_CONFIG* config)
+{
+	calibrationConfig = *config;
+}
+
+const TEMPERATURE_CALIBRATION_CONFIG* temperatureCalibration_getConfig(void)
+{
+	return &calibrationConfig;
+}
+
+void temperatureCalibration_start(float offsetC, TEMPERATURE_OFFSET_SOURCE source, uint64_t nowUs)
+{
+	state.offsetC = offsetC;
+	state.source = source;
+	state.selfHeatingC = state.timeConstantSeconds = NAN;
+
+	warmupActive = true;
+	startUs = nowUs;
+	firstC = NAN;
+	stepSum = 0;
+	stepCount = 0;
+	stepStartUs = nowUs;
+	previousMeanC = NAN;
+	n = sumX = sumY = sumXX = sumXY = 0;
+	settlingC = NAN;
+	steadyUs = UINT64_MAX;
+	pendingC = NAN;
+	writing = false;
+}
+
+bool temperatureCalibration_setReference(float reference, uint64_t nowUs)
+{
+	if (nowUs < steadyUs)
+	{
+		return false;
+	}
+	referenceActive = true;
+	referenceC = reference;
+	referenceSetUs = nowUs;
+	referenceCount = referenceSum = referenceSumSquares = 0;
+	state.referenceErrorC = NAN;
+	return true;
+}
+
+static float ClampOffset(float offsetC)
+{
+	return fminf(fmaxf(offsetC, 0.0f), TEMPERATURE_CALIBRATION_MAX_OFFSET_C);
+}
+
+static void Converged(float offsetC, TEMPERATURE_OFFSET_SOURCE source, uint64_t sinceUs, uint64_t nowUs)
+{
+	pendingC = ClampOffset(offsetC);
+	pendingSource = source;
+	state.convergedSeconds = (uint32_t)((nowUs - sinceUs) / 1000000u);
+}
+
+/// <summary>
+/// Close a minute of readings: add its slope against the previous minute to the fit and test the fitted rise
+/// </summary>
+static void WarmupStep(uint64_t nowUs)
+{
+	float mean = (float)(stepSum / stepCount);
+	double slope, intercept, finalC, rise;
+
+	if (isnan(firstC))
+	{
+		firstC = mean;
+		firstMidSeconds = (double)(nowUs - startUs) / 2e6;
+	}
+	else
+	{
+		double x = (mean + previousMeanC) / 2;
+		double y = (mean - previousMeanC) / ((double)(stepStartUs - previousMeanUs) / 1e6);
+
+		n += 1;
+		sumX += x;
+		sumY += y;
+		sumXX += x * x;
+		sumXY += x * y;
+	}
+	previousMeanC = mean;
+	previousMeanUs = stepStartUs;
+
+	// A warm restart barely moves, there is no curve to wait for
+	if (nowUs - startUs >= (uint64_t)calibrationConfig.settleSeconds * 1000000u && fabsf(mean - firstC) < calibrationConfig.minRiseC / 2)
+	{
+		warmupActive = false;
+		steadyUs = nowUs;
+		return;
+	}
+
+	if (n < 3 || n * sumXX - sumX * sumX <= 0)
+	{
+		return;
+	}
+
+	slope = (n * sumXY - sumX * sumY) / (n * sumXX - sumX * sumX);
+	intercept = (sumY - slope * sumX) / n;
+	if (slope >= 0)
+	{
+		return;		// not approaching anything yet
+	}
+	// The first minute has already risen a little, taken back to the start along the fitted curve
+	finalC = -intercept / slope;
+	rise = (finalC - firstC) * exp(-slope * firstMidSeconds);
+
+	if (isnan(settlingC) || fabs(finalC - settlingC) > calibrationConfig.settleToleranceC)
+	{
+		settlingC = (float)finalC;
+		settlingSinceUs = nowUs;
+		return;
+	}
+
+	if (nowUs - settlingSinceUs >= (uint64_t)calibrationConfig.settleSeconds * 1000000u && rise >= calibrationConfig.minRiseC)
+	{
+		warmupActive = false;
+		state.selfHeatingC = (float)rise;
+		state.timeConstantSeconds = (float)(-1 / slope);
+		steadyUs = startUs + (uint64_t)(4e6 * state.timeConstantSeconds);
+		if (state.source != TEMPERATURE_OFFSET_REFERENCE)
+		{
+			Converged((float)rise, TEMPERATURE_OFFSET_WARMUP, startUs, nowUs);
+		}
+	}
+}
+
+bool temperatureCalibration_update(float temperature, uint64_t nowUs, float* offsetC)
+{
+	double mean, variance;
+
+	if (isnan(temperature) || writing)
+	{
+		return false;
+	}
+
+	if (warmupActive)
+	{
+		if (nowUs - stepStartUs >= TEMPERATURE_CALIBRATION_STEP_SECONDS * 1000000ull && stepCount)
+		{
+			WarmupStep(nowUs);
+			stepSum = 0;
+			stepCount = 0;
+			stepStartUs = nowUs;
+		}
+		stepSum += temperature;
+		stepCount++;
+
+		if (nowUs - startUs > (uint64_t)calibrationConfig.warmupMaxSeconds * 1000000u)
+		{
+			warmupActive = false;		// a warm restart, or the room would not keep still
+			steadyUs = nowUs;
+		}
+	}
+	else if (referenceActive)
+	{
+		if (referenceCount == 0)
+		{
+			referenceUs = nowUs;
+		}
+		referenceCount += 1;
+		referenceSum += temperature - referenceC;
+		referenceSumSquares += (double)(temperature - referenceC) * (temperature - referenceC);
+
+		mean = referenceSum / referenceCount;
+		variance = fmax(0.0, referenceSumSquares / referenceCount - mean * mean);
+		if (referenceCount >= 10 && nowUs - referenceUs >= (uint64_t)calibrationConfig.referenceSeconds * 1000000u &&
+			sqrt(variance / referenceCount) < calibrationConfig.referenceToleranceC)
+		{
+			referenceActive = false;
+			state.referenceErrorC = (float)mean;
+			Converged(state.offsetC + (float)mean, TEMPERATURE_OFFSET_REFERENCE, referenceSetUs, nowUs);
+		}
+	}
+
+	if (isnan(pendingC))
+	{
+		return false;
+	}
+	if (fabsf(pendingC - state.offsetC) < calibrationConfig.applyThresholdC)
+	{
+		state.source = pendingSource;		// confirmed without a write
+		pendingC = NAN;
+		return false;
+	}
+
+	writing = true;
+	*offsetC = pendingC;
+	return true;
+}
+
+void temperatureCalibration_written(float offsetC)
+{
+	writing = false;
+	if (isnan(offsetC))
+	{
+		return;		// pendingC is handed out again on the next reading
+	}
+
+	state.offsetC = offsetC;
+	state.source = pendingSource;
+	state.writes++;
+	pendingC = NAN;
+}
+
+void temperatureCalibration_getState(TEMPERATURE_CALIBRATION_STATE* out)
+{
+	*out = state;
+}
+
+const char* temperatureCalibration_sourceName(TEMPERATURE_OFFSET_SOURCE source)
+{
+	switch (source)
+	{
+	case TEMPERATURE_OFFSET_WARMUP: return "warm-up";
+	case TEMPERATURE_OFFSET_REFERENCE: return "reference";
+	case TEMPERATURE_OFFSET_UNCALIBRATED:
+	default: return "uncalibrated";
+	}
+}
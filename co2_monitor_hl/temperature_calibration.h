@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// SCD30 temperature offset from the sensor's own self-heating. After power-up the reading rises as
+// T(t) = T_inf - (T_inf - T_0) e^(-t / tau), so dT/dt is linear in T: a least squares line through
+// (T, dT/dt) taken on minute means gives T_inf = -intercept / slope and the rise T_inf - T_0 is the
+// offset. A reference temperature from the device twin overrides it: readings are averaged against
+// the reference from when it is sent, which has to be once the self-heating is steady. No I2C here, the caller writes the offset it is handed.
+#define TEMPERATURE_CALIBRATION_MAX_OFFSET_C 10.0f
+#define TEMPERATURE_CALIBRATION_STEP_SECONDS 60		// warm-up readings are averaged over this before the fit
+
+typedef enum
+{
+	TEMPERATURE_OFFSET_UNCALIBRATED,
+	TEMPERATURE_OFFSET_WARMUP,			// fitted from the warm-up curve
+	TEMPERATURE_OFFSET_REFERENCE		// measured against a reference, warm-up fits no longer replace it
+} TEMPERATURE_OFFSET_SOURCE;
+
+typedef struct
+{
+	float minRiseC;					// smaller rises are a warm restart, not a warm-up
+	uint16_t settleSeconds;			// the fitted rise must hold within settleToleranceC this long
+	float settleToleranceC;
+	uint16_t warmupMaxSeconds;		// the warm-up fit gives up after this
+	uint16_t referenceSeconds;		// readings averaged against a reference at least this long
+	float referenceToleranceC;		// and until the standard error of the mean is under this
+	float applyThresholdC;			// smaller offset changes are not written
+} TEMPERATURE_CALIBRATION_CONFIG;
+
+typedef struct
+{
+	TEMPERATURE_OFFSET_SOURCE source;	// of offsetC
+	float offsetC;						// offset in the sensor
+	float selfHeatingC;					// warm-up fit of the rise, NAN until settled
+	float timeConstantSeconds;
+	float referenceErrorC;				// reading minus reference, NAN until converged
+	uint32_t convergedSeconds;			// from start or reference to the last convergence
+	uint32_t writes;
+} TEMPERATURE_CALIBRATION_STATE;
+
+void temperatureCalibration_configure(const TEMPERATURE_CALIBRATION_CONFIG* config);
+
+const TEMPERATURE_CALIBRATION_CONFIG* temperatureCalibration_getConfig(void);
+
+/// <summary>
+/// Start a warm-up fit when the sensor starts measuring.
+/// </summary>
+/// <param name="offsetC">offset read from the sensor</param>
+/// <param name="source">where that offset came from, persisted by the caller</param>
+void temperatureCalibration_start(float offsetC, TEMPERATURE_OFFSET_SOURCE source, uint64_t nowUs);
+
+/// <summary>
+/// Calibrate against a reference temperature measured now next to the device.
+/// </summary>
+/// <returns>false until the self-heating is steady, four fitted time constants after a warm-up</returns>
+bool temperatureCalibration_setReference(float referenceC, uint64_t nowUs);
+
+/// <summary>
+/// Feed a temperature reading.
+/// </summary>
+/// <param name="offsetC">receives the offset to write</param>
+/// <returns>true when a converged offset should be written, then nothing more until temperatureCalibration_written</returns>
+bool temperatureCalibration_update(float temperature, uint64_t nowUs, float* offsetC);
+
+/// <summary>
+/// The write handed out by temperatureCalibration_update finished.
+/// </summary>
+/// <param name="offsetC">offset read back from the sensor, NAN when the write failed and should be retried</param>
+void temperatureCalibration_written(float offsetC);
+
+void temperatureCalibration_getState(TEMPERATURE_CALIBRATION_STATE* state);
+
+const char* temperatureCalibration_sourceName(TEMPERATURE_OFFSET_SOURCE source);
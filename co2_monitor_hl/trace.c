@@ -0,0 +1,224 @@
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Bucket i counts spans shorter than 16us << i, the last bucket collects everything slower
+#define TRACE_HISTOGRAM_BUCKETS 24
+#define TRACE_HISTOGRAM_BASE_US 16u
+#define TRACE_STATS_CLOSE_BYTES 24	// " }, \"Dropped\": nn }" and the terminator
+#define TRACE_CHROME_EVENT_BYTES 128
+
+typedef struct
+{
+	uint64_t startUs;
+	uint32_t durationUs;
+	uint16_t span;
+} TRACE_EVENT;
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t maxUs;
+	uint32_t histogram[TRACE_HISTOGRAM_BUCKETS];
+} TRACE_SPAN_HISTOGRAM;
+
+static const char* spanNames[TRACE_SPAN_COUNT] = {
+	[TRACE_BOOT_CONFIG_PARSE] = "BootConfigParse",
+	[TRACE_BOOT_AZURE_INIT] = "BootAzureInit",
+	[TRACE_BOOT_I2C_INIT] = "BootI2cInit",
+	[TRACE_BOOT_SENSOR_PROBE] = "BootSensorProbe",
+	[TRACE_BOOT_FIRST_SAMPLE] = "BootFirstSample",
+	[TRACE_BOOT_FIRST_CONNECT] = "BootFirstConnect",
+	[TRACE_BOOT_FIRST_SEND] = "BootFirstSend",
+	[TRACE_FLASH_LEDS] = "FlashLeds",
+	[TRACE_FLASH_LED_OFF] = "FlashLedOff",
+	[TRACE_MEASURE_SENSOR] = "MeasureSensor",
+	[TRACE_PUBLISH_TELEMETRY] = "PublishTelemetry",
+	[TRACE_CO2_ALERT] = "CO2Alert",
+	[TRACE_CO2_BUZZER_OFF] = "CO2BuzzerOff",
+	[TRACE_CO2_ALERT_LATENCY] = "CO2AlertLatency",
+	[TRACE_PUBLISH_DIAGNOSTICS] = "PublishDiagnostics",
+	[TRACE_SENSOR_START] = "SensorStart",
+	[TRACE_FIRST_TELEMETRY] = "FirstTelemetry",
+	[TRACE_DEVICE_TWIN] = "DeviceTwin",
+	[TRACE_RT_FRAME_AGE] = "RtFrameAge",
+	[TRACE_SAMPLE_ENQUEUE] = "SampleEnqueue",
+	[TRACE_SEND_WAIT] = "SendWait",
+	[TRACE_SEND_CONFIRM] = "SendConfirm",
+	[TRACE_SAMPLE_TO_CLOUD] = "SampleToCloud",
+	[TRACE_I2C_READ] = "I2cRead",
+	[TRACE_I2C_WRITE] = "I2cWrite",
+	[TRACE_DUTY_CYCLE_POWER_DOWN] = "DutyCyclePowerDown",
+	[TRACE_PUBLISH_VENTILATION] = "PublishVentilation",
+	[TRACE_TEMPERATURE_OFFSET] = "TemperatureOffset",
+	[TRACE_CO2_CALIBRATION] = "CO2Calibration",
+	[TRACE_CO2_AUTO_CALIBRATION] = "CO2AutoCalibration",
+	[TRACE_SENSOR_POLL] = "SensorPoll",
+};
+
+static struct timespec traceStart;
+static TRACE_EVENT ring[TRACE_RING_EVENTS];
+static uint32_t ringNext = 0;
+static bool ringWrapped = false;
+static TRACE_SPAN_HISTOGRAM spanHistograms[TRACE_SPAN_COUNT];
+
+void trace_init(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &traceStart);
+	memset(spanHistograms, 0, sizeof(spanHistograms));
+	ringNext = 0;
+	ringWrapped = false;
+}
+
+uint64_t trace_nowUs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)(now.tv_sec - traceStart.tv_sec) * 1000000u + (uint64_t)((now.tv_nsec - traceStart.tv_nsec) / 1000);
+}
+
+static void Record(TRACE_SPAN span, uint64_t startUs, uint32_t durationUs)
+{
+	TRACE_SPAN_HISTOGRAM* h = &spanHistograms[span];
+	uint32_t bound = TRACE_HISTOGRAM_BASE_US;
+	uint8_t bucket = 0;
+
+	while (durationUs >= bound && bucket < TRACE_HISTOGRAM_BUCKETS - 1)
+	{
+		bound <<= 1;
+		bucket++;
+	}
+
+	h->count++;
+	h->histogram[bucket]++;
+	if (durationUs > h->maxUs)
+	{
+		h->maxUs = durationUs;
+	}
+
+	ring[ringNext] = (TRACE_EVENT){ .startUs = startUs, .durationUs = durationUs, .span = (uint16_t)span };
+	if (++ringNext == TRACE_RING_EVENTS)
+	{
+		ringNext = 0;
+		ringWrapped = true;
+	}
+}
+
+void trace_end(TRACE_SPAN span, uint64_t startUs)
+{
+	uint64_t now = trace_nowUs();
+	uint64_t duration = now > startUs ? now - startUs : 0;
+
+	Record(span, startUs, duration > UINT32_MAX ? UINT32_MAX : (uint32_t)duration);
+}
+
+void trace_recordDuration(TRACE_SPAN span, uint32_t durationUs)
+{
+	uint64_t now = trace_nowUs();
+
+	Record(span, now > durationUs ? now - durationUs : 0, durationUs);
+}
+
+void trace_bootMilestone(TRACE_SPAN span)
+{
+	if (spanHistograms[span].count == 0)
+	{
+		trace_end(span, 0);
+	}
+}
+
+static uint32_t Percentile(const TRACE_SPAN_HISTOGRAM* h, uint32_t percentile)
+{
+	uint64_t target = ((uint64_t)h->count * percentile + 99) / 100;
+	uint64_t seen = 0;
+
+	for (uint8_t i = 0; i < TRACE_HISTOGRAM_BUCKETS; i++)
+	{
+		seen += h->histogram[i];
+		if (seen >= target)
+		{
+			// The upper bound overstates the last bucket, max is exact
+			uint32_t bound = TRACE_HISTOGRAM_BASE_US << i;
+			return bound < h->maxUs ? bound : h->maxUs;
+		}
+	}
+	return h->maxUs;
+}
+
+void trace_getStats(TRACE_SPAN span, TRACE_SPAN_STATS* stats)
+{
+	const TRACE_SPAN_HISTOGRAM* h = &spanHistograms[span];
+
+	stats->count = h->count;
+	stats->maxUs = h->maxUs;
+	stats->p50Us = h->count ? Percentile(h, 50) : 0;
+	stats->p99Us = h->count ? Percentile(h, 99) : 0;
+}
+
+const char* trace_spanName(TRACE_SPAN span)
+{
+	return span < TRACE_SPAN_COUNT ? spanNames[span] : "Unknown";
+}
+
+bool trace_formatStats(char* buffer, size_t length)
+{
+	TRACE_SPAN_STATS stats;
+	bool first = true;
+	size_t used;
+	uint32_t dropped = 0;
+	int written = snprintf(buffer, length, "{ \"Spans\": {");
+
+	if (written < 0 || (used = (size_t)written) + TRACE_STATS_CLOSE_BYTES >= length)
+	{
+		return false;
+	}
+
+	for (int span = 0; span < TRACE_SPAN_COUNT; span++)
+	{
+		trace_getStats(span, &stats);
+		if (stats.count == 0)
+		{
+			continue;
+		}
+
+		// A span that does not fit is counted instead, the room for the close is kept
+		written = snprintf(buffer + used, length - used - TRACE_STATS_CLOSE_BYTES, "%s \"%s\": [%u, %u, %u, %u]",
+			first ? "" : ",", spanNames[span], stats.count, stats.p50Us, stats.p99Us, stats.maxUs);
+		if (written < 0 || used + (size_t)written >= length - TRACE_STATS_CLOSE_BYTES)
+		{
+			buffer[used] = '\0';
+			dropped++;
+			continue;
+		}
+		used += (size_t)written;
+		first = false;
+	}
+
+	written = dropped ? snprintf(buffer + used, length - used, " }, \"Dropped\": %u }", dropped)
+		: snprintf(buffer + used, length - used, " } }");
+	return written > 0 && used + (size_t)written < length;
+}
+
+void trace_writeChromeTrace(TRACE_WRITE write)
+{
+	uint32_t events = ringWrapped ? TRACE_RING_EVENTS : ringNext;
+	uint32_t first = ringWrapped ? ringNext : 0;
+	char event[TRACE_CHROME_EVENT_BYTES];
+
+	write("{\"traceEvents\":[");
+
+	for (uint32_t i = 0; i < events; i++)
+	{
+		const TRACE_EVENT* e = &ring[(first + i) % TRACE_RING_EVENTS];
+		bool i2c = e->span == TRACE_I2C_READ || e->span == TRACE_I2C_WRITE;
+
+		snprintf(event, sizeof(event), "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":1,\"tid\":%d}",
+			i ? "," : "", spanNames[e->span], (unsigned long long)e->startUs, e->durationUs, i2c ? 2 : 1);
+		write(event);
+	}
+
+	write("\n],\"displayTimeUnit\":\"ms\"}\n");
+}
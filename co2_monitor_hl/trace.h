@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Instrumented spans. Boot spans start at trace_init, the rest are individual executions.
+typedef enum
+{
+	TRACE_BOOT_CONFIG_PARSE,
+	TRACE_BOOT_AZURE_INIT,
+	TRACE_BOOT_I2C_INIT,
+	TRACE_BOOT_SENSOR_PROBE,
+	TRACE_BOOT_FIRST_SAMPLE,
+	TRACE_BOOT_FIRST_CONNECT,
+	TRACE_BOOT_FIRST_SEND,
+	TRACE_FLASH_LEDS,
+	TRACE_FLASH_LED_OFF,
+	TRACE_MEASURE_SENSOR,
+	TRACE_PUBLISH_TELEMETRY,
+	TRACE_CO2_ALERT,
+	TRACE_CO2_BUZZER_OFF,
+	TRACE_CO2_ALERT_LATENCY,
+	TRACE_PUBLISH_DIAGNOSTICS,
+	TRACE_SENSOR_START,
+	TRACE_FIRST_TELEMETRY,
+	TRACE_DEVICE_TWIN,
+	TRACE_RT_FRAME_AGE,
+	TRACE_SAMPLE_ENQUEUE,
+	TRACE_SEND_WAIT,
+	TRACE_SEND_CONFIRM,
+	TRACE_SAMPLE_TO_CLOUD,
+	TRACE_I2C_READ,
+	TRACE_I2C_WRITE,
+	TRACE_DUTY_CYCLE_POWER_DOWN,
+	TRACE_PUBLISH_VENTILATION,
+	TRACE_TEMPERATURE_OFFSET,
+	TRACE_CO2_CALIBRATION,
+	TRACE_CO2_AUTO_CALIBRATION,
+	TRACE_SENSOR_POLL,
+	TRACE_SPAN_COUNT
+} TRACE_SPAN;
+
+// Most recent spans kept for trace_writeChromeTrace
+#define TRACE_RING_EVENTS 256
+
+/// <summary>
+/// Takes the Chrome trace a piece at a time, each piece a NUL terminated string.
+/// </summary>
+typedef void (*TRACE_WRITE)(const char* text);
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t p50Us;
+	uint32_t p99Us;
+	uint32_t maxUs;
+} TRACE_SPAN_STATS;
+
+/// <summary>
+/// Start the trace clock. Boot spans are measured from this point.
+/// </summary>
+void trace_init(void);
+
+/// <summary>
+/// Microseconds on the monotonic clock since trace_init.
+/// </summary>
+uint64_t trace_nowUs(void);
+
+/// <summary>
+/// Close a span opened at startUs (a value returned by trace_nowUs).
+/// </summary>
+void trace_end(TRACE_SPAN span, uint64_t startUs);
+
+/// <summary>
+/// Record a span whose duration was measured elsewhere and that ended now.
+/// </summary>
+void trace_recordDuration(TRACE_SPAN span, uint32_t durationUs);
+
+/// <summary>
+/// Record a boot span from trace_init until now, only the first call per span counts.
+/// </summary>
+void trace_bootMilestone(TRACE_SPAN span);
+
+/// <summary>
+/// Count and p50/p99/max (histogram bucket upper bounds) for a span.
+/// </summary>
+void trace_getStats(TRACE_SPAN span, TRACE_SPAN_STATS* stats);
+
+const char* trace_spanName(TRACE_SPAN span);
+
+/// <summary>
+/// Format { "Spans": { "name": [count, p50, p99, max], ... } } for spans that have run.
+/// Spans that do not fit are left out and counted in a "Dropped" member after "Spans".
+/// Returns false if the buffer is too small for even an empty message.
+/// </summary>
+bool trace_formatStats(char* buffer, size_t length);
+
+/// <summary>
+/// Write the ring buffer as Chrome trace event JSON (chrome://tracing, Perfetto), one event per line.
+/// </summary>
+void trace_writeChromeTrace(TRACE_WRITE write);
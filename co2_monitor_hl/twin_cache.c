@@ -0,0 +1,205 @@
+#include "twin_cache.h"
+
+#include "persistent_store.h"
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include <string.h>
+
+typedef struct
+{
+	char name[TWIN_CACHE_NAME_BYTES];
+	int32_t type;
+	uint32_t stringOffset;
+	union
+	{
+		double d;
+		float f;
+		int32_t i;
+		bool b;
+	} value;
+} TWIN_CACHE_ENTRY;
+
+typedef struct
+{
+	int32_t version;
+	uint32_t count;
+	TWIN_CACHE_ENTRY entries[TWIN_CACHE_PROPERTIES];
+	char strings[TWIN_CACHE_STRING_BYTES];
+} TWIN_CACHE;
+
+static TWIN_CACHE cache = { .version = -1 };
+static bool dirty = false;
+
+static TWIN_CACHE_ENTRY* FindEntry(const char* property)
+{
+	for (uint32_t i = 0; i < cache.count; i++)
+	{
+		if (strncmp(cache.entries[i].name, property, TWIN_CACHE_NAME_BYTES) == 0)
+		{
+			return &cache.entries[i];
+		}
+	}
+	return NULL;
+}
+
+bool twinCache_load(void)
+{
+	if (!store_readRecord(STORE_RECORD_DESIRED_TWIN, &cache, sizeof(cache)) || cache.count > TWIN_CACHE_PROPERTIES)
+	{
+		memset(&cache, 0, sizeof(cache));
+		cache.version = -1;
+		return false;
+	}
+	return true;
+}
+
+int32_t twinCache_version(void)
+{
+	return cache.version;
+}
+
+bool twinCache_get(const char* property, DX_DEVICE_TWIN_TYPE type, void* value)
+{
+	const TWIN_CACHE_ENTRY* entry = FindEntry(property);
+
+	if (entry == NULL || entry->type != (int32_t)type)
+	{
+		return false;
+	}
+
+	switch (type)
+	{
+	case DX_TYPE_FLOAT: *(float*)value = entry->value.f; break;
+	case DX_TYPE_DOUBLE: *(double*)value = entry->value.d; break;
+	case DX_TYPE_INT: *(int*)value = entry->value.i; break;
+	case DX_TYPE_BOOL: *(bool*)value = entry->value.b; break;
+	case DX_TYPE_STRING: *(const char**)value = &cache.strings[entry->stringOffset]; break;
+	default: return false;
+	}
+	return true;
+}
+
+bool twinCache_matches(const DX_DEVICE_TWIN_BINDING* binding)
+{
+	const TWIN_CACHE_ENTRY* entry = FindEntry(binding->twinProperty);
+
+	if (entry == NULL || entry->type != (int32_t)binding->twinType || binding->twinState == NULL)
+	{
+		return false;
+	}
+
+	switch (binding->twinType)
+	{
+	case DX_TYPE_FLOAT: return entry->value.f == *(float*)binding->twinState;
+	case DX_TYPE_DOUBLE: return entry->value.d == *(double*)binding->twinState;
+	case DX_TYPE_INT: return entry->value.i == *(int*)binding->twinState;
+	case DX_TYPE_BOOL: return entry->value.b == *(bool*)binding->twinState;
+	case DX_TYPE_STRING: return strcmp(&cache.strings[entry->stringOffset], (const char*)binding->twinState) == 0;
+	default: return false;
+	}
+}
+
+// Replace one string in the shared string area, repacking the others around it
+static bool StoreString(TWIN_CACHE_ENTRY* target, const char* text)
+{
+	char packed[TWIN_CACHE_STRING_BYTES];
+	uint16_t offsets[TWIN_CACHE_PROPERTIES];
+	size_t used = 0;
+
+	for (uint32_t i = 0; i < cache.count; i++)
+	{
+		const TWIN_CACHE_ENTRY* entry = &cache.entries[i];
+		const char* source = entry == target ? text : &cache.strings[entry->stringOffset];
+		size_t length;
+
+		if (entry->type != DX_TYPE_STRING)
+		{
+			continue;
+		}
+
+		length = strlen(source) + 1;
+		if (used + length > sizeof(packed))
+		{
+			return false;
+		}
+
+		memcpy(&packed[used], source, length);
+		offsets[i] = (uint16_t)used;
+		used += length;
+	}
+
+	for (uint32_t i = 0; i < cache.count; i++)
+	{
+		if (cache.entries[i].type == DX_TYPE_STRING)
+		{
+			cache.entries[i].stringOffset = offsets[i];
+		}
+	}
+	memcpy(cache.strings, packed, used);
+	return true;
+}
+
+void twinCache_store(const DX_DEVICE_TWIN_BINDING* binding)
+{
+	TWIN_CACHE_ENTRY* entry;
+
+	if (binding->twinState == NULL)
+	{
+		return;
+	}
+	if (strlen(binding->twinProperty) >= TWIN_CACHE_NAME_BYTES)
+	{
+		Log_Debug("Twin cache: %s not cached, name longer than %d bytes\n", binding->twinProperty, TWIN_CACHE_NAME_BYTES - 1);
+		return;
+	}
+
+	if (twinCache_matches(binding) && cache.version == binding->twinVersion)
+	{
+		return;
+	}
+
+	if ((entry = FindEntry(binding->twinProperty)) == NULL)
+	{
+		if (cache.count == TWIN_CACHE_PROPERTIES)
+		{
+			Log_Debug("Twin cache: %s not cached, all %d entries in use\n", binding->twinProperty, TWIN_CACHE_PROPERTIES);
+			return;
+		}
+		entry = &cache.entries[cache.count++];
+		memset(entry, 0, sizeof(*entry));
+		strncpy(entry->name, binding->twinProperty, TWIN_CACHE_NAME_BYTES - 1);
+	}
+	entry->type = binding->twinType;
+
+	switch (binding->twinType)
+	{
+	case DX_TYPE_FLOAT: entry->value.f = *(float*)binding->twinState; break;
+	case DX_TYPE_DOUBLE: entry->value.d = *(double*)binding->twinState; break;
+	case DX_TYPE_INT: entry->value.i = *(int*)binding->twinState; break;
+	case DX_TYPE_BOOL: entry->value.b = *(bool*)binding->twinState; break;
+	case DX_TYPE_STRING:
+		if (!StoreString(entry, (const char*)binding->twinState))
+		{
+			// Too long to cache, drop it rather than keep a stale value
+			Log_Debug("Twin cache: %s not cached, strings exceed %d bytes\n", binding->twinProperty, TWIN_CACHE_STRING_BYTES);
+			*entry = cache.entries[--cache.count];
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (binding->twinVersion > cache.version)
+	{
+		cache.version = binding->twinVersion;
+	}
+	dirty = true;
+}
+
+void twinCache_flush(void)
+{
+	if (dirty && store_writeRecord(STORE_RECORD_DESIRED_TWIN, &cache, sizeof(cache)))
+	{
+		dirty = false;
+	}
+}
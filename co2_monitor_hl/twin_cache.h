@@ -0,0 +1,47 @@
+#pragma once
+
+#include "dx_device_twins.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Desired properties last received from the cloud, kept in mutable storage so they can be used
+// from boot, before the device connects and receives its twin. main.c checks the capability model's writable
+// properties fit, with room for a few more before the store record has to grow.
+#define TWIN_CACHE_PROPERTIES 16
+#define TWIN_CACHE_NAME_BYTES 32
+#define TWIN_CACHE_STRING_BYTES 512		// shared by all string properties
+
+/// <summary>
+/// Load the cache from mutable storage, synchronously. Call once at startup.
+/// </summary>
+/// <returns>true when a valid cache was found</returns>
+bool twinCache_load(void);
+
+/// <summary>
+/// Desired twin $version the cache was last reconciled with, -1 when empty.
+/// </summary>
+int32_t twinCache_version(void);
+
+/// <summary>
+/// Cached value of a desired property. value points to a float, double, int or bool matching type,
+/// for DX_TYPE_STRING it receives a const char* into the cache.
+/// </summary>
+/// <returns>false when the property is not cached with that type</returns>
+bool twinCache_get(const char* property, DX_DEVICE_TWIN_TYPE type, void* value);
+
+/// <summary>
+/// True when the cache already holds the binding's current desired value, so the property was applied
+/// at boot and a twin received on connect carries no delta for it.
+/// </summary>
+bool twinCache_matches(const DX_DEVICE_TWIN_BINDING* binding);
+
+/// <summary>
+/// Record a desired value the app has accepted, with the binding's twin version. Storage is written
+/// by twinCache_flush, so a storm of desired updates costs one write per flush.
+/// </summary>
+void twinCache_store(const DX_DEVICE_TWIN_BINDING* binding);
+
+/// <summary>
+/// Write the cache to mutable storage if twinCache_store changed it since the last flush.
+/// </summary>
+void twinCache_flush(void);
@@ -0,0 +1,190 @@
+#include "ventilation.h"
+
+#include <math.h>
+#include <string.h>
+
+#define US_PER_HOUR 3.6e9
+#define SHORT_LAG_SECONDS 120	// a decay must still be falling over this lag, the long trend trails a turn
+
+static VENTILATION_CONFIG ventilationConfig = {
+	.roomVolumeM3 = 50.0f,
+	.outdoorPpm = 420.0f,
+	.personM3PerHour = 0.019f,
+	.decayPpmPerHour = 60.0f,
+	.minExcessPpm = 80.0f,
+	.minDecaySeconds = 1200,
+	.minDecayR2 = 0.9f,
+	.generationSeconds = 900
+};
+
+// Incremental least squares of y on x from running sums
+typedef struct
+{
+	double n, sx, sy, sxx, sxy, syy;
+} LINEAR_FIT;
+
+static struct
+{
+	uint64_t us;
+	float co2;
+} history[VENTILATION_HISTORY];
+static int historyCount = 0;
+static int historyNext = 0;
+
+static bool inDecay = false;
+static LINEAR_FIT decayFit;
+static uint64_t decayStartUs, decayLastUs;
+static uint64_t lastUs = 0;
+static VENTILATION_ESTIMATE estimate = { .airChangesPerHour = NAN, .generationPpmPerHour = NAN, .occupancy = NAN };
+
+void ventilation_configure(const VENTILATION_CONFIG* config)
+{
+	ventilationConfig = *config;
+	historyCount = 0;
+	historyNext = 0;
+	inDecay = false;
+	lastUs = 0;
+	estimate = (VENTILATION_ESTIMATE){ .airChangesPerHour = NAN, .generationPpmPerHour = NAN, .occupancy = NAN };
+}
+
+const VENTILATION_CONFIG* ventilation_getConfig(void)
+{
+	return &ventilationConfig;
+}
+
+void ventilation_setRoomVolume(float roomVolumeM3)
+{
+	ventilationConfig.roomVolumeM3 = roomVolumeM3;
+}
+
+static void FitAdd(LINEAR_FIT* fit, double x, double y)
+{
+	fit->n += 1;
+	fit->sx += x;
+	fit->sy += y;
+	fit->sxx += x * x;
+	fit->sxy += x * y;
+	fit->syy += y * y;
+}
+
+static bool FitSlope(const LINEAR_FIT* fit, double* slope, double* r2)
+{
+	double covariance = fit->n * fit->sxy - fit->sx * fit->sy;
+	double varianceX = fit->n * fit->sxx - fit->sx * fit->sx;
+	double varianceY = fit->n * fit->syy - fit->sy * fit->sy;
+
+	if (fit->n < 3 || varianceX <= 0 || varianceY <= 0)
+	{
+		return false;
+	}
+
+	*slope = covariance / varianceX;
+	*r2 = covariance * covariance / (varianceX * varianceY);
+	return true;
+}
+
+/// <summary>
+/// CO2 trend in ppm per hour against the newest history point at least lagSeconds old
+/// </summary>
+static bool Trend(float co2, uint64_t nowUs, uint32_t lagSeconds, float* trend, float* lagCo2)
+{
+	uint64_t bestUs = 0;
+
+	for (int i = 0; i < historyCount; i++)
+	{
+		if (nowUs - history[i].us >= (uint64_t)lagSeconds * 1000000u && history[i].us > bestUs)
+		{
+			bestUs = history[i].us;
+			*lagCo2 = history[i].co2;
+		}
+	}
+
+	if (bestUs == 0)
+	{
+		return false;
+	}
+	*trend = (float)((co2 - *lagCo2) * US_PER_HOUR / (double)(nowUs - bestUs));
+	return true;
+}
+
+static void FinishDecay(void)
+{
+	double slope, r2;
+
+	inDecay = false;
+	if (decayLastUs - decayStartUs < (uint64_t)ventilationConfig.minDecaySeconds * 1000000u)
+	{
+		return;		// noise dipping the trend under the threshold, not worth counting
+	}
+
+	if (!FitSlope(&decayFit, &slope, &r2) || r2 < ventilationConfig.minDecayR2 || slope >= 0)
+	{
+		estimate.decaysRejected++;
+		return;
+	}
+
+	// Later decays refine rather than replace, one door left open should not swing the estimate
+	estimate.airChangesPerHour = isnan(estimate.airChangesPerHour) ? (float)-slope :
+		0.7f * estimate.airChangesPerHour + 0.3f * (float)-slope;
+	estimate.decaysFitted++;
+}
+
+void ventilation_update(float co2, uint64_t nowUs)
+{
+	float excess = co2 - ventilationConfig.outdoorPpm;
+	float trend, shortTrend, lagCo2, shortLagCo2, generation, weight;
+	bool trendKnown;
+
+	if (isnan(co2))
+	{
+		return;
+	}
+
+	trendKnown = Trend(co2, nowUs, VENTILATION_TREND_LAG_SECONDS, &trend, &lagCo2);
+
+	if (trendKnown && trend < -ventilationConfig.decayPpmPerHour && excess > ventilationConfig.minExcessPpm &&
+		Trend(co2, nowUs, SHORT_LAG_SECONDS, &shortTrend, &shortLagCo2) && shortTrend < 0)
+	{
+		if (!inDecay)
+		{
+			inDecay = true;
+			memset(&decayFit, 0, sizeof(decayFit));
+			decayStartUs = nowUs;
+		}
+		FitAdd(&decayFit, (double)(nowUs - decayStartUs) / US_PER_HOUR, log(excess));
+		decayLastUs = nowUs;
+	}
+	else if (inDecay)
+	{
+		FinishDecay();
+	}
+
+	// Mass balance over the lag, the midpoint excess matches the difference quotient
+	if (trendKnown && !isnan(estimate.airChangesPerHour))
+	{
+		generation = trend + estimate.airChangesPerHour * ((co2 + lagCo2) / 2 - ventilationConfig.outdoorPpm);
+		weight = fminf(1.0f, (float)(nowUs - lastUs) / 1e6f / ventilationConfig.generationSeconds);
+		estimate.generationPpmPerHour = isnan(estimate.generationPpmPerHour) ? generation :
+			estimate.generationPpmPerHour + weight * (generation - estimate.generationPpmPerHour);
+		estimate.occupancy = fmaxf(0.0f, estimate.generationPpmPerHour) * ventilationConfig.roomVolumeM3 /
+			(1e6f * ventilationConfig.personM3PerHour);
+	}
+	lastUs = nowUs;
+
+	if (historyCount == 0 || nowUs - history[(historyNext + VENTILATION_HISTORY - 1) % VENTILATION_HISTORY].us >=
+		VENTILATION_HISTORY_SECONDS * 1000000ull)
+	{
+		history[historyNext].us = nowUs;
+		history[historyNext].co2 = co2;
+		historyNext = (historyNext + 1) % VENTILATION_HISTORY;
+		if (historyCount < VENTILATION_HISTORY)
+		{
+			historyCount++;
+		}
+	}
+}
+
+void ventilation_getEstimate(VENTILATION_ESTIMATE* out)
+{
+	*out = estimate;
+}
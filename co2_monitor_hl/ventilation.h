@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Air changes and occupancy from the CO2 mass balance dC/dt = G - ACH * (C - outdoor).
+// ACH is fitted on decay segments, where the room is assumed empty, by least squares of ln(C - outdoor)
+// against time. With ACH known each sample gives G = dC/dt + ACH * (C - outdoor), averaged with exponential
+// forgetting, and occupancy is G over one person's CO2 output. Running sums only, constant memory.
+#define VENTILATION_TREND_LAG_SECONDS 600		// dC/dt over this lag, sensor noise is too large sample to sample
+#define VENTILATION_HISTORY 24					// lag points, at least VENTILATION_TREND_LAG_SECONDS / VENTILATION_HISTORY_SECONDS
+#define VENTILATION_HISTORY_SECONDS 30
+#define VENTILATION_PUBLISH_PERIOD_MS (15 * 60 * 1000)
+
+typedef struct
+{
+	float roomVolumeM3;
+	float outdoorPpm;
+	float personM3PerHour;		// CO2 exhaled by one sedentary adult
+	float decayPpmPerHour;		// falling faster than this is a decay segment
+	float minExcessPpm;			// decay samples closer to outdoor than this are too noisy to fit
+	uint16_t minDecaySeconds;	// shorter decays are not fitted
+	float minDecayR2;			// nor are decays that are not exponential
+	uint16_t generationSeconds;	// time constant of the generation average
+} VENTILATION_CONFIG;
+
+typedef struct
+{
+	float airChangesPerHour;	// NAN until a decay has been fitted
+	float generationPpmPerHour;	// NAN until air changes are known
+	float occupancy;
+	uint32_t decaysFitted;
+	uint32_t decaysRejected;	// long enough but not exponential
+} VENTILATION_ESTIMATE;
+
+void ventilation_configure(const VENTILATION_CONFIG* config);
+
+const VENTILATION_CONFIG* ventilation_getConfig(void);
+
+/// <summary>
+/// Room volume changes occupancy, not the fit, so it can be set without losing the estimate.
+/// </summary>
+void ventilation_setRoomVolume(float roomVolumeM3);
+
+/// <summary>
+/// Feed a filtered CO2 sample taken at nowUs.
+/// </summary>
+void ventilation_update(float co2, uint64_t nowUs);
+
+void ventilation_getEstimate(VENTILATION_ESTIMATE* estimate);
@@ -0,0 +1,123 @@
+/*
+ * Host simulation of a day of readings at the rate adaptive_sampling.c picks, against a fixed 20 s interval. The
+ * room sits at a 450 ppm baseline with +/-10 ppm of sensor noise until a meeting starts at 14:00: CO2 ramps at
+ * 40 ppm/min to 1200 ppm, holds for 30 minutes and decays back with a 40 minute time constant once the room
+ * empties. The app reads once per interval and feeds every reading to adaptiveSampling_update, as
+ * MeasureSensorHandler does.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl adaptive_day_sim.c ../../co2_monitor_hl/adaptive_sampling.c -o adaptive_day_sim -lm
+ *   ./adaptive_day_sim [alert level]
+ *
+ * Reports readings per day and overnight, level changes, and how long after CO2 truly crossed the alert level a
+ * reading first showed it.
+ */
+
+#include "adaptive_sampling.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DAY_SECONDS 86400
+#define FIXED_INTERVAL_SECONDS 20
+#define BASELINE_PPM 450.0
+#define NOISE_PPM 10.0
+#define MEETING_START_SECONDS (14 * 3600)
+#define RAMP_PPM_PER_SECOND (40.0 / 60.0)
+#define PEAK_PPM 1200.0
+#define HOLD_SECONDS 1800
+#define DECAY_SECONDS 2400.0
+#define NIGHT_END_SECONDS (8 * 3600)
+
+static uint32_t seed = 1;
+
+// Deterministic uniform in [-1, 1), the same sequence for every run
+static double Noise(void)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) / (double)(1u << 23) - 1.0;
+}
+
+// True CO2 at second t of the day
+static double Room(double t)
+{
+	double rampSeconds = (PEAK_PPM - BASELINE_PPM) / RAMP_PPM_PER_SECOND;
+
+	if (t < MEETING_START_SECONDS)
+	{
+		return BASELINE_PPM;
+	}
+	if (t < MEETING_START_SECONDS + rampSeconds)
+	{
+		return BASELINE_PPM + (t - MEETING_START_SECONDS) * RAMP_PPM_PER_SECOND;
+	}
+	if (t < MEETING_START_SECONDS + rampSeconds + HOLD_SECONDS)
+	{
+		return PEAK_PPM;
+	}
+	return BASELINE_PPM + (PEAK_PPM - BASELINE_PPM) * exp(-(t - MEETING_START_SECONDS - rampSeconds - HOLD_SECONDS) / DECAY_SECONDS);
+}
+
+typedef struct
+{
+	uint32_t readings;
+	uint32_t nightReadings;
+	uint32_t retunes;
+	double alertLatencySeconds;			// first reading at or above the level after the true crossing
+} DAY;
+
+static void Run(bool adaptive, double alertLevel, uint32_t phaseSeconds, DAY* day)
+{
+	double crossingSeconds = MEETING_START_SECONDS + (alertLevel - BASELINE_PPM) / RAMP_PPM_PER_SECOND;
+	uint16_t interval = FIXED_INTERVAL_SECONDS;
+	ADAPTIVE_SAMPLING_STATE state;
+
+	*day = (DAY){ .alertLatencySeconds = NAN };
+	seed = 1;
+	adaptiveSampling_init(FIXED_INTERVAL_SECONDS);
+	for (uint32_t t = phaseSeconds; t < DAY_SECONDS; t += interval)
+	{
+		double co2 = Room(t) + NOISE_PPM * Noise();
+
+		day->readings++;
+		day->nightReadings += t < NIGHT_END_SECONDS;
+		if (isnan(day->alertLatencySeconds) && t >= crossingSeconds && co2 >= alertLevel)
+		{
+			day->alertLatencySeconds = t - crossingSeconds;
+		}
+		if (adaptive)
+		{
+			interval = adaptiveSampling_update((float)co2, (float)alertLevel, t);
+		}
+	}
+	adaptiveSampling_getState(&state);
+	day->retunes = adaptive ? state.retunes : 0;
+}
+
+int main(int argc, char* argv[])
+{
+	double alertLevel = argc > 1 ? atof(argv[1]) : 1000;
+	double fixedWorstSeconds = 0, adaptiveWorstSeconds = 0;
+	DAY adaptive, fixed;
+
+	// The latency depends on where the crossing falls between readings, try every phase of the fixed interval
+	for (uint32_t phase = 0; phase < FIXED_INTERVAL_SECONDS; phase++)
+	{
+		Run(false, alertLevel, phase, &fixed);
+		Run(true, alertLevel, phase, &adaptive);
+		fixedWorstSeconds = fmax(fixedWorstSeconds, fixed.alertLatencySeconds);
+		adaptiveWorstSeconds = fmax(adaptiveWorstSeconds, adaptive.alertLatencySeconds);
+	}
+	Run(false, alertLevel, 0, &fixed);
+	Run(true, alertLevel, 0, &adaptive);
+
+	printf("24 h, %.0f ppm baseline +/-%.0f ppm, meeting at 14:00 ramping %.0f ppm/min to %.0f ppm, alert at %.0f ppm\n",
+		BASELINE_PPM, NOISE_PPM, RAMP_PPM_PER_SECOND * 60, PEAK_PPM, alertLevel);
+	printf("%-10s %5u readings/day, %4u from 00:00 to 08:00, %2u level changes, alert reading %4.1f s after the "
+		"crossing (worst over phases %4.1f s)\n", "adaptive", adaptive.readings, adaptive.nightReadings,
+		adaptive.retunes, adaptive.alertLatencySeconds, adaptiveWorstSeconds);
+	printf("%-10s %5u readings/day, %4u from 00:00 to 08:00, %2u level changes, alert reading %4.1f s after the "
+		"crossing (worst over phases %4.1f s)\n", "fixed 20 s", fixed.readings, fixed.nightReadings, fixed.retunes,
+		fixed.alertLatencySeconds, fixedWorstSeconds);
+	return 0;
+}
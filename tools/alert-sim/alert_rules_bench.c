@@ -0,0 +1,93 @@
+/*
+ * Host benchmark of the app's alert_rules.c: a full 16-rule table, compiled from twin text as
+ * DesiredAlertRules delivers it, evaluated against a synthetic sample stream that walks every metric across its
+ * thresholds so rules fire and clear. Each sample is evaluated as ProcessSample does, into a caller-supplied
+ * event array.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl alert_rules_bench.c ../../co2_monitor_hl/alert_rules.c -o alert_rules_bench -lm
+ *   ./alert_rules_bench [samples]
+ *
+ * Reports the time per evaluated sample and the events raised. A table that no longer compiles fails the run.
+ */
+
+#include "alert_rules.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_US 2000000u
+#define TIMING_ROUNDS 5
+
+static const char ruleText[] =
+	"co2 > 1500 for 60 buzzer:3; co2 > 1200 for 120 led; co2 > 1000 telemetry; co2 < 350 report; "
+	"temperature > 28 for 300 led; temperature > 30 buzzer:2; temperature < 16 for 600 telemetry; temperature < 12 report; "
+	"humidity > 70 for 300 telemetry; humidity > 80 buzzer:1; humidity < 25 report; humidity < 20 for 60 led; "
+	"co2slope > 50 telemetry; co2slope > 100 buzzer:5; co2slope < -50 report; co2slope < -100 for 30 led";
+
+static uint32_t seed = 1;
+
+// Deterministic uniform in [0, 1), the same sequence for every run
+static double Uniform(void)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) / (double)(1u << 24);
+}
+
+static double NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t samples = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+	float (*metrics)[RULE_METRIC_COUNT] = malloc(samples * sizeof(*metrics));
+	ALERT_RULE_EVENT events[ALERT_RULES_MAX];
+	double bestNs = INFINITY;
+	size_t raised = 0;
+
+	if (metrics == NULL || !alertRules_compile(ruleText) || alertRules_count() != ALERT_RULES_MAX)
+	{
+		printf("rule table did not compile to %d rules\n", ALERT_RULES_MAX);
+		return 1;
+	}
+
+	// Slow sweeps across each metric's thresholds with sensor noise, a reading in 500 unreadable
+	for (size_t i = 0; i < samples; i++)
+	{
+		double phase = (double)i / 1800.0;
+
+		metrics[i][RULE_METRIC_CO2] = (float)(900 + 700 * sin(phase) + 10 * Uniform());
+		metrics[i][RULE_METRIC_TEMPERATURE] = (float)(22 + 10 * sin(phase * 0.7) + 0.2 * Uniform());
+		metrics[i][RULE_METRIC_HUMIDITY] = (float)(50 + 32 * sin(phase * 1.3) + 0.5 * Uniform());
+		metrics[i][RULE_METRIC_CO2_SLOPE] = (float)(120 * cos(phase * 3) + 5 * Uniform());
+		if (Uniform() < 0.002)
+		{
+			metrics[i][RULE_METRIC_CO2] = NAN;
+		}
+	}
+
+	for (int round = 0; round < TIMING_ROUNDS; round++)
+	{
+		double startNs;
+
+		alertRules_compile(ruleText);
+		raised = 0;
+		startNs = NowNs();
+		for (size_t i = 0; i < samples; i++)
+		{
+			raised += alertRules_evaluate(metrics[i], (uint64_t)i * SAMPLE_US, events, ALERT_RULES_MAX);
+		}
+		bestNs = fmin(bestNs, (NowNs() - startNs) / (double)samples);
+	}
+
+	printf("%zu samples against %zu rules: %.1f ns per sample (best of %d), %zu events, active mask 0x%04x\n",
+		samples, alertRules_count(), bestNs, TIMING_ROUNDS, raised, alertRules_activeMask());
+	free(metrics);
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * Host simulation of the CO2 alert: the app's co2_alert.c, sampled at the rate adaptive_sampling.c picks, against
+ * the previous design, which polled the latest 20 s sample every 4 s and chirped on every poll above the level.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl co2_alert_sim.c ../../co2_monitor_hl/co2_alert.c \
+ *       ../../co2_monitor_hl/adaptive_sampling.c -o co2_alert_sim -lm
+ *   ./co2_alert_sim [alert level]
+ *
+ * Scenarios:
+ *   crossing  CO2 rises through the level at 30 ppm/min, 1000 random sampling phases, time from crossing to buzzer
+ *   hovering  10 minutes at the level with +/-30 ppm of noise, chirps and raise/clear cycles per hysteresis
+ *   unread    the sensor stops returning readings while the alert is raised, time until the buzzer stops
+ */
+
+#include "adaptive_sampling.h"
+#include "co2_alert.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TRIALS 1000
+#define RISE_PPM_PER_SECOND 0.5
+#define OLD_SAMPLE_SECONDS 20
+#define OLD_POLL_SECONDS 4
+#define HOVER_SECONDS 600
+#define HOVER_NOISE_PPM 30.0
+#define UNREAD_SECONDS 600
+
+static float alertLevel = 1000.0f;
+
+// Deterministic uniform in [0, 1)
+static double Uniform(uint32_t* seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return (*seed >> 8) / (double)(1u << 24);
+}
+
+static uint64_t Us(double seconds)
+{
+	return (uint64_t)(seconds * 1e6);
+}
+
+// co2_alert keeps its state in statics, a reading far below the level after the hold clears it
+static void ResetAlert(double* clock)
+{
+	*clock += 3600;
+	co2Alert_evaluate(0.0f, alertLevel, Us(*clock));
+}
+
+static void Crossing(void)
+{
+	uint32_t seed = 1;
+	double clock = 0, oldSum = 0, oldMax = 0, newSum = 0, newMax = 0;
+
+	for (int trial = 0; trial < TRIALS; trial++)
+	{
+		double phase = Uniform(&seed), start = -600.0, latency;
+		double crossing = 0.0;		// CO2 reaches the level at t = 0, starting 300 ppm below
+
+		// Previous design: samples every 20 s, a poll every 4 s sees the latest one
+		double sample = start + phase * OLD_SAMPLE_SECONDS, poll = start + Uniform(&seed) * OLD_POLL_SECONDS;
+		while (sample <= crossing)
+		{
+			sample += OLD_SAMPLE_SECONDS;
+		}
+		while (poll < sample)
+		{
+			poll += OLD_POLL_SECONDS;
+		}
+		latency = poll - crossing;
+		oldSum += latency;
+		oldMax = latency > oldMax ? latency : oldMax;
+
+		// Now: every sample evaluated at the adaptive rate
+		adaptiveSampling_init(OLD_SAMPLE_SECONDS);
+		ResetAlert(&clock);
+		for (double t = start + phase * OLD_SAMPLE_SECONDS; ; )
+		{
+			float co2 = (float)(alertLevel + RISE_PPM_PER_SECOND * t);
+			uint16_t interval = adaptiveSampling_update(co2, alertLevel, (uint32_t)(clock + t + 600));
+
+			if (co2Alert_evaluate(co2, alertLevel, Us(clock + t + 600)) == CO2_ALERT_RAISED)
+			{
+				latency = t - crossing;
+				break;
+			}
+			t += interval;
+		}
+		newSum += latency;
+		newMax = latency > newMax ? latency : newMax;
+	}
+
+	printf("crossing to buzzer over %d phases: previous mean %.1f s, max %.1f s; now mean %.1f s, max %.1f s\n",
+		TRIALS, oldSum / TRIALS, oldMax, newSum / TRIALS, newMax);
+}
+
+static void Hovering(float hysteresisPpm)
+{
+	CO2_ALERT_CONFIG config = *co2Alert_getConfig();
+	uint32_t seed = 7, oldChirps = 0, oldBursts = 0, changes = 0, chirps = 0;
+	double clock = 0, nextChirp = 0;
+	float latest = 0.0f;
+	bool oldAbove = false;
+
+	config.hysteresisPpm = hysteresisPpm;
+	co2Alert_configure(&config);
+	ResetAlert(&clock);
+
+	for (int t = 0; t < HOVER_SECONDS; t++)
+	{
+		float co2 = (float)(alertLevel + HOVER_NOISE_PPM * (2.0 * Uniform(&seed) - 1.0));
+
+		if (t % OLD_SAMPLE_SECONDS == 0)
+		{
+			latest = co2;
+		}
+		if (t % OLD_POLL_SECONDS == 0)
+		{
+			oldChirps += latest > alertLevel;
+			oldBursts += latest > alertLevel && !oldAbove;
+			oldAbove = latest > alertLevel;
+		}
+
+		// 2 s samples near the level
+		if (t % 2 == 0)
+		{
+			switch (co2Alert_evaluate(co2, alertLevel, Us(clock + t)))
+			{
+			case CO2_ALERT_RAISED:
+				changes++;
+				nextChirp = t;
+				break;
+			case CO2_ALERT_CLEARED:
+				changes++;
+				break;
+			default:
+				break;
+			}
+		}
+		if (co2Alert_isActive() && t >= nextChirp)
+		{
+			chirps++;
+			nextChirp = config.buzzerCadenceMs ? t + config.buzzerCadenceMs / 1000.0 : 1e30;
+		}
+	}
+
+	printf("hovering %d s, hysteresis %3.0f ppm: previous %u chirps in %u bursts; now %u chirps, %u state changes\n",
+		HOVER_SECONDS, hysteresisPpm, oldChirps, oldBursts, chirps, changes);
+}
+
+static void Unread(void)
+{
+	CO2_ALERT_CONFIG config = *co2Alert_getConfig();
+	double clock = 0;
+	int t;
+
+	ResetAlert(&clock);
+	co2Alert_evaluate(alertLevel + 200.0f, alertLevel, Us(clock));
+	for (t = 2; t < UNREAD_SECONDS && co2Alert_isActive(); t += 2)
+	{
+		co2Alert_evaluate(NAN, alertLevel, Us(clock + t));
+	}
+
+	printf("readings lost while raised: previous design kept sounding on the last sample; now cleared after %d s (%u unread samples at 2 s)\n",
+		t - 2, config.maxInvalidReadings);
+}
+
+int main(int argc, char* argv[])
+{
+	static const float hystereses[] = { 0.0f, 25.0f, 50.0f, 100.0f };
+
+	if (argc > 1)
+	{
+		alertLevel = (float)atof(argv[1]);
+	}
+
+	printf("alert level %.0f ppm\n", alertLevel);
+	Crossing();
+	for (size_t i = 0; i < sizeof(hystereses) / sizeof(hystereses[0]); i++)
+	{
+		Hovering(hystereses[i]);
+	}
+	Unread();
+	return 0;
+}
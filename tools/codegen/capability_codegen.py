@@ -0,0 +1,297 @@
+"""Generate capability_model.c/.h for co2_monitor_hl from the IoT Central capability model.
+
+    python capability_codegen.py <capability model json> <output directory>
+
+Telemetry becomes a fixed-layout struct with a field offset table and an encoder that writes the
+JSON message with constant key fragments and integer digit loops, without printf or name lookups.
+Telemetry with a "message: <name>" comment is sent in a message of its own, with its own struct
+and encoder, so low-rate values do not ride along with every sample as nulls.
+Properties become DX_DEVICE_TWIN_BINDING initializers, writable ones take their handler.
+Commands become DX_DIRECT_METHOD_BINDING initializers taking their handler.
+The CMake build reruns this whenever the model changes, so the app cannot drift from the model.
+"""
+
+import json
+import os
+import re
+import sys
+
+# schema: (C type, CAPABILITY_SCHEMA, DevX twin type, encoded characters at most, decimals)
+SCHEMAS = {
+    "float": ("float", "CAPABILITY_SCHEMA_FLOAT", "DX_TYPE_FLOAT", 20, 2),
+    "double": ("double", "CAPABILITY_SCHEMA_DOUBLE", "DX_TYPE_DOUBLE", 22, 4),
+    "integer": ("int32_t", "CAPABILITY_SCHEMA_INTEGER", "DX_TYPE_INT", 11, 0),
+    "long": ("int64_t", "CAPABILITY_SCHEMA_LONG", None, 20, 0),
+    "boolean": ("bool", "CAPABILITY_SCHEMA_BOOLEAN", "DX_TYPE_BOOL", 5, 0),
+    "string": ("const char*", "CAPABILITY_SCHEMA_STRING", "DX_TYPE_STRING", None, 0),
+}
+
+ENCODERS = {
+    "float": ("PutFixed", "PutFixed(p, {value}, {decimals})"),
+    "double": ("PutFixed", "PutFixed(p, {value}, {decimals})"),
+    "integer": ("PutInteger", "PutInteger(p, {value})"),
+    "long": ("PutInteger", "PutInteger(p, {value})"),
+    "boolean": ("PutBoolean", "PutBoolean(p, {value})"),
+}
+
+# Encoder helpers, only those the telemetry needs are emitted
+HELPERS = {
+    "PutUnsigned": r"""
+static char* PutUnsigned(char* p, uint64_t value)
+{
+	char digits[20];
+	int count = 0;
+
+	do
+	{
+		digits[count++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value);
+
+	while (count)
+	{
+		*p++ = digits[--count];
+	}
+	return p;
+}
+""",
+    "PutInteger": r"""
+static char* PutInteger(char* p, int64_t value)
+{
+	if (value < 0)
+	{
+		*p++ = '-';
+		return PutUnsigned(p, 0 - (uint64_t)value);
+	}
+	return PutUnsigned(p, (uint64_t)value);
+}
+""",
+    "PutNull": r"""
+static char* PutNull(char* p)
+{
+	memcpy(p, "null", 4);
+	return p + 4;
+}
+""",
+    "PutBoolean": r"""
+static char* PutBoolean(char* p, bool value)
+{
+	if (value)
+	{
+		memcpy(p, "true", 4);
+		return p + 4;
+	}
+	memcpy(p, "false", 5);
+	return p + 5;
+}
+""",
+    "PutFixed": r"""
+// Rounded to a fixed number of decimals. JSON has no NaN, unread values go out as null.
+static char* PutFixed(char* p, double value, int decimals)
+{
+	static const uint64_t scales[] = { 1, 10, 100, 1000, 10000 };
+	uint64_t scaled, fraction;
+
+	if (isnan(value) || fabs(value) >= CAPABILITY_FIXED_LIMIT)
+	{
+		return PutNull(p);
+	}
+
+	scaled = (uint64_t)(fabs(value) * (double)scales[decimals] + 0.5);
+	if (value < 0 && scaled != 0)
+	{
+		*p++ = '-';
+	}
+	p = PutUnsigned(p, scaled / scales[decimals]);
+
+	*p++ = '.';
+	fraction = scaled % scales[decimals];
+	for (int i = decimals - 1; i >= 0; i--)
+	{
+		p[i] = (char)('0' + fraction % 10);
+		fraction /= 10;
+	}
+	return p + decimals;
+}
+""",
+}
+
+HELPER_DEPENDENCIES = {
+    "PutInteger": ["PutUnsigned"],
+    "PutFixed": ["PutUnsigned", "PutNull"],
+}
+
+
+def words(name):
+    return re.findall(r"[A-Z]+[0-9]*(?=[A-Z][a-z]|$)|[A-Z]?[a-z]+[0-9]*|[A-Z]+[0-9]*|[0-9]+", name)
+
+
+def camel_case(name):
+    parts = words(name)
+    return parts[0].lower() + "".join(parts[1:])
+
+
+def macro_case(name):
+    return "_".join(part.upper() for part in words(name))
+
+
+def has_type(content, kind):
+    types = content["@type"]
+    return kind in (types if isinstance(types, list) else [types])
+
+
+def load_contents(model_path):
+    with open(model_path) as model_file:
+        model = json.load(model_file)
+
+    interfaces = []
+
+    def collect(node):
+        if isinstance(node, dict):
+            if node.get("@type") == "Interface":
+                interfaces.append(node)
+            for value in node.values():
+                collect(value)
+        elif isinstance(node, list):
+            for value in node:
+                collect(value)
+
+    collect(model)
+    return [content for interface in interfaces for content in interface.get("contents", [])]
+
+
+def schema_of(content):
+    schema = content["schema"]
+    if schema not in SCHEMAS:
+        sys.exit(f"{content['name']}: schema {schema!r} is not supported")
+    return schema
+
+
+def message_of(content):
+    match = re.match(r"message:\s*(\w+)", content.get("comment", ""))
+    return match.group(1) if match else ""
+
+
+def telemetry_names(message):
+    """Struct type, fields table, macro prefix and encoder for a telemetry message, the default one unprefixed."""
+    prefix = macro_case(message) + "_" if message else ""
+    camel = "".join(part.capitalize() for part in words(message)) if message else ""
+    return (f"CAPABILITY_{prefix}TELEMETRY", f"capability{camel}TelemetryFields",
+            f"CAPABILITY_{prefix}TELEMETRY", f"capability_encode{camel}Telemetry")
+
+
+def generate_telemetry_header(message, telemetry):
+    struct, fields, macro, encoder = telemetry_names(message)
+
+    # Longest encoding: braces, terminator, and per field a separator, quoted key, colon and value
+    max_bytes = 3 + sum(1 + len(c["name"]) + 3 + SCHEMAS[c["schema"]][3] for c in telemetry)
+
+    header = [f"// {message.capitalize() + ' telemetry' if message else 'Telemetry'}, in model order\ntypedef struct\n{{\n"]
+    for content in telemetry:
+        header.append(f"\t{SCHEMAS[content['schema']][0]} {camel_case(content['name'])};\n")
+    header.append(f"}} {struct};\n\n")
+    header.append(f"#define {macro}_FIELD_COUNT {len(telemetry)}\n")
+    header.append(f"#define {macro}_MAX_BYTES {max_bytes}\t\t// longest encoding, terminator included\n\n")
+    header.append(f"extern const CAPABILITY_FIELD {fields}[{macro}_FIELD_COUNT];\n\n")
+    header.append("/// <summary>\n/// Encode telemetry as the model's JSON message. Floating point values are written with fixed decimals,\n")
+    header.append(f"/// NaN as null. buffer must hold {macro}_MAX_BYTES.\n/// </summary>\n")
+    header.append("/// <returns>length of the message, excluding the terminator</returns>\n")
+    header.append(f"size_t {encoder}(const {struct}* telemetry, char* buffer);\n\n")
+    return header
+
+
+def generate_telemetry_source(message, telemetry):
+    struct, fields, macro, encoder = telemetry_names(message)
+
+    source = [f"\nconst CAPABILITY_FIELD {fields}[{macro}_FIELD_COUNT] = {{\n"]
+    source.append(",\n".join(
+        f"\t{{ \"{c['name']}\", {SCHEMAS[c['schema']][1]}, offsetof({struct}, {camel_case(c['name'])}) }}"
+        for c in telemetry))
+    source.append("\n};\n\n")
+
+    source.append(f"size_t {encoder}(const {struct}* telemetry, char* buffer)\n{{\n\tchar* p = buffer;\n")
+    for index, content in enumerate(telemetry):
+        key = ("{" if index == 0 else ",") + f"\\\"{content['name']}\\\":"
+        length = len(key.replace("\\", ""))
+        value = f"telemetry->{camel_case(content['name'])}"
+        encode = ENCODERS[content["schema"]][1].format(value=value, decimals=SCHEMAS[content["schema"]][4])
+        source.append(f"\n\tmemcpy(p, \"{key}\", {length});\n\tp += {length};\n\tp = {encode};\n")
+    if not telemetry:
+        source.append("\n\t*p++ = '{';\n")
+    source.append("\n\t*p++ = '}';\n\t*p = '\\0';\n\treturn (size_t)(p - buffer);\n}\n")
+    return source
+
+
+def generate(contents, model_name):
+    telemetry = [c for c in contents if has_type(c, "Telemetry")]
+    properties = [c for c in contents if has_type(c, "Property")]
+    commands = [c for c in contents if has_type(c, "Command")]
+    banner = f"// Generated by tools/codegen/capability_codegen.py from {model_name}, do not edit.\n"
+
+    for content in telemetry:
+        if schema_of(content) == "string":
+            sys.exit(f"{content['name']}: string telemetry has no fixed encoded size")
+
+    # The default message first, then the others in order of first appearance
+    messages = {"": []}
+    for content in telemetry:
+        messages.setdefault(message_of(content), []).append(content)
+
+    header = [banner, "#pragma once\n\n#include \"dx_device_twins.h\"\n"]
+    if commands:
+        header.append("#include \"dx_direct_methods.h\"\n")
+    header.append("#include <stdbool.h>\n#include <stddef.h>\n#include <stdint.h>\n\n")
+    header.append("typedef enum\n{\n")
+    header.append("".join(f"\t{schema[1]},\n" for schema in SCHEMAS.values()))
+    header.append("} CAPABILITY_SCHEMA;\n\n")
+    header.append("typedef struct\n{\n\tconst char* name;\n\tCAPABILITY_SCHEMA schema;\n\tsize_t offset;\n} CAPABILITY_FIELD;\n\n")
+    for message, fields in messages.items():
+        header.extend(generate_telemetry_header(message, fields))
+
+    header.append("// Device twin bindings, writable properties take their handler\n")
+    header.append(f"#define CAPABILITY_TWIN_COUNT {len(properties)}\n")
+    header.append(f"#define CAPABILITY_TWIN_WRITABLE_COUNT {sum(1 for content in properties if content.get('writable'))}\n")
+    for content in properties:
+        twin_type = SCHEMAS[schema_of(content)][2]
+        if twin_type is None:
+            sys.exit(f"{content['name']}: schema {content['schema']!r} has no device twin type")
+        initializer = f".twinProperty = \"{content['name']}\", .twinType = {twin_type}"
+        if content.get("writable"):
+            header.append(f"#define CAPABILITY_TWIN_{macro_case(content['name'])}(handlerFunction) {{ {initializer}, .handler = handlerFunction }}\n")
+        else:
+            header.append(f"#define CAPABILITY_TWIN_{macro_case(content['name'])} {{ {initializer} }}\n")
+
+    if commands:
+        header.append("\n// Direct method bindings\n")
+        header.append(f"#define CAPABILITY_METHOD_COUNT {len(commands)}\n")
+    for content in commands:
+        header.append(f"#define CAPABILITY_METHOD_{macro_case(content['name'])}(handlerFunction) "
+                      f"{{ .methodName = \"{content['name']}\", .handler = handlerFunction }}\n")
+
+    source = [banner, "#include \"capability_model.h\"\n\n#include <math.h>\n#include <string.h>\n\n"]
+    source.append("#define CAPABILITY_FIXED_LIMIT 1e15\n")
+    needed = {ENCODERS[c["schema"]][0] for c in telemetry}
+    needed |= {dependency for helper in needed for dependency in HELPER_DEPENDENCIES.get(helper, [])}
+    source.extend("\n" + code.strip("\n") + "\n" for helper, code in HELPERS.items() if helper in needed)
+    for message, fields in messages.items():
+        source.extend(generate_telemetry_source(message, fields))
+    return "".join(header), "".join(source)
+
+
+def write(path, text):
+    with open(path, "w", newline="\n") as output:
+        output.write(text)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+
+    model_path, output_dir = sys.argv[1], sys.argv[2]
+    header, source = generate(load_contents(model_path), "iot_central/" + os.path.basename(model_path))
+    write(os.path.join(output_dir, "capability_model.h"), header)
+    write(os.path.join(output_dir, "capability_model.c"), source)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+/*
+ * Host benchmark of the generated telemetry encoder, capability_encodeTelemetry, against the snprintf template it
+ * replaced, extended to the same keys and decimals. Both encode the same table of readings in the ranges the app
+ * sends, a NaN among them now and then.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -I../twin-bench/shim encoder_bench.c ../../co2_monitor_hl/capability_model.c \
+ *       -o encoder_bench -lm
+ *   ./encoder_bench [messages]
+ *
+ * Reports the time per message for each. Every message is checked first: the encoder's output must parse back to
+ * the template's values, NaN as null, and fit CAPABILITY_TELEMETRY_MAX_BYTES.
+ */
+
+#include "capability_model.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TABLE_SIZE 4096
+#define TIMING_ROUNDS 5
+
+// The previous template's format, with the keys and two decimals the model now declares
+static const char* MsgTemplate = "{\"Temperature\":%.2f,\"CO2\":%.2f,\"CO2Quality\":%d,\"Humidity\":%.2f,\"MsgId\":%d,"
+	"\"CapturedAt\":%lld,\"EnqueueMs\":%d,\"DewPoint\":%.2f,\"AbsoluteHumidity\":%.2f,\"HeatIndex\":%.2f,\"IAQ\":%.2f}";
+
+static CAPABILITY_TELEMETRY table[TABLE_SIZE];
+static uint32_t seed = 1;
+
+// Deterministic uniform in [0, 1), the same sequence for every run
+static double Uniform(void)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) / (double)(1u << 24);
+}
+
+static double NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int Template(const CAPABILITY_TELEMETRY* t, char* buffer, size_t size)
+{
+	return snprintf(buffer, size, MsgTemplate, t->temperature, t->co2, t->co2Quality, t->humidity, t->msgId,
+		(long long)t->capturedAt, t->enqueueMs, t->dewPoint, t->absoluteHumidity, t->heatIndex, t->iaq);
+}
+
+// Compare the two encodings value by value, the encoder rounds half up where printf rounds the binary value
+static bool SameValues(const char* encoded, const char* templated)
+{
+	while (*encoded != '\0' && *templated != '\0')
+	{
+		if (strncmp(encoded, "null", 4) == 0 && (strncmp(templated, "nan", 3) == 0 || strncmp(templated, "-nan", 4) == 0))
+		{
+			encoded += 4;
+			templated += *templated == '-' ? 4 : 3;
+		}
+		else if ((*encoded == '-' || (*encoded >= '0' && *encoded <= '9')) && encoded[-1] == ':')
+		{
+			char *encodedEnd, *templatedEnd;
+
+			if (fabs(strtod(encoded, &encodedEnd) - strtod(templated, &templatedEnd)) > 0.0100001)
+			{
+				return false;
+			}
+			encoded = encodedEnd;
+			templated = templatedEnd;
+		}
+		else if (*encoded++ != *templated++)
+		{
+			return false;
+		}
+	}
+	return *encoded == *templated;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t messages = argc > 1 ? (size_t)atol(argv[1]) : 2000000;
+	char encoded[CAPABILITY_TELEMETRY_MAX_BYTES], templated[512];
+	double encoderNs = INFINITY, templateNs = INFINITY;
+	volatile size_t sink = 0;
+
+	for (size_t i = 0; i < TABLE_SIZE; i++)
+	{
+		table[i] = (CAPABILITY_TELEMETRY){
+			.temperature = (float)(15 + 15 * Uniform()),
+			.co2 = (float)(400 + 2000 * Uniform()),
+			.co2Quality = (int32_t)(Uniform() * 4),
+			.humidity = (float)(20 + 60 * Uniform()),
+			.msgId = (int32_t)i + 1,
+			.capturedAt = 1760000000000LL + (int64_t)i * 20000,
+			.enqueueMs = (int32_t)(Uniform() * 3000),
+			.dewPoint = (float)(-5 + 25 * Uniform()),
+			.absoluteHumidity = (float)(3 + 15 * Uniform()),
+			.heatIndex = (float)(15 + 20 * Uniform()),
+			.iaq = Uniform() < 0.05 ? NAN : (float)(500 * Uniform()),
+		};
+		if (Uniform() < 0.02)
+		{
+			table[i].co2 = NAN;
+		}
+
+		if (capability_encodeTelemetry(&table[i], encoded) >= CAPABILITY_TELEMETRY_MAX_BYTES ||
+			Template(&table[i], templated, sizeof(templated)) <= 0 || !SameValues(encoded, templated))
+		{
+			printf("message %zu differs:\n  %s\n  %s\n", i, encoded, templated);
+			return 1;
+		}
+	}
+
+	for (int round = 0; round < TIMING_ROUNDS; round++)
+	{
+		double startNs = NowNs();
+
+		for (size_t i = 0; i < messages; i++)
+		{
+			sink += capability_encodeTelemetry(&table[i % TABLE_SIZE], encoded);
+		}
+		encoderNs = fmin(encoderNs, (NowNs() - startNs) / (double)messages);
+
+		startNs = NowNs();
+		for (size_t i = 0; i < messages; i++)
+		{
+			sink += (size_t)Template(&table[i % TABLE_SIZE], templated, sizeof(templated));
+		}
+		templateNs = fmin(templateNs, (NowNs() - startNs) / (double)messages);
+	}
+
+	printf("%d messages checked, %zu timed (best of %d): encoder %.0f ns, snprintf template %.0f ns per message\n",
+		TABLE_SIZE, messages, TIMING_ROUNDS, encoderNs, templateNs);
+	return 0;
+}
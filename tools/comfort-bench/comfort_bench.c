@@ -0,0 +1,109 @@
+/*
+ * Host benchmark of the app's comfort.c against the same formulas evaluated with libm: worst error of each
+ * metric over the SCD30 operating range, and time per sample for the app's code, libm in float and in double.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl comfort_bench.c ../../co2_monitor_hl/comfort.c -o comfort_bench -lm
+ *   ./comfort_bench
+ */
+
+#include "comfort.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#define ROUNDS 20
+
+static double NowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// Reference dew point and absolute humidity, libm in double
+static void Reference(double temperature, double humidity, double* dewPoint, double* absoluteHumidity)
+{
+	double magnus = 17.62 * temperature / (243.12 + temperature);
+	double gamma = log(humidity / 100.0) + magnus;
+
+	*dewPoint = 243.12 * gamma / (17.62 - gamma);
+	*absoluteHumidity = 216.7 * humidity / 100.0 * 6.112 * exp(magnus) / (273.15 + temperature);
+}
+
+int main(void)
+{
+	COMFORT_METRICS metrics;
+	double dewPoint, absoluteHumidity, start, elapsedNs[4];
+	double worstDewPoint = 0, worstAbsolute = 0, worstExp2 = 0, worstLog2 = 0;
+	volatile float sinkF = 0;
+	volatile double sinkD = 0;
+	long samples = 0, calls = 0;
+
+	// Approximations alone: exp2 over the exponents Magnus produces and beyond, log2 over 1e-3 to 1e3
+	for (float x = -10.0f; x <= 10.0f; x += 1e-4f)
+	{
+		worstExp2 = fmax(worstExp2, fabs(comfort_fastExp2(x) / exp2((double)x) - 1));
+	}
+	for (float x = 1e-3f; x <= 1e3f; x *= 1.00001f)
+	{
+		worstLog2 = fmax(worstLog2, fabs(comfort_fastLog2(x) - log2((double)x)));
+	}
+
+	// Metrics over the SCD30 range, -40 to 70 degrees C and 1 to 100 %RH
+	for (float t = -40.0f; t <= 70.0f; t += 0.05f)
+	{
+		for (float rh = 1.0f; rh <= 100.0f; rh += 0.1f)
+		{
+			comfort_compute(800.0f, t, rh, &metrics);
+			Reference(t, rh, &dewPoint, &absoluteHumidity);
+			worstDewPoint = fmax(worstDewPoint, fabs(metrics.dewPoint - dewPoint));
+			worstAbsolute = fmax(worstAbsolute, fabs(metrics.absoluteHumidity / absoluteHumidity - 1));
+			samples++;
+		}
+	}
+
+	// One log and one exp per sample, as the dew point and absolute humidity need
+	start = NowNs();
+	for (int round = 0; round < ROUNDS; round++)
+		for (float x = 0.01f; x < 1.0f; x += 1e-5f)
+		{
+			sinkF += comfort_fastLog2(x) + comfort_fastExp2(x);
+		}
+	elapsedNs[0] = NowNs() - start;
+
+	start = NowNs();
+	for (int round = 0; round < ROUNDS; round++)
+		for (float x = 0.01f; x < 1.0f; x += 1e-5f)
+		{
+			sinkF += logf(x) + expf(x);
+			calls++;
+		}
+	elapsedNs[1] = NowNs() - start;
+
+	start = NowNs();
+	for (int round = 0; round < ROUNDS; round++)
+		for (float x = 0.01f; x < 1.0f; x += 1e-5f)
+		{
+			sinkD += log((double)x) + exp((double)x);
+		}
+	elapsedNs[2] = NowNs() - start;
+
+	start = NowNs();
+	for (int round = 0; round < ROUNDS; round++)
+		for (float t = 10.0f; t < 35.0f; t += 0.05f)
+			for (float rh = 10.0f; rh < 90.0f; rh += 0.1f)
+			{
+				comfort_compute(800.0f, t, rh, &metrics);
+				sinkF += metrics.dewPoint + metrics.iaq;
+			}
+	elapsedNs[3] = NowNs() - start;
+
+	printf("fastExp2 worst relative error %.2e, fastLog2 worst absolute error %.2e\n", worstExp2, worstLog2);
+	printf("%ld grid points: dew point worst error %.5f C, absolute humidity worst relative error %.2e\n",
+		samples, worstDewPoint, worstAbsolute);
+	printf("log + exp per call: fast %.2f ns, libm float %.2f ns, libm double %.2f ns\n",
+		elapsedNs[0] / calls, elapsedNs[1] / calls, elapsedNs[2] / calls);
+	printf("comfort_compute, all four metrics: %.1f ns per sample\n", elapsedNs[3] / ((double)ROUNDS * 500 * 800));
+	return 0;
+}
@@ -0,0 +1,243 @@
+/*
+ * Host benchmark of the app's co2_filter.c on a synthetic 30-day trace at the 20 s reading interval: office
+ * occupancy on weekdays with an afternoon meeting on some of them, 10 ppm of sensor noise, single-sample breath
+ * spikes of +300-1500 ppm, NaN readings and the occasional 65535. Each filter configuration feeds the app's
+ * co2_alert.c at a 1000 ppm level with its default hysteresis and hold. Alerts raised while the true CO2 is more than
+ * the hysteresis below the level are false, noise on a room sitting at the level is not; for alerts raised with
+ * the true CO2 at or above the level the delay from its crossing is averaged. Time per sample is measured
+ * over the whole trace.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl co2_filter_bench.c ../../co2_monitor_hl/co2_alert.c -o co2_filter_bench -lm
+ *   ./co2_filter_bench [days]
+ *
+ * The window order and the MAD bisection are also checked against sorting, over random windows of every size.
+ */
+
+#include "../../co2_monitor_hl/co2_filter.c"
+#include "co2_alert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLE_SECONDS 20
+#define MAX_DAYS 60
+#define MAX_SAMPLES (MAX_DAYS * 86400 / SAMPLE_SECONDS)
+#define ALERT_LEVEL_PPM 1000.0f
+#define OUTDOOR_PPM 420.0
+#define NOISE_PPM 10.0
+#define SPIKE_PROBABILITY 0.011
+#define NAN_PROBABILITY 0.0019
+#define SATURATED_PROBABILITY 0.0003
+#define TIMING_ROUNDS 10
+#define CHECK_WINDOWS 300000
+
+static float truePpm[MAX_SAMPLES], readings[MAX_SAMPLES];
+static int sampleCount;
+static uint32_t spikes, nans, saturated;
+
+// Deterministic uniform in [0, 1), the same sequence for every run
+static double Uniform(uint32_t* seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return (*seed >> 8) / (double)(1u << 24);
+}
+
+static uint64_t Us(int sample)
+{
+	return (uint64_t)sample * SAMPLE_SECONDS * 1000000u;
+}
+
+// Occupied 9:00-17:00 on weekdays with a lunch dip, filling towards a level that varies by day, plus a one hour
+// meeting at 14:00 every third day. Empty, the room vents towards outdoor air.
+static void BuildTrace(int days)
+{
+	uint32_t seed = 1;
+	double co2 = OUTDOOR_PPM;
+
+	sampleCount = days * 86400 / SAMPLE_SECONDS;
+	for (int i = 0; i < sampleCount; i++)
+	{
+		int day = i * SAMPLE_SECONDS / 86400;
+		double hour = (i * SAMPLE_SECONDS % 86400) / 3600.0;
+		double target = OUTDOOR_PPM, tauSeconds = 3600;
+		double noise = (Uniform(&seed) + Uniform(&seed) + Uniform(&seed) - 1.5) * 2 * NOISE_PPM;
+		double draw = Uniform(&seed);
+
+		if (day % 7 < 5 && hour >= 9 && hour < 17 && !(hour >= 12 && hour < 13))
+		{
+			target = 750 + 35 * ((day * 37) % 10);
+			tauSeconds = 1800;
+			if (day % 3 == 0 && hour >= 14 && hour < 15)
+			{
+				target += 500;
+			}
+		}
+		co2 += (target - co2) * (1 - exp(-SAMPLE_SECONDS / tauSeconds));
+		truePpm[i] = (float)co2;
+		readings[i] = (float)(co2 + noise);
+
+		if (draw < NAN_PROBABILITY)
+		{
+			readings[i] = NAN;
+			nans++;
+		}
+		else if (draw < NAN_PROBABILITY + SATURATED_PROBABILITY)
+		{
+			readings[i] = 65535.0f;
+			saturated++;
+		}
+		else if (draw < NAN_PROBABILITY + SATURATED_PROBABILITY + SPIKE_PROBABILITY)
+		{
+			readings[i] += (float)(300 + 1200 * Uniform(&seed));
+			spikes++;
+		}
+	}
+}
+
+static double NowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// filter NULL feeds the readings to the alert unfiltered
+static void Run(const char* label, const CO2_FILTER_CONFIG* filter)
+{
+	uint32_t quality, falseAlerts = 0, trueAlerts = 0;
+	double delaySeconds = 0, start, elapsedNs = 0;
+	int lastCrossing = 0;
+	volatile float sink = 0;
+
+	if (filter != NULL)
+	{
+		co2Filter_configure(filter);
+	}
+	for (int i = 0; i < sampleCount; i++)
+	{
+		float value = filter != NULL ? co2Filter_apply(readings[i], Us(i), &quality) : readings[i];
+
+		if (i > 0 && truePpm[i - 1] < ALERT_LEVEL_PPM && truePpm[i] >= ALERT_LEVEL_PPM)
+		{
+			lastCrossing = i;
+		}
+		if (co2Alert_evaluate(value, ALERT_LEVEL_PPM, Us(i)) == CO2_ALERT_RAISED)
+		{
+			if (truePpm[i] < ALERT_LEVEL_PPM - co2Alert_getConfig()->hysteresisPpm)
+			{
+				falseAlerts++;
+			}
+			else if (truePpm[i] >= ALERT_LEVEL_PPM)
+			{
+				trueAlerts++;
+				delaySeconds += (i - lastCrossing) * SAMPLE_SECONDS;
+			}
+		}
+	}
+
+	for (int round = 0; filter != NULL && round < TIMING_ROUNDS; round++)
+	{
+		co2Filter_configure(filter);
+		start = NowNs();
+		for (int i = 0; i < sampleCount; i++)
+		{
+			sink += co2Filter_apply(readings[i], Us(i), &quality);
+		}
+		elapsedNs += NowNs() - start;
+	}
+
+	printf("%-14s %4u false alerts, %3u true, mean delay %5.1f s", label, falseAlerts, trueAlerts,
+		trueAlerts ? delaySeconds / trueAlerts : 0.0);
+	if (filter != NULL)
+	{
+		printf(", %5.1f ns/sample", elapsedNs / TIMING_ROUNDS / sampleCount);
+	}
+	printf("\n");
+}
+
+// The modules keep their state in statics, each configuration runs in a child so it starts from boot
+static void RunFresh(const char* label, const CO2_FILTER_CONFIG* filter)
+{
+	pid_t child;
+
+	fflush(stdout);
+	child = fork();
+	if (child == 0)
+	{
+		Run(label, filter);
+		fflush(stdout);
+		_exit(0);
+	}
+	waitpid(child, NULL, 0);
+}
+
+static int CompareFloats(const void* a, const void* b)
+{
+	float x = *(const float*)a, y = *(const float*)b;
+	return (x > y) - (x < y);
+}
+
+// Slide random readings, with ties, through every window size and compare against sorting
+static uint32_t CheckWindows(void)
+{
+	CO2_FILTER_CONFIG config = filterConfig;
+	float expected[CO2_FILTER_MAX_WINDOW], deviations[CO2_FILTER_MAX_WINDOW];
+	uint32_t seed = 7, mismatches = 0, checked = 0;
+
+	for (uint8_t window = 3; checked < CHECK_WINDOWS; window = window + 2 > CO2_FILTER_MAX_WINDOW ? 3 : window + 2)
+	{
+		config.window = window;
+		co2Filter_configure(&config);
+		for (int i = 0; i < 1000; i++, checked++)
+		{
+			Insert((float)(400 + (int)(Uniform(&seed) * 50) * 8));
+
+			memcpy(expected, history, sizeof(float) * (size_t)count);
+			qsort(expected, (size_t)count, sizeof(float), CompareFloats);
+			for (int j = 0; j < count; j++)
+			{
+				deviations[j] = fabsf(expected[j] - expected[count / 2]);
+			}
+			qsort(deviations, (size_t)count, sizeof(float), CompareFloats);
+
+			mismatches += memcmp(expected, sorted, sizeof(float) * (size_t)count) != 0 ||
+				(count >= 3 && MedianAbsoluteDeviation() != deviations[count / 2]);
+		}
+	}
+	return mismatches;
+}
+
+int main(int argc, char* argv[])
+{
+	int days = argc > 1 ? atoi(argv[1]) : 30;
+	CO2_FILTER_CONFIG config, kalman, median, hampel;
+
+	if (days < 1 || days > MAX_DAYS)
+	{
+		printf("days: 1 to %d\n", MAX_DAYS);
+		return 1;
+	}
+	BuildTrace(days);
+	config = *co2Filter_getConfig();
+	kalman = config;
+	kalman.hampel = false;
+	median = config;
+	median.hampel = false;
+	median.smoother = CO2_SMOOTH_MEDIAN;
+	hampel = config;
+	hampel.smoother = CO2_SMOOTH_NONE;
+
+	printf("%d days at %d s: %d readings, %u spikes, %u NaN, %u at 65535, alert at %.0f ppm\n", days, SAMPLE_SECONDS,
+		sampleCount, spikes, nans, saturated, ALERT_LEVEL_PPM);
+	RunFresh("raw", NULL);
+	RunFresh("kalman only", &kalman);
+	RunFresh("median-7", &median);
+	RunFresh("hampel only", &hampel);
+	RunFresh("hampel+kalman", &config);
+
+	printf("window order and MAD against sorting: %u mismatches in %d windows\n", CheckWindows(), CHECK_WINDOWS);
+	return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * Host benchmark of the app's I2C HAL, sensirion_hw_i2c_implementation.c, against a simulated bus on a simulated
+ * clock. The traffic mirrors main.c with the SCD30 at a 2 s interval and the barometer fitted: data ready and
+ * measurement reads every cycle, a barometer one-shot, the measurement interval written every minute, measurement
+ * restarted every 20 minutes and a forced recalibration every hour. Transfers take 90 us a byte at 100 kHz plus
+ * jitter. Each scenario adds NACKs, half of them after a write was taken, and clock stretches.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl/embedded-scd/embedded-common -I../../co2_monitor_hl/embedded-scd/embedded-common/hw_i2c \
+ *       -Ishim -I../intercore-standin/shim i2c_retry_bench.c -o i2c_retry_bench
+ *   ./i2c_retry_bench [hours]
+ *
+ * Reports retries, failures and timeouts, the timeout the HAL settled on against the p99 it tracked and the
+ * bus's true p99, the longest a transaction held the event loop, and how often a write that acts on the sensor
+ * was carried out twice. The last scenario retries every write, as the HAL did before the retry filter.
+ */
+
+// Backoff sleeps and transaction timing run on the simulated clock, the failure log is left out
+#include <time.h>
+#define clock_gettime SimClockGettime
+#define nanosleep SimNanosleep
+static int SimClockGettime(clockid_t clock, struct timespec* ts);
+static int SimNanosleep(const struct timespec* request, struct timespec* remaining);
+#include <applibs/log.h>
+#undef Log_Debug
+#define Log_Debug(...) ((void)0)
+#include "../../co2_monitor_hl/embedded-scd/embedded-common/hw_i2c/sensirion_hw_i2c_implementation.c"
+#undef clock_gettime
+#undef nanosleep
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+#define CYCLE_MS 2000
+#define SCD30_ADDRESS 0x61
+#define BAROMETER_ADDRESS 0x5C
+#define MAX_SAMPLES 2000000
+
+typedef struct
+{
+	const char* name;
+	double nackProbability;
+	double stretchProbability;
+	uint32_t stretchMinUs;
+	uint32_t stretchMaxUs;
+	bool retryAllWrites;
+} SCENARIO;
+
+static uint64_t simNowUs;
+static uint32_t seed = 1;
+static uint32_t busTimeoutMs;
+static const SCENARIO* scenario;
+static uint32_t deliveries, timeouts;
+static uint32_t attemptUs[MAX_SAMPLES];
+static size_t attemptCount;
+
+static int SimClockGettime(clockid_t clock, struct timespec* ts)
+{
+	ts->tv_sec = (time_t)(simNowUs / 1000000u);
+	ts->tv_nsec = (long)(simNowUs % 1000000u) * 1000;
+	return 0;
+}
+
+static int SimNanosleep(const struct timespec* request, struct timespec* remaining)
+{
+	simNowUs += (uint64_t)request->tv_sec * 1000000u + (uint64_t)request->tv_nsec / 1000u;
+	return 0;
+}
+
+// Deterministic uniform in [0, 1), the same sequence for every run
+static double Uniform(void)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) / (double)(1u << 24);
+}
+
+int I2CMaster_Open(int id)
+{
+	return 3;
+}
+
+int I2CMaster_SetBusSpeed(int fd, uint32_t speed)
+{
+	return 0;
+}
+
+int I2CMaster_SetTimeout(int fd, uint32_t timeoutMs)
+{
+	busTimeoutMs = timeoutMs;
+	return 0;
+}
+
+// One attempt on the bus. A stretch past the timeout, or a NACK after the address, still leaves a write taken.
+static ssize_t Transfer(size_t length, bool isWrite)
+{
+	uint32_t usec = 90u * (uint32_t)(length + 1) + (uint32_t)(Uniform() * 200);
+	double draw = Uniform();
+
+	if (Uniform() < scenario->stretchProbability)
+	{
+		usec += scenario->stretchMinUs + (uint32_t)(Uniform() * (scenario->stretchMaxUs - scenario->stretchMinUs));
+	}
+	if (usec > busTimeoutMs * 1000u)
+	{
+		simNowUs += busTimeoutMs * 1000u;
+		deliveries += isWrite;
+		timeouts++;
+		errno = ETIMEDOUT;
+		return -1;
+	}
+	if (draw < scenario->nackProbability / 2)
+	{
+		simNowUs += 100;
+		errno = EIO;
+		return -1;
+	}
+	simNowUs += usec;
+	deliveries += isWrite;
+	if (draw < scenario->nackProbability)
+	{
+		errno = EIO;
+		return -1;
+	}
+	if (attemptCount < MAX_SAMPLES)
+	{
+		attemptUs[attemptCount++] = usec;
+	}
+	return (ssize_t)length;
+}
+
+ssize_t I2CMaster_Read(int fd, uint8_t address, uint8_t* buffer, size_t maxLength)
+{
+	memset(buffer, 0, maxLength);
+	return Transfer(maxLength, false);
+}
+
+ssize_t I2CMaster_Write(int fd, uint8_t address, const uint8_t* data, size_t length)
+{
+	return Transfer(length, true);
+}
+
+// main.c I2cWriteRetryable
+static uint8_t WriteRetryable(uint8_t address, const uint8_t* data, uint16_t count)
+{
+	uint16_t command = count >= 2 ? (uint16_t)((data[0] << 8) | data[1]) : 0;
+
+	if (scenario->retryAllWrites)
+	{
+		return 1;
+	}
+	if (address == SCD30_ADDRESS)
+	{
+		return count == 2 || (command != 0x0010 && command != 0x5204);
+	}
+	return address == BAROMETER_ADDRESS && count == 1;
+}
+
+static int CompareUint32(const void* a, const void* b)
+{
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+typedef struct
+{
+	uint32_t maxHoldUs;
+	uint32_t twice;				// writes that act on the sensor carried out more than once
+} RUN;
+
+static void Write(RUN* run, uint8_t address, const uint8_t* data, uint16_t count, bool actsOnSensor)
+{
+	uint64_t startUs = simNowUs;
+
+	deliveries = 0;
+	sensirion_i2c_write(address, data, count);
+	run->twice += actsOnSensor && deliveries > 1;
+	if (simNowUs - startUs > run->maxHoldUs)
+	{
+		run->maxHoldUs = (uint32_t)(simNowUs - startUs);
+	}
+}
+
+static void Read(RUN* run, uint8_t address, uint16_t count)
+{
+	uint8_t buffer[18];
+	uint64_t startUs = simNowUs;
+
+	sensirion_i2c_read(address, buffer, count);
+	if (simNowUs - startUs > run->maxHoldUs)
+	{
+		run->maxHoldUs = (uint32_t)(simNowUs - startUs);
+	}
+}
+
+static void Run(const SCENARIO* s, double hours)
+{
+	static const uint8_t dataReady[] = { 0x02, 0x02 }, readMeasurement[] = { 0x03, 0x00 };
+	static const uint8_t setInterval[] = { 0x46, 0x00, 0x00, 0x02, 0xE3 }, start[] = { 0x00, 0x10, 0x00, 0x00, 0x81 };
+	static const uint8_t forcedRecalibration[] = { 0x52, 0x04, 0x01, 0xA4, 0x4B };
+	static const uint8_t pressurePointer[] = { 0x27 }, oneShot[] = { 0x11, 0x11 };
+	uint32_t cycles = (uint32_t)(hours * 3600 * 1000 / CYCLE_MS);
+	uint64_t timeoutSumMs = 0;
+	sensirion_i2c_stats_t stats;
+	RUN run = { 0 };
+
+	scenario = s;
+	sensirion_i2c_init();
+	sensirion_i2c_set_write_retry_filter(WriteRetryable);
+	for (uint32_t cycle = 0; cycle < cycles; cycle++)
+	{
+		simNowUs = (uint64_t)cycle * CYCLE_MS * 1000u;
+		Write(&run, SCD30_ADDRESS, dataReady, sizeof(dataReady), false);
+		Read(&run, SCD30_ADDRESS, 3);
+		Write(&run, SCD30_ADDRESS, readMeasurement, sizeof(readMeasurement), false);
+		Read(&run, SCD30_ADDRESS, 18);
+		Write(&run, BAROMETER_ADDRESS, pressurePointer, sizeof(pressurePointer), false);
+		Read(&run, BAROMETER_ADDRESS, 4);
+		Write(&run, BAROMETER_ADDRESS, oneShot, sizeof(oneShot), true);
+		if (cycle % 30 == 0)
+		{
+			Write(&run, SCD30_ADDRESS, setInterval, sizeof(setInterval), false);
+		}
+		if (cycle % 600 == 300)
+		{
+			Write(&run, SCD30_ADDRESS, start, sizeof(start), true);
+		}
+		if (cycle % 1800 == 900)
+		{
+			Write(&run, SCD30_ADDRESS, forcedRecalibration, sizeof(forcedRecalibration), true);
+		}
+		timeoutSumMs += busTimeoutMs;
+	}
+
+	sensirion_i2c_get_stats(&stats);
+	qsort(attemptUs, attemptCount, sizeof(uint32_t), CompareUint32);
+	printf("%-26s %7u transactions, %5u retries, %4u failed, %4u timeouts\n", s->name, stats.transactions,
+		stats.retries, stats.failures, timeouts);
+	printf("%-26s timeout %3u ms (mean %5.1f ms, %u changes), p99 tracked %5u us, true %5u us\n", "", stats.timeout_ms,
+		(double)timeoutSumMs / cycles, stats.timeout_adjustments, stats.p99_usec, attemptUs[attemptCount * 99 / 100]);
+	printf("%-26s longest hold %6.1f ms, writes acting on the sensor carried out twice: %u\n", "", run.maxHoldUs / 1000.0,
+		run.twice);
+}
+
+// The HAL keeps its state in statics, each scenario runs in a child so it starts from boot
+static void RunFresh(const SCENARIO* s, double hours)
+{
+	pid_t child;
+
+	fflush(stdout);
+	child = fork();
+	if (child == 0)
+	{
+		Run(s, hours);
+		fflush(stdout);
+		_exit(0);
+	}
+	waitpid(child, NULL, 0);
+}
+
+int main(int argc, char* argv[])
+{
+	static const SCENARIO scenarios[] = {
+		{ "healthy", 0.002, 0, 0, 0, false },
+		{ "stretching 3%", 0.002, 0.03, 5000, 20000, false },
+		{ "rare long stretch", 0.002, 0.002, 20000, 60000, false },
+		{ "noisy bus", 0.08, 0, 0, 0, false },
+		{ "noisy, all writes retried", 0.08, 0, 0, 0, true },
+	};
+	double hours = argc > 1 ? atof(argv[1]) : 24;
+
+	printf("%.0f h, a cycle every %d ms\n", hours, CYCLE_MS);
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+	{
+		RunFresh(&scenarios[i], hours);
+	}
+	return 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// Host shim for the I2C bench: the I2CMaster calls are served by the simulated bus in i2c_retry_bench.c
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define I2C_BUS_SPEED_STANDARD 100000
+
+int I2CMaster_Open(int id);
+int I2CMaster_SetBusSpeed(int fd, uint32_t speed);
+int I2CMaster_SetTimeout(int fd, uint32_t timeoutMs);
+ssize_t I2CMaster_Read(int fd, uint8_t address, uint8_t* buffer, size_t maxLength);
+ssize_t I2CMaster_Write(int fd, uint8_t address, const uint8_t* data, size_t length);
@@ -0,0 +1,4 @@
+#pragma once
+
+// Host shim for the I2C bench
+#define I2cMaster2 2
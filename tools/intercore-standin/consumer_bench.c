@@ -0,0 +1,103 @@
+/*
+ * Host benchmark for the consumer side of the intercore sample channel. It runs the app's own
+ * rt_sampling.c against sampler_standin over the Linux stand-in, with a poll() loop in place of
+ * the applibs event loop, and reports throughput and capture-to-delivery latency.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -Ishim -DINTERCORE_STANDIN consumer_bench.c ../../co2_monitor_hl/rt_sampling.c \
+ *       ../../co2_monitor_hl/sample_ring.c -o consumer -lrt
+ *   ./sampler 1000 100000 & ./consumer 100000
+ */
+
+#include "rt_sampling.h"
+#include "trace.h"
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define LATENCY_SAMPLES 200000
+
+static int loopFd = -1;
+static EventLoopIoCallback* loopCallback = NULL;
+static uint32_t latencyUs[LATENCY_SAMPLES];
+static uint32_t received = 0;
+
+EventRegistration* EventLoop_RegisterIo(EventLoop* el, int fd, EventLoop_IoEvents eventBitmask, EventLoopIoCallback* callback, void* context)
+{
+	loopFd = fd;
+	loopCallback = callback;
+	return (EventRegistration*)&loopFd;
+}
+
+int EventLoop_UnregisterIo(EventLoop* el, EventRegistration* reg)
+{
+	loopFd = -1;
+	return 0;
+}
+
+uint64_t trace_nowUs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+void trace_recordDuration(TRACE_SPAN span, uint32_t durationUs)
+{
+}
+
+static void FramesHandler(const SAMPLE_FRAME* frames, size_t count)
+{
+	uint64_t nowUs = trace_nowUs();
+
+	for (size_t i = 0; i < count; i++, received++)
+	{
+		latencyUs[received % LATENCY_SAMPLES] = (uint32_t)(nowUs - frames[i].captureUs);
+	}
+}
+
+static int CompareUs(const void* a, const void* b)
+{
+	return *(const uint32_t*)a < *(const uint32_t*)b ? -1 : *(const uint32_t*)a > *(const uint32_t*)b;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t expected = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1000;
+	RT_SAMPLING_STATS stats;
+	uint64_t startUs;
+	double seconds;
+	size_t samples;
+
+	if (!rtSampling_start(NULL, FramesHandler))
+	{
+		return 1;
+	}
+
+	startUs = trace_nowUs();
+	while (received < expected)
+	{
+		struct pollfd pfd = { .fd = loopFd, .events = POLLIN };
+		if (poll(&pfd, 1, 30000) <= 0)
+		{
+			break;
+		}
+		loopCallback(NULL, loopFd, EventLoop_Input, NULL);
+	}
+	seconds = (double)(trace_nowUs() - startUs) / 1e6;
+
+	rtSampling_getStats(&stats);
+	samples = received < LATENCY_SAMPLES ? received : LATENCY_SAMPLES;
+	qsort(latencyUs, samples, sizeof(latencyUs[0]), CompareUs);
+	printf("%u frames in %.2f s (%.0f frames/s), %u batches (max %u), %u lost, %u bad messages\n", stats.frames, seconds,
+		stats.frames / seconds, stats.batches, stats.maxBatch, stats.lostFrames, stats.badMessages);
+	if (samples)
+	{
+		printf("capture to delivery p50 %u us, p99 %u us, max %u us\n", latencyUs[samples / 2], latencyUs[samples * 99 / 100],
+			latencyUs[samples - 1]);
+	}
+
+	rtSampling_stop();
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Linux stand-in for the real-time sampling app, the producer side of the intercore sample channel
+ * (co2_monitor_hl/sample_ring.h). It creates the ring in POSIX shared memory, waits for the control
+ * message from the consumer, then pushes synthetic SCD30 frames and rings the consumer's doorbell
+ * with the batching the control message asked for.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -Ishim sampler_standin.c ../../co2_monitor_hl/sample_ring.c -o sampler -lrt -lm
+ *   ./sampler [frames per second] [frames]
+ *
+ * Without arguments it samples at the requested sensor interval until interrupted. A rate overrides the
+ * interval for throughput runs.
+ */
+
+#include "rt_sampling.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t NowUs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+static void SleepUntil(uint64_t deadlineUs)
+{
+	struct timespec deadline = { .tv_sec = (time_t)(deadlineUs / 1000000u), .tv_nsec = (long)(deadlineUs % 1000000u) * 1000 };
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+	{
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	double rate = argc > 1 ? atof(argv[1]) : 0;
+	uint32_t frameLimit = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 0;
+	struct sockaddr_un address = { .sun_family = AF_UNIX, .sun_path = INTERCORE_STANDIN_PRODUCER_SOCKET };
+	struct sockaddr_un consumer;
+	socklen_t consumerLength = sizeof(consumer);
+	SAMPLE_CONTROL_MESSAGE control;
+	SAMPLE_BATCH_MESSAGE doorbell = { .type = SAMPLE_MESSAGE_BATCH, .version = SAMPLE_PROTOCOL_VERSION };
+	SAMPLE_FRAME frame = { 0 };
+	SAMPLE_RING* ring;
+	uint64_t periodUs, nextUs, oldestWaitingUs = 0;
+	uint32_t waiting = 0, overruns = 0, doorbells = 0;
+	int shmFd, sockFd;
+
+	shmFd = shm_open(INTERCORE_STANDIN_SHM_NAME, O_RDWR | O_CREAT, 0600);
+	if (shmFd < 0 || ftruncate(shmFd, sizeof(SAMPLE_RING)) < 0 ||
+		(ring = mmap(NULL, sizeof(SAMPLE_RING), PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0)) == MAP_FAILED)
+	{
+		fprintf(stderr, "shared memory: %s\n", strerror(errno));
+		return 1;
+	}
+	sampleRing_init(ring);
+
+	sockFd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	unlink(INTERCORE_STANDIN_PRODUCER_SOCKET);
+	if (sockFd < 0 || bind(sockFd, (struct sockaddr*)&address, sizeof(address)) < 0)
+	{
+		fprintf(stderr, "socket: %s\n", strerror(errno));
+		return 1;
+	}
+
+	// Like the real-time app, only start once the high-level app has introduced itself
+	printf("Waiting for the consumer\n");
+	while (recvfrom(sockFd, &control, sizeof(control), 0, (struct sockaddr*)&consumer, &consumerLength) != sizeof(control) ||
+		control.type != SAMPLE_MESSAGE_CONTROL || control.version != SAMPLE_PROTOCOL_VERSION)
+	{
+		consumerLength = sizeof(consumer);
+	}
+
+	periodUs = rate > 0 ? (uint64_t)(1000000 / rate) : (uint64_t)control.intervalSeconds * 1000000u;
+	printf("Sampling every %llu us, batches of %u frames or %u ms\n", (unsigned long long)periodUs, control.batchFrames,
+		control.maxLatencyMs);
+
+	nextUs = NowUs();
+	while (frameLimit == 0 || frame.sequence < frameLimit)
+	{
+		SleepUntil(nextUs);
+		nextUs += periodUs;
+
+		// Indoor CO2 with a slow occupancy cycle
+		frame.captureUs = NowUs();
+		frame.co2 = 800.0f + 400.0f * sinf((float)frame.sequence / 300.0f);
+		frame.temperature = 22.0f;
+		frame.humidity = 45.0f;
+		if (sampleRing_push(ring, &frame))
+		{
+			if (waiting++ == 0)
+			{
+				oldestWaitingUs = frame.captureUs;
+			}
+		}
+		else
+		{
+			overruns++;
+		}
+		frame.sequence++;
+
+		if (waiting && (waiting >= control.batchFrames || frame.captureUs - oldestWaitingUs >= control.maxLatencyMs * 1000ull ||
+			frame.sequence == frameLimit))
+		{
+			doorbell.producerUs = NowUs();
+			sendto(sockFd, &doorbell, SAMPLE_BATCH_MESSAGE_BYTES(0), 0, (struct sockaddr*)&consumer, consumerLength);
+			doorbells++;
+			waiting = 0;
+		}
+	}
+
+	printf("%u frames, %u doorbells, %u ring overruns\n", frame.sequence, doorbells, overruns);
+	shm_unlink(INTERCORE_STANDIN_SHM_NAME);
+	unlink(INTERCORE_STANDIN_PRODUCER_SOCKET);
+	return 0;
+}
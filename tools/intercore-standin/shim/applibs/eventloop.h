@@ -0,0 +1,13 @@
+#pragma once
+
+// Host shim for the intercore stand-in: a single registration served by poll(), see consumer_bench.c
+#include <stdint.h>
+
+typedef struct EventLoop EventLoop;
+typedef struct EventRegistration EventRegistration;
+typedef uint32_t EventLoop_IoEvents;
+enum { EventLoop_Input = 1 };
+typedef void EventLoopIoCallback(EventLoop* el, int fd, EventLoop_IoEvents events, void* context);
+
+EventRegistration* EventLoop_RegisterIo(EventLoop* el, int fd, EventLoop_IoEvents eventBitmask, EventLoopIoCallback* callback, void* context);
+int EventLoop_UnregisterIo(EventLoop* el, EventRegistration* reg);
@@ -0,0 +1,6 @@
+#pragma once
+
+// Host shim for the intercore stand-in, see consumer_bench.c
+#include <stdio.h>
+
+#define Log_Debug(...) printf(__VA_ARGS__)
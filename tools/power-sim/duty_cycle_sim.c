@@ -0,0 +1,196 @@
+/*
+ * Host simulation of duty-cycle mode through the app's duty_cycle.c and scd30_power.c: every boot takes one
+ * reading, logs it, uploads the log every DUTY_CYCLE_UPLOAD_EVERY cycles and powers down for what
+ * dutyCycle_planPowerDown returns, the way main.c drives it. The SCD30 keeps measuring through power-down under
+ * SCD30_POWER_LONG_INTERVAL, its measurements on its own oscillator, which may run off the RTC by a fraction of
+ * a percent. After power-down exit the app is up in the model's boot time and polls data ready every 100 ms, as
+ * SensorStartHandler does. An upload connects, sends and waits out the flush. The RTC is the simulated clock.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -Ishim -I../twin-bench/shim -I../intercore-standin/shim duty_cycle_sim.c \
+ *       ../../co2_monitor_hl/scd30_power.c -o duty_cycle_sim -lm
+ *   ./duty_cycle_sim [hours]
+ *
+ * Reports how long each boot waited for a fresh measurement and how far the readings drifted from the RTC's
+ * period grid, with the wake-up aligned to the sensor and with plain deadlines, for a sensor clock on time, fast
+ * and slow. A boot that comes up just after a measurement waits a whole interval. The energy integrated over the
+ * run with the model's currents is set against dutyCycle_energyPerSampleMj, for the SCD30 policies and the
+ * always-on app.
+ */
+
+// time() is the simulated RTC, the store is a RAM copy of the record
+#include <time.h>
+#define time(t) SimTime(t)
+static time_t SimTime(time_t* t);
+#include "../../co2_monitor_hl/duty_cycle.c"
+#undef time
+
+#include <stdlib.h>
+
+#define READY_POLL_S 0.1			// main.c SCD30_READY_POLL_MS
+#define READ_S 0.3					// read, filter and log once data is ready
+#define UPLOAD_DELAY_S 1.0			// dutyCycleUploadTimer
+#define CONNECT_S 6.0
+#define FLUSH_S 5.0					// main.c DUTY_CYCLE_FLUSH_MS
+#define SENSOR_PHASE_S 6.3			// first measurement after the sensor was started
+
+static double simNowS;
+static uint32_t residencyS;
+static bool poweredDown;
+static DUTY_CYCLE_STATE stored;
+static bool storedValid;
+static uint32_t storeWrites, batchMessages;
+
+static time_t SimTime(time_t* t)
+{
+	return (time_t)simNowS;
+}
+
+bool store_readRecord(STORE_RECORD record, void* data, size_t length)
+{
+	if (storedValid)
+	{
+		memcpy(data, &stored, length);
+	}
+	return storedValid;
+}
+
+bool store_writeRecord(STORE_RECORD record, const void* data, size_t length)
+{
+	memcpy(&stored, data, length);
+	storedValid = true;
+	storeWrites++;
+	return true;
+}
+
+bool dx_azureMsgSendWithProperties(const char* msg, DX_MESSAGE_PROPERTY** messageProperties, size_t messagePropertyCount)
+{
+	batchMessages++;
+	return true;
+}
+
+int PowerManagement_ForceSystemPowerDown(unsigned int maximumResidencyInSeconds)
+{
+	residencyS = maximumResidencyInSeconds;
+	poweredDown = true;
+	return 0;
+}
+
+typedef struct
+{
+	uint32_t cycles;
+	uint32_t uploads;
+	double waitSumS, waitMaxS;		// app up until data ready
+	double driftMaxS;				// reading against first reading + n periods
+	double reading24S;				// time of the 24th reading
+	double awakeS, uploadS;
+	double energyMj;
+} SIM_RESULT;
+
+static void Simulate(double hours, bool aligned, double sensorErrorPct, SIM_RESULT* r)
+{
+	const DUTY_ENERGY_MODEL* model = &dutyCycleDefaultEnergyModel;
+	uint16_t intervalS = scd30Power_measurementInterval(SCD30_POWER_LONG_INTERVAL, DUTY_CYCLE_PERIOD_SECONDS);
+	SCD30_POWER_ESTIMATE sensor;
+	double sensorIntervalS = intervalS * (1 + sensorErrorPct / 100), wakeS = 0, firstReadingS = 0;
+
+	memset(r, 0, sizeof(*r));
+	storedValid = false;
+	storeWrites = batchMessages = 0;
+	while (wakeS < hours * 3600)
+	{
+		double upS = wakeS + model->bootSeconds, readyS, readS, waitS;
+		bool upload;
+
+		// A power-down exit is a reboot, the cycle state comes back from the store
+		stateLoaded = false;
+		poweredDown = false;
+
+		readyS = SENSOR_PHASE_S + ceil((upS - SENSOR_PHASE_S) / sensorIntervalS) * sensorIntervalS;
+		readS = upS + ceil((readyS - upS) / READY_POLL_S - 1e-9) * READY_POLL_S;
+		waitS = readS - upS;
+		r->waitSumS += waitS;
+		r->waitMaxS = waitS > r->waitMaxS ? waitS : r->waitMaxS;
+		if (r->cycles == 0)
+		{
+			firstReadingS = readS;
+		}
+		else if (fabs(readS - firstReadingS - r->cycles * DUTY_CYCLE_PERIOD_SECONDS) > r->driftMaxS)
+		{
+			r->driftMaxS = fabs(readS - firstReadingS - r->cycles * DUTY_CYCLE_PERIOD_SECONDS);
+		}
+		if (r->cycles == 23)
+		{
+			r->reading24S = readS;
+		}
+
+		simNowS = readS + READ_S;
+		upload = dutyCycle_recordSample(612.0f, 22.5f, 41.0f, false);
+		if (!aligned)
+		{
+			state.lastSensorReady = 0;
+		}
+		if (upload)
+		{
+			simNowS += UPLOAD_DELAY_S + CONNECT_S;
+			dutyCycle_uploadBatch(NULL, 0);
+			simNowS += FLUSH_S;
+			r->uploads++;
+			r->uploadS += UPLOAD_DELAY_S + CONNECT_S + FLUSH_S;
+		}
+		dutyCycle_powerDown(intervalS, SCD30_POWER_LONG_INTERVAL);
+		if (!poweredDown)
+		{
+			printf("power-down not requested\n");
+			exit(1);
+		}
+
+		r->awakeS += simNowS - wakeS;
+		wakeS = simNowS + residencyS;
+		r->cycles++;
+	}
+
+	// MT3620 awake, transmitting or powered down, the SCD30 at its policy's average throughout
+	scd30Power_estimate(SCD30_POWER_LONG_INTERVAL, DUTY_CYCLE_PERIOD_SECONDS, &sensor);
+	r->energyMj = model->supplyVolts * (model->activeMa * (r->awakeS - r->uploadS) + model->uploadMa * r->uploadS +
+		model->powerDownMa * (wakeS - r->awakeS) + sensor.averageMa * wakeS);
+}
+
+static void Report(const char* label, double sensorErrorPct, const SIM_RESULT* r)
+{
+	printf("%-18s SCD30 interval %+4.1f%%: %3u cycles, %2u uploads, wait for data %6.2f s mean %6.2f s max, drift %5.1f s, "
+		"awake %5.1f s/cycle, %5.0f mJ/sample\n", label, sensorErrorPct, r->cycles, r->uploads, r->waitSumS / r->cycles,
+		r->waitMaxS, r->driftMaxS, r->awakeS / r->cycles, r->energyMj / r->cycles);
+}
+
+int main(int argc, char* argv[])
+{
+	static const double sensorErrorsPct[] = { 0, 0.5, -0.5 };
+	double hours = argc > 1 ? atof(argv[1]) : 24;
+	SIM_RESULT aligned, plain;
+
+	printf("%.0f h, %d s period, SCD30 %s at %u s, upload every %d cycles\n", hours, DUTY_CYCLE_PERIOD_SECONDS,
+		scd30Power_policyName(SCD30_POWER_LONG_INTERVAL),
+		scd30Power_measurementInterval(SCD30_POWER_LONG_INTERVAL, DUTY_CYCLE_PERIOD_SECONDS), DUTY_CYCLE_UPLOAD_EVERY);
+	for (size_t i = 0; i < sizeof(sensorErrorsPct) / sizeof(sensorErrorsPct[0]); i++)
+	{
+		Simulate(hours, false, sensorErrorsPct[i], &plain);
+		Report("plain deadlines", sensorErrorsPct[i], &plain);
+		Simulate(hours, true, sensorErrorsPct[i], &aligned);
+		Report("aligned to sensor", sensorErrorsPct[i], &aligned);
+		if (i == 0)
+		{
+			printf("%u storage writes (%.2f per cycle), %u batch messages, 24th reading at %.1f s against %.1f s\n",
+				storeWrites, (double)storeWrites / aligned.cycles, batchMessages, aligned.reading24S,
+				SENSOR_PHASE_S + 23 * DUTY_CYCLE_PERIOD_SECONDS);
+		}
+	}
+	printf("model: %.1f J/sample duty-cycled (SCD30 %s), %.1f J/sample (SCD30 %s), %.1f J/sample always on\n",
+		dutyCycle_energyPerSampleMj(&dutyCycleDefaultEnergyModel, SCD30_POWER_LONG_INTERVAL, DUTY_CYCLE_PERIOD_SECONDS,
+			DUTY_CYCLE_UPLOAD_EVERY) / 1000,
+		scd30Power_policyName(SCD30_POWER_LONG_INTERVAL),
+		dutyCycle_energyPerSampleMj(&dutyCycleDefaultEnergyModel, SCD30_POWER_CONTINUOUS, DUTY_CYCLE_PERIOD_SECONDS,
+			DUTY_CYCLE_UPLOAD_EVERY) / 1000,
+		scd30Power_policyName(SCD30_POWER_CONTINUOUS),
+		dutyCycle_energyPerSampleMj(&dutyCycleDefaultEnergyModel, SCD30_POWER_CONTINUOUS, DUTY_CYCLE_PERIOD_SECONDS, 0) / 1000);
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Host simulation of the SCD30 power policies in scd30_power.c. Each policy's command sequence, as main.c issues
+ * it, runs against a simulated sensor for a number of hours: periodic measurement with its own interval and
+ * phase, stopped and restarted under stop-start, and readings taken on measureSensorTimer, which the scheduler
+ * may run up to its 1 s tolerance early. The charge drawn, the age of the measurement each reading returns and
+ * the measurements taken since a restart are compared with scd30Power_estimate's model. The run is split into
+ * SIM_BOOTS boots so the sensor's measurement phase against the reads is averaged.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -I../intercore-standin/shim scd30_power_sim.c -o scd30_power_sim -lm
+ *   ./scd30_power_sim [hours]
+ */
+
+#include "../../co2_monitor_hl/scd30_power.c"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define READ_TOLERANCE_MS 1000		// measureSensorTimer toleranceMs
+#define STEP_MS 10
+#define SIM_BOOTS 16
+
+typedef struct
+{
+	double chargeMas;
+	double ageSeconds;
+	uint32_t readings;
+	uint32_t warmReadings;			// stop-start readings with fewer than SCD30_POWER_WARMUP_SAMPLES behind them
+	uint32_t measurements;
+} SIM_RESULT;
+
+// Deterministic uniform in [0, 1)
+static double Uniform(uint32_t* seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return (*seed >> 8) / (double)(1u << 24);
+}
+
+static void Simulate(SCD30_POWER_POLICY policy, uint32_t periodSeconds, double hours, uint32_t seed, SIM_RESULT* result)
+{
+	uint64_t endMs = (uint64_t)(hours * 3600000.0), periodMs = (uint64_t)periodSeconds * 1000u;
+	uint64_t intervalMs = (uint64_t)scd30Power_measurementInterval(policy, periodSeconds) * 1000u;
+	uint64_t deadlineMs = periodMs, readMs, restartMs = 0, nextMeasurementMs, lastMeasurementMs = 0;
+	uint32_t sinceRestart = 0;
+	bool measuring = true;
+
+	// The sensor's measurement phase is unrelated to the app's deadlines
+	nextMeasurementMs = (uint64_t)(Uniform(&seed) * (double)intervalMs);
+	readMs = deadlineMs - (uint64_t)(Uniform(&seed) * READ_TOLERANCE_MS);
+
+	for (uint64_t nowMs = 0; nowMs < endMs; nowMs += STEP_MS)
+	{
+		result->chargeMas += SCD30_IDLE_MA * STEP_MS / 1000.0;
+
+		if (!measuring && policy == SCD30_POWER_STOP_START && nowMs >= restartMs)
+		{
+			measuring = true;
+			sinceRestart = 0;
+			nextMeasurementMs = nowMs + intervalMs;
+		}
+		if (measuring && nowMs >= nextMeasurementMs)
+		{
+			result->chargeMas += SCD30_MEASUREMENT_MAS;
+			result->measurements++;
+			lastMeasurementMs = nowMs;
+			sinceRestart++;
+			nextMeasurementMs += intervalMs;
+		}
+
+		if (nowMs >= readMs)
+		{
+			result->readings++;
+			result->ageSeconds += (double)(nowMs - lastMeasurementMs) / 1000.0;
+			if (policy == SCD30_POWER_STOP_START)
+			{
+				if (sinceRestart < SCD30_POWER_WARMUP_SAMPLES)
+				{
+					result->warmReadings++;
+				}
+				// Scd30PowerAfterReading: stop now, restart a warm-up ahead of the next deadline
+				measuring = false;
+				restartMs = deadlineMs + periodMs - scd30Power_warmupMs();
+			}
+			deadlineMs += periodMs;
+			readMs = deadlineMs - (uint64_t)(Uniform(&seed) * READ_TOLERANCE_MS);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	double hours = argc > 1 ? atof(argv[1]) : 240;
+	static const uint32_t periods[] = { 20, 60, 300 };
+	SCD30_POWER_ESTIMATE model;
+	SIM_RESULT sim;
+	double simMa;
+
+	printf("%.0f simulated hours, readings up to %d ms early\n", hours, READ_TOLERANCE_MS);
+	printf("period  policy          model mA  sim mA  model mJ/reading  sim mJ/reading  model age s  sim age s  under-warmed\n");
+	for (size_t p = 0; p < sizeof(periods) / sizeof(periods[0]); p++)
+	{
+		for (int policy = SCD30_POWER_CONTINUOUS; policy <= SCD30_POWER_STOP_START; policy++)
+		{
+			scd30Power_estimate(policy, periods[p], &model);
+			sim = (SIM_RESULT){ 0 };
+			for (uint32_t boot = 0; boot < SIM_BOOTS; boot++)
+			{
+				Simulate(policy, periods[p], hours / SIM_BOOTS, boot * 7919u + 1u, &sim);
+			}
+
+			simMa = sim.chargeMas / (hours * 3600.0);
+			printf("%4u s  %-14s  %8.2f  %6.2f  %16.0f  %14.0f  %11.1f  %9.1f  %u of %u\n", periods[p], scd30Power_policyName(policy),
+				model.averageMa, simMa, model.energyMjPerReading, sim.chargeMas * SCD30_SUPPLY_VOLTS / sim.readings,
+				model.stalenessSeconds, sim.ageSeconds / sim.readings, sim.warmReadings, sim.readings);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Host shim for the duty-cycle simulation: power-down is served by duty_cycle_sim.c
+#include <stdint.h>
+
+int PowerManagement_ForceSystemPowerDown(unsigned int maximumResidencyInSeconds);
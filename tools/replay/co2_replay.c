@@ -0,0 +1,139 @@
+/*
+ * Host replay of a CO2 trace through the app's own sample path: co2_filter, co2_alert and co2_forecast.
+ * Reports how far ahead of each alert the forecast warned and how close its predicted crossing time was.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl co2_replay.c ../../co2_monitor_hl/co2_filter.c ../../co2_monitor_hl/co2_alert.c \
+ *       ../../co2_monitor_hl/co2_forecast.c -o co2_replay -lm
+ *   ./co2_replay trace.csv 1000
+ *
+ * The trace is one "seconds,co2" line per reading, seconds monotonic, lines starting with '#' are skipped.
+ * An unreadable reading may be given as nan.
+ */
+
+#include "co2_alert.h"
+#include "co2_filter.h"
+#include "co2_forecast.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_WARNINGS 4096
+
+typedef struct
+{
+	double seconds;
+	double predictedSeconds;	// crossing time predicted when the warning was raised
+	double crossedSeconds;		// NAN when the warning cleared without an alert
+} WARNING;
+
+static WARNING warnings[MAX_WARNINGS];
+static int warningCount = 0;
+
+static int CompareDoubles(const void* a, const void* b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+static double Percentile(double* values, int count, int percent)
+{
+	if (count == 0)
+	{
+		return NAN;
+	}
+	qsort(values, (size_t)count, sizeof(double), CompareDoubles);
+	return values[(count - 1) * percent / 100];
+}
+
+int main(int argc, char* argv[])
+{
+	FILE* trace;
+	char line[128];
+	double seconds, co2, leads[MAX_WARNINGS], errors[MAX_WARNINGS];
+	float filtered, alertLevel;
+	uint32_t quality;
+	uint64_t nowUs;
+	CO2_FORECAST_STATE state;
+	int samples = 0, alerts = 0, warned = 0, falseWarnings = 0, leadCount = 0;
+	bool pending = false;
+
+	if (argc != 3 || (trace = fopen(argv[1], "r")) == NULL)
+	{
+		fprintf(stderr, "usage: %s <trace.csv> <alert level ppm>\n", argv[0]);
+		return 1;
+	}
+	alertLevel = strtof(argv[2], NULL);
+
+	while (fgets(line, sizeof(line), trace))
+	{
+		if (line[0] == '#' || sscanf(line, "%lf,%lf", &seconds, &co2) != 2)
+		{
+			continue;
+		}
+		samples++;
+		nowUs = (uint64_t)(seconds * 1e6);
+
+		filtered = co2Filter_apply((float)co2, nowUs, &quality);
+		if (isnan(filtered))
+		{
+			continue;
+		}
+
+		// Same order as ProcessSample: the alert sees the reading before the forecast
+		if (co2Alert_evaluate(filtered, alertLevel, nowUs) == CO2_ALERT_RAISED)
+		{
+			alerts++;
+			if (pending)
+			{
+				warned++;
+				warnings[warningCount - 1].crossedSeconds = seconds;
+				pending = false;
+			}
+		}
+
+		switch (co2Forecast_update(filtered, co2Alert_isActive() ? NAN : alertLevel, nowUs))
+		{
+		case CO2_FORECAST_WARNING:
+			co2Forecast_getState(&state);
+			if (warningCount < MAX_WARNINGS)
+			{
+				warnings[warningCount++] = (WARNING){ seconds, seconds + state.secondsToLevel, NAN };
+				pending = true;
+			}
+			break;
+		case CO2_FORECAST_CLEARED:
+			// The alert being raised clears the warning on the same reading
+			if (pending)
+			{
+				falseWarnings++;
+				pending = false;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	fclose(trace);
+
+	for (int i = 0; i < warningCount; i++)
+	{
+		if (!isnan(warnings[i].crossedSeconds))
+		{
+			leads[leadCount] = warnings[i].crossedSeconds - warnings[i].seconds;
+			errors[leadCount++] = fabs(warnings[i].crossedSeconds - warnings[i].predictedSeconds);
+		}
+	}
+
+	co2Forecast_getState(&state);
+	printf("%d readings, %d alerts at %.0f ppm, %d forecast warnings (%u readings clipped)\n",
+		samples, alerts, alertLevel, warningCount, state.clipped);
+	printf("warned ahead of %d/%d alerts, %d warnings cleared without an alert\n", warned, alerts, falseWarnings);
+	if (leadCount)
+	{
+		printf("lead time s: p10 %.0f, p50 %.0f, p90 %.0f\n",
+			Percentile(leads, leadCount, 10), Percentile(leads, leadCount, 50), Percentile(leads, leadCount, 90));
+		printf("crossing time error s: p50 %.0f, p90 %.0f\n", Percentile(errors, leadCount, 50), Percentile(errors, leadCount, 90));
+	}
+	return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Host replay of a site pressure trace through the app's pressure_compensation.c. The SCD30 reading is simulated
+ * as the true CO2 scaled by the actual pressure over the pressure the sensor compensates for, 1013.25 mbar when
+ * uncompensated, so the replay reports how far readings are from the true CO2 and how many restarts each way
+ * of compensating costs per day.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl pressure_replay.c ../../co2_monitor_hl/pressure_compensation.c \
+ *       -o pressure_replay -lm
+ *   ./pressure_replay trace.csv [site mbar]
+ *
+ * The trace is one "seconds,mbar,ppm" line per reading: the actual pressure and the true CO2. The site pressure,
+ * by default the first pressure in the trace, stands for a fixed pressure set as the default or in the twin.
+ * The barometer is simulated with a 0.3 mbar offset and 0.05 mbar of noise.
+ */
+
+#include "pressure_compensation.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MAX_READINGS 500000
+#define UNCOMPENSATED_MBAR 1013.25
+#define BAROMETER_OFFSET_MBAR 0.3
+#define BAROMETER_NOISE_MBAR 0.05
+
+static double traceSeconds[MAX_READINGS];
+static float traceMbar[MAX_READINGS], tracePpm[MAX_READINGS];
+static float errors[MAX_READINGS];		// |reading - true CO2|, in trace order
+
+static int CompareFloats(const void* a, const void* b)
+{
+	float x = *(const float*)a, y = *(const float*)b;
+	return (x > y) - (x < y);
+}
+
+// Deterministic uniform noise in [-1, 1], the same sequence for every run
+static double Noise(uint32_t* seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return (*seed >> 8) / (double)(1u << 23) - 1.0;
+}
+
+static void Replay(const char* label, int count, float siteMbar, float thresholdMbar, bool barometer)
+{
+	PRESSURE_COMPENSATION_CONFIG config = *pressureCompensation_getConfig();
+	PRESSURE_COMPENSATION_STATE state;
+	uint32_t seed = 1;
+	uint16_t mbar, applied = 0;
+	uint64_t nowUs;
+	double sum = 0, days = (traceSeconds[count - 1] - traceSeconds[0]) / 86400;
+	float reading;
+
+	config.defaultMbar = siteMbar;
+	config.thresholdMbar = thresholdMbar;
+	pressureCompensation_configure(&config);
+
+	for (int i = 0; i < count; i++)
+	{
+		nowUs = (uint64_t)((traceSeconds[i] - traceSeconds[0]) * 1e6);
+		if (barometer)
+		{
+			pressureCompensation_addBarometer((float)(traceMbar[i] + BAROMETER_OFFSET_MBAR + BAROMETER_NOISE_MBAR * Noise(&seed)), nowUs);
+		}
+		if (siteMbar != 0.0f && pressureCompensation_update(nowUs, &mbar))
+		{
+			pressureCompensation_written(true, mbar, nowUs);
+			applied = mbar;
+		}
+
+		reading = (float)(tracePpm[i] * traceMbar[i] / (applied ? applied : UNCOMPENSATED_MBAR));
+		errors[i] = fabsf(reading - tracePpm[i]);
+		sum += errors[i];
+	}
+
+	pressureCompensation_getState(&state);
+	qsort(errors, (size_t)count, sizeof(float), CompareFloats);
+	printf("%-24s mean |error| %6.1f ppm, p95 %6.1f ppm, max %6.1f ppm, %6.2f writes/day, %u held back\n", label,
+		sum / count, errors[count * 95 / 100], errors[count - 1], state.writes / days, state.deferred);
+}
+
+// The module keeps its state in statics, each replay runs in a child so it starts from boot
+static void ReplayFresh(const char* label, int count, float siteMbar, float thresholdMbar, bool barometer)
+{
+	pid_t child;
+
+	fflush(stdout);
+	child = fork();
+	if (child == 0)
+	{
+		Replay(label, count, siteMbar, thresholdMbar, barometer);
+		fflush(stdout);
+		_exit(0);
+	}
+	waitpid(child, NULL, 0);
+}
+
+int main(int argc, char* argv[])
+{
+	FILE* trace;
+	char line[128];
+	double seconds, mbar, ppm;
+	float siteMbar;
+	int count = 0;
+	char label[32];
+	static const float thresholds[] = { 1.0f, 2.0f, 5.0f, 10.0f };
+
+	if (argc < 2 || (trace = fopen(argv[1], "r")) == NULL)
+	{
+		fprintf(stderr, "usage: %s <trace.csv> [site mbar]\n", argv[0]);
+		return 1;
+	}
+	while (count < MAX_READINGS && fgets(line, sizeof(line), trace) != NULL)
+	{
+		if (sscanf(line, "%lf,%lf,%lf", &seconds, &mbar, &ppm) == 3)
+		{
+			traceSeconds[count] = seconds;
+			traceMbar[count] = (float)mbar;
+			tracePpm[count] = (float)ppm;
+			count++;
+		}
+	}
+	fclose(trace);
+	if (count < 2)
+	{
+		fprintf(stderr, "no readings in %s\n", argv[1]);
+		return 1;
+	}
+	siteMbar = argc > 2 ? (float)atof(argv[2]) : traceMbar[0];
+
+	printf("%d readings over %.1f days, site pressure %.0f mbar\n", count, (traceSeconds[count - 1] - traceSeconds[0]) / 86400, siteMbar);
+
+	ReplayFresh("uncompensated", count, 0.0f, 0.0f, false);
+	ReplayFresh("site pressure", count, siteMbar, pressureCompensation_getConfig()->thresholdMbar, false);
+	for (size_t i = 0; i < sizeof(thresholds) / sizeof(thresholds[0]); i++)
+	{
+		snprintf(label, sizeof(label), "barometer, %.0f mbar", thresholds[i]);
+		ReplayFresh(label, count, siteMbar, thresholds[i], true);
+	}
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Host replay of an SCD30 temperature trace through the app's temperature_calibration.c. The sensor offset is
+ * simulated, so the replay reports when the calibration converged, what it wrote and how far the corrected
+ * readings are from the true ambient temperature before and after.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl temperature_replay.c ../../co2_monitor_hl/temperature_calibration.c \
+ *       -o temperature_replay -lm
+ *   ./temperature_replay trace.csv [reference at seconds]
+ *
+ * The trace is one "seconds,raw,ambient" line per reading: the sensor's reading with no offset applied and the
+ * true ambient temperature. With a reference time the ambient temperature at that time is sent as the reference,
+ * again every minute while the calibration turns it away during the warm-up.
+ */
+
+#include "temperature_calibration.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_READINGS 200000
+
+static float errors[MAX_READINGS];		// |reading - ambient|, in trace order
+
+static int CompareFloats(const void* a, const void* b)
+{
+	float x = *(const float*)a, y = *(const float*)b;
+	return (x > y) - (x < y);
+}
+
+static void Report(const char* label, float* values, int count)
+{
+	double sum = 0;
+
+	if (count == 0)
+	{
+		return;
+	}
+	for (int i = 0; i < count; i++)
+	{
+		sum += values[i];
+	}
+	qsort(values, (size_t)count, sizeof(float), CompareFloats);
+	printf("%s: %d readings, mean |error| %.3f C, p95 %.3f C\n", label, count, sum / count, values[count * 95 / 100]);
+}
+
+int main(int argc, char* argv[])
+{
+	FILE* trace;
+	char line[128];
+	double seconds, raw, ambient, referenceAt = argc > 2 ? atof(argv[2]) : -1;
+	float offsetC = 0.0f, newOffsetC, reading;
+	TEMPERATURE_CALIBRATION_STATE state;
+	bool started = false, referenceSent = false;
+	double referenceRetry = 0;
+	int count = 0, lastWrite = -1;
+
+	if (argc < 2 || (trace = fopen(argv[1], "r")) == NULL)
+	{
+		fprintf(stderr, "usage: %s <trace.csv> [reference at seconds]\n", argv[0]);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), trace))
+	{
+		if (line[0] == '#' || sscanf(line, "%lf,%lf,%lf", &seconds, &raw, &ambient) != 3)
+		{
+			continue;
+		}
+		if (!started)
+		{
+			temperatureCalibration_start(offsetC, TEMPERATURE_OFFSET_UNCALIBRATED, (uint64_t)(seconds * 1e6));
+			started = true;
+		}
+		if (!referenceSent && referenceAt >= 0 && seconds >= referenceAt && seconds >= referenceRetry)
+		{
+			referenceSent = temperatureCalibration_setReference((float)ambient, (uint64_t)(seconds * 1e6));
+			if (!referenceSent)
+			{
+				printf("%.0f s: reference turned away during the warm-up\n", seconds);
+				referenceRetry = seconds + 60;
+			}
+		}
+
+		// The sensor subtracts its offset, the write lands before the next reading as it does 20 ms after it
+		reading = (float)(raw - offsetC);
+		if (count < MAX_READINGS)
+		{
+			errors[count++] = fabsf(reading - (float)ambient);
+		}
+		if (temperatureCalibration_update(reading, (uint64_t)(seconds * 1e6), &newOffsetC))
+		{
+			offsetC = newOffsetC;
+			temperatureCalibration_written(offsetC);
+			temperatureCalibration_getState(&state);
+			printf("%.0f s: offset %.2f C written (%s), converged in %u s\n", seconds, offsetC,
+				state.source == TEMPERATURE_OFFSET_REFERENCE ? "reference" : "warm-up", state.convergedSeconds);
+			lastWrite = count;
+		}
+	}
+	fclose(trace);
+
+	temperatureCalibration_getState(&state);
+	printf("self-heating fit %.2f C, time constant %.0f s, reference error %.2f C, %u writes\n",
+		state.selfHeatingC, state.timeConstantSeconds, state.referenceErrorC, state.writes);
+	// Only the readings after the last write count as calibrated
+	if (lastWrite < 0)
+	{
+		lastWrite = count;
+	}
+	Report("before calibration", errors, lastWrite);
+	Report("after calibration", errors + lastWrite, count - lastWrite);
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Host validation of the app's ventilation.c, the least-squares air change estimate, on generated CO2 traces.
+ * Each trace integrates the mass balance dC/dt = G - ACH * (C - outdoor) for a room of the default volume at a
+ * set air change rate, with occupancy steps driving G and uniform sensor noise on every reading, and feeds the
+ * readings to ventilation_update at the app's 20 s reading period.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl ventilation_validate.c ../../co2_monitor_hl/ventilation.c -o ventilation_validate -lm
+ *   ./ventilation_validate
+ *
+ * Every case states the air change rate it must recover and the error allowed, or that no rate may come out of
+ * it: a decay too short to fit, one read too sparsely to fit, which must count as rejected, and a trace that
+ * only rises. A decay is fitted when it ends, so decay traces end with people back in the room. The exit code is
+ * the number of failed cases.
+ */
+
+#include "ventilation.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NELEMS(a) (sizeof(a) / sizeof(a[0]))
+#define READING_SECONDS 20
+#define STEP_SECONDS 1					// integration step
+#define MAX_PHASES 6
+
+typedef struct
+{
+	uint32_t seconds;
+	uint8_t people;
+} PHASE;
+
+typedef struct
+{
+	const char* name;
+	float airChangesPerHour;
+	float noisePpm;						// readings are off by up to this much either way
+	uint32_t readingSeconds;			// 0 for READING_SECONDS
+	PHASE phases[MAX_PHASES];			// occupancy steps, in order
+	bool expectRate;					// false when no rate may be fitted
+	bool expectRejected;				// a decay must be turned down by the fit
+	float tolerance;					// allowed error, fraction of airChangesPerHour
+} CASE;
+
+static uint32_t seed = 1;
+
+// Deterministic uniform in [-1, 1), the same sequence for every run
+static double Noise(void)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) / (double)(1u << 23) - 1.0;
+}
+
+static bool Run(const CASE* c, const VENTILATION_CONFIG* config)
+{
+	double co2 = config->outdoorPpm, error;
+	uint32_t readingSeconds = c->readingSeconds ? c->readingSeconds : READING_SECONDS, t = 0, readings = 0;
+	float lastOccupancy = NAN;
+	VENTILATION_ESTIMATE estimate;
+	bool pass;
+
+	seed = 1;
+	ventilation_configure(config);
+	for (size_t p = 0; p < MAX_PHASES && c->phases[p].seconds != 0; p++)
+	{
+		// ppm per hour from the people in the room
+		double generation = c->phases[p].people * config->personM3PerHour * 1e6 / config->roomVolumeM3;
+
+		for (uint32_t end = t + c->phases[p].seconds; t < end; t += STEP_SECONDS)
+		{
+			co2 += (generation - c->airChangesPerHour * (co2 - config->outdoorPpm)) * STEP_SECONDS / 3600.0;
+			if (t % readingSeconds == 0)
+			{
+				ventilation_update((float)(co2 + c->noisePpm * Noise()), (uint64_t)t * 1000000u + 1);
+				readings++;
+			}
+		}
+		ventilation_getEstimate(&estimate);
+		if (c->phases[p].people != 0)
+		{
+			lastOccupancy = estimate.occupancy;
+		}
+	}
+
+	ventilation_getEstimate(&estimate);
+	error = fabs(estimate.airChangesPerHour - c->airChangesPerHour);
+	pass = c->expectRate ? !isnan(estimate.airChangesPerHour) && error <= c->tolerance * c->airChangesPerHour :
+		isnan(estimate.airChangesPerHour) && estimate.decaysFitted == 0 && (!c->expectRejected || estimate.decaysRejected > 0);
+
+	printf("%-4s %-32s ACH %4.2f: ", pass ? "ok" : "FAIL", c->name, c->airChangesPerHour);
+	if (c->expectRate)
+	{
+		printf("fitted %5.3f, error %5.1f%% (allowed %2.0f%%)", estimate.airChangesPerHour,
+			100 * error / c->airChangesPerHour, 100 * c->tolerance);
+	}
+	else
+	{
+		printf("fitted %5.3f, none allowed", estimate.airChangesPerHour);
+	}
+	printf(", %u decays fitted, %u rejected, %u readings, occupancy %.1f at the end of the last occupied step\n",
+		estimate.decaysFitted, estimate.decaysRejected, readings, lastOccupancy);
+	return pass;
+}
+
+int main(int argc, char* argv[])
+{
+	// Occupancy steps as seconds and people, every decay ended by people coming back
+	static const CASE cases[] = {
+		{ "clean decay", 0.5f, 0, 0, { { 7200, 8 }, { 21600, 0 }, { 1800, 8 } }, true, false, 0.02f },
+		{ "clean decay", 1.0f, 0, 0, { { 7200, 8 }, { 14400, 0 }, { 1800, 8 } }, true, false, 0.02f },
+		{ "clean decay", 3.0f, 0, 0, { { 3600, 8 }, { 7200, 0 }, { 1800, 8 } }, true, false, 0.02f },
+		{ "noisy decay", 0.5f, 10, 0, { { 7200, 8 }, { 21600, 0 }, { 1800, 8 } }, true, false, 0.10f },
+		{ "noisy decay", 1.0f, 10, 0, { { 7200, 8 }, { 14400, 0 }, { 1800, 8 } }, true, false, 0.10f },
+		{ "noisy decay", 3.0f, 10, 0, { { 3600, 8 }, { 7200, 0 }, { 1800, 8 } }, true, false, 0.10f },
+		{ "occupancy steps, two decays", 1.0f, 10, 0, { { 3600, 4 }, { 3600, 12 }, { 10800, 0 }, { 5400, 6 }, { 14400, 0 }, { 1800, 8 } }, true, false, 0.10f },
+		// The fit assumes an empty room, a decay with people still leaving reads low
+		{ "people leave in steps", 1.5f, 10, 0, { { 5400, 10 }, { 1800, 5 }, { 1800, 2 }, { 10800, 0 }, { 1800, 8 } }, true, false, 0.30f },
+		{ "decay too short to fit", 1.0f, 10, 0, { { 7200, 8 }, { 900, 0 }, { 7200, 8 } }, false, false, 0 },
+		{ "decay read too sparsely", 1.0f, 10, 1300, { { 7200, 8 }, { 2000, 0 }, { 7200, 8 } }, false, true, 0 },
+		{ "rising only", 1.0f, 10, 0, { { 3600, 2 }, { 3600, 6 }, { 3600, 12 } }, false, false, 0 },
+	};
+	VENTILATION_CONFIG config = *ventilation_getConfig();
+	int failed = 0;
+
+	printf("%.0f m3 room, %.0f ppm outdoor, readings every %d s\n", config.roomVolumeM3, config.outdoorPpm, READING_SECONDS);
+	for (size_t i = 0; i < NELEMS(cases); i++)
+	{
+		failed += !Run(&cases[i], &config);
+	}
+	printf("%d of %zu cases failed\n", failed, NELEMS(cases));
+	return failed;
+}
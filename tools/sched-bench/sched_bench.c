@@ -0,0 +1,201 @@
+/*
+ * Host benchmark for the app's scheduler.c on a simulated clock. The task set mirrors the periodic tasks and
+ * one-shots in main.c, steady state with the device connected, and a simulated day is run through the real
+ * scheduler. Reports wakeups per hour against one wakeup per task run, which is what separate timers cost,
+ * and how early or late tasks ran against their deadlines.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -I../intercore-standin/shim sched_bench.c -o sched_bench
+ *   ./sched_bench [hours]
+ *
+ * Handlers take no time, so lateness is the scheduler's own.
+ */
+
+// The scheduler's clock and timerfd run on simulated time
+#define clock_gettime SimClockGettime
+#define timerfd_create SimTimerfdCreate
+#define timerfd_settime SimTimerfdSettime
+#define read SimRead
+#define close SimClose
+#include "../../co2_monitor_hl/scheduler.c"
+#undef clock_gettime
+#undef timerfd_create
+#undef timerfd_settime
+#undef read
+#undef close
+
+#include <stdlib.h>
+
+#define NELEMS(a) (sizeof(a) / sizeof(a[0]))
+#define SIM_FD 3
+#define CO2_ALERT_CADENCE_MS 10000		// co2_alert.c defaults
+#define CO2_ALERT_BUZZER_ON_MS 500
+#define SGP30_CONVERSION_MS 12
+
+static uint64_t simNowUs = 1000000;
+static uint64_t simWakeUs = 0;			// 0 when disarmed
+static EventLoopIoCallback* simCallback = NULL;
+static int64_t earliestUs = 0, latestUs = 0;
+
+int SimClockGettime(clockid_t clock, struct timespec* ts)
+{
+	ts->tv_sec = (time_t)(simNowUs / 1000000u);
+	ts->tv_nsec = (long)(simNowUs % 1000000u) * 1000;
+	return 0;
+}
+
+int SimTimerfdCreate(int clock, int flags)
+{
+	return SIM_FD;
+}
+
+int SimTimerfdSettime(int fd, int flags, const struct itimerspec* value, struct itimerspec* old)
+{
+	simWakeUs = (uint64_t)value->it_value.tv_sec * 1000000u + (uint64_t)value->it_value.tv_nsec / 1000u;
+	return 0;
+}
+
+ssize_t SimRead(int fd, void* buffer, size_t count)
+{
+	*(uint64_t*)buffer = 1;
+	return (ssize_t)sizeof(uint64_t);
+}
+
+int SimClose(int fd)
+{
+	return 0;
+}
+
+EventRegistration* EventLoop_RegisterIo(EventLoop* el, int fd, EventLoop_IoEvents eventBitmask, EventLoopIoCallback* callback, void* context)
+{
+	simCallback = callback;
+	return (EventRegistration*)&simCallback;
+}
+
+int EventLoop_UnregisterIo(EventLoop* el, EventRegistration* reg)
+{
+	simCallback = NULL;
+	return 0;
+}
+
+uint64_t trace_nowUs(void)
+{
+	return simNowUs;
+}
+
+void trace_end(TRACE_SPAN span, uint64_t startUs)
+{
+}
+
+static void Ran(SCHED_TASK* task)
+{
+	int64_t offset = (int64_t)(simNowUs - task->lastDeadlineUs);
+
+	earliestUs = offset < earliestUs ? offset : earliestUs;
+	latestUs = offset > latestUs ? offset : latestUs;
+}
+
+static void Nothing(SCHED_TASK* task);
+static void FlashLeds(SCHED_TASK* task);
+static void CO2Alert(SCHED_TASK* task);
+static void SensorPoll(SCHED_TASK* task);
+
+// Periods, tolerances and priorities as in main.c
+static SCHED_TASK flashLEDsTimer = { .name = "flashLEDsTimer", .handler = FlashLeds, .periodMs = 1400, .toleranceMs = 50, .priority = 2 };
+static SCHED_TASK flashLedOffTimer = { .name = "flashLedOffTimer", .handler = Nothing, .toleranceMs = 50, .priority = 2 };
+static SCHED_TASK measureSensorTimer = { .name = "measureSensorTimer", .handler = Nothing, .periodMs = 20000, .toleranceMs = 1000, .priority = 1 };
+static SCHED_TASK publishTelemetryTimer = { .name = "publishTelemetryTimer", .handler = Nothing, .periodMs = 30000, .toleranceMs = 2000, .priority = 3 };
+static SCHED_TASK co2AlertTimer = { .name = "co2AlertTimer", .handler = CO2Alert, .toleranceMs = 100, .priority = 0 };
+static SCHED_TASK co2AlertBuzzerOffOneShotTimer = { .name = "co2AlertBuzzerOffOneShotTimer", .handler = Nothing, .priority = 0 };
+static SCHED_TASK publishVentilationTimer = { .name = "publishVentilationTimer", .handler = Nothing, .periodMs = 15 * 60 * 1000, .toleranceMs = 30000, .priority = 4 };
+static SCHED_TASK publishDiagnosticsTimer = { .name = "publishDiagnosticsTimer", .handler = Nothing, .periodMs = 300000, .toleranceMs = 10000, .priority = 4 };
+static SCHED_TASK sensorPollTimer = { .name = "sensorPollTimer", .handler = SensorPoll, .priority = 2 };
+
+static SCHED_TASK* timerSet[] = { &flashLEDsTimer, &flashLedOffTimer, &measureSensorTimer, &publishTelemetryTimer, &co2AlertTimer,
+	&co2AlertBuzzerOffOneShotTimer, &publishVentilationTimer, &publishDiagnosticsTimer, &sensorPollTimer };
+
+static void Nothing(SCHED_TASK* task)
+{
+	Ran(task);
+}
+
+// Connected: on for 1300 ms, off for 100 ms
+static void FlashLeds(SCHED_TASK* task)
+{
+	Ran(task);
+	sched_runAt(&flashLedOffTimer, task->lastDeadlineUs + 1300 * 1000);
+}
+
+static void CO2Alert(SCHED_TASK* task)
+{
+	Ran(task);
+	sched_runAfter(&co2AlertBuzzerOffOneShotTimer, CO2_ALERT_BUZZER_ON_MS);
+}
+
+// The SGP30 through the sensor registry: a start, the read one conversion later, the next start a second after
+static void SensorPoll(SCHED_TASK* task)
+{
+	static bool converting = false;
+	static uint64_t startedUs;
+
+	Ran(task);
+	if (!converting)
+	{
+		startedUs = simNowUs;
+		sched_runAt(task, startedUs + SGP30_CONVERSION_MS * 1000u);
+	}
+	else
+	{
+		sched_runAt(task, startedUs + 1000000u);
+	}
+	converting = !converting;
+}
+
+static void Run(const char* label, double hours, bool alert, bool sgp30)
+{
+	SCHED_STATS stats;
+	uint64_t endUs;
+
+	earliestUs = latestUs = 0;
+	sched_start(NULL, timerSet, NELEMS(timerSet));
+	if (alert)
+	{
+		co2AlertTimer.periodMs = CO2_ALERT_CADENCE_MS;
+		sched_runAfter(&co2AlertTimer, CO2_ALERT_CADENCE_MS);
+	}
+	if (sgp30)
+	{
+		sched_runAfter(&sensorPollTimer, 0);
+	}
+
+	endUs = simNowUs + (uint64_t)(hours * 3600e6);
+	while (simWakeUs != 0 && simWakeUs <= endUs)
+	{
+		simNowUs = simWakeUs;
+		simCallback(NULL, SIM_FD, EventLoop_Input, NULL);
+	}
+	simNowUs = endUs;
+
+	sched_getStats(&stats);
+	printf("%-26s %7.0f task runs/h (separate timers), %7.0f wakeups/h, %5.1f%% saved, %u pulled in, "
+		"earliest %lld ms before, latest %lld us after its deadline\n", label, stats.tasksRun / hours, stats.wakeups / hours,
+		100.0 * (stats.tasksRun - stats.wakeups) / stats.tasksRun, stats.pulledIn, (long long)-earliestUs / 1000, (long long)latestUs);
+
+	sched_stop();
+	for (size_t i = 0; i < NELEMS(timerSet); i++)
+	{
+		timerSet[i]->armed = false;
+		timerSet[i]->lastDeadlineUs = 0;
+	}
+	co2AlertTimer.periodMs = 0;
+}
+
+int main(int argc, char* argv[])
+{
+	double hours = argc > 1 ? atof(argv[1]) : 24;
+
+	printf("%.1f simulated hours\n", hours);
+	Run("connected", hours, false, false);
+	Run("connected, alert raised", hours, true, false);
+	Run("connected, SGP30 fitted", hours, false, true);
+	return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * Host benchmark of sample staleness through the app's send_window.c on a simulated clock. The SCD30 is read every
+ * 20 s, telemetry carrying the latest reading goes out every 30 s through sendWindow_sendSample, and the hub
+ * acknowledges each message 150-900 ms after it is handed to the SDK. The link drops for 2 minutes every hour;
+ * messages in flight then are acknowledged after the reconnect. Reports p50/p99 of each stage of the pipeline
+ * sendWindow_sendSample traces: capture to enqueue, send wait, confirm, and capture to cloud end to end.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -I../twin-bench/shim -I../intercore-standin/shim sample_latency_bench.c \
+ *       -o sample_latency_bench
+ *   ./sample_latency_bench [hours]
+ *
+ * The reads run 5 s after the telemetry phase. On the device the phase is set by when the SCD30 came up.
+ */
+
+// Trace spans run on the simulated clock, and the per-sample confirmation log is left out
+#include <time.h>
+#define clock_gettime SimClockGettime
+static int SimClockGettime(clockid_t clock, struct timespec* ts);
+#include "../../co2_monitor_hl/trace.c"
+#undef clock_gettime
+#include <applibs/log.h>
+#undef Log_Debug
+#define Log_Debug(...) ((void)0)
+#include "../../co2_monitor_hl/send_window.c"
+
+#include <stdlib.h>
+
+#define STEP_MS 10
+#define SAMPLE_PERIOD_MS 20000
+#define SAMPLE_PHASE_MS 5000
+#define TELEMETRY_PERIOD_MS 30000
+#define OUTAGE_START_MS (30 * 60 * 1000)	// into every hour
+#define OUTAGE_MS (2 * 60 * 1000)
+#define ACK_MIN_MS 150
+#define ACK_MAX_MS 900
+#define MAX_MESSAGES 200000
+
+typedef struct IOTHUB_MESSAGE_HANDLE_DATA
+{
+	uint64_t captureMs;
+	uint32_t sendWaitMs;
+} MESSAGE;
+
+typedef struct
+{
+	bool inUse;
+	uint64_t submittedMs;
+	uint64_t doneMs;
+	MESSAGE message;
+	IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+	void* context;
+} HUB_SLOT;
+
+typedef enum
+{
+	STAGE_ENQUEUE,
+	STAGE_SEND_WAIT,
+	STAGE_CONFIRM,
+	STAGE_END_TO_END,
+	STAGE_COUNT
+} STAGE;
+
+static const char* const stageNames[STAGE_COUNT] = { "capture to enqueue", "send wait", "confirm", "end to end" };
+
+static uint64_t simNowMs;
+static bool connected = true;
+static uint32_t seed = 1;
+static HUB_SLOT hub[SEND_WINDOW_MAX_MESSAGES];
+static uint32_t stageMs[STAGE_COUNT][MAX_MESSAGES];
+static size_t confirmedCount;
+
+static int SimClockGettime(clockid_t clock, struct timespec* ts)
+{
+	ts->tv_sec = (time_t)(simNowMs / 1000u);
+	ts->tv_nsec = (long)(simNowMs % 1000u) * 1000000;
+	return 0;
+}
+
+static uint32_t AckDelayMs(void)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return ACK_MIN_MS + (seed >> 8) % (ACK_MAX_MS - ACK_MIN_MS + 1);
+}
+
+bool dx_azureIsConnected(void)
+{
+	return connected;
+}
+
+IOTHUB_DEVICE_CLIENT_LL_HANDLE dx_azureClientHandleGet(void)
+{
+	return NULL;
+}
+
+// The message text carries the capture time, the send wait comes in as its property
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
+{
+	MESSAGE* message = calloc(1, sizeof(MESSAGE));
+
+	message->captureMs = strtoull(strstr(source, "\"CapturedAt\":") + 13, NULL, 10);
+	return message;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetProperty(IOTHUB_MESSAGE_HANDLE handle, const char* key, const char* value)
+{
+	if (strcmp(key, SEND_WINDOW_WAIT_PROPERTY) == 0)
+	{
+		handle->sendWaitMs = (uint32_t)strtoul(value, NULL, 10);
+	}
+	return IOTHUB_MESSAGE_OK;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE handle, const char* contentType)
+{
+	return IOTHUB_MESSAGE_OK;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE handle, const char* contentEncoding)
+{
+	return IOTHUB_MESSAGE_OK;
+}
+
+void IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE handle)
+{
+	free(handle);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendEventAsync(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle, IOTHUB_MESSAGE_HANDLE message,
+	IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback, void* context)
+{
+	for (size_t i = 0; i < SEND_WINDOW_MAX_MESSAGES; i++)
+	{
+		if (!hub[i].inUse)
+		{
+			hub[i] = (HUB_SLOT){ .inUse = true, .submittedMs = simNowMs, .doneMs = simNowMs + AckDelayMs(), .message = *message,
+				.callback = callback, .context = context };
+			return IOTHUB_CLIENT_OK;
+		}
+	}
+	return IOTHUB_CLIENT_ERROR;
+}
+
+static void RunHub(void)
+{
+	for (size_t i = 0; connected && i < SEND_WINDOW_MAX_MESSAGES; i++)
+	{
+		HUB_SLOT* slot = &hub[i];
+
+		if (!slot->inUse || simNowMs < slot->doneMs)
+		{
+			continue;
+		}
+		slot->inUse = false;
+		if (confirmedCount < MAX_MESSAGES)
+		{
+			uint64_t enqueuedMs = slot->submittedMs - slot->message.sendWaitMs;
+
+			stageMs[STAGE_ENQUEUE][confirmedCount] = (uint32_t)(enqueuedMs - slot->message.captureMs);
+			stageMs[STAGE_SEND_WAIT][confirmedCount] = slot->message.sendWaitMs;
+			stageMs[STAGE_CONFIRM][confirmedCount] = (uint32_t)(simNowMs - slot->submittedMs);
+			stageMs[STAGE_END_TO_END][confirmedCount] = (uint32_t)(simNowMs - slot->message.captureMs);
+			confirmedCount++;
+		}
+		slot->callback(IOTHUB_CLIENT_CONFIRMATION_OK, slot->context);
+	}
+}
+
+// The link comes back: what was in flight is resent and acknowledged afresh
+static void Reconnect(void)
+{
+	connected = true;
+	for (size_t i = 0; i < SEND_WINDOW_MAX_MESSAGES; i++)
+	{
+		if (hub[i].inUse && hub[i].doneMs <= simNowMs)
+		{
+			hub[i].doneMs = simNowMs + AckDelayMs();
+		}
+	}
+}
+
+static int CompareUint32(const void* a, const void* b)
+{
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[])
+{
+	double hours = argc > 1 ? atof(argv[1]) : 24;
+	uint64_t runMs = (uint64_t)(hours * 3600 * 1000), captureMs = 0;
+	SEND_WINDOW_STATS stats;
+	char msg[96];
+	bool captured = false;
+
+	trace_init();
+	for (simNowMs = 0; simNowMs < runMs; simNowMs += STEP_MS)
+	{
+		uint64_t inHourMs = simNowMs % (3600 * 1000);
+
+		if (connected && inHourMs >= OUTAGE_START_MS && inHourMs < OUTAGE_START_MS + OUTAGE_MS)
+		{
+			connected = false;
+		}
+		else if (!connected && inHourMs >= OUTAGE_START_MS + OUTAGE_MS)
+		{
+			Reconnect();
+		}
+
+		if (simNowMs % SAMPLE_PERIOD_MS == SAMPLE_PHASE_MS)
+		{
+			captureMs = simNowMs;
+			captured = true;
+		}
+		if (simNowMs % TELEMETRY_PERIOD_MS == 0 && captured)
+		{
+			snprintf(msg, sizeof(msg), "{ \"CO2\": 612.00, \"CapturedAt\":%llu }", (unsigned long long)captureMs);
+			sendWindow_sendSample(SEND_KIND_TELEMETRY, msg, NULL, 0, captureMs * 1000);
+		}
+		RunHub();
+		// The LED tick services the backlog while connected
+		if (simNowMs % 1000 == 0 && connected)
+		{
+			sendWindow_service();
+		}
+	}
+
+	sendWindow_getStats(&stats);
+	printf("%.0f h, reads every %d s, telemetry every %d s, hub ack %d-%d ms, %d min outage every hour\n", hours,
+		SAMPLE_PERIOD_MS / 1000, TELEMETRY_PERIOD_MS / 1000, ACK_MIN_MS, ACK_MAX_MS, OUTAGE_MS / 60000);
+	printf("%u sent, %zu confirmed, %u aggregated, %u dropped\n", stats.sent, confirmedCount, stats.aggregated, stats.dropped);
+	for (int stage = 0; stage < STAGE_COUNT; stage++)
+	{
+		qsort(stageMs[stage], confirmedCount, sizeof(uint32_t), CompareUint32);
+		printf("  %-20s p50 %6u ms  p99 %6u ms  max %6u ms\n", stageNames[stage], stageMs[stage][confirmedCount / 2],
+			stageMs[stage][confirmedCount * 99 / 100], stageMs[stage][confirmedCount - 1]);
+	}
+	return 0;
+}
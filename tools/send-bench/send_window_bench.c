@@ -0,0 +1,234 @@
+/*
+ * Host benchmark of the app's send_window.c on a simulated clock, against a link that delivers one message at a
+ * time and confirms it when delivered. The traffic mirrors main.c: CO2 telemetry and secondary sensor readings
+ * every 30 s, ventilation every 10 minutes, diagnostics and trace statistics every 5 minutes, the boot timeline
+ * once, and alert, rule and forecast edges. The window is serviced every second, as the LED tick does.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -I../twin-bench/shim -I../intercore-standin/shim send_window_bench.c \
+ *       ../../co2_monitor_hl/send_window.c -o send_window_bench
+ *   ./send_window_bench [link ms per message]
+ *
+ * Each policy runs from boot over one hour, with a 40 s link by default. Reports the SDK queue depth, how many
+ * messages of each kind were made and delivered once the backlog has drained, and how many events were lost.
+ */
+
+// Trace spans run on the simulated clock
+#include <time.h>
+#define clock_gettime SimClockGettime
+static int SimClockGettime(clockid_t clock, struct timespec* ts);
+#include "../../co2_monitor_hl/trace.c"
+#undef clock_gettime
+
+#include "send_window.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define RUN_MS (3600 * 1000)
+#define LINK_MAX 64						// more than the window ever hands the SDK
+
+typedef struct
+{
+	IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+	void* context;
+	SEND_KIND kind;
+} LINK_MESSAGE;
+
+static const char* const kindNames[] = { "telemetry", "sensors", "ventilation", "alert", "diagnostics", "trace", "boot" };
+#define KIND_COUNT (sizeof(kindNames) / sizeof(kindNames[0]))
+
+static uint64_t simNowMs;
+static uint32_t linkMs = 40000;
+static LINK_MESSAGE linkQueue[LINK_MAX];
+static size_t linkHead, linkCount, linkMaxDepth;
+static uint64_t linkDoneMs;
+static uint32_t made[KIND_COUNT], delivered[KIND_COUNT];
+
+static int SimClockGettime(clockid_t clock, struct timespec* ts)
+{
+	ts->tv_sec = (time_t)(simNowMs / 1000u);
+	ts->tv_nsec = (long)(simNowMs % 1000u) * 1000000;
+	return 0;
+}
+
+bool dx_azureIsConnected(void)
+{
+	return true;
+}
+
+IOTHUB_DEVICE_CLIENT_LL_HANDLE dx_azureClientHandleGet(void)
+{
+	return NULL;
+}
+
+// A message is its text, the kind is read back from it
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
+{
+	return (IOTHUB_MESSAGE_HANDLE)strdup(source);
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetProperty(IOTHUB_MESSAGE_HANDLE handle, const char* key, const char* value)
+{
+	return IOTHUB_MESSAGE_OK;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE handle, const char* contentType)
+{
+	return IOTHUB_MESSAGE_OK;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE handle, const char* contentEncoding)
+{
+	return IOTHUB_MESSAGE_OK;
+}
+
+void IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE handle)
+{
+	free(handle);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendEventAsync(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle, IOTHUB_MESSAGE_HANDLE message,
+	IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback, void* context)
+{
+	LINK_MESSAGE* queued;
+
+	if (linkCount == LINK_MAX)
+	{
+		return IOTHUB_CLIENT_ERROR;
+	}
+	queued = &linkQueue[(linkHead + linkCount) % LINK_MAX];
+	queued->callback = callback;
+	queued->context = context;
+	queued->kind = (SEND_KIND)atoi(strstr((const char*)message, "\"Kind\":") + 7);
+	if (linkCount++ == 0)
+	{
+		linkDoneMs = simNowMs + linkMs;
+	}
+	if (linkCount > linkMaxDepth)
+	{
+		linkMaxDepth = linkCount;
+	}
+	return IOTHUB_CLIENT_OK;
+}
+
+// One message crosses the link at a time, confirmed as it arrives
+static void RunLink(void)
+{
+	while (linkCount && simNowMs >= linkDoneMs)
+	{
+		LINK_MESSAGE message = linkQueue[linkHead];
+
+		linkHead = (linkHead + 1) % LINK_MAX;
+		linkCount--;
+		linkDoneMs = simNowMs + linkMs;
+		delivered[message.kind]++;
+		message.callback(IOTHUB_CLIENT_CONFIRMATION_OK, message.context);
+	}
+}
+
+static void Send(SEND_KIND kind)
+{
+	char text[64];
+
+	snprintf(text, sizeof(text), "{\"Kind\":%d,\"Seq\":%u}", (int)kind, made[kind]++);
+	sendWindow_send(kind, text, NULL, 0);
+}
+
+static void Run(SEND_WINDOW_POLICY policy, const char* label)
+{
+	SEND_WINDOW_STATS stats;
+	uint32_t total = 0, lost = 0;
+
+	trace_init();
+	sendWindow_setPolicy(policy);
+	for (simNowMs = 0; simNowMs < RUN_MS; simNowMs += 100)
+	{
+		uint64_t s = simNowMs / 1000;
+
+		if (simNowMs % 1000 != 0)
+		{
+			RunLink();
+			continue;
+		}
+		if (s % 30 == 0)
+		{
+			Send(SEND_KIND_TELEMETRY);
+			Send(SEND_KIND_SENSORS);
+		}
+		if (s % 600 == 300)
+		{
+			Send(SEND_KIND_VENTILATION);
+		}
+		if (s % 300 == 0 && s)
+		{
+			Send(SEND_KIND_DIAGNOSTICS);
+			Send(SEND_KIND_TRACE);
+		}
+		if (s == 5)
+		{
+			Send(SEND_KIND_BOOT_TIMELINE);
+		}
+		// Forecast warning, alert raised, a rule going active, then all of it clearing
+		if (s == 900 || s == 1200 || s == 1210 || s == 2400 || s == 2410 || s == 2420)
+		{
+			Send(SEND_KIND_ALERT);
+		}
+		RunLink();
+		sendWindow_service();
+	}
+	printf("%-12s SDK queue max %2zu", label, linkMaxDepth);
+
+	// Drain what is left, so anything not delivered was given up on by the window
+	do
+	{
+		simNowMs += 100;
+		RunLink();
+		sendWindow_service();
+		sendWindow_getStats(&stats);
+	} while (stats.backlog + stats.inFlight > 0);
+
+	printf(", %u aggregated, %u dropped\n", stats.aggregated, stats.dropped);
+	for (size_t kind = 0; kind < KIND_COUNT; kind++)
+	{
+		printf("  %-12s made %4u delivered %4u\n", kindNames[kind], made[kind], delivered[kind]);
+		total += made[kind];
+	}
+	for (size_t kind = SEND_KIND_ALERT; kind < KIND_COUNT; kind++)
+	{
+		lost += made[kind] - delivered[kind];
+	}
+	printf("  alert, diagnostics, trace and boot messages lost %u\n", lost);
+	printf("  without the window the SDK would hold %u messages at the end\n", total - (uint32_t)(RUN_MS / linkMs));
+}
+
+// The module keeps its state in statics, each policy runs in a child so it starts from boot
+static void RunFresh(SEND_WINDOW_POLICY policy, const char* label)
+{
+	pid_t child;
+
+	fflush(stdout);
+	child = fork();
+	if (child == 0)
+	{
+		Run(policy, label);
+		fflush(stdout);
+		_exit(0);
+	}
+	waitpid(child, NULL, 0);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1)
+	{
+		linkMs = (uint32_t)atoi(argv[1]);
+	}
+	printf("Link delivering one message per %u ms, one hour\n", linkMs);
+	RunFresh(SEND_POLICY_AGGREGATE, "aggregate");
+	RunFresh(SEND_POLICY_DROP_OLDEST, "drop oldest");
+	RunFresh(SEND_POLICY_DROP_NEWEST, "drop newest");
+	return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * Host run of the app's sensor registry, sensor_registry.c, with the real SGP30 and LPS22HH drivers, sgp30.c and
+ * barometer.c, over sensirion_common.c on a simulated bus. The poll task runs at whatever time
+ * sensorRegistry_poll returns, as SensorPollHandler does. The bus answers as the parts do, CRCs included, and
+ * each scenario may hold the barometer off the bus for a while.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -I../intercore-standin/shim sensor_registry_bench.c \
+ *       ../../co2_monitor_hl/sensor_registry.c ../../co2_monitor_hl/sgp30.c ../../co2_monitor_hl/barometer.c \
+ *       ../../co2_monitor_hl/embedded-scd/embedded-common/sensirion_common.c -o sensor_registry_bench
+ *   ./sensor_registry_bench [minutes]
+ *
+ * Reports wakeups, bus operations and readings per sensor. Each sensor is also run on its own, the wakeups
+ * separate timers would need being the sum.
+ */
+
+#include "barometer.h"
+#include "sgp30.h"
+#include "./embedded-scd/embedded-common/sensirion_common.h"
+#include "./embedded-scd/embedded-common/sensirion_i2c.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NELEMS(a) (sizeof(a) / sizeof(a[0]))
+#define SGP30_CMD_GET_FEATURE_SET 0x202F
+#define LPS22HH_WHO_AM_I 0x0F
+#define LPS22HH_ID 0xB3
+
+typedef struct
+{
+	const char* name;
+	bool sgp30;
+	bool barometer;
+	uint32_t barometerOffFromS;			// barometer NACKs everything in [from, until)
+	uint32_t barometerOffUntilS;
+} SCENARIO;
+
+static uint64_t simNowUs;
+static const SCENARIO* scenario;
+static uint16_t sgp30Command;
+static uint8_t barometerRegister;
+static uint32_t sgp30Readings, barometerReadings;
+static uint64_t barometerFirstUs, barometerLastUs;
+static uint32_t barometerBusFailures;
+
+static bool BarometerOff(void)
+{
+	return scenario->barometerOffFromS * 1000000ull <= simNowUs && simNowUs < scenario->barometerOffUntilS * 1000000ull;
+}
+
+int8_t sensirion_i2c_write(uint8_t address, const uint8_t* data, uint16_t count)
+{
+	if (address == SGP30_I2C_ADDRESS && scenario->sgp30 && count >= 2)
+	{
+		sgp30Command = (uint16_t)(data[0] << 8 | data[1]);
+		return STATUS_OK;
+	}
+	if (address == BAROMETER_I2C_ADDRESS && scenario->barometer && !BarometerOff())
+	{
+		barometerRegister = data[0];
+		return STATUS_OK;
+	}
+	barometerBusFailures += address == BAROMETER_I2C_ADDRESS;
+	return STATUS_FAIL;
+}
+
+// Sensirion words carry a CRC after every two bytes
+static void PutWord(uint8_t* data, uint16_t word)
+{
+	data[0] = (uint8_t)(word >> 8);
+	data[1] = (uint8_t)word;
+	data[2] = sensirion_common_generate_crc(data, 2);
+}
+
+int8_t sensirion_i2c_read(uint8_t address, uint8_t* data, uint16_t count)
+{
+	if (address == SGP30_I2C_ADDRESS && scenario->sgp30)
+	{
+		PutWord(data, sgp30Command == SGP30_CMD_GET_FEATURE_SET ? 0x0020 : 415);
+		if (count >= 6)
+		{
+			PutWord(data + 3, 12);
+		}
+		return STATUS_OK;
+	}
+	if (address == BAROMETER_I2C_ADDRESS && scenario->barometer && !BarometerOff())
+	{
+		// 1013.25 mbar is 0x3F5400 at 4096 LSB per mbar
+		static const uint8_t pressure[] = { 0x01, 0x00, 0x54, 0x3F };
+
+		if (barometerRegister == LPS22HH_WHO_AM_I)
+		{
+			data[0] = LPS22HH_ID;
+		}
+		else
+		{
+			memcpy(data, pressure, count < sizeof(pressure) ? count : sizeof(pressure));
+		}
+		return STATUS_OK;
+	}
+	barometerBusFailures += address == BAROMETER_I2C_ADDRESS;
+	return STATUS_FAIL;
+}
+
+void sensirion_sleep_usec(uint32_t useconds)
+{
+	simNowUs += useconds;
+}
+
+static void Reading(const SENSOR_DRIVER* driver, const float* values)
+{
+	if (driver == &sgp30Driver)
+	{
+		sgp30Readings++;
+		return;
+	}
+	if (barometerReadings++ == 0)
+	{
+		barometerFirstUs = simNowUs;
+	}
+	barometerLastUs = simNowUs;
+}
+
+static uint32_t Run(const SCENARIO* s, double minutes)
+{
+	static const SENSOR_DRIVER* const drivers[] = { &sgp30Driver, &barometerDriver };
+	uint64_t endUs = (uint64_t)(minutes * 60e6), nextUs = 0;
+	SENSOR_REGISTRY_STATS stats;
+
+	scenario = s;
+	simNowUs = 0;
+	sgp30Readings = barometerReadings = barometerBusFailures = 0;
+	barometerFirstUs = barometerLastUs = 0;
+	sensorRegistry_init(drivers, NELEMS(drivers), Reading);
+	while (nextUs < endUs)
+	{
+		simNowUs = nextUs;
+		nextUs = sensorRegistry_poll(simNowUs);
+	}
+
+	sensorRegistry_getStats(&stats);
+	printf("%-26s %5u wakeups, %5u operations, most %u in one, %3u starts pulled in\n", s->name, stats.wakeups,
+		stats.operations, stats.maxBatch, stats.pulledIn);
+	printf("%-26s SGP30 %4u readings, barometer %3u readings (first at %5.1f s, last at %6.1f s), %u bus failures, "
+		"%u start/read failures\n", "", sgp30Readings, barometerReadings, barometerFirstUs / 1e6, barometerLastUs / 1e6,
+		barometerBusFailures, stats.failures);
+	return stats.wakeups;
+}
+
+int main(int argc, char* argv[])
+{
+	static const SCENARIO scenarios[] = {
+		{ "SGP30 alone", true, false },
+		{ "barometer alone", false, true },
+		{ "SGP30 and barometer", true, true },
+		{ "barometer off 10-15 min", true, true, 600, 900 },
+		{ "barometer plugged at 5 min", true, true, 0, 300 },
+	};
+	double minutes = argc > 1 ? atof(argv[1]) : 60;
+	uint32_t separate, shared;
+
+	printf("%.0f simulated minutes, SGP30 every %u ms, barometer every %u ms\n", minutes, sgp30Driver.periodMs,
+		barometerDriver.periodMs);
+	separate = Run(&scenarios[0], minutes) + Run(&scenarios[1], minutes);
+	shared = Run(&scenarios[2], minutes);
+	printf("%-26s %5u wakeups shared against %u on separate timers\n", "", shared, separate);
+	for (size_t i = 3; i < NELEMS(scenarios); i++)
+	{
+		Run(&scenarios[i], minutes);
+	}
+	return 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Host run of the app's trace.c through scheduler.c on a simulated clock, writing the Chrome trace the app writes
+ * to its debug output when built with TRACE_CHROME_JSON. The boot spans are recorded as main.c records them, then
+ * the LED, measurement, telemetry and diagnostics tasks run on main.c's periods, each taking a fixed time. A
+ * measurement reads the SCD30, its I2C transactions are recorded through trace_recordDuration as the HAL's
+ * transaction hook does.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -I../intercore-standin/shim chrome_trace_bench.c -o chrome_trace_bench
+ *   ./chrome_trace_bench [minutes] [file]
+ *
+ * Writes chrome_trace.json by default, to be opened in chrome://tracing or ui.perfetto.dev. The file is read
+ * back and every event parsed, and each I2C span is checked to sit inside the MeasureSensor or BootSensorProbe
+ * span that made it.
+ */
+
+// The trace clock, the scheduler's clock and its timerfd run on simulated time
+#include <time.h>
+#define clock_gettime SimClockGettime
+#define timerfd_create SimTimerfdCreate
+#define timerfd_settime SimTimerfdSettime
+#define read SimRead
+#define close SimClose
+int SimClockGettime(clockid_t clock, struct timespec* ts);
+#include "../../co2_monitor_hl/trace.c"
+#include "../../co2_monitor_hl/scheduler.c"
+#undef clock_gettime
+#undef timerfd_create
+#undef timerfd_settime
+#undef read
+#undef close
+
+#include <stdlib.h>
+
+#define NELEMS(a) (sizeof(a) / sizeof(a[0]))
+#define SIM_FD 3
+
+typedef struct
+{
+	char name[32];
+	unsigned long long ts;
+	unsigned dur;
+	int tid;
+} EVENT;
+
+static uint64_t simNowUs = 0;
+static uint64_t simWakeUs = 0;			// 0 when disarmed
+static EventLoopIoCallback* simCallback = NULL;
+static FILE* traceFile;
+static EVENT events[TRACE_RING_EVENTS];
+static uint32_t recorded;
+
+int SimClockGettime(clockid_t clock, struct timespec* ts)
+{
+	ts->tv_sec = (time_t)(simNowUs / 1000000u);
+	ts->tv_nsec = (long)(simNowUs % 1000000u) * 1000;
+	return 0;
+}
+
+int SimTimerfdCreate(int clock, int flags)
+{
+	return SIM_FD;
+}
+
+int SimTimerfdSettime(int fd, int flags, const struct itimerspec* value, struct itimerspec* old)
+{
+	simWakeUs = (uint64_t)value->it_value.tv_sec * 1000000u + (uint64_t)value->it_value.tv_nsec / 1000u;
+	return 0;
+}
+
+ssize_t SimRead(int fd, void* buffer, size_t count)
+{
+	*(uint64_t*)buffer = 1;
+	return (ssize_t)sizeof(uint64_t);
+}
+
+int SimClose(int fd)
+{
+	return 0;
+}
+
+EventRegistration* EventLoop_RegisterIo(EventLoop* el, int fd, EventLoop_IoEvents eventBitmask, EventLoopIoCallback* callback, void* context)
+{
+	simCallback = callback;
+	return (EventRegistration*)&simCallback;
+}
+
+int EventLoop_UnregisterIo(EventLoop* el, EventRegistration* reg)
+{
+	simCallback = NULL;
+	return 0;
+}
+
+static void Work(uint32_t usec)
+{
+	simNowUs += usec;
+}
+
+// One bus transaction, recorded when it ends as the HAL's hook does
+static void I2c(TRACE_SPAN span, uint32_t usec)
+{
+	Work(usec);
+	trace_recordDuration(span, usec);
+	recorded++;
+}
+
+static void FlashLeds(SCHED_TASK* task);
+static void FlashLedOff(SCHED_TASK* task);
+static void MeasureSensor(SCHED_TASK* task);
+static void PublishTelemetry(SCHED_TASK* task);
+static void PublishDiagnostics(SCHED_TASK* task);
+
+// Periods, tolerances, priorities and spans as in main.c
+static SCHED_TASK flashLEDsTimer = { .name = "flashLEDsTimer", .handler = FlashLeds, .periodMs = 1400, .toleranceMs = 50, .priority = 2, .span = TRACE_FLASH_LEDS };
+static SCHED_TASK flashLedOffTimer = { .name = "flashLedOffTimer", .handler = FlashLedOff, .toleranceMs = 50, .priority = 2, .span = TRACE_FLASH_LED_OFF };
+static SCHED_TASK measureSensorTimer = { .name = "measureSensorTimer", .handler = MeasureSensor, .periodMs = 20000, .toleranceMs = 1000, .priority = 1, .span = TRACE_MEASURE_SENSOR };
+static SCHED_TASK publishTelemetryTimer = { .name = "publishTelemetryTimer", .handler = PublishTelemetry, .periodMs = 30000, .toleranceMs = 2000, .priority = 3, .span = TRACE_PUBLISH_TELEMETRY };
+static SCHED_TASK publishDiagnosticsTimer = { .name = "publishDiagnosticsTimer", .handler = PublishDiagnostics, .periodMs = 300000, .toleranceMs = 10000, .priority = 4, .span = TRACE_PUBLISH_DIAGNOSTICS };
+
+static SCHED_TASK* timerSet[] = { &flashLEDsTimer, &flashLedOffTimer, &measureSensorTimer, &publishTelemetryTimer, &publishDiagnosticsTimer };
+
+static void FlashLeds(SCHED_TASK* task)
+{
+	Work(40);
+	sched_runAt(&flashLedOffTimer, task->lastDeadlineUs + 1300 * 1000);
+}
+
+static void FlashLedOff(SCHED_TASK* task)
+{
+	Work(25);
+}
+
+// Data ready, then the 18 byte measurement read
+static void MeasureSensor(SCHED_TASK* task)
+{
+	Work(60);
+	I2c(TRACE_I2C_WRITE, 280);
+	I2c(TRACE_I2C_READ, 430);
+	Work(20);
+	I2c(TRACE_I2C_WRITE, 280);
+	I2c(TRACE_I2C_READ, 1820);
+	Work(350);
+}
+
+static void PublishTelemetry(SCHED_TASK* task)
+{
+	Work(900);
+}
+
+static void PublishDiagnostics(SCHED_TASK* task)
+{
+	Work(2100);
+}
+
+static void Write(const char* text)
+{
+	fputs(text, traceFile);
+}
+
+// Config parse, Azure and I2C init, the SCD30 probe, then the first sample, connection and send
+static void Boot(void)
+{
+	uint64_t startUs;
+
+	trace_init();
+	startUs = trace_nowUs();
+	Work(1800);
+	trace_end(TRACE_BOOT_CONFIG_PARSE, startUs);
+	startUs = trace_nowUs();
+	Work(36000);
+	trace_end(TRACE_BOOT_AZURE_INIT, startUs);
+	startUs = trace_nowUs();
+	Work(900);
+	trace_end(TRACE_BOOT_I2C_INIT, startUs);
+	startUs = trace_nowUs();
+	I2c(TRACE_I2C_WRITE, 280);
+	I2c(TRACE_I2C_READ, 430);
+	trace_end(TRACE_BOOT_SENSOR_PROBE, startUs);
+	recorded += 4;
+}
+
+static void Milestones(void)
+{
+	static const struct
+	{
+		uint64_t atUs;
+		TRACE_SPAN span;
+	} milestones[] = { { 2100000, TRACE_BOOT_FIRST_SAMPLE }, { 5800000, TRACE_BOOT_FIRST_CONNECT }, { 5900000, TRACE_BOOT_FIRST_SEND } };
+
+	for (size_t i = 0; i < NELEMS(milestones); i++)
+	{
+		if (simNowUs >= milestones[i].atUs && spanHistograms[milestones[i].span].count == 0)
+		{
+			trace_bootMilestone(milestones[i].span);
+			recorded++;
+		}
+	}
+}
+
+// Read the file back as JSON lines, one event each
+static size_t Parse(const char* path, bool* wellFormed)
+{
+	char line[256];
+	size_t count = 0;
+	FILE* file = fopen(path, "r");
+
+	*wellFormed = file != NULL && fgets(line, sizeof(line), file) != NULL && strcmp(line, "{\"traceEvents\":[\n") == 0;
+	while (*wellFormed && fgets(line, sizeof(line), file) != NULL && line[0] == '{')
+	{
+		EVENT* e = &events[count];
+
+		*wellFormed = count < TRACE_RING_EVENTS &&
+			sscanf(line, "{\"name\":\"%31[^\"]\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":1,\"tid\":%d}", e->name, &e->ts, &e->dur, &e->tid) == 4;
+		count++;
+	}
+	*wellFormed = *wellFormed && strcmp(line, "],\"displayTimeUnit\":\"ms\"}\n") == 0;
+	if (file != NULL)
+	{
+		fclose(file);
+	}
+	return count;
+}
+
+int main(int argc, char* argv[])
+{
+	double minutes = argc > 1 ? atof(argv[1]) : 2;
+	const char* path = argc > 2 ? argv[2] : "chrome_trace.json";
+	uint64_t endUs;
+	SCHED_STATS schedStats;
+	size_t count, i2c = 0, nested = 0;
+	bool wellFormed;
+
+	Boot();
+	sched_start(NULL, timerSet, NELEMS(timerSet));
+	sched_runAfter(&measureSensorTimer, 2000);
+	endUs = simNowUs + (uint64_t)(minutes * 60e6);
+	while (simWakeUs != 0 && simWakeUs <= endUs)
+	{
+		simNowUs = simWakeUs;
+		simCallback(NULL, SIM_FD, EventLoop_Input, NULL);
+		Milestones();
+	}
+	sched_getStats(&schedStats);
+	sched_stop();
+	recorded += schedStats.tasksRun;
+
+	traceFile = fopen(path, "w");
+	if (traceFile == NULL)
+	{
+		printf("cannot write %s\n", path);
+		return 1;
+	}
+	trace_writeChromeTrace(Write);
+	fclose(traceFile);
+
+	count = Parse(path, &wellFormed);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (events[i].tid != 2)
+		{
+			continue;
+		}
+		i2c++;
+		for (size_t j = 0; j < count; j++)
+		{
+			if ((strcmp(events[j].name, "MeasureSensor") == 0 || strcmp(events[j].name, "BootSensorProbe") == 0) &&
+				events[i].ts >= events[j].ts && events[i].ts + events[i].dur <= events[j].ts + events[j].dur)
+			{
+				nested++;
+				break;
+			}
+		}
+	}
+
+	printf("%.1f simulated minutes, %u spans recorded, the last %u kept\n", minutes, recorded,
+		recorded < TRACE_RING_EVENTS ? recorded : TRACE_RING_EVENTS);
+	printf("%s: %zu events parsed, %s, %zu of %zu I2C spans inside a MeasureSensor or BootSensorProbe span\n", path,
+		count, wellFormed ? "well formed" : "MALFORMED", nested, i2c);
+	return !wellFormed || nested != i2c;
+}
@@ -0,0 +1,148 @@
+/*
+ * Host benchmark of the app's reported_state.c over a simulated day: ActualCO2Level reported with every 30 s
+ * telemetry, CO2 at 450 ppm with +/-5 ppm of noise and a one hour meeting, one desired property change per hour.
+ * Reports twin patches per hour the way main.c sent them before reported_state, one per report and an ack plus
+ * a report per desired change, against reported_state with the 2 s twin window and the 10 ppm tolerance.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -Ishim -I../intercore-standin/shim reported_state_bench.c \
+ *       ../../co2_monitor_hl/reported_state.c -o reported_state_bench -lm
+ *   ./reported_state_bench [days]
+ *
+ * Every patch is checked for raw control characters, and a string ack with control characters in it is
+ * checked for its escapes.
+ */
+
+#include "reported_state.h"
+#include "dx_azure_iot.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DAY_S 86400
+#define TELEMETRY_S 30
+#define TWIN_WINDOW_S 2						// main.c TWIN_WINDOW_MS
+#define CO2_REPORT_TOLERANCE_PPM 10.0f		// main.c
+#define DESIRED_CHANGE_S 1020				// minute 17 of every hour
+#define MEETING_START_S (10 * 3600)
+#define MEETING_END_S (11 * 3600)
+
+static uint32_t patches, patchBytes, rawControl;
+static char lastPatch[REPORTED_STATE_PATCH_BYTES + 1];
+
+bool dx_azureIsConnected(void)
+{
+	return true;
+}
+
+IOTHUB_DEVICE_CLIENT_LL_HANDLE dx_azureClientHandleGet(void)
+{
+	return NULL;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendReportedState(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle, const unsigned char* reportedState,
+	size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK callback, void* context)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		rawControl += reportedState[i] < 0x20;
+	}
+	memcpy(lastPatch, reportedState, size);
+	lastPatch[size] = '\0';
+	patches++;
+	patchBytes += (uint32_t)size;
+	callback(204, context);
+	return IOTHUB_CLIENT_OK;
+}
+
+// Acks too large for reported_state go out on their own
+bool dx_deviceTwinAckDesiredState(DX_DEVICE_TWIN_BINDING* binding, void* state, DX_DEVICE_TWIN_RESPONSE_CODE statusCode)
+{
+	patches++;
+	return true;
+}
+
+// Deterministic uniform noise in [-1, 1], the same sequence for every run
+static double Noise(uint32_t* seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return (double)*seed / 2147483647.5 - 1.0;
+}
+
+// Outdoor air, filling towards 1500 ppm through the meeting and venting afterwards
+static double TrueCO2(int second)
+{
+	if (second < MEETING_START_S)
+	{
+		return 450.0;
+	}
+	if (second < MEETING_END_S)
+	{
+		return 1500.0 - 1050.0 * exp(-(second - MEETING_START_S) / 1200.0);
+	}
+	return 450.0 + (1500.0 - 1050.0 * exp(-3600.0 / 1200.0) - 450.0) * exp(-(second - MEETING_END_S) / 2400.0);
+}
+
+int main(int argc, char* argv[])
+{
+	int days = argc > 1 ? atoi(argv[1]) : 1;
+	uint32_t seed = 1, before = 0;
+	float alertLevel = 1000.0f;
+	int windowEnd = -1;
+	DX_DEVICE_TWIN_BINDING desiredCO2AlertLevel = { .twinProperty = "DesiredCO2AlertLevel", .twinState = &alertLevel, .twinType = DX_TYPE_FLOAT };
+	REPORTED_STATE_STATS stats;
+
+	for (int second = 0; second < days * DAY_S; second++)
+	{
+		bool queued = false;
+
+		if (second % TELEMETRY_S == 0)
+		{
+			float co2 = (float)(TrueCO2(second % DAY_S) + 5.0 * Noise(&seed));
+
+			queued |= reportedState_setFloat("ActualCO2Level", co2, CO2_REPORT_TOLERANCE_PPM);
+			before++;
+		}
+		if (second % 3600 == DESIRED_CHANGE_S)
+		{
+			alertLevel = alertLevel == 1000.0f ? 1100.0f : 1000.0f;
+			desiredCO2AlertLevel.twinVersion++;
+			queued |= reportedState_ack(&desiredCO2AlertLevel, DX_DEVICE_TWIN_COMPLETED);
+			before += 2;
+		}
+
+		if (queued && windowEnd < 0)
+		{
+			windowEnd = second + TWIN_WINDOW_S;
+		}
+		if (second == windowEnd)
+		{
+			reportedState_flush();
+			windowEnd = reportedState_pending() ? second + TWIN_WINDOW_S : -1;
+		}
+	}
+
+	reportedState_getStats(&stats);
+	printf("%d day(s), telemetry every %d s, one desired change per hour\n", days, TELEMETRY_S);
+	printf("  before  %6.1f patches/h\n", before / (days * 24.0));
+	printf("  after   %6.1f patches/h (%u property values sent, %u unchanged values dropped, %u bytes/h)\n",
+		patches / (days * 24.0), stats.properties, stats.suppressed, (uint32_t)(patchBytes / (days * 24.0)));
+
+	// A desired string with control characters must still give valid JSON
+	{
+		char rules[] = "CO2>900\tbuzz\nline\x01";
+		DX_DEVICE_TWIN_BINDING desiredAlertRules = { .twinProperty = "DesiredAlertRules", .twinState = rules, .twinType = DX_TYPE_STRING };
+
+		reportedState_ack(&desiredAlertRules, DX_DEVICE_TWIN_COMPLETED);
+		reportedState_flush();
+		printf("string ack: %s\n", lastPatch);
+		if (strstr(lastPatch, "CO2>900\\u0009buzz\\u000aline\\u0001") == NULL)
+		{
+			printf("FAIL: control characters not escaped\n");
+			return 1;
+		}
+	}
+	printf("raw control characters in patches: %u\n", rawControl);
+	return rawControl != 0;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Host shim for the DevX benches: persistent_store.c is built with STORE_FILE_PATH, this is never called
+int Storage_OpenMutableFile(void);
@@ -0,0 +1,24 @@
+#pragma once
+
+// Host shim for the DevX benches: the SDK calls the app makes, answered by the bench
+#include <azureiot/iothub_message.h>
+#include <stddef.h>
+
+typedef void* IOTHUB_DEVICE_CLIENT_LL_HANDLE;
+typedef enum { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR } IOTHUB_CLIENT_RESULT;
+typedef void (*IOTHUB_CLIENT_REPORTED_STATE_CALLBACK)(int status_code, void* userContextCallback);
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendReportedState(IOTHUB_DEVICE_CLIENT_LL_HANDLE iotHubClientHandle,
+	const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback);
+
+typedef enum
+{
+	IOTHUB_CLIENT_CONFIRMATION_OK,
+	IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY,
+	IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT,
+	IOTHUB_CLIENT_CONFIRMATION_ERROR
+} IOTHUB_CLIENT_CONFIRMATION_RESULT;
+typedef void (*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK)(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback);
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendEventAsync(IOTHUB_DEVICE_CLIENT_LL_HANDLE iotHubClientHandle,
+	IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback);
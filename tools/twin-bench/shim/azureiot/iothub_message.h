@@ -0,0 +1,11 @@
+#pragma once
+
+// Host shim for the DevX benches: messages are made and destroyed by the bench
+typedef struct IOTHUB_MESSAGE_HANDLE_DATA* IOTHUB_MESSAGE_HANDLE;
+typedef enum { IOTHUB_MESSAGE_OK, IOTHUB_MESSAGE_ERROR } IOTHUB_MESSAGE_RESULT;
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source);
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetProperty(IOTHUB_MESSAGE_HANDLE handle, const char* key, const char* value);
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE handle, const char* contentType);
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE handle, const char* contentEncoding);
+void IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE handle);
@@ -0,0 +1,16 @@
+#pragma once
+
+// Host shim for the DevX benches: connection state, message properties and the SDK handle, served by the bench
+#include "dx_device_twins.h"
+#include <azureiot/iothub_device_client_ll.h>
+#include <stdbool.h>
+
+typedef struct
+{
+	const char* key;
+	const char* value;
+} DX_MESSAGE_PROPERTY;
+
+bool dx_azureIsConnected(void);
+bool dx_azureMsgSendWithProperties(const char* msg, DX_MESSAGE_PROPERTY** messageProperties, size_t messagePropertyCount);
+IOTHUB_DEVICE_CLIENT_LL_HANDLE dx_azureClientHandleGet(void);
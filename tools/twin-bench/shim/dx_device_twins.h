@@ -0,0 +1,35 @@
+#pragma once
+
+// Host shim for the DevX benches: the twin binding as the app uses it, see ../reported_state_bench.c
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum
+{
+	DX_TYPE_UNKNOWN,
+	DX_TYPE_BOOL,
+	DX_TYPE_FLOAT,
+	DX_TYPE_DOUBLE,
+	DX_TYPE_INT,
+	DX_TYPE_STRING
+} DX_DEVICE_TWIN_TYPE;
+
+typedef enum
+{
+	DX_DEVICE_TWIN_COMPLETED = 200,
+	DX_DEVICE_TWIN_ERROR = 500,
+	DX_DEVICE_TWIN_INVALID = 404
+} DX_DEVICE_TWIN_RESPONSE_CODE;
+
+typedef struct _deviceTwinBinding
+{
+	const char* twinProperty;
+	void* twinState;
+	int twinVersion;
+	bool twinStateUpdated;
+	DX_DEVICE_TWIN_TYPE twinType;
+	void (*handler)(struct _deviceTwinBinding* deviceTwinBinding);
+	void* context;
+} DX_DEVICE_TWIN_BINDING;
+
+bool dx_deviceTwinAckDesiredState(DX_DEVICE_TWIN_BINDING* deviceTwinBinding, void* state, DX_DEVICE_TWIN_RESPONSE_CODE statusCode);
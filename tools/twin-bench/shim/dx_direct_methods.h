@@ -0,0 +1,3 @@
+#pragma once
+
+// Host shim for the DevX benches: no bench invokes a direct method, capability_model.h only needs the header
@@ -0,0 +1,163 @@
+/*
+ * Host load test of a desired-property storm through the app's twin_cache.c, reported_state.c and a file-backed
+ * persistent_store.c, the way main.c wires them: every update is applied, stored in the cache and acked at once,
+ * the ack patch and the cache write wait for the end of the twin window. The storm is what dt.py sends when
+ * driven in a loop, one DesiredCO2AlertLevel patch every 250 ms for 10 minutes. Each twin window is run from boot.
+ *
+ *   gcc -O2 -I../../co2_monitor_hl -Ishim -I../intercore-standin/shim twin_storm.c \
+ *       ../../co2_monitor_hl/twin_cache.c ../../co2_monitor_hl/reported_state.c -o twin_storm -lm
+ *   ./twin_storm [store file]
+ *
+ * CPU time per update covers the handler work and the flushes, storage writes included.
+ */
+
+// Storage writes are counted, the store is a plain file
+#define STORE_FILE_PATH storePath
+static const char* storePath = "twin_storm.store";
+#include <unistd.h>
+#define pwrite CountedPwrite
+static ssize_t CountedPwrite(int fd, const void* buffer, size_t count, off_t offset);
+#include "../../co2_monitor_hl/persistent_store.c"
+#undef pwrite
+
+#include "reported_state.h"
+#include "twin_cache.h"
+#include "dx_azure_iot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#define STORM_PERIOD_MS 250
+#define STORM_MS (10 * 60 * 1000)
+
+static uint32_t patches, patchBytes, storeWrites;
+
+static ssize_t CountedPwrite(int fd, const void* buffer, size_t count, off_t offset)
+{
+	// A record is its data, then its header
+	if (count == sizeof(STORE_HEADER))
+	{
+		storeWrites++;
+	}
+	return pwrite(fd, buffer, count, offset);
+}
+
+bool dx_azureIsConnected(void)
+{
+	return true;
+}
+
+IOTHUB_DEVICE_CLIENT_LL_HANDLE dx_azureClientHandleGet(void)
+{
+	return NULL;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendReportedState(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle, const unsigned char* reportedState,
+	size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK callback, void* context)
+{
+	patches++;
+	patchBytes += (uint32_t)size;
+	callback(204, context);
+	return IOTHUB_CLIENT_OK;
+}
+
+bool dx_deviceTwinAckDesiredState(DX_DEVICE_TWIN_BINDING* binding, void* state, DX_DEVICE_TWIN_RESPONSE_CODE statusCode)
+{
+	patches++;
+	return true;
+}
+
+static double CpuNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// main.c ReportedStateFlushHandler
+static void FlushWindow(void)
+{
+	reportedState_flush();
+	twinCache_flush();
+}
+
+static void Storm(uint32_t windowMs)
+{
+	float alertLevel = 0;
+	DX_DEVICE_TWIN_BINDING desiredCO2AlertLevel = { .twinProperty = "DesiredCO2AlertLevel", .twinState = &alertLevel, .twinType = DX_TYPE_FLOAT };
+	REPORTED_STATE_STATS stats;
+	uint32_t updates = 0;
+	int64_t windowEnd = -1;
+	double start;
+
+	unlink(storePath);
+	start = CpuNs();
+	for (int64_t ms = 0; ms <= STORM_MS + (int64_t)windowMs; ms++)
+	{
+		if (ms < STORM_MS && ms % STORM_PERIOD_MS == 0)
+		{
+			// DesiredCO2AlertLevel handler: apply, cache, ack, open a window
+			alertLevel = 800.0f + (float)(updates % 40) * 10.0f;
+			desiredCO2AlertLevel.twinVersion++;
+			twinCache_store(&desiredCO2AlertLevel);
+			reportedState_ack(&desiredCO2AlertLevel, DX_DEVICE_TWIN_COMPLETED);
+			updates++;
+			if (windowEnd < 0)
+			{
+				windowEnd = ms + windowMs;
+			}
+		}
+		if (ms == windowEnd)
+		{
+			FlushWindow();
+			windowEnd = reportedState_pending() ? ms + windowMs : -1;
+		}
+	}
+
+	reportedState_getStats(&stats);
+	printf("window %5u ms  %4u updates  %4u patches  %6.1f KB sent  %4u storage writes  %3u acks coalesced  %5.2f us CPU/update\n",
+		windowMs, updates, patches, patchBytes / 1024.0, storeWrites, stats.coalesced, (CpuNs() - start) / 1000.0 / updates);
+
+	// The last accepted value is what a reboot would apply
+	twinCache_load();
+	twinCache_get(desiredCO2AlertLevel.twinProperty, DX_TYPE_FLOAT, &alertLevel);
+	if (alertLevel != 800.0f + (float)((updates - 1) % 40) * 10.0f)
+	{
+		printf("FAIL: cache holds %.0f after the storm\n", alertLevel);
+	}
+}
+
+// The modules keep their state in statics, each window runs in a child so it starts from boot
+static void StormFresh(uint32_t windowMs)
+{
+	pid_t child;
+
+	fflush(stdout);
+	child = fork();
+	if (child == 0)
+	{
+		Storm(windowMs);
+		fflush(stdout);
+		_exit(0);
+	}
+	waitpid(child, NULL, 0);
+}
+
+int main(int argc, char* argv[])
+{
+	static const uint32_t windows[] = { 0, 500, 2000, 10000 };
+
+	if (argc > 1)
+	{
+		storePath = argv[1];
+	}
+	printf("DesiredCO2AlertLevel every %d ms for %d minutes\n", STORM_PERIOD_MS, STORM_MS / 60000);
+	for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+	{
+		StormFresh(windows[i]);
+	}
+	unlink(storePath);
+	return 0;
+}